@@ -34,6 +34,674 @@ namespace optixu {
 
 
 
+    WorkerThreadPool::WorkerThreadPool(uint32_t numThreads) : stop(false) {
+        threads.reserve(numThreads);
+        for (uint32_t i = 0; i < numThreads; ++i)
+            threads.emplace_back(&WorkerThreadPool::work, this);
+    }
+
+    WorkerThreadPool::~WorkerThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    void WorkerThreadPool::work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stop || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    void WorkerThreadPool::enqueue(const std::function<void()> &task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(task);
+        }
+        condition.notify_one();
+    }
+
+    void parallelFor(
+        ThreadPool* threadPool, uint32_t numItems, uint32_t minNumItemsPerTask,
+        const std::function<void(uint32_t, uint32_t)> &func) {
+        uint32_t numTasks = 1;
+        if (threadPool && minNumItemsPerTask > 0)
+            numTasks = std::min(
+                threadPool->getNumThreads() + 1,
+                (numItems + minNumItemsPerTask - 1) / minNumItemsPerTask);
+        if (numTasks <= 1) {
+            if (numItems > 0)
+                func(0, numItems);
+            return;
+        }
+
+        struct {
+            std::mutex mutex;
+            std::condition_variable condition;
+            uint32_t numRemainingTasks;
+            std::exception_ptr exception;
+        } state;
+        state.numRemainingTasks = numTasks - 1;
+
+        const auto runTask = [&state, &func, numItems, numTasks](uint32_t taskIdx) {
+            uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(numItems) * taskIdx / numTasks);
+            uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(numItems) * (taskIdx + 1) / numTasks);
+            try {
+                func(begin, end);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (!state.exception)
+                    state.exception = std::current_exception();
+            }
+        };
+
+        for (uint32_t taskIdx = 1; taskIdx < numTasks; ++taskIdx) {
+            threadPool->enqueue([&state, &runTask, taskIdx]() {
+                runTask(taskIdx);
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (--state.numRemainingTasks == 0)
+                    state.condition.notify_one();
+            });
+        }
+        runTask(0);
+
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.condition.wait(lock, [&state]() { return state.numRemainingTasks == 0; });
+        }
+        if (state.exception)
+            std::rethrow_exception(state.exception);
+    }
+
+
+
+    void ModuleCompileJob::dispatch(uint32_t numTasks) {
+        if (!threadPool)
+            return;
+        // JP: ワーカーは実行時にキューの先頭のタスクを取る。待機中の呼び出し元スレッドが先に取った場合は何もしない。
+        // EN: A worker takes the head task of the queue at its execution.
+        //     It does nothing if the waiting calling thread has taken the task first.
+        std::shared_ptr<ModuleCompileJob> self = shared_from_this();
+        for (uint32_t i = 0; i < numTasks; ++i)
+            threadPool->enqueue([self]() { self->executeOne(); });
+    }
+
+    bool ModuleCompileJob::executeOne() {
+        OptixTask task;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queuedTasks.empty())
+                return false;
+            task = queuedTasks.front();
+            queuedTasks.pop_front();
+        }
+
+        std::vector<OptixTask> newTasks(maxNumNewTasksPerExecution);
+        uint32_t numNewTasks = 0;
+        try {
+            taskSource->execute(task, newTasks.data(), maxNumNewTasksPerExecution, &numNewTasks);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!exception)
+                exception = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (exception) {
+                numUnfinishedTasks -= static_cast<uint32_t>(queuedTasks.size());
+                queuedTasks.clear();
+                numNewTasks = 0;
+            }
+            queuedTasks.insert(queuedTasks.end(), newTasks.cbegin(), newTasks.cbegin() + numNewTasks);
+            numUnfinishedTasks += numNewTasks;
+            --numUnfinishedTasks;
+        }
+        condition.notify_all();
+        dispatch(numNewTasks);
+
+        return true;
+    }
+
+    void ModuleCompileJob::start(OptixTask firstTask) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queuedTasks.push_back(firstTask);
+            ++numUnfinishedTasks;
+        }
+        dispatch(1);
+    }
+
+    void ModuleCompileJob::wait() {
+        while (true) {
+            if (executeOne())
+                continue;
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return numUnfinishedTasks == 0 || !queuedTasks.empty(); });
+            if (numUnfinishedTasks == 0)
+                break;
+        }
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+
+
+
+    bool MemoryArenaCore::allocateFromBlock(
+        CUdeviceptr base, Block* block, size_t size, size_t alignment, CUdeviceptr* ptr) {
+        for (auto it = block->freeRanges.begin(); it != block->freeRanges.end(); ++it) {
+            size_t rangeOffset = it->first;
+            size_t rangeSize = it->second;
+            size_t offset = ((base + rangeOffset + alignment - 1) & ~(alignment - 1)) - base;
+            if (offset + size > rangeOffset + rangeSize)
+                continue;
+
+            // JP: 空き範囲を切り分け、アラインメントによる前方の隙間と後方の残りを空き範囲として残す。
+            // EN: Split the free range, leaving the front gap by alignment and the rest behind as free ranges.
+            block->freeRanges.erase(it);
+            if (offset > rangeOffset)
+                block->freeRanges[rangeOffset] = offset - rangeOffset;
+            size_t endOffset = offset + size;
+            if (endOffset < rangeOffset + rangeSize)
+                block->freeRanges[endOffset] = rangeOffset + rangeSize - endOffset;
+            ++block->numAllocations;
+            *ptr = base + offset;
+            return true;
+        }
+        return false;
+    }
+
+    CUdeviceptr MemoryArenaCore::allocate(size_t size, size_t alignment) {
+        optixuAssert(
+            alignment > 0 && (alignment & (alignment - 1)) == 0,
+            "Alignment must be a power of two: %zu.", alignment);
+        size = (std::max<size_t>(size, 1) + alignment - 1) & ~(alignment - 1);
+
+        CUdeviceptr ptr;
+        for (auto &it : blocks) {
+            if (allocateFromBlock(it.first, &it.second, size, alignment, &ptr)) {
+                allocationSizes[ptr] = size;
+                return ptr;
+            }
+        }
+
+        // JP: ブロックの先頭がアラインされていない場合も収まるように余裕を持たせる。
+        // EN: Give some margin so that the request fits even when the block head is not aligned.
+        size_t newBlockSize = std::max(blockSize, size + alignment);
+        CUdeviceptr base = heap->allocate(newBlockSize);
+        Block &block = blocks[base];
+        block.size = newBlockSize;
+        block.freeRanges[0] = newBlockSize;
+        block.numAllocations = 0;
+        bool allocated = allocateFromBlock(base, &block, size, alignment, &ptr);
+        optixuAssert(allocated, "Allocation from a new block must succeed.");
+        (void)allocated;
+        allocationSizes[ptr] = size;
+        return ptr;
+    }
+
+    void MemoryArenaCore::release(CUdeviceptr ptr) {
+        auto itAlloc = allocationSizes.find(ptr);
+        if (itAlloc == allocationSizes.end())
+            _throwRuntimeError("Memory arena: %p is not allocated from this arena.", reinterpret_cast<void*>(ptr));
+        size_t size = itAlloc->second;
+        allocationSizes.erase(itAlloc);
+
+        auto itBlock = std::prev(blocks.upper_bound(ptr));
+        CUdeviceptr base = itBlock->first;
+        Block &block = itBlock->second;
+        --block.numAllocations;
+
+        // JP: 前後の空き範囲と結合する。
+        // EN: Merge with the preceding and following free ranges.
+        size_t offset = ptr - base;
+        auto next = block.freeRanges.lower_bound(offset);
+        if (next != block.freeRanges.end() && next->first == offset + size) {
+            size += next->second;
+            next = block.freeRanges.erase(next);
+        }
+        if (next != block.freeRanges.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset) {
+                prev->second += size;
+                size = 0;
+            }
+        }
+        if (size > 0)
+            block.freeRanges[offset] = size;
+
+        // JP: 専用ブロックは空になった時点で解放する。
+        // EN: Free a dedicated block as soon as it becomes empty.
+        if (block.numAllocations == 0 && block.size > blockSize) {
+            heap->release(base);
+            blocks.erase(itBlock);
+        }
+    }
+
+    void MemoryArenaCore::trim() {
+        for (auto it = blocks.begin(); it != blocks.end();) {
+            if (it->second.numAllocations == 0) {
+                heap->release(it->first);
+                it = blocks.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void MemoryArenaCore::releaseAll() {
+        for (const auto &it : blocks)
+            heap->release(it.first);
+        blocks.clear();
+        allocationSizes.clear();
+    }
+
+    void MemoryArenaCore::getStats(AccelerationStructureMemoryArenaStats* stats) const {
+        *stats = {};
+        size_t freeSize = 0;
+        for (const auto &it : blocks) {
+            const Block &block = it.second;
+            stats->reservedSize += block.size;
+            stats->numFreeRanges += static_cast<uint32_t>(block.freeRanges.size());
+            for (const auto &range : block.freeRanges) {
+                freeSize += range.second;
+                stats->largestFreeRangeSize = std::max(stats->largestFreeRangeSize, range.second);
+            }
+        }
+        stats->numBlocks = static_cast<uint32_t>(blocks.size());
+        stats->numAllocations = static_cast<uint32_t>(allocationSizes.size());
+        stats->usedSize = stats->reservedSize - freeSize;
+        stats->fragmentation = freeSize > 0 ?
+            1.0f - static_cast<float>(stats->largestFreeRangeSize) / freeSize : 0.0f;
+    }
+
+
+
+    // static
+    AccelerationStructureMemoryArena AccelerationStructureMemoryArena::create(size_t blockSize) {
+        AccelerationStructureMemoryArena ret;
+        ret.m = new Priv(blockSize);
+        return ret;
+    }
+
+    void AccelerationStructureMemoryArena::destroy() {
+        if (m)
+            delete m;
+        m = nullptr;
+    }
+
+    BufferView AccelerationStructureMemoryArena::allocate(size_t size, size_t alignment) {
+        CUdeviceptr ptr = m->getCore().allocate(size, alignment);
+        return BufferView(ptr, size, 1);
+    }
+
+    void AccelerationStructureMemoryArena::release(const BufferView &buffer) {
+        m->getCore().release(buffer.getCUdeviceptr());
+    }
+
+    void AccelerationStructureMemoryArena::trim() const {
+        m->getCore().trim();
+    }
+
+    void AccelerationStructureMemoryArena::getStats(AccelerationStructureMemoryArenaStats* stats) const {
+        m->getCore().getStats(stats);
+    }
+
+
+
+    // JP: MurmurHash64Aの各呼び出しを、それまでの状態をシードとして連鎖させる。
+    // EN: Chain MurmurHash64A calls using the state so far as the seed.
+    void ContentHasher::add(const void* data, size_t size) {
+        constexpr uint64_t m = 0xc6a4a7935bd1e995ull;
+        constexpr int r = 47;
+
+        uint64_t h = state ^ (size * m);
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        size_t numWords = size / sizeof(uint64_t);
+        for (size_t i = 0; i < numWords; ++i) {
+            uint64_t k;
+            std::memcpy(&k, bytes + sizeof(uint64_t) * i, sizeof(uint64_t));
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+            h ^= k;
+            h *= m;
+        }
+
+        const uint8_t* tail = bytes + sizeof(uint64_t) * numWords;
+        size_t tailSize = size % sizeof(uint64_t);
+        if (tailSize > 0) {
+            uint64_t k = 0;
+            for (size_t i = 0; i < tailSize; ++i)
+                k |= static_cast<uint64_t>(tail[i]) << (8 * i);
+            h ^= k;
+            h *= m;
+        }
+
+        h ^= h >> r;
+        h *= m;
+        h ^= h >> r;
+        state = h;
+    }
+
+    std::string getASCacheFileName(uint64_t contentHash) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.optixuas", static_cast<unsigned long long>(contentHash));
+        return name;
+    }
+
+    void writeASCacheFile(
+        std::ostream &out, uint64_t contentHash, const OptixRelocationInfo &relocationInfo,
+        const void* data, size_t size) {
+        ContentHasher dataHasher;
+        dataHasher.add(data, size);
+
+        ASCacheFileHeader header = {};
+        std::memcpy(header.magic, s_asCacheFileMagic, sizeof(header.magic));
+        header.version = s_asCacheFileVersion;
+        header.optixVersion = OPTIX_VERSION;
+        header.contentHash = contentHash;
+        header.dataSize = size;
+        header.dataHash = dataHasher.getValue();
+        header.relocationInfo = relocationInfo;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(static_cast<const char*>(data), size);
+    }
+
+    bool readASCacheFile(
+        std::istream &in, uint64_t contentHash,
+        OptixRelocationInfo* relocationInfo, std::vector<uint8_t>* data) {
+        ASCacheFileHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            return false;
+        if (std::memcmp(header.magic, s_asCacheFileMagic, sizeof(header.magic)) != 0 ||
+            header.version != s_asCacheFileVersion ||
+            header.optixVersion != OPTIX_VERSION ||
+            header.contentHash != contentHash)
+            return false;
+
+        // JP: 壊れたファイルのサイズを信用して巨大な確保をしないよう、残りの長さと照合する。
+        // EN: Check against the remaining length so as not to make a huge allocation trusting the size of a corrupt file.
+        std::streampos dataBegin = in.tellg();
+        if (dataBegin == std::streampos(-1) || !in.seekg(0, std::ios::end))
+            return false;
+        std::streampos streamEnd = in.tellg();
+        if (streamEnd == std::streampos(-1) || !in.seekg(dataBegin))
+            return false;
+        if (header.dataSize > static_cast<uint64_t>(streamEnd - dataBegin))
+            return false;
+
+        data->resize(header.dataSize);
+        if (!in.read(reinterpret_cast<char*>(data->data()), header.dataSize))
+            return false;
+        ContentHasher dataHasher;
+        dataHasher.add(data->data(), data->size());
+        if (dataHasher.getValue() != header.dataHash)
+            return false;
+
+        *relocationInfo = header.relocationInfo;
+
+        return true;
+    }
+
+    // JP: nullptrと空文字列を区別するため、長さの代わりに番兵値を加える。
+    // EN: Add a sentinel instead of the length to distinguish nullptr from an empty string.
+    static void hashString(ContentHasher* hasher, const char* str) {
+        if (!str) {
+            hasher->add(~static_cast<size_t>(0));
+            return;
+        }
+        size_t length = std::strlen(str);
+        hasher->add(length);
+        hasher->add(str, length);
+    }
+
+    static void hashPayloadType(ContentHasher* hasher, const OptixPayloadType &payloadType) {
+        hasher->add(payloadType.numPayloadValues);
+        hasher->add(payloadType.payloadSemantics, sizeof(uint32_t) * payloadType.numPayloadValues);
+    }
+
+    void hashPipelineCompileOptions(ContentHasher* hasher, const OptixPipelineCompileOptions &options) {
+        // JP: 構造体のパディングやポインターを含めないようにフィールドごとに加える。
+        // EN: Add field by field so as not to include padding and pointers in the struct.
+        hasher->add(options.usesMotionBlur);
+        hasher->add(options.traversableGraphFlags);
+        hasher->add(options.numPayloadValues);
+        hasher->add(options.numAttributeValues);
+        hasher->add(options.exceptionFlags);
+        hashString(hasher, options.pipelineLaunchParamsVariableName);
+        hasher->add(options.usesPrimitiveTypeFlags);
+        hasher->add(options.allowOpacityMicromaps);
+    }
+
+    uint64_t computeModuleCacheKey(
+        const char* data, size_t size,
+        const OptixModuleCompileOptions &moduleCompileOptions,
+        const OptixPipelineCompileOptions &pipelineCompileOptions) {
+        ContentHasher hasher;
+        hasher.add(size);
+        hasher.add(data, size);
+
+        hasher.add(moduleCompileOptions.maxRegisterCount);
+        hasher.add(moduleCompileOptions.optLevel);
+        hasher.add(moduleCompileOptions.debugLevel);
+        hasher.add(moduleCompileOptions.numBoundValues);
+        for (uint32_t i = 0; i < moduleCompileOptions.numBoundValues; ++i) {
+            const OptixModuleCompileBoundValueEntry &entry = moduleCompileOptions.boundValues[i];
+            hasher.add(entry.pipelineParamOffsetInBytes);
+            hasher.add(entry.sizeInBytes);
+            hasher.add(entry.boundValuePtr, entry.sizeInBytes);
+        }
+        hasher.add(moduleCompileOptions.numPayloadTypes);
+        for (uint32_t i = 0; i < moduleCompileOptions.numPayloadTypes; ++i)
+            hashPayloadType(&hasher, moduleCompileOptions.payloadTypes[i]);
+
+        hashPipelineCompileOptions(&hasher, pipelineCompileOptions);
+
+        return hasher.getValue();
+    }
+
+    bool computeProgramGroupCacheKey(
+        const OptixProgramGroupDesc &desc, const OptixProgramGroupOptions &options,
+        const OptixPipelineCompileOptions &pipelineCompileOptions,
+        const std::unordered_map<OptixModule, uint64_t> &moduleKeys,
+        uint64_t* key) {
+        ContentHasher hasher;
+        const auto addEntry = [&hasher, &moduleKeys](OptixModule module, const char* entryFunctionName) {
+            uint64_t moduleKey = 0;
+            if (module) {
+                if (moduleKeys.count(module) == 0)
+                    return false;
+                moduleKey = moduleKeys.at(module);
+            }
+            hasher.add(moduleKey);
+            hashString(&hasher, entryFunctionName);
+            return true;
+        };
+
+        hasher.add(desc.kind);
+        hasher.add(desc.flags);
+        bool cacheable = true;
+        switch (desc.kind) {
+        case OPTIX_PROGRAM_GROUP_KIND_RAYGEN:
+            cacheable = addEntry(desc.raygen.module, desc.raygen.entryFunctionName);
+            break;
+        case OPTIX_PROGRAM_GROUP_KIND_MISS:
+            cacheable = addEntry(desc.miss.module, desc.miss.entryFunctionName);
+            break;
+        case OPTIX_PROGRAM_GROUP_KIND_EXCEPTION:
+            cacheable = addEntry(desc.exception.module, desc.exception.entryFunctionName);
+            break;
+        case OPTIX_PROGRAM_GROUP_KIND_HITGROUP:
+            cacheable =
+                addEntry(desc.hitgroup.moduleCH, desc.hitgroup.entryFunctionNameCH) &&
+                addEntry(desc.hitgroup.moduleAH, desc.hitgroup.entryFunctionNameAH) &&
+                addEntry(desc.hitgroup.moduleIS, desc.hitgroup.entryFunctionNameIS);
+            break;
+        case OPTIX_PROGRAM_GROUP_KIND_CALLABLES:
+            cacheable =
+                addEntry(desc.callables.moduleDC, desc.callables.entryFunctionNameDC) &&
+                addEntry(desc.callables.moduleCC, desc.callables.entryFunctionNameCC);
+            break;
+        default:
+            cacheable = false;
+            break;
+        }
+        if (!cacheable)
+            return false;
+
+        hasher.add(options.payloadType != nullptr);
+        if (options.payloadType)
+            hashPayloadType(&hasher, *options.payloadType);
+
+        hashPipelineCompileOptions(&hasher, pipelineCompileOptions);
+
+        *key = hasher.getValue();
+        return true;
+    }
+
+    void accumulateStackSizes(const OptixStackSizes &stackSizes, OptixStackSizes* accumulated) {
+        accumulated->cssRG = std::max(accumulated->cssRG, stackSizes.cssRG);
+        accumulated->cssMS = std::max(accumulated->cssMS, stackSizes.cssMS);
+        accumulated->cssCH = std::max(accumulated->cssCH, stackSizes.cssCH);
+        accumulated->cssAH = std::max(accumulated->cssAH, stackSizes.cssAH);
+        accumulated->cssIS = std::max(accumulated->cssIS, stackSizes.cssIS);
+        accumulated->cssCC = std::max(accumulated->cssCC, stackSizes.cssCC);
+        accumulated->dssDC = std::max(accumulated->dssDC, stackSizes.dssDC);
+    }
+
+    void calcPipelineStackSizes(
+        const OptixStackSizes &stackSizes,
+        uint32_t maxTraceDepth, uint32_t maxCCDepth, uint32_t maxDCDepth,
+        uint32_t* directCallableStackSizeFromTraversal,
+        uint32_t* directCallableStackSizeFromState,
+        uint32_t* continuationStackSize) {
+        const uint32_t cssCCTree = maxCCDepth * stackSizes.cssCC;
+        const uint32_t cssCHOrMSPlusCCTree = std::max(stackSizes.cssCH, stackSizes.cssMS) + cssCCTree;
+
+        *directCallableStackSizeFromTraversal = maxDCDepth * stackSizes.dssDC;
+        *directCallableStackSizeFromState = maxDCDepth * stackSizes.dssDC;
+
+        // JP: 最も深いトレース以外ではCH/MSが次のトレースを呼ぶ。
+        //     最も深いトレースではIS+AHがCH/MSより大きい可能性がある。
+        // EN: CH/MS calls the next trace except for the deepest trace.
+        //     In the deepest trace, IS+AH may be larger than CH/MS.
+        *continuationStackSize =
+            stackSizes.cssRG + cssCCTree +
+            (std::max(maxTraceDepth, 1u) - 1) * cssCHOrMSPlusCCTree +
+            std::min(maxTraceDepth, 1u) * std::max(cssCHOrMSPlusCCTree, stackSizes.cssIS + stackSizes.cssAH);
+    }
+
+
+
+    _Material* Context::Priv::createMaterial() {
+        return materialPool.create(this);
+    }
+
+    void Context::Priv::destroyMaterial(_Material* mat) {
+        materialPool.destroy(mat);
+    }
+
+    bool Context::Priv::acquireCachedModule(uint64_t key, OptixModule* rawModule) {
+        std::lock_guard<std::mutex> lock(programCacheMutex);
+        auto it = cachedModules.find(key);
+        if (it == cachedModules.end())
+            return false;
+        ++it->second.refCount;
+        *rawModule = it->second.rawObject;
+        return true;
+    }
+
+    OptixModule Context::Priv::registerCachedModule(uint64_t key, OptixModule rawModule) {
+        std::lock_guard<std::mutex> lock(programCacheMutex);
+        auto it = cachedModules.find(key);
+        if (it != cachedModules.end()) {
+            OPTIX_CHECK(optixModuleDestroy(rawModule));
+            ++it->second.refCount;
+            return it->second.rawObject;
+        }
+        cachedModules[key] = CachedEntry<OptixModule>{ rawModule, 1 };
+        cachedModuleKeys[rawModule] = key;
+        return rawModule;
+    }
+
+    bool Context::Priv::releaseCachedModule(OptixModule rawModule) {
+        std::lock_guard<std::mutex> lock(programCacheMutex);
+        auto keyIt = cachedModuleKeys.find(rawModule);
+        if (keyIt == cachedModuleKeys.end())
+            return false;
+        CachedEntry<OptixModule> &entry = cachedModules.at(keyIt->second);
+        if (--entry.refCount == 0) {
+            OPTIX_CHECK(optixModuleDestroy(rawModule));
+            cachedModules.erase(keyIt->second);
+            cachedModuleKeys.erase(keyIt);
+        }
+        return true;
+    }
+
+    bool Context::Priv::computeProgramGroupCacheKey(
+        const OptixProgramGroupDesc &desc, const OptixProgramGroupOptions &options,
+        const OptixPipelineCompileOptions &pipelineCompileOptions,
+        uint64_t* key) {
+        std::lock_guard<std::mutex> lock(programCacheMutex);
+        return optixu::computeProgramGroupCacheKey(desc, options, pipelineCompileOptions, cachedModuleKeys, key);
+    }
+
+    bool Context::Priv::acquireCachedProgramGroup(uint64_t key, OptixProgramGroup* rawGroup) {
+        std::lock_guard<std::mutex> lock(programCacheMutex);
+        auto it = cachedProgramGroups.find(key);
+        if (it == cachedProgramGroups.end())
+            return false;
+        ++it->second.refCount;
+        *rawGroup = it->second.rawObject;
+        return true;
+    }
+
+    OptixProgramGroup Context::Priv::registerCachedProgramGroup(uint64_t key, OptixProgramGroup rawGroup) {
+        std::lock_guard<std::mutex> lock(programCacheMutex);
+        auto it = cachedProgramGroups.find(key);
+        if (it != cachedProgramGroups.end()) {
+            OPTIX_CHECK(optixProgramGroupDestroy(rawGroup));
+            ++it->second.refCount;
+            return it->second.rawObject;
+        }
+        cachedProgramGroups[key] = CachedEntry<OptixProgramGroup>{ rawGroup, 1 };
+        cachedProgramGroupKeys[rawGroup] = key;
+        return rawGroup;
+    }
+
+    bool Context::Priv::releaseCachedProgramGroup(OptixProgramGroup rawGroup) {
+        std::lock_guard<std::mutex> lock(programCacheMutex);
+        auto keyIt = cachedProgramGroupKeys.find(rawGroup);
+        if (keyIt == cachedProgramGroupKeys.end())
+            return false;
+        CachedEntry<OptixProgramGroup> &entry = cachedProgramGroups.at(keyIt->second);
+        if (--entry.refCount == 0) {
+            OPTIX_CHECK(optixProgramGroupDestroy(rawGroup));
+            cachedProgramGroups.erase(keyIt->second);
+            cachedProgramGroupKeys.erase(keyIt);
+        }
+        return true;
+    }
+
+
+
     // static
     Context Context::create(CUcontext cuContext, uint32_t logLevel, EnableValidation enableValidation) {
         return (new _Context(cuContext, logLevel, enableValidation))->getPublicType();
@@ -82,7 +750,7 @@ namespace optixu {
 
 
     Material Context::createMaterial() const {
-        return (new _Material(m))->getPublicType();
+        return m->createMaterial()->getPublicType();
     }
 
     Scene Context::createScene() const {
@@ -104,8 +772,95 @@ namespace optixu {
         return m->cuContext;
     }
 
+    void Context::setThreadPool(ThreadPool* threadPool) const {
+        m->userThreadPool = threadPool;
+    }
+
+    void Context::setNumWorkerThreads(uint32_t numThreads) const {
+        if (m->workerThreadPool)
+            delete m->workerThreadPool;
+        m->workerThreadPool = nullptr;
+        if (numThreads > 0)
+            m->workerThreadPool = new WorkerThreadPool(numThreads);
+    }
+
+    void Context::setDiskCache(
+        bool enable, const char* location, size_t lowWaterMark, size_t highWaterMark) const {
+        m->throwRuntimeError(
+            lowWaterMark <= highWaterMark,
+            "lowWaterMark must not be greater than highWaterMark.");
+        if (!enable) {
+            OPTIX_CHECK(optixDeviceContextSetCacheEnabled(m->rawContext, 0));
+            return;
+        }
+        // JP: 場所とサイズを先に設定してから有効化することで、既定の場所のキャッシュを開かないようにする。
+        // EN: Set the location and sizes before enabling so as not to open the cache at the default location.
+        if (location)
+            OPTIX_CHECK(optixDeviceContextSetCacheLocation(m->rawContext, location));
+        if (highWaterMark > 0)
+            OPTIX_CHECK(optixDeviceContextSetCacheDatabaseSizes(m->rawContext, lowWaterMark, highWaterMark));
+        OPTIX_CHECK(optixDeviceContextSetCacheEnabled(m->rawContext, 1));
+    }
+
+    bool Context::getDiskCache(std::string* location, size_t* lowWaterMark, size_t* highWaterMark) const {
+        int enabled;
+        OPTIX_CHECK(optixDeviceContextGetCacheEnabled(m->rawContext, &enabled));
+        if (location) {
+            char buffer[4096] = {};
+            OPTIX_CHECK(optixDeviceContextGetCacheLocation(m->rawContext, buffer, sizeof(buffer)));
+            *location = buffer;
+        }
+        if (lowWaterMark || highWaterMark) {
+            size_t low, high;
+            OPTIX_CHECK(optixDeviceContextGetCacheDatabaseSizes(m->rawContext, &low, &high));
+            if (lowWaterMark)
+                *lowWaterMark = low;
+            if (highWaterMark)
+                *highWaterMark = high;
+        }
+        return enabled != 0;
+    }
+
+    void Context::setProgramCacheEnabled(bool enable) const {
+        m->programCacheEnabled = enable;
+    }
+
+    void Context::getProgramCacheStats(uint32_t* numModules, uint32_t* numProgramGroups) const {
+        m->getProgramCacheStats(numModules, numProgramGroups);
+    }
+
 
 
+    Material::Priv::~Priv() {
+        for (const std::pair<_GeometryInstance* const, uint32_t> &user : users)
+            user.first->releaseMaterial(this);
+        // JP: 破棄したマテリアルのデータを次のセットアップで転送しないよう、シーンの配置から取り除く。
+        // EN: Remove this material from the placement of the scenes not to transfer the data of
+        //     the destroyed material at the next setup.
+        std::unordered_set<_Scene*> scenes = std::move(userDataScenes);
+        for (_Scene* scene : scenes)
+            scene->releaseMaterialUserData(this);
+        context->unregisterName(this);
+    }
+
+    void Material::Priv::markSBTLayoutDirty() const {
+        std::unordered_set<_Scene*> scenes = userDataScenes;
+        for (const std::pair<_GeometryInstance* const, uint32_t> &user : users)
+            scenes.insert(user.first->getScene());
+        for (_Scene* scene : scenes)
+            scene->markSBTLayoutDirty();
+    }
+
+    void Material::Priv::markSBTRecordsDirty() const {
+        for (const std::pair<_GeometryInstance* const, uint32_t> &user : users)
+            user.first->getScene()->markSBTRecordsDirty(user.first);
+    }
+
+    void Material::Priv::markUserDataDirty() const {
+        for (const std::pair<_GeometryInstance* const, uint32_t> &user : users)
+            user.first->getScene()->markMaterialUserDataDirty();
+    }
+
     void Material::Priv::setRecordHeader(
         const _Pipeline* pipeline, uint32_t rayType, uint8_t* record, SizeAlign* curSizeAlign) const {
         Key key{ pipeline, rayType };
@@ -126,16 +881,23 @@ namespace optixu {
 
     void Material::destroy() {
         if (m)
-            delete m;
+            m->context->destroyMaterial(m);
         m = nullptr;
     }
 
     void Material::setHitGroup(uint32_t rayType, HitProgramGroup hitGroup) const {
-        const _Pipeline* _pipeline = extract(hitGroup)->getPipeline();
+        _HitProgramGroup* _hitGroup = extract(hitGroup);
+        const _Pipeline* _pipeline = _hitGroup->getPipeline();
         m->throwRuntimeError(_pipeline, "Invalid pipeline %p.", _pipeline);
+        m->throwRuntimeError(
+            !_hitGroup->isPending(),
+            "The hit group %s is still pending in a program group batch.",
+            _hitGroup->getName().c_str());
 
         _Material::Key key{ _pipeline, rayType };
-        m->programs[key] = extract(hitGroup);
+        m->programs[key] = _hitGroup;
+
+        m->markSBTRecordsDirty();
     }
 
     void Material::setUserData(const void* data, uint32_t size, uint32_t alignment) const {
@@ -147,9 +909,19 @@ namespace optixu {
             alignment > 0 && alignment <= OPTIX_SBT_RECORD_ALIGNMENT,
             "Valid alignment range is [1, %u].",
             OPTIX_SBT_RECORD_ALIGNMENT);
+        // JP: サイズやアラインメントの変更はレコードやユーザーデータの配置を変えるので
+        //     レイアウトを無効化する。
+        // EN: Invalidate the layout since a change of the size or alignment changes the placement of
+        //     records and user data.
+        if (m->userDataSizeAlign.size != size ||
+            m->userDataSizeAlign.alignment != alignment)
+            m->markSBTLayoutDirty();
         m->userDataSizeAlign = SizeAlign(size, alignment);
         m->userData.resize(size);
         std::memcpy(m->userData.data(), data, size);
+
+        m->markSBTRecordsDirty();
+        m->markUserDataDirty();
     }
 
     HitProgramGroup Material::getHitGroup(Pipeline pipeline, uint32_t rayType) const {
@@ -175,72 +947,595 @@ namespace optixu {
 
 
 
-    void Scene::Priv::addGAS(_GeometryAccelerationStructure* gas) {
-        geomASs[gas->getSerialID()] = gas;
+    // JP: 生成直後のトラバーサブルは未ビルドかつモーション無しである。
+    // EN: A traversable right after creation is not built and has no motion.
+    uint32_t Scene::Priv::addGAS(_GeometryAccelerationStructure* gas) {
+        ++numNotReadyTraversables;
+        return geomASs.allocate(gas);
     }
 
     void Scene::Priv::removeGAS(_GeometryAccelerationStructure* gas) {
-        geomASs.erase(gas->getSerialID());
+        uint32_t serialID = gas->getSerialID();
+        geomASs.release(serialID);
+        // JP: 再利用されたシリアルIDが古いレイアウトのオフセットを参照しないようにする。
+        // EN: Prevent a reused serial ID from referring to offsets of the old layout.
+        if (serialID < gasSBTOffsetRanges.size())
+            gasSBTOffsetRanges[serialID].numMaterialSets = 0;
+        onReadinessChanged(gas->isReady(), true);
+        onMotionChanged(gas->hasMotion(), false);
+    }
+
+    uint32_t Scene::Priv::addTransform(_Transform* tr) {
+        ++numNotReadyTraversables;
+        return transforms.allocate(tr);
+    }
+
+    void Scene::Priv::removeTransform(_Transform* tr) {
+        transforms.release(tr->getSlotInScene());
+        onReadinessChanged(tr->isReady(), true);
+    }
+
+    uint32_t Scene::Priv::addIAS(_InstanceAccelerationStructure* ias) {
+        ++numNotReadyTraversables;
+        return instASs.allocate(ias);
+    }
+
+    void Scene::Priv::removeIAS(_InstanceAccelerationStructure* ias) {
+        instASs.release(ias->getSlotInScene());
+        onReadinessChanged(ias->isReady(), true);
+        onMotionChanged(ias->hasMotion(), false);
+    }
+
+    void Scene::Priv::detachUpdatePolicies() {
+        geomASs.forEach([](_GeometryAccelerationStructure* gas) {
+            gas->detachUpdatePolicy();
+        });
+        instASs.forEach([](_InstanceAccelerationStructure* ias) {
+            ias->detachUpdatePolicy();
+        });
     }
 
     void Scene::Priv::markSBTLayoutDirty() {
         sbtLayoutIsUpToDate = false;
 
-        for (_InstanceAccelerationStructure* _ias : instASs)
+        instASs.forEach([](_InstanceAccelerationStructure* _ias) {
             _ias->markDirty(true);
+        });
     }
 
     uint32_t Scene::Priv::getSBTOffset(_GeometryAccelerationStructure* gas, uint32_t matSetIdx) {
-        SBTOffsetKey key = SBTOffsetKey{ gas->getSerialID(), matSetIdx };
         throwRuntimeError(
-            sbtOffsets.count(key),
+            hasSBTOffset(gas->getSerialID(), matSetIdx),
             "GAS %s: material set index %u is out of bounds.",
             gas->getName().c_str(), matSetIdx);
-        return sbtOffsets.at(key);
+        return lookUpSBTOffset(gas->getSerialID(), matSetIdx);
+    }
+
+    void Scene::Priv::markSBTRecordsDirty(const _GeometryInstance* geomInst) {
+        if (!sbtLayoutIsUpToDate)
+            return;
+
+        for (const std::pair<_GeometryAccelerationStructure* const, uint32_t> &parent : geomInst->getParentGASs()) {
+            const _GeometryAccelerationStructure* gas = parent.first;
+            uint32_t numChildren = gas->getNumChildren();
+            for (uint32_t childIdx = 0; childIdx < numChildren; ++childIdx) {
+                if (gas->hasChild(geomInst, childIdx))
+                    markSBTRecordsDirty(gas, childIdx);
+            }
+        }
+    }
+
+    void HitGroupSBTSyncState::reset() {
+        if (scene)
+            scene->unregisterSBTSyncState(this);
+        scene = nullptr;
+        valid = false;
+    }
+
+    void Scene::Priv::markSBTRecordsDirty(const _GeometryAccelerationStructure* gas, uint32_t childIndex) {
+        // JP: レイアウトが無効な場合はどのみち全体のセットアップが行われる。
+        // EN: The whole setup will be performed anyway when the layout is invalid.
+        if (!sbtLayoutIsUpToDate)
+            return;
+
+        // JP: 変更履歴が大きくなりすぎた場合は履歴を捨てて全体のセットアップを強制する。
+        // EN: Discard the edit log and force the whole setup when the log has grown too large.
+        if (sbtRecordEdits.size() >= s_maxNumSBTRecordEdits) {
+            resetSBTRecordEdits();
+            return;
+        }
+
+        uint32_t numMatSets = gas->getNumMaterialSets();
+        for (uint32_t matSetIdx = 0; matSetIdx < numMatSets; ++matSetIdx) {
+            // JP: レイアウト生成後に作られたGASはレコードを持たない。
+            // EN: A GAS created after the layout generation has no records.
+            if (!hasSBTOffset(gas->getSerialID(), matSetIdx))
+                continue;
+            sbtRecordEdits.push_back(SBTRecordEdit{ gas->getSerialID(), matSetIdx, childIndex });
+        }
+    }
+
+    bool Scene::Priv::collectSBTRecordEdits(
+        const HitGroupSBTSyncState &syncState,
+        std::vector<SBTRecordEdit>* edits, std::vector<SBTRecordRange>* ranges) const {
+        // JP: 未登録の同期状態が必要とする履歴は捨てられている場合がある。
+        // EN: The log needed by an unregistered sync state may have been dropped.
+        if (!syncState.valid || syncState.epoch != sbtEpoch || syncState.numSyncedEdits < sbtRecordEditBase)
+            return false;
+
+        edits->assign(
+            sbtRecordEdits.cbegin() + (syncState.numSyncedEdits - sbtRecordEditBase),
+            sbtRecordEdits.cend());
+        std::sort(edits->begin(), edits->end());
+        edits->erase(std::unique(edits->begin(), edits->end()), edits->end());
+
+        // JP: マテリアルセット全体の変更(ソート順で末尾に来る)があれば同じマテリアルセットの子の変更は不要。
+        // EN: Child edits are unnecessary if there is a whole material set edit (comes last in the sort order).
+        uint32_t numEdits = 0;
+        for (uint32_t i = 0; i < edits->size();) {
+            const SBTRecordEdit &first = (*edits)[i];
+            uint32_t j = i + 1;
+            while (j < edits->size() &&
+                   (*edits)[j].gasSerialID == first.gasSerialID &&
+                   (*edits)[j].matSetIndex == first.matSetIndex)
+                ++j;
+            if ((*edits)[j - 1].childIndex == 0xFFFFFFFF)
+                (*edits)[numEdits++] = (*edits)[j - 1];
+            else
+                for (uint32_t k = i; k < j; ++k)
+                    (*edits)[numEdits++] = (*edits)[k];
+            i = j;
+        }
+        edits->resize(numEdits);
+
+        // JP: 変更後に破棄されたGASのレコードは更新不要。
+        // EN: Records of a GAS destroyed after the edit don't need updating.
+        edits->erase(
+            std::remove_if(
+                edits->begin(), edits->end(),
+                [this](const SBTRecordEdit &edit) {
+                    return geomASs.get(edit.gasSerialID) == nullptr;
+                }),
+            edits->end());
+
+        ranges->clear();
+        for (const SBTRecordEdit &edit : *edits) {
+            const _GeometryAccelerationStructure* gas = geomASs.get(edit.gasSerialID);
+            uint32_t baseOffset = lookUpSBTOffset(edit.gasSerialID, edit.matSetIndex);
+            SBTRecordRange range;
+            if (edit.childIndex == 0xFFFFFFFF) {
+                range.offset = baseOffset;
+                range.count = gas->getNumSBTRecords(edit.matSetIndex);
+            }
+            else {
+                range = gas->getChildSBTRecordRange(edit.matSetIndex, edit.childIndex);
+                range.offset += baseOffset;
+            }
+            if (range.count > 0)
+                ranges->push_back(range);
+        }
+
+        // JP: 隣接・重複する範囲をまとめて転送回数を減らす。
+        // EN: Coalesce adjacent or overlapping ranges to reduce the number of transfers.
+        std::sort(ranges->begin(), ranges->end());
+        uint32_t numRanges = 0;
+        for (const SBTRecordRange &range : *ranges) {
+            if (numRanges > 0) {
+                SBTRecordRange &last = (*ranges)[numRanges - 1];
+                if (range.offset <= last.offset + last.count) {
+                    last.count = std::max(last.count, range.offset + range.count - last.offset);
+                    continue;
+                }
+            }
+            (*ranges)[numRanges++] = range;
+        }
+        ranges->resize(numRanges);
+
+        return true;
+    }
+
+    void Scene::Priv::allocateMaterialUserData(const _Material* mat) {
+        if (materialUserDataOffsets.count(mat))
+            return;
+        uint32_t offset;
+        materialUserDataSizeAlign.add(mat->getUserDataSizeAlign(), &offset);
+        materialUserDataOffsets[mat] = offset;
+        mat->addUserDataScene(this);
+    }
+
+    void Scene::Priv::releaseMaterialUserData(const _Material* mat) {
+        if (materialUserDataOffsets.erase(mat) == 0)
+            return;
+        markSBTLayoutDirty();
+    }
+
+    void Scene::Priv::clearMaterialUserDataLayout() {
+        for (const std::pair<const _Material* const, uint32_t> &matOffset : materialUserDataOffsets)
+            matOffset.first->removeUserDataScene(this);
+        materialUserDataOffsets.clear();
+        materialUserDataSizeAlign = SizeAlign();
+    }
+
+    void Scene::Priv::setupMaterialUserData(CUstream stream) {
+        throwRuntimeError(
+            materialUserDataBuffer.isValid() && materialUserDataHostMem,
+            "Material user data buffer is not set.");
+        throwRuntimeError(
+            materialUserDataBuffer.sizeInBytes() >= materialUserDataSizeAlign.size,
+            "Material user data buffer size is not enough.");
+        throwRuntimeError(
+            sbtLayoutIsUpToDate,
+            "Shader binding table layout is outdated.");
+        if (materialUserDataIsUpToDate)
+            return;
+
+        auto data = reinterpret_cast<uint8_t*>(materialUserDataHostMem);
+        for (const std::pair<const _Material* const, uint32_t> &matOffset : materialUserDataOffsets) {
+            const _Material* mat = matOffset.first;
+            std::memcpy(data + matOffset.second, mat->getUserData(), mat->getUserDataSizeAlign().size);
+        }
+        if (materialUserDataSizeAlign.size > 0) {
+            CUDADRV_CHECK(cuMemcpyHtoDAsync(
+                materialUserDataBuffer.getCUdeviceptr(), materialUserDataHostMem,
+                materialUserDataSizeAlign.size, stream));
+        }
+
+        materialUserDataIsUpToDate = true;
     }
 
     void Scene::Priv::setupHitGroupSBT(
-        CUstream stream, const _Pipeline* pipeline, const BufferView &sbt, void* hostMem) {
+        CUstream stream, const _Pipeline* pipeline, const BufferView &sbt, void* hostMem,
+        HitGroupSBTSyncState* syncState) {
         throwRuntimeError(
             sbt.sizeInBytes() >= singleRecordSize * numSBTRecords,
             "Hit group shader binding table size is not enough.");
 
+        if (indirectMaterialUserData)
+            setupMaterialUserData(stream);
+
         auto records = reinterpret_cast<uint8_t*>(hostMem);
 
-        for (const std::pair<uint32_t, _GeometryAccelerationStructure*> &gas : geomASs) {
-            uint32_t numMatSets = gas.second->getNumMaterialSets();
-            for (uint32_t matSetIdx = 0; matSetIdx < numMatSets; ++matSetIdx) {
-                uint32_t numRecords = gas.second->fillSBTRecords(pipeline, matSetIdx, records);
-                records += numRecords * singleRecordSize;
+        // JP: 各(GAS, マテリアルセット)のレコードはレイアウト生成時に決まった互いに重ならない領域を占めるので、
+        //     ホスト側のメモリに直接並列に詰め込むことができる。
+        // EN: Records of each (GAS, material set) occupy a disjoint region determined at the layout generation,
+        //     so they can be directly packed into the host-side memory in parallel.
+        const auto packRecords = [this, pipeline, records](const std::vector<SBTRecordEdit> &units) {
+            parallelFor(
+                context->getThreadPool(),
+                static_cast<uint32_t>(units.size()), s_minNumSBTPackingUnitsPerTask,
+                [this, pipeline, records, &units](uint32_t begin, uint32_t end) {
+                    for (uint32_t unitIdx = begin; unitIdx < end; ++unitIdx) {
+                        const SBTRecordEdit &unit = units[unitIdx];
+                        const _GeometryAccelerationStructure* gas = geomASs.get(unit.gasSerialID);
+                        uint32_t baseOffset = lookUpSBTOffset(unit.gasSerialID, unit.matSetIndex);
+                        if (unit.childIndex == 0xFFFFFFFF) {
+                            gas->fillSBTRecords(pipeline, unit.matSetIndex, records + baseOffset * singleRecordSize);
+                        }
+                        else {
+                            SBTRecordRange range = gas->getChildSBTRecordRange(unit.matSetIndex, unit.childIndex);
+                            gas->fillChildSBTRecords(
+                                pipeline, unit.matSetIndex, unit.childIndex,
+                                records + (baseOffset + range.offset) * singleRecordSize);
+                        }
+                    }
+                });
+        };
+
+        // JP: 前回のセットアップ以降に変更されたレコードのみを詰め直して転送する。
+        // EN: Re-pack and transfer only the records edited since the previous setup.
+        std::vector<SBTRecordEdit> edits;
+        std::vector<SBTRecordRange> ranges;
+        if (collectSBTRecordEdits(*syncState, &edits, &ranges)) {
+            packRecords(edits);
+
+            for (const SBTRecordRange &range : ranges) {
+                size_t offsetInBytes = static_cast<size_t>(range.offset) * singleRecordSize;
+                CUDADRV_CHECK(cuMemcpyHtoDAsync(
+                    sbt.getCUdeviceptr() + offsetInBytes, records + offsetInBytes,
+                    static_cast<size_t>(range.count) * singleRecordSize, stream));
+            }
+        }
+        else {
+            std::vector<SBTRecordEdit> units;
+            units.reserve(sbtOffsets.size());
+            // JP: レイアウト生成後に作られたGASはレイアウトに含まれない。
+            // EN: A GAS created after the layout generation is not included in the layout.
+            uint32_t numGASSlots = static_cast<uint32_t>(gasSBTOffsetRanges.size());
+            for (uint32_t serialID = 0; serialID < numGASSlots; ++serialID) {
+                uint32_t numMatSets = gasSBTOffsetRanges[serialID].numMaterialSets;
+                for (uint32_t matSetIdx = 0; matSetIdx < numMatSets; ++matSetIdx)
+                    units.push_back(SBTRecordEdit{ serialID, matSetIdx, 0xFFFFFFFF });
             }
+            packRecords(units);
+
+            CUDADRV_CHECK(cuMemcpyHtoDAsync(sbt.getCUdeviceptr(), hostMem, sbt.sizeInBytes(), stream));
         }
 
-        CUDADRV_CHECK(cuMemcpyHtoDAsync(sbt.getCUdeviceptr(), hostMem, sbt.sizeInBytes(), stream));
+        if (syncState->scene != this) {
+            syncState->reset();
+            syncState->scene = this;
+            sbtSyncStates.insert(syncState);
+        }
+        syncState->epoch = sbtEpoch;
+        syncState->numSyncedEdits = getNumSBTRecordEdits();
+        syncState->valid = true;
+
+        // JP: 全ての同期状態が反映済みの変更を履歴から捨てる。
+        // EN: Drop the edits already reflected by all the sync states from the log.
+        uint32_t minNumSyncedEdits = syncState->numSyncedEdits;
+        for (const HitGroupSBTSyncState* state : sbtSyncStates) {
+            if (state->valid && state->epoch == sbtEpoch)
+                minNumSyncedEdits = std::min(minNumSyncedEdits, state->numSyncedEdits);
+        }
+        if (minNumSyncedEdits > sbtRecordEditBase) {
+            sbtRecordEdits.erase(
+                sbtRecordEdits.cbegin(),
+                sbtRecordEdits.cbegin() + (minNumSyncedEdits - sbtRecordEditBase));
+            sbtRecordEditBase = minNumSyncedEdits;
+        }
     }
 
-    bool Scene::Priv::isReady(bool* hasMotionAS) {
+    bool Scene::Priv::isReady(bool* hasMotionAS) const {
+        *hasMotionAS = numMotionASs > 0;
+        bool ready = numNotReadyTraversables == 0 && sbtLayoutIsUpToDate;
+
+#if defined(OPTIXU_ENABLE_ASSERT)
+        bool hasMotionASByWalk;
+        bool readyByWalk = isReadyByFullWalk(&hasMotionASByWalk);
+        optixuAssert(
+            ready == readyByWalk && *hasMotionAS == hasMotionASByWalk,
+            "Readiness counters are inconsistent: ready %u (walk: %u), motion %u (walk: %u).",
+            ready, readyByWalk, *hasMotionAS, hasMotionASByWalk);
+#endif
+
+        return ready;
+    }
+
+    bool Scene::Priv::isReadyByFullWalk(bool* hasMotionAS) const {
+        bool ready = true;
         *hasMotionAS = false;
-        for (const std::pair<uint32_t, _GeometryAccelerationStructure*> &gas : geomASs) {
-            *hasMotionAS |= gas.second->hasMotion();
-            if (!gas.second->isReady())
-                return false;
-        }
+        geomASs.forEach([&](const _GeometryAccelerationStructure* gas) {
+            *hasMotionAS |= gas->hasMotion();
+            ready &= gas->isReady();
+        });
 
-        for (_Transform* tr : transforms) {
-            if (!tr->isReady())
-                return false;
-        }
+        transforms.forEach([&](const _Transform* tr) {
+            ready &= tr->isReady();
+        });
 
-        for (_InstanceAccelerationStructure* ias : instASs) {
+        instASs.forEach([&](const _InstanceAccelerationStructure* ias) {
             *hasMotionAS |= ias->hasMotion();
+            ready &= ias->isReady();
+        });
+
+        ready &= sbtLayoutIsUpToDate;
+
+        return ready;
+    }
+
+    void Scene::Priv::buildDirty(CUstream stream, AccelerationStructureMemoryAllocator* allocator) {
+        std::vector<_GeometryAccelerationStructure*> dirtyGASes;
+        std::vector<_Transform*> pendingTransforms;
+        std::vector<_InstanceAccelerationStructure*> pendingIASes;
+        geomASs.forEach([&](_GeometryAccelerationStructure* gas) {
+            if (!gas->isReady())
+                dirtyGASes.push_back(gas);
+        });
+        transforms.forEach([&](_Transform* tr) {
+            if (!tr->isReady())
+                pendingTransforms.push_back(tr);
+        });
+        instASs.forEach([&](_InstanceAccelerationStructure* ias) {
             if (!ias->isReady())
-                return false;
+                pendingIASes.push_back(ias);
+        });
+        if (dirtyGASes.empty() && pendingTransforms.empty() && pendingIASes.empty())
+            return;
+
+        throwRuntimeError(
+            pendingIASes.empty() || sbtLayoutIsUpToDate,
+            "Shader binding table layout generation has not been done.");
+
+        // JP: 先に全ASのビルド準備を行い、共有のスクラッチバッファーのサイズと
+        //     コンパクション後のサイズを受け取るスロットの数を決める。
+        // EN: Prepare all the ASs for build first to determine the size of the shared scratch buffer
+        //     and the number of slots receiving compacted sizes.
+        size_t scratchSize = 0;
+        uint32_t numCompactedSizes = 0;
+        for (_GeometryAccelerationStructure* gas : dirtyGASes) {
+            OptixAccelBufferSizes memReq;
+            gas->getPublicType().prepareForBuild(&memReq);
+            scratchSize = std::max(scratchSize, memReq.tempSizeInBytes);
+            if (gas->compactionIsEnabled() && gas->getNumChildren() > 0)
+                ++numCompactedSizes;
+        }
+        for (_InstanceAccelerationStructure* ias : pendingIASes) {
+            OptixAccelBufferSizes memReq;
+            ias->getPublicType().prepareForBuild(&memReq);
+            scratchSize = std::max(scratchSize, memReq.tempSizeInBytes);
+            if (ias->compactionIsEnabled())
+                ++numCompactedSizes;
         }
 
-        if (!sbtLayoutIsUpToDate)
-            return false;
+        BufferView scratchBuffer;
+        if (scratchSize > 0)
+            scratchBuffer = allocator->allocate(scratchSize, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+        BufferView compactedSizeBuffer;
+        if (numCompactedSizes > 0)
+            compactedSizeBuffer = allocator->allocate(numCompactedSizes * sizeof(size_t), sizeof(size_t));
+        std::vector<size_t> compactedSizes(numCompactedSizes);
+        uint32_t numUsedCompactedSizes = 0;
+
+        std::vector<_GeometryAccelerationStructure*> compactedGASes;
+        std::vector<_InstanceAccelerationStructure*> compactedIASes;
+
+        // JP: ある階層のコンパクション後のサイズを1回の読み戻しで取得し、まとめてコンパクションする。
+        //     上の階層は子のコンパクション後のハンドルを参照する必要があるので階層ごとに行う。
+        // EN: Obtain compacted sizes of a level with one readback, then compact them together.
+        //     This is done per level since upper levels need to refer to the compacted handles of children.
+        const auto compactLevel = [&](const auto &ases, uint32_t firstIdx, auto* compacted) {
+            if (ases.empty())
+                return;
+            uint32_t numASs = static_cast<uint32_t>(ases.size());
+            CUDADRV_CHECK(cuMemcpyDtoHAsync(
+                &compactedSizes[firstIdx],
+                compactedSizeBuffer.getCUdeviceptr() + firstIdx * sizeof(size_t),
+                numASs * sizeof(size_t), stream));
+            CUDADRV_CHECK(cuStreamSynchronize(stream));
+            for (uint32_t i = 0; i < numASs; ++i) {
+                auto as = ases[i];
+                size_t compactedSize = compactedSizes[firstIdx + i];
+                as->setCompactedSize(compactedSize);
+                ManagedASMemory &mem = as->getManagedMemory();
+                mem.acquire(&mem.compactedAccelBuffer, compactedSize, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+                as->getPublicType().compact(stream, mem.compactedAccelBuffer);
+                compacted->push_back(as);
+            }
+        };
 
-        return true;
+        {
+            std::vector<_GeometryAccelerationStructure*> compactables;
+            uint32_t firstIdx = numUsedCompactedSizes;
+            for (_GeometryAccelerationStructure* gas : dirtyGASes) {
+                ManagedASMemory &mem = gas->getManagedMemory();
+                mem.setAllocator(allocator);
+                mem.acquire(
+                    &mem.accelBuffer, gas->getMemoryRequirement().outputSizeInBytes,
+                    OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+                bool compactable = gas->compactionIsEnabled() && gas->getNumChildren() > 0;
+                if (compactable) {
+                    gas->setCompactedSizeEmitTarget(
+                        compactedSizeBuffer.getCUdeviceptr() + numUsedCompactedSizes++ * sizeof(size_t));
+                    compactables.push_back(gas);
+                }
+                gas->getPublicType().rebuild(stream, mem.accelBuffer, scratchBuffer);
+                if (compactable)
+                    gas->setCompactedSizeEmitTarget(0);
+            }
+            compactLevel(compactables, firstIdx, &compactedGASes);
+        }
+
+        while (!pendingTransforms.empty() || !pendingIASes.empty()) {
+            // JP: 子が全て準備完了しているものを現在の階層としてビルドする。
+            // EN: Build ones whose children are all ready as the current level.
+            std::vector<_Transform*> levelTransforms;
+            std::vector<_InstanceAccelerationStructure*> levelIASes;
+            for (auto it = pendingTransforms.begin(); it != pendingTransforms.end();) {
+                if ((*it)->childIsReady()) {
+                    levelTransforms.push_back(*it);
+                    it = pendingTransforms.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            for (auto it = pendingIASes.begin(); it != pendingIASes.end();) {
+                if ((*it)->childrenAreReady()) {
+                    levelIASes.push_back(*it);
+                    it = pendingIASes.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            throwRuntimeError(
+                !levelTransforms.empty() || !levelIASes.empty(),
+                "Some transforms or IASs cannot be built since their children are invalid or cyclic.");
+
+            for (_Transform* tr : levelTransforms) {
+                ManagedASMemory &mem = tr->getManagedMemory();
+                mem.setAllocator(allocator);
+                mem.acquire(&mem.auxBuffer, tr->getDataSize(), OPTIX_TRANSFORM_BYTE_ALIGNMENT);
+                tr->getPublicType().rebuild(stream, mem.auxBuffer);
+            }
+
+            std::vector<_InstanceAccelerationStructure*> compactables;
+            uint32_t firstIdx = numUsedCompactedSizes;
+            for (_InstanceAccelerationStructure* ias : levelIASes) {
+                ManagedASMemory &mem = ias->getManagedMemory();
+                mem.setAllocator(allocator);
+                mem.acquire(
+                    &mem.auxBuffer, ias->getNumChildren() * sizeof(OptixInstance),
+                    OPTIX_INSTANCE_BYTE_ALIGNMENT);
+                mem.acquire(
+                    &mem.accelBuffer, ias->getMemoryRequirement().outputSizeInBytes,
+                    OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+                bool compactable = ias->compactionIsEnabled();
+                if (compactable) {
+                    ias->setCompactedSizeEmitTarget(
+                        compactedSizeBuffer.getCUdeviceptr() + numUsedCompactedSizes++ * sizeof(size_t));
+                    compactables.push_back(ias);
+                }
+                ias->getPublicType().rebuild(stream, mem.auxBuffer, mem.accelBuffer, scratchBuffer);
+                if (compactable)
+                    ias->setCompactedSizeEmitTarget(0);
+            }
+            compactLevel(compactables, firstIdx, &compactedIASes);
+        }
+
+        // JP: 全ての処理の完了を待ってからコンパクション前のバッファーとスクラッチを返却する。
+        // EN: Wait for the completion of all the work, then return the uncompacted buffers and scratch.
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        for (_GeometryAccelerationStructure* gas : compactedGASes) {
+            gas->getPublicType().removeUncompacted();
+            ManagedASMemory &mem = gas->getManagedMemory();
+            mem.release(&mem.accelBuffer);
+        }
+        for (_InstanceAccelerationStructure* ias : compactedIASes) {
+            ias->getPublicType().removeUncompacted();
+            ManagedASMemory &mem = ias->getManagedMemory();
+            mem.release(&mem.accelBuffer);
+        }
+        if (compactedSizeBuffer.isValid())
+            allocator->release(compactedSizeBuffer);
+        if (scratchBuffer.isValid())
+            allocator->release(scratchBuffer);
+    }
+
+    uint32_t Scene::Priv::defragmentAccelerationStructures(CUstream stream) {
+        // JP: 低いアドレスにあるGASから順に、より低いアドレスの隙間へと移動する。
+        // EN: Move GASs into lower gaps in order starting from the one at the lowest address.
+        std::vector<std::pair<CUdeviceptr, _GeometryAccelerationStructure*>> candidates;
+        geomASs.forEach([&](_GeometryAccelerationStructure* gas) {
+            CUdeviceptr address = gas->getRelocatableAddress();
+            if (address)
+                candidates.emplace_back(address, gas);
+        });
+        std::sort(
+            candidates.begin(), candidates.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        std::unordered_set<const _GeometryAccelerationStructure*> relocatedGASes;
+        for (const auto &candidate : candidates) {
+            if (candidate.second->relocate(stream))
+                relocatedGASes.insert(candidate.second);
+        }
+        if (relocatedGASes.empty())
+            return 0;
+
+        // JP: 移動したGASを間接的に参照するものも含めて、親をdirty状態にする。
+        // EN: Mark parents dirty, including ones indirectly referring to a moved GAS.
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            transforms.forEach([&](_Transform* tr) {
+                if (tr->isReady() && tr->childIsInvalidated(relocatedGASes)) {
+                    tr->markDirty();
+                    changed = true;
+                }
+            });
+            instASs.forEach([&](_InstanceAccelerationStructure* ias) {
+                if (ias->isReady() && ias->hasInvalidatedChild(relocatedGASes)) {
+                    ias->markDirty(false);
+                    ManagedASMemory &mem = ias->getManagedMemory();
+                    if (mem.allocator)
+                        mem.releaseAll();
+                    changed = true;
+                }
+            });
+        }
+
+        return static_cast<uint32_t>(relocatedGASes.size());
     }
 
     void Scene::destroy() {
@@ -250,11 +1545,11 @@ namespace optixu {
     }
 
     OpacityMicroMapArray Scene::createOpacityMicroMapArray() const {
-        return (new _OpacityMicroMapArray(m))->getPublicType();
+        return m->createObject<_OpacityMicroMapArray>()->getPublicType();
     }
 
     DisplacementMicroMapArray Scene::createDisplacementMicroMapArray() const {
-        return (new _DisplacementMicroMapArray(m))->getPublicType();
+        return m->createObject<_DisplacementMicroMapArray>()->getPublicType();
     }
 
     GeometryInstance Scene::createGeometryInstance(GeometryType geomType) const {
@@ -270,7 +1565,7 @@ namespace optixu {
             geomType == GeometryType::CustomPrimitives,
             "Invalid geometry type: %u.",
             static_cast<uint32_t>(geomType));
-        return (new _GeometryInstance(m, geomType))->getPublicType();
+        return m->createObject<_GeometryInstance>(geomType)->getPublicType();
     }
 
     GeometryAccelerationStructure Scene::createGeometryAccelerationStructure(GeometryType geomType) const {
@@ -288,21 +1583,29 @@ namespace optixu {
             static_cast<uint32_t>(geomType));
         // JP: GASを生成するだけならSBTレイアウトには影響を与えないので無効化は不要。
         // EN: Only generating a GAS doesn't affect a SBT layout, no need to invalidate it.
-        optixuAssert(m->geomASs.count(m->nextGeomASSerialID) == 0,
-                     "Too many GAS creation beyond expectation has been done.");
-        return (new _GeometryAccelerationStructure(m, m->nextGeomASSerialID++, geomType))->getPublicType();
+        return m->createObject<_GeometryAccelerationStructure>(geomType)->getPublicType();
     }
 
     Transform Scene::createTransform() const {
-        return (new _Transform(m))->getPublicType();
+        return m->createObject<_Transform>()->getPublicType();
     }
 
     Instance Scene::createInstance() const {
-        return (new _Instance(m))->getPublicType();
+        return m->createObject<_Instance>()->getPublicType();
+    }
+
+    void Scene::createInstances(uint32_t numInstances, Instance* instances) const {
+        m->throwRuntimeError(
+            instances || numInstances == 0,
+            "Invalid output array.");
+        std::vector<_Instance*> _instances(numInstances);
+        m->createObjects(numInstances, _instances.data());
+        for (uint32_t i = 0; i < numInstances; ++i)
+            instances[i] = _instances[i]->getPublicType();
     }
 
     InstanceAccelerationStructure Scene::createInstanceAccelerationStructure() const {
-        return (new _InstanceAccelerationStructure(m))->getPublicType();
+        return m->createObject<_InstanceAccelerationStructure>()->getPublicType();
     }
 
     void Scene::markShaderBindingTableLayoutDirty() const {
@@ -316,6 +1619,9 @@ namespace optixu {
         }
 
         uint32_t sbtOffset = 0;
+        m->clearMaterialUserDataLayout();
+        uint32_t numGASSlots = m->geomASs.getNumSlots();
+        m->gasSBTOffsetRanges.resize(numGASSlots);
         m->sbtOffsets.clear();
         SizeAlign maxRecordSizeAlign;
         maxRecordSizeAlign += SizeAlign(OPTIX_SBT_RECORD_HEADER_SIZE, OPTIX_SBT_RECORD_ALIGNMENT);
@@ -323,22 +1629,31 @@ namespace optixu {
         //     GASはアドレスではなくシリアルIDに紐付けられている。
         // EN: A GAS is associated to its serial ID instead of its address to make SBT layout fixed
         //     in an environment where GAS's virtual address changes run to run.
-        for (const std::pair<uint32_t, _GeometryAccelerationStructure*> &gas : m->geomASs) {
-            uint32_t numMatSets = gas.second->getNumMaterialSets();
+        for (uint32_t serialID = 0; serialID < numGASSlots; ++serialID) {
+            _Scene::GASSBTOffsetRange &offsetRange = m->gasSBTOffsetRanges[serialID];
+            offsetRange.firstIndex = static_cast<uint32_t>(m->sbtOffsets.size());
+            offsetRange.numMaterialSets = 0;
+            const _GeometryAccelerationStructure* gas = m->geomASs.get(serialID);
+            if (!gas)
+                continue;
+
+            uint32_t numMatSets = gas->getNumMaterialSets();
             for (uint32_t matSetIdx = 0; matSetIdx < numMatSets; ++matSetIdx) {
                 SizeAlign gasRecordSizeAlign;
                 uint32_t gasNumSBTRecords;
-                gas.second->calcSBTRequirements(matSetIdx, &gasRecordSizeAlign, &gasNumSBTRecords);
+                gas->calcSBTRequirements(matSetIdx, &gasRecordSizeAlign, &gasNumSBTRecords);
                 maxRecordSizeAlign = max(maxRecordSizeAlign, gasRecordSizeAlign);
-                _Scene::SBTOffsetKey key = { gas.first, matSetIdx };
-                m->sbtOffsets[key] = sbtOffset;
+                m->sbtOffsets.push_back(sbtOffset);
                 sbtOffset += gasNumSBTRecords;
             }
+            offsetRange.numMaterialSets = numMatSets;
         }
         maxRecordSizeAlign.alignUp();
         m->singleRecordSize = maxRecordSizeAlign.size;
         m->numSBTRecords = sbtOffset;
+        m->resetSBTRecordEdits();
         m->sbtLayoutIsUpToDate = true;
+        m->materialUserDataIsUpToDate = false;
 
         *memorySize = m->singleRecordSize * std::max(m->numSBTRecords, 1u);
     }
@@ -347,11 +1662,81 @@ namespace optixu {
         return m->sbtLayoutIsUpToDate;
     }
 
+    void Scene::getShaderBindingTableLayoutStats(ShaderBindingTableLayoutStats* stats) const {
+        m->throwRuntimeError(
+            m->sbtLayoutIsUpToDate,
+            "Shader binding table layout generation has not been done.");
+
+        stats->materialSetEntries.clear();
+        stats->materialSetEntries.reserve(m->sbtOffsets.size());
+        stats->numRecords = m->numSBTRecords;
+        stats->recordStride = m->singleRecordSize;
+        stats->maxRecordSize = 0;
+        stats->maxRecordGAS = GeometryAccelerationStructure();
+        stats->maxRecordMaterialSetIndex = 0;
+        stats->maxRecordGeometryInstance = GeometryInstance();
+        stats->maxRecordMaterial = Material();
+        stats->totalPaddingBytes = 0;
+
+        uint32_t numGASSlots = static_cast<uint32_t>(m->gasSBTOffsetRanges.size());
+        for (uint32_t serialID = 0; serialID < numGASSlots; ++serialID) {
+            uint32_t numMatSets = m->gasSBTOffsetRanges[serialID].numMaterialSets;
+            _GeometryAccelerationStructure* gas = m->geomASs.get(serialID);
+            for (uint32_t matSetIdx = 0; matSetIdx < numMatSets; ++matSetIdx)
+                gas->accumulateSBTLayoutStats(matSetIdx, stats);
+        }
+    }
+
+    void Scene::setConfiguration(IndirectMaterialUserData indirectMaterialUserData) const {
+        bool changed = false;
+        changed |= m->indirectMaterialUserData != indirectMaterialUserData;
+        m->indirectMaterialUserData = indirectMaterialUserData;
+
+        if (changed)
+            m->markSBTLayoutDirty();
+    }
+
+    void Scene::getConfiguration(IndirectMaterialUserData* indirectMaterialUserData) const {
+        if (indirectMaterialUserData)
+            *indirectMaterialUserData = IndirectMaterialUserData(m->indirectMaterialUserData);
+    }
+
+    size_t Scene::getMaterialUserDataBufferSize() const {
+        m->throwRuntimeError(
+            m->sbtLayoutIsUpToDate,
+            "Shader binding table layout generation has not been done.");
+        return m->materialUserDataSizeAlign.size;
+    }
+
+    void Scene::setMaterialUserDataBuffer(const BufferView &buffer, void* hostMem) const {
+        m->throwRuntimeError(
+            hostMem,
+            "Host-side material user data counterpart must be provided.");
+        // JP: レコードに埋め込まれたアドレスが変わるので全体のセットアップを強制する。
+        // EN: Force the whole setup since addresses embedded in records change.
+        if (!(buffer == m->materialUserDataBuffer))
+            m->resetSBTRecordEdits();
+        m->materialUserDataBuffer = buffer;
+        m->materialUserDataHostMem = hostMem;
+        m->materialUserDataIsUpToDate = false;
+    }
+
+    void Scene::buildDirty(CUstream stream, AccelerationStructureMemoryAllocator* allocator) const {
+        m->throwRuntimeError(
+            allocator,
+            "Allocator must be provided.");
+        m->buildDirty(stream, allocator);
+    }
+
+    uint32_t Scene::defragmentAccelerationStructures(CUstream stream) const {
+        return m->defragmentAccelerationStructures(stream);
+    }
+
 
 
     void OpacityMicroMapArray::destroy() {
         if (m)
-            delete m;
+            m->scene->destroyObject(m);
         m = nullptr;
     }
 
@@ -445,7 +1830,7 @@ namespace optixu {
 
     void DisplacementMicroMapArray::destroy() {
         if (m)
-            delete m;
+            m->scene->destroyObject(m);
         m = nullptr;
     }
 
@@ -1114,6 +2499,109 @@ namespace optixu {
         }
     }
 
+    static void hashBufferContents(ContentHasher* hasher, const BufferView &buffer) {
+        hasher->add(buffer.isValid());
+        if (!buffer.isValid())
+            return;
+        hasher->add(buffer.numElements());
+        hasher->add(buffer.stride());
+        std::vector<uint8_t> contents(buffer.sizeInBytes());
+        CUDADRV_CHECK(cuMemcpyDtoH(contents.data(), buffer.getCUdeviceptr(), contents.size()));
+        hasher->add(contents.data(), contents.size());
+    }
+
+    bool GeometryInstance::Priv::hashBuildInput(ContentHasher* hasher) const {
+        hasher->add(geomType);
+        hasher->add(numMotionSteps);
+        hasher->add(primitiveIndexOffset);
+        hasher->add(buildInputFlags.data(), buildInputFlags.size() * sizeof(buildInputFlags[0]));
+        bool hasMaterialIndices = buildInputFlags.size() > 1;
+
+        if (std::holds_alternative<TriangleGeometry>(geometry)) {
+            auto &geom = std::get<TriangleGeometry>(geometry);
+            // JP: OMM, DMMはGASから参照されるため、GASだけをキャッシュすることはできない。
+            // EN: OMMs and DMMs are referenced by the GAS, so the GAS alone can't be cached.
+            if (geom.opacityMicroMapArray || geom.displacementMicroMapArray)
+                return false;
+
+            hasher->add(geom.vertexFormat);
+            hasher->add(geom.indexFormat);
+            for (uint32_t i = 0; i < numMotionSteps; ++i)
+                hashBufferContents(hasher, geom.vertexBuffers[i]);
+            hashBufferContents(hasher, geom.triangleBuffer);
+            if (hasMaterialIndices) {
+                hasher->add(static_cast<uint32_t>(geom.materialIndexSize));
+                hashBufferContents(hasher, geom.materialIndexBuffer);
+            }
+        }
+        else if (std::holds_alternative<CurveGeometry>(geometry)) {
+            auto &geom = std::get<CurveGeometry>(geometry);
+            hasher->add(geom.endcapFlags);
+            for (uint32_t i = 0; i < numMotionSteps; ++i) {
+                hashBufferContents(hasher, geom.vertexBuffers[i]);
+                hashBufferContents(hasher, geom.widthBuffers[i]);
+                if (geomType == GeometryType::FlatQuadraticBSplines)
+                    hashBufferContents(hasher, geom.normalBuffers[i]);
+            }
+            hashBufferContents(hasher, geom.segmentIndexBuffer);
+        }
+        else if (std::holds_alternative<SphereGeometry>(geometry)) {
+            auto &geom = std::get<SphereGeometry>(geometry);
+            hasher->add(static_cast<bool>(geom.useSingleRadius));
+            for (uint32_t i = 0; i < numMotionSteps; ++i) {
+                hashBufferContents(hasher, geom.centerBuffers[i]);
+                hashBufferContents(hasher, geom.radiusBuffers[i]);
+            }
+            if (hasMaterialIndices) {
+                hasher->add(static_cast<uint32_t>(geom.materialIndexSize));
+                hashBufferContents(hasher, geom.materialIndexBuffer);
+            }
+        }
+        else if (std::holds_alternative<CustomPrimitiveGeometry>(geometry)) {
+            auto &geom = std::get<CustomPrimitiveGeometry>(geometry);
+            for (uint32_t i = 0; i < numMotionSteps; ++i)
+                hashBufferContents(hasher, geom.primitiveAabbBuffers[i]);
+            if (hasMaterialIndices) {
+                hasher->add(static_cast<uint32_t>(geom.materialIndexSize));
+                hashBufferContents(hasher, geom.materialIndexBuffer);
+            }
+        }
+        else {
+            optixuAssert_ShouldNotBeCalled();
+        }
+
+        return true;
+    }
+
+    uint32_t GeometryInstance::Priv::getNumPrimitives() const {
+        if (std::holds_alternative<TriangleGeometry>(geometry)) {
+            auto &geom = std::get<TriangleGeometry>(geometry);
+            if (geom.indexFormat != OPTIX_INDICES_FORMAT_NONE)
+                return static_cast<uint32_t>(geom.triangleBuffer.numElements());
+            return static_cast<uint32_t>(geom.vertexBuffers[0].numElements() / 3);
+        }
+        else if (std::holds_alternative<CurveGeometry>(geometry)) {
+            auto &geom = std::get<CurveGeometry>(geometry);
+            return static_cast<uint32_t>(geom.segmentIndexBuffer.numElements());
+        }
+        else if (std::holds_alternative<SphereGeometry>(geometry)) {
+            auto &geom = std::get<SphereGeometry>(geometry);
+            return static_cast<uint32_t>(geom.centerBuffers[0].numElements());
+        }
+        else if (std::holds_alternative<CustomPrimitiveGeometry>(geometry)) {
+            auto &geom = std::get<CustomPrimitiveGeometry>(geometry);
+            return static_cast<uint32_t>(geom.primitiveAabbBuffers[0].numElements());
+        }
+        optixuAssert_ShouldNotBeCalled();
+        return 0;
+    }
+
+    void GeometryInstance::Priv::releaseParentGASs() {
+        for (const std::pair<_GeometryAccelerationStructure* const, uint32_t> &parent : parentGASs)
+            parent.first->releaseChild(this);
+        parentGASs.clear();
+    }
+
     void GeometryInstance::Priv::calcSBTRequirements(
         uint32_t gasMatSetIdx,
         const SizeAlign &gasUserDataSizeAlign,
@@ -1121,18 +2609,17 @@ namespace optixu {
         SizeAlign* maxRecordSizeAlign, uint32_t* numSBTRecords) const {
         *maxRecordSizeAlign = SizeAlign();
         for (int matIdx = 0; matIdx < materials.size(); ++matIdx) {
-            throwRuntimeError(
-                materials[matIdx][0],
-                "Default material (== material set 0) is not set for the slot %u.",
-                matIdx);
-            uint32_t matSetIdx = gasMatSetIdx < materials[matIdx].size() ? gasMatSetIdx : 0;
-            const _Material* mat = materials[matIdx][matSetIdx];
-            if (!mat)
-                mat = materials[matIdx][0];
+            const _Material* mat = getMaterial(gasMatSetIdx, matIdx);
             SizeAlign recordSizeAlign(OPTIX_SBT_RECORD_HEADER_SIZE, OPTIX_SBT_RECORD_ALIGNMENT);
             recordSizeAlign += gasUserDataSizeAlign;
             recordSizeAlign += gasChildUserDataSizeAlign;
-            recordSizeAlign += mat->getUserDataSizeAlign();
+            if (scene->usesIndirectMaterialUserData()) {
+                scene->allocateMaterialUserData(mat);
+                recordSizeAlign += SizeAlign(sizeof(CUdeviceptr), alignof(CUdeviceptr));
+            }
+            else {
+                recordSizeAlign += mat->getUserDataSizeAlign();
+            }
             *maxRecordSizeAlign = max(*maxRecordSizeAlign, recordSizeAlign);
         }
         *maxRecordSizeAlign += userDataSizeAlign;
@@ -1144,16 +2631,10 @@ namespace optixu {
         const void* gasUserData, const SizeAlign &gasUserDataSizeAlign,
         const void* gasChildUserData, const SizeAlign &gasChildUserDataSizeAlign,
         uint32_t numRayTypes, uint8_t* records) const {
+        bool indirectMaterialUserData = scene->usesIndirectMaterialUserData();
         uint32_t numMaterials = static_cast<uint32_t>(materials.size());
         for (uint32_t matIdx = 0; matIdx < numMaterials; ++matIdx) {
-            throwRuntimeError(
-                materials[matIdx][0],
-                "Default material (== material set 0) is not set for material %u.",
-                matIdx);
-            uint32_t matSetIdx = gasMatSetIdx < materials[matIdx].size() ? gasMatSetIdx : 0;
-            const _Material* mat = materials[matIdx][matSetIdx];
-            if (!mat)
-                mat = materials[matIdx][0];
+            const _Material* mat = getMaterial(gasMatSetIdx, matIdx);
             for (uint32_t rIdx = 0; rIdx < numRayTypes; ++rIdx) {
                 SizeAlign curSizeAlign;
                 mat->setRecordHeader(pipeline, rIdx, records, &curSizeAlign);
@@ -1164,7 +2645,16 @@ namespace optixu {
                 std::memcpy(records + offset, gasChildUserData, gasChildUserDataSizeAlign.size);
                 curSizeAlign.add(userDataSizeAlign, &offset);
                 std::memcpy(records + offset, userData.data(), userDataSizeAlign.size);
-                mat->setRecordData(records, &curSizeAlign);
+                if (indirectMaterialUserData) {
+                    // JP: マテリアルのユーザーデータの代わりにそのデバイスアドレスを置く。
+                    // EN: Place the device address of material user data instead of the data itself.
+                    CUdeviceptr matUserDataAddress = scene->getMaterialUserDataAddress(mat);
+                    curSizeAlign.add(SizeAlign(sizeof(CUdeviceptr), alignof(CUdeviceptr)), &offset);
+                    std::memcpy(records + offset, &matUserDataAddress, sizeof(matUserDataAddress));
+                }
+                else {
+                    mat->setRecordData(records, &curSizeAlign);
+                }
                 records += scene->getSingleRecordSize();
             }
         }
@@ -1172,9 +2662,43 @@ namespace optixu {
         return numMaterials * numRayTypes;
     }
 
+    void GeometryInstance::Priv::accumulateSBTLayoutStats(
+        _GeometryAccelerationStructure* gas, uint32_t gasMatSetIdx,
+        const SizeAlign &gasUserDataSizeAlign,
+        const SizeAlign &gasChildUserDataSizeAlign,
+        uint32_t numRayTypes,
+        ShaderBindingTableLayoutStats::MaterialSetEntry* entry,
+        ShaderBindingTableLayoutStats* stats) {
+        uint32_t numMaterials = static_cast<uint32_t>(materials.size());
+        for (uint32_t matIdx = 0; matIdx < numMaterials; ++matIdx) {
+            _Material* mat = getMaterial(gasMatSetIdx, matIdx);
+            // JP: fillSBTRecords()と同じ順番でレコードの実サイズを求める。
+            // EN: Compute the actual record size in the same order as fillSBTRecords().
+            SizeAlign recordSizeAlign(OPTIX_SBT_RECORD_HEADER_SIZE, OPTIX_SBT_RECORD_ALIGNMENT);
+            recordSizeAlign += gasUserDataSizeAlign;
+            recordSizeAlign += gasChildUserDataSizeAlign;
+            recordSizeAlign += userDataSizeAlign;
+            if (scene->usesIndirectMaterialUserData())
+                recordSizeAlign += SizeAlign(sizeof(CUdeviceptr), alignof(CUdeviceptr));
+            else
+                recordSizeAlign += mat->getUserDataSizeAlign();
+
+            entry->numRecords += numRayTypes;
+            entry->paddingBytes +=
+                static_cast<size_t>(stats->recordStride - recordSizeAlign.size) * numRayTypes;
+            if (recordSizeAlign.size > stats->maxRecordSize) {
+                stats->maxRecordSize = recordSizeAlign.size;
+                stats->maxRecordGAS = gas->getPublicType();
+                stats->maxRecordMaterialSetIndex = gasMatSetIdx;
+                stats->maxRecordGeometryInstance = getPublicType();
+                stats->maxRecordMaterial = mat->getPublicType();
+            }
+        }
+    }
+
     void GeometryInstance::destroy() {
         if (m)
-            delete m;
+            m->scene->destroyObject(m);
         m = nullptr;
     }
 
@@ -1460,6 +2984,12 @@ namespace optixu {
             optixuAssert_ShouldNotBeCalled();
         }
         uint32_t prevNumMaterials = static_cast<uint32_t>(m->materials.size());
+        for (uint32_t matIdx = numMaterials; matIdx < prevNumMaterials; ++matIdx) {
+            for (_Material* mat : m->materials[matIdx]) {
+                if (mat)
+                    mat->removeUser(m, false);
+            }
+        }
         m->materials.resize(numMaterials);
         for (int matIdx = prevNumMaterials; matIdx < m->materials.size(); ++matIdx)
             m->materials[matIdx].resize(1, nullptr);
@@ -1483,7 +3013,14 @@ namespace optixu {
         uint32_t prevNumMatSets = static_cast<uint32_t>(m->materials[matIdx].size());
         if (matSetIdx >= prevNumMatSets)
             m->materials[matIdx].resize(matSetIdx + 1, nullptr);
-        m->materials[matIdx][matSetIdx] = extract(mat);
+        _Material* &slot = m->materials[matIdx][matSetIdx];
+        if (slot)
+            slot->removeUser(m, false);
+        slot = extract(mat);
+        if (slot)
+            slot->addUser(m);
+
+        m->scene->markSBTRecordsDirty(m);
     }
 
     void GeometryInstance::setUserData(const void* data, uint32_t size, uint32_t alignment) const {
@@ -1501,6 +3038,8 @@ namespace optixu {
         m->userDataSizeAlign = SizeAlign(size, alignment);
         m->userData.resize(size);
         std::memcpy(m->userData.data(), data, size);
+
+        m->scene->markSBTRecordsDirty(m);
     }
 
     uint32_t GeometryInstance::getNumMotionSteps() const {
@@ -1744,33 +3283,213 @@ namespace optixu {
             "Material set index %u is out of bounds [0, %u).",
             matSetIdx, static_cast<uint32_t>(numRayTypesPerMaterialSet.size()));
 
-        uint32_t numRayTypes = numRayTypesPerMaterialSet[matSetIdx];
-        uint32_t sumRecords = 0;
-        for (uint32_t sbtGasIdx = 0; sbtGasIdx < children.size(); ++sbtGasIdx) {
-            const Child &child = children[sbtGasIdx];
-            uint32_t numRecords = child.geomInst->fillSBTRecords(
-                pipeline, matSetIdx,
-                userData.data(), userDataSizeAlign,
-                child.userData.data(), child.userDataSizeAlign,
-                numRayTypes, records);
-            records += numRecords * scene->getSingleRecordSize();
-            sumRecords += numRecords;
+        uint32_t numRayTypes = numRayTypesPerMaterialSet[matSetIdx];
+        uint32_t sumRecords = 0;
+        for (uint32_t sbtGasIdx = 0; sbtGasIdx < children.size(); ++sbtGasIdx) {
+            const Child &child = children[sbtGasIdx];
+            uint32_t numRecords = child.geomInst->fillSBTRecords(
+                pipeline, matSetIdx,
+                userData.data(), userDataSizeAlign,
+                child.userData.data(), child.userDataSizeAlign,
+                numRayTypes, records);
+            records += numRecords * scene->getSingleRecordSize();
+            sumRecords += numRecords;
+        }
+
+        return sumRecords;
+    }
+
+    uint32_t GeometryAccelerationStructure::Priv::getNumPrimitives() const {
+        uint32_t numPrimitives = 0;
+        for (const Child &child : children) {
+            if (child.geomInst)
+                numPrimitives += child.geomInst->getNumPrimitives();
+        }
+        return numPrimitives;
+    }
+
+    uint32_t GeometryAccelerationStructure::Priv::getNumSBTRecords(uint32_t matSetIdx) const {
+        uint32_t numRecords = 0;
+        for (const Child &child : children)
+            numRecords += child.geomInst->getNumSBTRecords();
+        return numRecords * numRayTypesPerMaterialSet[matSetIdx];
+    }
+
+    SBTRecordRange GeometryAccelerationStructure::Priv::getChildSBTRecordRange(
+        uint32_t matSetIdx, uint32_t childIdx) const {
+        uint32_t numRayTypes = numRayTypesPerMaterialSet[matSetIdx];
+        SBTRecordRange range = {};
+        for (uint32_t sbtGasIdx = 0; sbtGasIdx < childIdx; ++sbtGasIdx)
+            range.offset += children[sbtGasIdx].geomInst->getNumSBTRecords() * numRayTypes;
+        range.count = children[childIdx].geomInst->getNumSBTRecords() * numRayTypes;
+        return range;
+    }
+
+    uint32_t GeometryAccelerationStructure::Priv::fillChildSBTRecords(
+        const _Pipeline* pipeline, uint32_t matSetIdx, uint32_t childIdx, uint8_t* records) const {
+        const Child &child = children[childIdx];
+        return child.geomInst->fillSBTRecords(
+            pipeline, matSetIdx,
+            userData.data(), userDataSizeAlign,
+            child.userData.data(), child.userDataSizeAlign,
+            numRayTypesPerMaterialSet[matSetIdx], records);
+    }
+
+    void GeometryAccelerationStructure::Priv::accumulateSBTLayoutStats(
+        uint32_t matSetIdx, ShaderBindingTableLayoutStats* stats) {
+        ShaderBindingTableLayoutStats::MaterialSetEntry entry;
+        entry.gas = getPublicType();
+        entry.materialSetIndex = matSetIdx;
+        entry.numRecords = 0;
+        entry.paddingBytes = 0;
+        for (const Child &child : children) {
+            if (!child.geomInst)
+                continue;
+            child.geomInst->accumulateSBTLayoutStats(
+                this, matSetIdx,
+                userDataSizeAlign, child.userDataSizeAlign,
+                numRayTypesPerMaterialSet[matSetIdx],
+                &entry, stats);
+        }
+        stats->totalPaddingBytes += entry.paddingBytes;
+        stats->materialSetEntries.push_back(entry);
+    }
+
+    CUdeviceptr GeometryAccelerationStructure::Priv::getRelocatableAddress() const {
+        // JP: コンパクション前後のASが両方存在する間は移動しない。
+        // EN: Don't move while both the uncompacted and compacted ASs exist.
+        if (!managedMemory.allocator || available == compactedAvailable)
+            return 0;
+        const BufferView &buffer = compactedAvailable ? compactedAccelBuffer : accelBuffer;
+        const BufferView &managedBuffer = compactedAvailable ?
+            managedMemory.compactedAccelBuffer : managedMemory.accelBuffer;
+        if (!buffer.isValid() || !(buffer == managedBuffer))
+            return 0;
+        return buffer.getCUdeviceptr();
+    }
+
+    bool GeometryAccelerationStructure::Priv::relocate(CUstream stream) {
+        optixuAssert(getRelocatableAddress() != 0, "This GAS is not relocatable.");
+        BufferView &managedBuffer = compactedAvailable ?
+            managedMemory.compactedAccelBuffer : managedMemory.accelBuffer;
+        BufferView srcBuffer = managedBuffer;
+        BufferView dstBuffer = managedMemory.allocator->allocate(
+            srcBuffer.sizeInBytes(), OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+        if (dstBuffer.getCUdeviceptr() >= srcBuffer.getCUdeviceptr()) {
+            managedMemory.allocator->release(dstBuffer);
+            return false;
+        }
+
+        OptixTraversableHandle &curHandle = compactedAvailable ? compactedHandle : handle;
+        OptixRelocationInfo relocInfo;
+        OPTIX_CHECK(optixAccelGetRelocationInfo(getRawContext(), curHandle, &relocInfo));
+
+        std::vector<OptixRelocateInput> relocInputs;
+        fillRelocateInputs(&relocInputs);
+
+        CUDADRV_CHECK(cuMemcpyDtoDAsync(
+            dstBuffer.getCUdeviceptr(), srcBuffer.getCUdeviceptr(), srcBuffer.sizeInBytes(), stream));
+        OPTIX_CHECK(optixAccelRelocate(
+            getRawContext(), stream, &relocInfo,
+            relocInputs.data(), relocInputs.size(),
+            dstBuffer.getCUdeviceptr(), dstBuffer.sizeInBytes(),
+            &curHandle));
+        CUDADRV_CHECK(cuEventRecord(finishEvent, stream));
+
+        // JP: 移動元はストリーム上でコピーの後に使われるので、すぐに返却してよい。
+        // EN: The source is used after the copy on the stream, so it can be returned immediately.
+        managedMemory.allocator->release(srcBuffer);
+        managedBuffer = dstBuffer;
+        if (compactedAvailable)
+            compactedAccelBuffer = dstBuffer;
+        else
+            accelBuffer = dstBuffer;
+
+        return true;
+    }
+
+    void GeometryAccelerationStructure::Priv::fillRelocateInputs(
+        std::vector<OptixRelocateInput>* relocInputs) const {
+        // JP: 再配置入力はビルド入力と同じ順序で対応させる。OMM Arrayは移動しないので現在のアドレスを渡す。
+        // EN: Relocate inputs correspond to build inputs in the same order.
+        //     OMM arrays don't move, so pass their current addresses.
+        relocInputs->resize(buildInputs.size(), OptixRelocateInput{});
+        for (uint32_t i = 0; i < buildInputs.size(); ++i) {
+            const OptixBuildInput &buildInput = buildInputs[i];
+            OptixRelocateInput &relocInput = (*relocInputs)[i];
+            relocInput = OptixRelocateInput{};
+            relocInput.type = buildInput.type;
+            if (buildInput.type == OPTIX_BUILD_INPUT_TYPE_TRIANGLES) {
+                relocInput.triangleArray.numSbtRecords = buildInput.triangleArray.numSbtRecords;
+                relocInput.triangleArray.opacityMicromap.opacityMicromapArray =
+                    buildInput.triangleArray.opacityMicromap.opacityMicromapArray;
+            }
+        }
+    }
+
+    bool GeometryAccelerationStructure::Priv::computeContentHash(uint64_t* hash) const {
+        optixuAssert(readyToBuild, "prepareForBuild() has not been called.");
+        ContentHasher hasher;
+        hasher.add(geomType);
+        hasher.add(buildOptions.buildFlags);
+        hasher.add(buildOptions.motionOptions.numKeys);
+        hasher.add(buildOptions.motionOptions.flags);
+        hasher.add(buildOptions.motionOptions.timeBegin);
+        hasher.add(buildOptions.motionOptions.timeEnd);
+        hasher.add(static_cast<uint32_t>(children.size()));
+        for (const Child &child : children) {
+            if (!child.geomInst->hashBuildInput(&hasher))
+                return false;
+            hasher.add(child.preTransform != 0);
+            if (child.preTransform) {
+                float matrix[12];
+                CUDADRV_CHECK(cuMemcpyDtoH(matrix, child.preTransform, sizeof(matrix)));
+                hasher.add(matrix, sizeof(matrix));
+            }
         }
+        *hash = hasher.getValue();
+        return true;
+    }
 
-        return sumRecords;
+    void GeometryAccelerationStructure::Priv::adoptAS(
+        const BufferView &buffer, OptixTraversableHandle asHandle, CUstream stream) {
+        bool wasReady = isReady();
+        compactedSizeReadbackPending = false;
+        if (compactionIsEnabled()) {
+            handle = 0;
+            available = false;
+            compactedAccelBuffer = buffer;
+            compactedHandle = asHandle;
+            compactedSize = buffer.sizeInBytes();
+            readyToCompact = true;
+            compactedAvailable = true;
+        }
+        else {
+            accelBuffer = buffer;
+            handle = asHandle;
+            available = true;
+            readyToCompact = false;
+            compactedHandle = 0;
+            compactedAvailable = false;
+        }
+        CUDADRV_CHECK(cuEventRecord(finishEvent, stream));
+        scene->onReadinessChanged(wasReady, true);
     }
 
     void GeometryAccelerationStructure::Priv::markDirty() {
+        bool wasReady = isReady();
         readyToBuild = false;
         available = false;
+        compactedSizeReadbackPending = false;
         readyToCompact = false;
         compactedAvailable = false;
+        scene->onReadinessChanged(wasReady, false);
     }
 
     void GeometryAccelerationStructure::destroy() {
         if (m) {
             m->scene->markSBTLayoutDirty();
-            delete m;
+            m->scene->destroyObject(m);
         }
         m = nullptr;
     }
@@ -1785,6 +3504,9 @@ namespace optixu {
         m->throwRuntimeError(
             m->geomType != GeometryType::CustomPrimitives || !allowRandomVertexAccess,
             "Random vertex access is the feature only for triangle/curve/sphere GAS.");
+        m->throwRuntimeError(
+            allowUpdate || !m->updatePolicy,
+            "Update cannot be disallowed while an update policy is set.");
         bool changed = false;
         changed |= m->tradeoff != tradeoff;
         m->tradeoff = tradeoff;
@@ -1805,10 +3527,12 @@ namespace optixu {
 
     void GeometryAccelerationStructure::setMotionOptions(
         uint32_t numKeys, float timeBegin, float timeEnd, OptixMotionFlags flags) const {
+        bool hadMotion = m->hasMotion();
         m->buildOptions.motionOptions.numKeys = numKeys;
         m->buildOptions.motionOptions.timeBegin = timeBegin;
         m->buildOptions.motionOptions.timeEnd = timeEnd;
         m->buildOptions.motionOptions.flags = flags;
+        m->scene->onMotionChanged(hadMotion, m->hasMotion());
 
         m->markDirty();
     }
@@ -1854,6 +3578,78 @@ namespace optixu {
         std::memcpy(child.userData.data(), data, size);
 
         m->children.push_back(std::move(child));
+        _geomInst->addParentGAS(m);
+
+        m->markDirty();
+        m->scene->markSBTLayoutDirty();
+    }
+
+    // JP: 子のまとめての追加において、追加前にバッチ全体を検証する。
+    //     keysには既存の子のキーを入れておく。getKeyはi番目の子を検証してキーを返す。
+    //     重複判定は既存の子と合わせてソートして一度で行い、重複したキーを返す。
+    // EN: Validate the whole batch before adding children at once.
+    //     keys should contain the keys of the existing children. getKey validates the i-th child and returns its key.
+    //     Check duplicates at once by sorting together with the existing children, and return a duplicated key.
+    template <typename KeyType, typename GetKeyFunc>
+    static const KeyType* validateChildBatch(std::vector<KeyType>* keys, uint32_t numChildren, GetKeyFunc &&getKey) {
+        keys->reserve(keys->size() + numChildren);
+        for (uint32_t i = 0; i < numChildren; ++i)
+            keys->push_back(getKey(i));
+        std::sort(keys->begin(), keys->end());
+        auto dupIt = std::adjacent_find(keys->cbegin(), keys->cend());
+        return dupIt != keys->cend() ? &*dupIt : nullptr;
+    }
+
+    void GeometryAccelerationStructure::addChildren(
+        const GeometryInstance* geomInsts, const CUdeviceptr* preTransforms, uint32_t numChildren) const {
+        m->throwRuntimeError(
+            geomInsts || numChildren == 0,
+            "Invalid geometry instance array.");
+        m->throwRuntimeError(
+            m->geomType == GeometryType::Triangles || preTransforms == nullptr,
+            "Pre-transform is valid only for triangles.");
+        if (numChildren == 0)
+            return;
+
+        using ChildKey = std::pair<const _GeometryInstance*, CUdeviceptr>;
+        std::vector<ChildKey> keys;
+        for (const Priv::Child &child : m->children) {
+            if (child.geomInst)
+                keys.emplace_back(child.geomInst, child.preTransform);
+        }
+        const ChildKey* dupKey = validateChildBatch(
+            &keys, numChildren,
+            [this, geomInsts, preTransforms](uint32_t i) {
+                const _GeometryInstance* _geomInst = extract(geomInsts[i]);
+                m->throwRuntimeError(
+                    _geomInst,
+                    "Invalid geometry instance %p at %u.",
+                    _geomInst, i);
+                m->throwRuntimeError(
+                    _geomInst->getScene() == m->scene,
+                    "Scene mismatch for the given geometry instance %s.",
+                    _geomInst->getName().c_str());
+                m->throwRuntimeError(
+                    _geomInst->getGeometryType() == m->geomType,
+                    "Geometry type mismatch for the given geometry instance %s.",
+                    _geomInst->getName().c_str());
+                return ChildKey(_geomInst, preTransforms ? preTransforms[i] : 0);
+            });
+        m->throwRuntimeError(
+            dupKey == nullptr,
+            "Geometry instance %s with transform %p has been already added.",
+            dupKey ? dupKey->first->getName().c_str() : "",
+            dupKey ? dupKey->second : 0);
+
+        m->children.reserve(m->children.size() + numChildren);
+        for (uint32_t i = 0; i < numChildren; ++i) {
+            _GeometryInstance* _geomInst = extract(geomInsts[i]);
+            Priv::Child child;
+            child.geomInst = _geomInst;
+            child.preTransform = preTransforms ? preTransforms[i] : 0;
+            m->children.push_back(std::move(child));
+            _geomInst->addParentGAS(m);
+        }
 
         m->markDirty();
         m->scene->markSBTLayoutDirty();
@@ -1866,6 +3662,8 @@ namespace optixu {
             "Index is out of bounds [0, %u).]",
             numChildren);
 
+        if (m->children[index].geomInst)
+            m->children[index].geomInst->removeParentGAS(m);
         m->children.erase(m->children.cbegin() + index);
 
         m->markDirty();
@@ -1873,6 +3671,10 @@ namespace optixu {
     }
 
     void GeometryAccelerationStructure::clearChildren() const {
+        for (const Priv::Child &child : m->children) {
+            if (child.geomInst)
+                child.geomInst->removeParentGAS(m);
+        }
         m->children.clear();
 
         m->markDirty();
@@ -1962,28 +3764,41 @@ namespace optixu {
         for (const Priv::Child &child : m->children)
             child.geomInst->updateBuildInput(&m->buildInputs[childIdx++], child.preTransform);
 
+        if (m->updatePolicy)
+            m->updatePolicy->onRebuilt();
+
         m->buildOptions.operation = OPTIX_BUILD_OPERATION_BUILD;
         uint32_t numBuildInputs = static_cast<uint32_t>(m->buildInputs.size());
         if (numBuildInputs > 0) {
+            OptixAccelEmitDesc emitDescs[2];
+            bool emitsBounds;
+            uint32_t numEmitDescs = setUpASEmitDescs(
+                compactionEnabled ? &m->propertyCompactedSize : nullptr,
+                m->updatePolicy, m->buildOptions.motionOptions.numKeys,
+                emitDescs, &emitsBounds);
             OPTIX_CHECK(optixAccelBuild(
                 m->getRawContext(), stream,
                 &m->buildOptions, m->buildInputs.data(), numBuildInputs,
                 scratchBuffer.getCUdeviceptr(), scratchBuffer.sizeInBytes(),
                 accelBuffer.getCUdeviceptr(), accelBuffer.sizeInBytes(),
                 &m->handle,
-                compactionEnabled ? &m->propertyCompactedSize : nullptr,
-                compactionEnabled ? 1 : 0));
+                emitDescs, numEmitDescs));
             CUDADRV_CHECK(cuEventRecord(m->finishEvent, stream));
+            if (emitsBounds)
+                m->updatePolicy->requestBoundsReadback(stream);
         }
         else {
             m->handle = 0;
         }
 
+        bool wasReady = m->isReady();
         m->accelBuffer = accelBuffer;
         m->available = true;
+        m->compactedSizeReadbackPending = false;
         m->readyToCompact = false;
         m->compactedHandle = 0;
         m->compactedAvailable = false;
+        m->scene->onReadinessChanged(wasReady, true);
 
         return m->handle;
     }
@@ -1999,6 +3814,10 @@ namespace optixu {
 
         if (m->compactedAvailable)
             return;
+        if (m->readyToCompact) {
+            *compactedAccelBufferSize = m->compactedSize;
+            return;
+        }
 
         // JP: リビルド・アップデートの完了を待ってコンパクション後のサイズ情報を取得。
         // EN: Wait the completion of rebuild/update then obtain the size after coompaction.
@@ -2066,6 +3885,74 @@ namespace optixu {
         m->available = false;
     }
 
+    void GeometryAccelerationStructure::prepareForCompactAsync(CUstream stream) const {
+        m->throwRuntimeError(
+            m->compactionIsEnabled(),
+            "This AS does not allow compaction.");
+        m->throwRuntimeError(
+            m->available,
+            "Uncompacted AS has not been built yet.");
+
+        if (m->compactedAvailable || m->readyToCompact || m->compactedSizeReadbackPending)
+            return;
+
+        if (m->buildInputs.empty()) {
+            m->compactedSize = 0;
+            m->readyToCompact = true;
+            return;
+        }
+
+        if (!m->compactedSizeReadbackEvent) {
+            CUDADRV_CHECK(cuEventCreate(&m->compactedSizeReadbackEvent, CU_EVENT_DISABLE_TIMING));
+            CUDADRV_CHECK(cuMemAllocHost(
+                reinterpret_cast<void**>(&m->compactedSizeOnHost), sizeof(*m->compactedSizeOnHost)));
+        }
+
+        // JP: リビルドの完了をストリーム上で待ってからサイズ情報を読み戻す。
+        // EN: Wait for the completion of rebuild on the stream, then read back the size.
+        CUDADRV_CHECK(cuStreamWaitEvent(stream, m->finishEvent, 0));
+        CUDADRV_CHECK(cuMemcpyDtoHAsync(
+            m->compactedSizeOnHost, m->compactedSizeOnDevice, sizeof(*m->compactedSizeOnHost), stream));
+        CUDADRV_CHECK(cuEventRecord(m->compactedSizeReadbackEvent, stream));
+        m->compactedSizeReadbackPending = true;
+    }
+
+    bool GeometryAccelerationStructure::compactedSizeIsReady(size_t* compactedAccelBufferSize) const {
+        if (!m->readyToCompact) {
+            m->throwRuntimeError(
+                m->compactedSizeReadbackPending,
+                "You need to call prepareForCompactAsync() before querying the compacted size.");
+            CUresult res = cuEventQuery(m->compactedSizeReadbackEvent);
+            if (res == CUDA_ERROR_NOT_READY)
+                return false;
+            CUDADRV_CHECK(res);
+            m->compactedSize = *m->compactedSizeOnHost;
+            m->compactedSizeReadbackPending = false;
+            m->readyToCompact = true;
+        }
+
+        *compactedAccelBufferSize = m->compactedSize;
+
+        return true;
+    }
+
+    bool GeometryAccelerationStructure::tryRemoveUncompacted() const {
+        if (!m->compactedAvailable || !m->compactionIsEnabled())
+            return false;
+
+        if (m->available) {
+            CUresult res = cuEventQuery(m->finishEvent);
+            if (res == CUDA_ERROR_NOT_READY)
+                return false;
+            CUDADRV_CHECK(res);
+        }
+
+        m->handle = 0;
+        m->available = false;
+
+        return true;
+    }
+
     void GeometryAccelerationStructure::update(CUstream stream, const BufferView &scratchBuffer) const {
         bool updateEnabled = (m->buildOptions.buildFlags & OPTIX_BUILD_FLAG_ALLOW_UPDATE) != 0;
         m->throwRuntimeError(
@@ -2088,22 +3975,77 @@ namespace optixu {
         m->buildOptions.operation = OPTIX_BUILD_OPERATION_UPDATE;
         OptixTraversableHandle tempHandle = handle;
         uint32_t numBuildInputs = static_cast<uint32_t>(m->buildInputs.size());
-        if (numBuildInputs > 0)
+        if (numBuildInputs > 0) {
+            OptixAccelEmitDesc emitDescs[2];
+            bool emitsBounds;
+            uint32_t numEmitDescs = setUpASEmitDescs(
+                nullptr, m->updatePolicy, m->buildOptions.motionOptions.numKeys,
+                emitDescs, &emitsBounds);
             OPTIX_CHECK(optixAccelBuild(
                 m->getRawContext(), stream,
                 &m->buildOptions, m->buildInputs.data(), numBuildInputs,
                 scratchBuffer.getCUdeviceptr(), scratchBuffer.sizeInBytes(),
                 accelBuffer.getCUdeviceptr(), accelBuffer.sizeInBytes(),
                 &tempHandle,
-                nullptr, 0));
-        else
+                emitDescs, numEmitDescs));
+            if (emitsBounds)
+                m->updatePolicy->requestBoundsReadback(stream);
+        }
+        else {
             tempHandle = 0;
+        }
+        if (m->updatePolicy)
+            m->updatePolicy->onUpdated();
         optixuAssert(
             tempHandle == handle,
             "GAS %s: Update should not change the handle itself, what's going on?",
             getName());
     }
 
+    void GeometryAccelerationStructure::setUpdatePolicy(AccelerationStructureUpdatePolicy policy) const {
+        AccelerationStructureUpdatePolicy::Priv* _policy = extract(policy);
+        if (_policy == m->updatePolicy)
+            return;
+        m->throwRuntimeError(
+            !_policy || m->allowUpdate,
+            "Update policy can be set only to an AS allowing update.");
+        m->throwRuntimeError(
+            !_policy || !_policy->hasOwner(),
+            "The given update policy has been already attached to another AS.");
+
+        m->detachUpdatePolicy();
+        m->updatePolicy = _policy;
+        if (_policy) {
+            _policy->setOwner(m);
+            // JP: 設定時点の状態を新たな基準とする。
+            // EN: Make the state at the time of attaching the new base.
+            _policy->onRebuilt();
+        }
+    }
+
+    OptixTraversableHandle GeometryAccelerationStructure::buildOrUpdate(
+        CUstream stream, const BufferView &scratchBuffer, bool* rebuilt) const {
+        m->throwRuntimeError(
+            m->updatePolicy,
+            "Update policy has not been set.");
+        m->throwRuntimeError(
+            m->available || m->compactedAvailable,
+            "AS has not been built yet.");
+
+        m->updatePolicy->pollBoundsReadback();
+        // JP: 非コンパクションASが削除済みの場合はリビルド先が無いのでアップデートする。
+        // EN: Update if the uncompacted AS has been removed since there is no destination for rebuild.
+        bool doRebuild = m->available && m->updatePolicy->shouldRebuild();
+        if (doRebuild)
+            rebuild(stream, m->accelBuffer, scratchBuffer);
+        else
+            update(stream, scratchBuffer);
+        if (rebuilt)
+            *rebuilt = doRebuild;
+
+        return getHandle();
+    }
+
     void GeometryAccelerationStructure::setChildUserData(
         uint32_t index, const void* data, uint32_t size, uint32_t alignment) const {
         uint32_t numChildren = static_cast<uint32_t>(m->children.size());
@@ -2126,6 +4068,8 @@ namespace optixu {
         child.userDataSizeAlign = SizeAlign(size, alignment);
         child.userData.resize(size);
         std::memcpy(child.userData.data(), data, size);
+
+        m->scene->markSBTRecordsDirty(m, index);
     }
 
     void GeometryAccelerationStructure::setUserData(
@@ -2144,6 +4088,8 @@ namespace optixu {
         m->userDataSizeAlign = SizeAlign(size, alignment);
         m->userData.resize(size);
         std::memcpy(m->userData.data(), data, size);
+
+        m->scene->markSBTRecordsDirty(m, 0xFFFFFFFF);
     }
 
     bool GeometryAccelerationStructure::isReady() const {
@@ -2265,6 +4211,406 @@ namespace optixu {
 
 
 
+    bool AccelerationStructureCache::Priv::load(
+        _GeometryAccelerationStructure* gas, uint64_t contentHash,
+        CUstream stream, AccelerationStructureMemoryAllocator* allocator) const {
+        std::ifstream ifs(getFilePath(contentHash), std::ios::binary);
+        if (!ifs)
+            return false;
+        OptixRelocationInfo relocInfo;
+        std::vector<uint8_t> data;
+        if (!readASCacheFile(ifs, contentHash, &relocInfo, &data))
+            return false;
+
+        int compatible = 0;
+        OPTIX_CHECK(optixCheckRelocationCompatibility(gas->getRawContext(), &relocInfo, &compatible));
+        if (!compatible)
+            return false;
+
+        // JP: 以前のバッファーは再利用せず、データと同じサイズで確保し直す。
+        // EN: Don't reuse the previous buffers but allocate one with the same size as the data.
+        ManagedASMemory &memory = gas->getManagedMemory();
+        memory.setAllocator(allocator);
+        memory.release(&memory.accelBuffer);
+        memory.release(&memory.compactedAccelBuffer);
+        BufferView* dstBuffer = gas->compactionIsEnabled() ?
+            &memory.compactedAccelBuffer : &memory.accelBuffer;
+        memory.acquire(dstBuffer, data.size(), OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+
+        std::vector<OptixRelocateInput> relocInputs;
+        gas->fillRelocateInputs(&relocInputs);
+
+        OptixTraversableHandle handle;
+        CUDADRV_CHECK(cuMemcpyHtoDAsync(dstBuffer->getCUdeviceptr(), data.data(), data.size(), stream));
+        OPTIX_CHECK(optixAccelRelocate(
+            gas->getRawContext(), stream, &relocInfo,
+            relocInputs.data(), relocInputs.size(),
+            dstBuffer->getCUdeviceptr(), dstBuffer->sizeInBytes(),
+            &handle));
+        gas->adoptAS(*dstBuffer, handle, stream);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+
+        return true;
+    }
+
+    void AccelerationStructureCache::Priv::build(
+        _GeometryAccelerationStructure* gas,
+        CUstream stream, AccelerationStructureMemoryAllocator* allocator) const {
+        GeometryAccelerationStructure publicGAS = gas->getPublicType();
+        const OptixAccelBufferSizes &memReq = gas->getMemoryRequirement();
+        ManagedASMemory &memory = gas->getManagedMemory();
+        memory.setAllocator(allocator);
+
+        BufferView scratchBuffer;
+        if (memReq.tempSizeInBytes > 0)
+            scratchBuffer = allocator->allocate(memReq.tempSizeInBytes, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+        publicGAS.rebuild(
+            stream,
+            memory.acquire(&memory.accelBuffer, memReq.outputSizeInBytes, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT),
+            scratchBuffer);
+        if (gas->compactionIsEnabled()) {
+            size_t compactedSize;
+            publicGAS.prepareForCompact(&compactedSize);
+            publicGAS.compact(
+                stream,
+                memory.acquire(&memory.compactedAccelBuffer, compactedSize, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT));
+            publicGAS.removeUncompacted();
+            memory.release(&memory.accelBuffer);
+        }
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+
+        if (scratchBuffer.isValid())
+            allocator->release(scratchBuffer);
+    }
+
+    void AccelerationStructureCache::Priv::store(
+        _GeometryAccelerationStructure* gas, uint64_t contentHash) const {
+        std::vector<uint8_t> data(gas->getCurrentDataSize());
+        CUDADRV_CHECK(cuMemcpyDtoH(data.data(), gas->getCurrentAddress(), data.size()));
+        OptixRelocationInfo relocInfo = {};
+        OPTIX_CHECK(optixAccelGetRelocationInfo(gas->getRawContext(), gas->getHandle(), &relocInfo));
+
+        // JP: 書き込み途中のファイルが読まれないよう、一時ファイルに書いてから置き換える。
+        //     キャッシュへの書き込みの失敗はエラーとしない。
+        // EN: Write to a temporary file then replace so that a partially written file isn't read.
+        //     Failing to write to the cache isn't treated as an error.
+        std::string path = getFilePath(contentHash);
+        std::string tmpPath = path + ".tmp";
+        bool written;
+        {
+            std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!ofs)
+                return;
+            writeASCacheFile(ofs, contentHash, relocInfo, data.data(), data.size());
+            written = static_cast<bool>(ofs);
+        }
+        if (written) {
+            std::remove(path.c_str());
+            written = std::rename(tmpPath.c_str(), path.c_str()) == 0;
+        }
+        if (!written)
+            std::remove(tmpPath.c_str());
+    }
+
+    // static
+    AccelerationStructureCache AccelerationStructureCache::create(const std::string &directory) {
+        AccelerationStructureCache ret;
+        ret.m = new Priv(directory);
+        return ret;
+    }
+
+    void AccelerationStructureCache::destroy() {
+        if (m)
+            delete m;
+        m = nullptr;
+    }
+
+    bool AccelerationStructureCache::buildOrLoad(
+        GeometryAccelerationStructure gas,
+        CUstream stream, AccelerationStructureMemoryAllocator* allocator) const {
+        _GeometryAccelerationStructure* _gas = extract(gas);
+        _gas->throwRuntimeError(
+            allocator,
+            "Allocator must be provided.");
+
+        OptixAccelBufferSizes memReq;
+        gas.prepareForBuild(&memReq);
+
+        uint64_t contentHash;
+        bool cacheable = _gas->getNumChildren() > 0 && _gas->computeContentHash(&contentHash);
+        if (cacheable && m->load(_gas, contentHash, stream, allocator))
+            return true;
+
+        m->build(_gas, stream, allocator);
+        if (cacheable)
+            m->store(_gas, contentHash);
+
+        return false;
+    }
+
+
+
+    AccelerationStructureBuildQueue::Priv::~Priv() {
+        for (const InFlightBuild &build : inFlightBuilds) {
+            cuEventSynchronize(build.endEvent);
+            if (build.scratchBuffer.isValid())
+                allocator->release(build.scratchBuffer);
+            cuEventDestroy(build.startEvent);
+            cuEventDestroy(build.endEvent);
+        }
+        for (CUevent event : freeEvents)
+            cuEventDestroy(event);
+    }
+
+    void AccelerationStructureBuildQueue::Priv::issueBuild(
+        CUstream stream, _GeometryAccelerationStructure* gas, uint32_t numPrimitives) {
+        GeometryAccelerationStructure publicGAS = gas->getPublicType();
+        OptixAccelBufferSizes memReq;
+        publicGAS.prepareForBuild(&memReq);
+        ManagedASMemory &memory = gas->getManagedMemory();
+        memory.setAllocator(allocator);
+
+        InFlightBuild build;
+        build.gas = gas;
+        build.numPrimitives = numPrimitives;
+        build.startEvent = acquireEvent();
+        build.endEvent = acquireEvent();
+        if (memReq.tempSizeInBytes > 0)
+            build.scratchBuffer = allocator->allocate(memReq.tempSizeInBytes, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+
+        CUDADRV_CHECK(cuEventRecord(build.startEvent, stream));
+        publicGAS.rebuild(
+            stream,
+            memory.acquire(&memory.accelBuffer, memReq.outputSizeInBytes, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT),
+            build.scratchBuffer);
+        CUDADRV_CHECK(cuEventRecord(build.endEvent, stream));
+        inFlightBuilds.push_back(build);
+
+        if (gas->compactionIsEnabled() && gas->getNumChildren() > 0) {
+            publicGAS.prepareForCompactAsync(stream);
+            pendingCompactions.push_back(gas);
+        }
+    }
+
+    void AccelerationStructureBuildQueue::Priv::collectMeasurements() {
+        // JP: ビルドは同じストリーム上で発行順に完了するので、未完了のものが見つかったら打ち切る。
+        // EN: Builds complete in issue order on the same stream, so stop at the first incomplete one.
+        while (!inFlightBuilds.empty()) {
+            const InFlightBuild &build = inFlightBuilds.front();
+            CUresult res = cuEventQuery(build.endEvent);
+            if (res == CUDA_ERROR_NOT_READY)
+                break;
+            CUDADRV_CHECK(res);
+
+            float elapsed;
+            CUDADRV_CHECK(cuEventElapsedTime(&elapsed, build.startEvent, build.endEvent));
+            scheduler.addMeasurement(build.numPrimitives, elapsed);
+
+            if (build.scratchBuffer.isValid())
+                allocator->release(build.scratchBuffer);
+            freeEvents.push_back(build.startEvent);
+            freeEvents.push_back(build.endEvent);
+            inFlightBuilds.pop_front();
+        }
+    }
+
+    void AccelerationStructureBuildQueue::Priv::processFrame(
+        CUstream stream, std::vector<GeometryAccelerationStructure>* readyGASes) {
+        readyGASes->clear();
+        collectMeasurements();
+
+        for (auto it = pendingUncompactedRemovals.begin(); it != pendingUncompactedRemovals.end();) {
+            _GeometryAccelerationStructure* gas = *it;
+            if (gas->getPublicType().tryRemoveUncompacted()) {
+                ManagedASMemory &memory = gas->getManagedMemory();
+                memory.release(&memory.accelBuffer);
+                it = pendingUncompactedRemovals.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        for (auto it = pendingCompactions.begin(); it != pendingCompactions.end();) {
+            _GeometryAccelerationStructure* gas = *it;
+            GeometryAccelerationStructure publicGAS = gas->getPublicType();
+            size_t compactedSize;
+            if (publicGAS.compactedSizeIsReady(&compactedSize)) {
+                ManagedASMemory &memory = gas->getManagedMemory();
+                publicGAS.compact(
+                    stream,
+                    memory.acquire(
+                        &memory.compactedAccelBuffer, compactedSize, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT));
+                readyGASes->push_back(publicGAS);
+                pendingUncompactedRemovals.push_back(gas);
+                it = pendingCompactions.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        scheduler.dequeueWithinBudget(
+            frameBudget,
+            [&](_GeometryAccelerationStructure* gas, uint32_t numPrimitives) {
+                issueBuild(stream, gas, numPrimitives);
+                readyGASes->push_back(gas->getPublicType());
+            });
+    }
+
+    // static
+    AccelerationStructureBuildQueue AccelerationStructureBuildQueue::create(
+        AccelerationStructureMemoryAllocator* allocator) {
+        AccelerationStructureBuildQueue ret;
+        ret.m = new Priv(allocator);
+        return ret;
+    }
+
+    void AccelerationStructureBuildQueue::destroy() {
+        if (m)
+            delete m;
+        m = nullptr;
+    }
+
+    void AccelerationStructureBuildQueue::setFrameBudget(float budgetInMs) const {
+        m->setFrameBudget(budgetInMs);
+    }
+
+    void AccelerationStructureBuildQueue::setCostModel(float fixedCostInMs, float costPerPrimitiveInMs) const {
+        m->getScheduler().setCostModel(fixedCostInMs, costPerPrimitiveInMs);
+    }
+
+    float AccelerationStructureBuildQueue::estimateBuildCost(uint32_t numPrimitives) const {
+        return m->getScheduler().estimateCost(numPrimitives);
+    }
+
+    void AccelerationStructureBuildQueue::enqueue(GeometryAccelerationStructure gas) const {
+        _GeometryAccelerationStructure* _gas = extract(gas);
+        m->getScheduler().enqueue(_gas, _gas->getNumPrimitives());
+    }
+
+    void AccelerationStructureBuildQueue::processFrame(
+        CUstream stream, std::vector<GeometryAccelerationStructure>* readyGASes) const {
+        m->processFrame(stream, readyGASes);
+    }
+
+    uint32_t AccelerationStructureBuildQueue::getNumQueuedBuilds() const {
+        return m->getScheduler().getNumQueued();
+    }
+
+    bool AccelerationStructureBuildQueue::isIdle() const {
+        return m->isIdle();
+    }
+
+
+
+    void AccelerationStructureUpdatePolicy::Priv::reportBounds(const OptixAabb* aabbs, uint32_t numAabbs) {
+        OptixAabb bounds = aabbs[0];
+        for (uint32_t i = 1; i < numAabbs; ++i) {
+            bounds.minX = std::min(bounds.minX, aabbs[i].minX);
+            bounds.minY = std::min(bounds.minY, aabbs[i].minY);
+            bounds.minZ = std::min(bounds.minZ, aabbs[i].minZ);
+            bounds.maxX = std::max(bounds.maxX, aabbs[i].maxX);
+            bounds.maxY = std::max(bounds.maxY, aabbs[i].maxY);
+            bounds.maxZ = std::max(bounds.maxZ, aabbs[i].maxZ);
+        }
+        latestSurfaceArea = computeSurfaceArea(bounds);
+        if (!baseBoundsAreKnown) {
+            baseSurfaceArea = latestSurfaceArea;
+            baseDiagonalLength = computeDiagonalLength(bounds);
+            baseBoundsAreKnown = true;
+        }
+    }
+
+    void AccelerationStructureUpdatePolicy::Priv::pollBoundsReadback() {
+        if (!readbackPending)
+            return;
+        CUresult res = cuEventQuery(readbackEvent);
+        if (res == CUDA_ERROR_NOT_READY)
+            return;
+        CUDADRV_CHECK(res);
+        readbackPending = false;
+        // JP: 前回のリビルドより前に要求した読み戻しの結果は捨てる。
+        // EN: Discard the result of a readback requested before the last rebuild.
+        if (readbackRebuildIndex != numRebuilds)
+            return;
+        reportBounds(aabbsOnHost, numReadbackAabbs);
+    }
+
+    bool AccelerationStructureUpdatePolicy::Priv::prepareBoundsEmission(
+        uint32_t numAabbs, OptixAccelEmitDesc* emitDesc) {
+        pollBoundsReadback();
+        if (readbackPending)
+            return false;
+
+        if (numAabbs > aabbCapacity) {
+            releaseReadbackResources();
+            CUDADRV_CHECK(cuEventCreate(&readbackEvent, CU_EVENT_DISABLE_TIMING));
+            CUDADRV_CHECK(cuMemAlloc(&aabbsOnDevice, numAabbs * sizeof(OptixAabb)));
+            CUDADRV_CHECK(cuMemAllocHost(
+                reinterpret_cast<void**>(&aabbsOnHost), numAabbs * sizeof(OptixAabb)));
+            aabbCapacity = numAabbs;
+        }
+        numReadbackAabbs = numAabbs;
+
+        *emitDesc = OptixAccelEmitDesc{};
+        emitDesc->type = OPTIX_PROPERTY_TYPE_AABBS;
+        emitDesc->result = aabbsOnDevice;
+
+        return true;
+    }
+
+    void AccelerationStructureUpdatePolicy::Priv::detachFromOwner() {
+        if (std::holds_alternative<_GeometryAccelerationStructure*>(owner))
+            std::get<_GeometryAccelerationStructure*>(owner)->detachUpdatePolicy();
+        else if (std::holds_alternative<_InstanceAccelerationStructure*>(owner))
+            std::get<_InstanceAccelerationStructure*>(owner)->detachUpdatePolicy();
+    }
+
+    void AccelerationStructureUpdatePolicy::Priv::requestBoundsReadback(CUstream stream) {
+        CUDADRV_CHECK(cuMemcpyDtoHAsync(
+            aabbsOnHost, aabbsOnDevice, numReadbackAabbs * sizeof(OptixAabb), stream));
+        CUDADRV_CHECK(cuEventRecord(readbackEvent, stream));
+        readbackPending = true;
+        readbackRebuildIndex = numRebuilds;
+    }
+
+    // static
+    AccelerationStructureUpdatePolicy AccelerationStructureUpdatePolicy::create() {
+        AccelerationStructureUpdatePolicy ret;
+        ret.m = new Priv();
+        return ret;
+    }
+
+    void AccelerationStructureUpdatePolicy::destroy() {
+        if (m)
+            delete m;
+        m = nullptr;
+    }
+
+    void AccelerationStructureUpdatePolicy::setThresholds(
+        float maxSurfaceAreaGrowth, float maxRelativeDisplacement, uint32_t maxNumUpdates) const {
+        m->setThresholds(maxSurfaceAreaGrowth, maxRelativeDisplacement, maxNumUpdates);
+    }
+
+    void AccelerationStructureUpdatePolicy::addDisplacementBound(float distance) const {
+        m->addDisplacement(distance);
+    }
+
+    float AccelerationStructureUpdatePolicy::getSurfaceAreaGrowth() const {
+        return m->getSurfaceAreaGrowth();
+    }
+
+    float AccelerationStructureUpdatePolicy::getRelativeDisplacement() const {
+        return m->getRelativeDisplacement();
+    }
+
+    uint32_t AccelerationStructureUpdatePolicy::getNumUpdatesSinceRebuild() const {
+        return m->getNumUpdatesSinceRebuild();
+    }
+
+
+
     _GeometryAccelerationStructure* Transform::Priv::getDescendantGAS() const {
         if (std::holds_alternative<_GeometryAccelerationStructure*>(child))
             return std::get<_GeometryAccelerationStructure*>(child);
@@ -2276,13 +4622,34 @@ namespace optixu {
         return nullptr;
     }
 
+    bool Transform::Priv::childIsReady() const {
+        if (std::holds_alternative<_GeometryAccelerationStructure*>(child))
+            return std::get<_GeometryAccelerationStructure*>(child)->isReady();
+        else if (std::holds_alternative<_InstanceAccelerationStructure*>(child))
+            return std::get<_InstanceAccelerationStructure*>(child)->isReady();
+        else if (std::holds_alternative<_Transform*>(child))
+            return std::get<_Transform*>(child)->isReady();
+        return false;
+    }
+
+    bool Transform::Priv::childIsInvalidated(
+        const std::unordered_set<const _GeometryAccelerationStructure*> &relocatedGASes) const {
+        if (std::holds_alternative<_GeometryAccelerationStructure*>(child)) {
+            const _GeometryAccelerationStructure* gas = std::get<_GeometryAccelerationStructure*>(child);
+            return relocatedGASes.count(gas) > 0 || !gas->isReady();
+        }
+        return !childIsReady();
+    }
+
     void Transform::Priv::markDirty() {
+        bool wasReady = isReady();
         available = false;
+        scene->onReadinessChanged(wasReady, false);
     }
 
     void Transform::destroy() {
         if (m)
-            delete m;
+            m->scene->destroyObject(m);
         m = nullptr;
     }
 
@@ -2523,7 +4890,9 @@ namespace optixu {
             m->getRawContext(), trDeviceMem.getCUdeviceptr(),
             travType,
             &m->handle));
+        bool wasReady = m->isReady();
         m->available = true;
+        m->scene->onReadinessChanged(wasReady, true);
 
         return m->handle;
     }
@@ -2624,7 +4993,7 @@ namespace optixu {
         throwRuntimeError(!std::holds_alternative<void*>(child), "Child has not been set.");
 
         *instance = {};
-        std::copy_n(instTransform, 12, instance->transform);
+        packTransform(instTransform + 0, instTransform + 4, instTransform + 8, instance->transform);
         instance->instanceId = id;
 
         if (std::holds_alternative<_GeometryAccelerationStructure*>(child)) {
@@ -2658,7 +5027,7 @@ namespace optixu {
     }
 
     void Instance::Priv::updateInstance(OptixInstance* instance) const {
-        std::copy_n(instTransform, 12, instance->transform);
+        packTransform(instTransform + 0, instTransform + 4, instTransform + 8, instance->transform);
         instance->instanceId = id;
 
         if (std::holds_alternative<_GeometryAccelerationStructure*>(child)) {
@@ -2690,19 +5059,50 @@ namespace optixu {
 
     bool Instance::Priv::isMotionAS() const {
         if (std::holds_alternative<_GeometryAccelerationStructure*>(child))
-            std::get<_GeometryAccelerationStructure*>(child)->hasMotion();
+            std::get<_GeometryAccelerationStructure*>(child)->hasMotion();
+        else if (std::holds_alternative<_InstanceAccelerationStructure*>(child))
+            std::get<_InstanceAccelerationStructure*>(child)->hasMotion();
+        return false;
+    }
+
+    bool Instance::Priv::isTransform() const {
+        return std::holds_alternative<_Transform*>(child);
+    }
+
+    bool Instance::Priv::childIsInvalidated(
+        const std::unordered_set<const _GeometryAccelerationStructure*> &relocatedGASes) const {
+        if (std::holds_alternative<_GeometryAccelerationStructure*>(child)) {
+            const _GeometryAccelerationStructure* gas = std::get<_GeometryAccelerationStructure*>(child);
+            return relocatedGASes.count(gas) > 0 || !gas->isReady();
+        }
+        return !childIsReady();
+    }
+
+    OptixTraversableHandle Instance::Priv::getChildHandle() const {
+        if (!childIsReady())
+            return 0;
+        if (std::holds_alternative<_GeometryAccelerationStructure*>(child))
+            return std::get<_GeometryAccelerationStructure*>(child)->getHandle();
+        else if (std::holds_alternative<_InstanceAccelerationStructure*>(child))
+            return std::get<_InstanceAccelerationStructure*>(child)->getHandle();
+        else if (std::holds_alternative<_Transform*>(child))
+            return std::get<_Transform*>(child)->getHandle();
+        return 0;
+    }
+
+    bool Instance::Priv::childIsReady() const {
+        if (std::holds_alternative<_GeometryAccelerationStructure*>(child))
+            return std::get<_GeometryAccelerationStructure*>(child)->isReady();
         else if (std::holds_alternative<_InstanceAccelerationStructure*>(child))
-            std::get<_InstanceAccelerationStructure*>(child)->hasMotion();
+            return std::get<_InstanceAccelerationStructure*>(child)->isReady();
+        else if (std::holds_alternative<_Transform*>(child))
+            return std::get<_Transform*>(child)->isReady();
         return false;
     }
 
-    bool Instance::Priv::isTransform() const {
-        return std::holds_alternative<_Transform*>(child);
-    }
-
     void Instance::destroy() {
         if (m)
-            delete m;
+            m->scene->destroyObject(m);
         m = nullptr;
     }
 
@@ -2718,6 +5118,7 @@ namespace optixu {
             _child->getName().c_str());
         m->child = _child;
         m->matSetIndex = matSetIdx;
+        m->markDirty();
     }
 
     void Instance::setChild(InstanceAccelerationStructure child) const {
@@ -2732,6 +5133,7 @@ namespace optixu {
             _child->getName().c_str());
         m->child = _child;
         m->matSetIndex = 0;
+        m->markDirty();
     }
 
     void Instance::setChild(Transform child, uint32_t matSetIdx) const {
@@ -2746,10 +5148,11 @@ namespace optixu {
             _child->getName().c_str());
         m->child = _child;
         m->matSetIndex = matSetIdx;
+        m->markDirty();
     }
 
     void Instance::setTransform(const float transform[12]) const {
-        std::copy_n(transform, 12, m->instTransform);
+        m->setTransform(transform + 0, transform + 4, transform + 8);
     }
 
     void Instance::setID(uint32_t value) const {
@@ -2759,6 +5162,7 @@ namespace optixu {
             "Max instance ID value is 0x%08x.",
             maxInstanceID);
         m->id = value;
+        m->markDirty();
     }
 
     void Instance::setVisibilityMask(uint32_t mask) const {
@@ -2768,14 +5172,17 @@ namespace optixu {
             "Number of visibility mask bits is %u.",
             numVisibilityMaskBits);
         m->visibilityMask = mask;
+        m->markDirty();
     }
 
     void Instance::setFlags(OptixInstanceFlags flags) const {
         m->flags = flags;
+        m->markDirty();
     }
 
     void Instance::setMaterialSetIndex(uint32_t matSetIdx) const {
         m->matSetIndex = matSetIdx;
+        m->markDirty();
     }
 
     ChildType Instance::getChildType() const {
@@ -2821,16 +5228,136 @@ namespace optixu {
 
 
 
+    bool InstanceAccelerationStructure::Priv::childrenAreReady() const {
+        for (const _Instance* child : children) {
+            if (!child->childIsReady())
+                return false;
+        }
+        return true;
+    }
+
+    bool InstanceAccelerationStructure::Priv::hasInvalidatedChild(
+        const std::unordered_set<const _GeometryAccelerationStructure*> &relocatedGASes) const {
+        for (const _Instance* child : children) {
+            if (child->childIsInvalidated(relocatedGASes))
+                return true;
+        }
+        return false;
+    }
+
+    OptixInstance* InstanceAccelerationStructure::Priv::acquireStagingInstances(
+        CUstream stream, uint32_t numInstances) {
+        CUstreamCaptureStatus captureStatus;
+        CUDADRV_CHECK(cuStreamIsCapturing(stream, &captureStatus));
+        if (captureStatus != CU_STREAM_CAPTURE_STATUS_NONE) {
+            throwRuntimeError(
+                stagingIsPreparedForCapture && numInstances <= stagingCapacity,
+                "Staging memory is not prepared for stream capture. "
+                "Register this IAS to the LaunchGraph recording it.");
+            stagingIsCopiedByCapture = true;
+            return stagingInstances;
+        }
+
+        if (stagingUploadEvent)
+            CUDADRV_CHECK(cuEventSynchronize(stagingUploadEvent));
+        else
+            CUDADRV_CHECK(cuEventCreate(&stagingUploadEvent, CU_EVENT_DISABLE_TIMING));
+        if (numInstances > stagingCapacity) {
+            if (stagingInstances)
+                CUDADRV_CHECK(cuMemFreeHost(stagingInstances));
+            CUDADRV_CHECK(cuMemAllocHost(
+                reinterpret_cast<void**>(&stagingInstances), sizeof(OptixInstance) * numInstances));
+            stagingCapacity = numInstances;
+        }
+        return stagingInstances;
+    }
+
+    void InstanceAccelerationStructure::Priv::recordStagingUse(CUstream stream) {
+        // JP: キャプチャー中に記録したイベントは外から待てないので、LaunchGraphがグラフの実行後に記録する。
+        // EN: An event recorded during capture cannot be waited on from outside,
+        //     so LaunchGraph records it after launching the graph.
+        CUstreamCaptureStatus captureStatus;
+        CUDADRV_CHECK(cuStreamIsCapturing(stream, &captureStatus));
+        if (captureStatus == CU_STREAM_CAPTURE_STATUS_NONE)
+            CUDADRV_CHECK(cuEventRecord(stagingUploadEvent, stream));
+    }
+
+    void InstanceAccelerationStructure::Priv::uploadDirtyInstances(CUstream stream) {
+        uint32_t numChildren = static_cast<uint32_t>(children.size());
+        OptixInstance* instances = acquireStagingInstances(stream, numChildren);
+        auto upload = [&](uint32_t beginIdx, uint32_t endIdx) {
+            CUDADRV_CHECK(cuMemcpyHtoDAsync(
+                instanceBuffer.getCUdeviceptr() + sizeof(OptixInstance) * beginIdx,
+                &instances[beginIdx],
+                sizeof(OptixInstance) * (endIdx - beginIdx),
+                stream));
+        };
+
+        // JP: グラフの再実行ではホスト側の詰め直しは行われず、変更範囲も実行ごとに異なるので、
+        //     キャプチャー中は全体をコピーする。
+        // EN: Refilling on the host isn't replayed by the graph and the changed ranges differ per replay,
+        //     so copy the whole array during a capture.
+        bool copiesWhole = stagingIsPreparedForCapture;
+        uint32_t rangeBeginIdx = numChildren;
+        uint32_t rangeEndIdx = numChildren;
+        for (uint32_t childIdx = 0; childIdx < numChildren; ++childIdx) {
+            const _Instance* child = children[childIdx];
+            uint32_t revision = child->getRevision();
+            if (revision == uploadedInstanceRevisions[childIdx])
+                continue;
+
+            child->updateInstance(&instances[childIdx]);
+            uploadedInstanceRevisions[childIdx] = revision;
+            if (copiesWhole)
+                continue;
+
+            if (rangeBeginIdx < numChildren && childIdx - rangeEndIdx > s_maxInstanceUploadGap) {
+                upload(rangeBeginIdx, rangeEndIdx);
+                rangeBeginIdx = numChildren;
+            }
+            if (rangeBeginIdx == numChildren)
+                rangeBeginIdx = childIdx;
+            rangeEndIdx = childIdx + 1;
+        }
+        if (copiesWhole && numChildren > 0)
+            upload(0, numChildren);
+        else if (rangeBeginIdx < numChildren)
+            upload(rangeBeginIdx, rangeEndIdx);
+        recordStagingUse(stream);
+    }
+
+    void InstanceAccelerationStructure::Priv::refillStagingForGraph(CUstream stream) {
+        uint32_t numChildren = static_cast<uint32_t>(children.size());
+        OptixInstance* instances = acquireStagingInstances(stream, numChildren);
+        // JP: グラフはアップデートとリビルドのどちらも含み得るので、子のハンドルも含めて詰め直す。
+        // EN: The graph may contain either update or rebuild, so refill including handles of children.
+        parallelFor(
+            getContext()->getThreadPool(), numChildren, s_minNumInstancesPerTask,
+            [this, instances](uint32_t begin, uint32_t end) {
+                for (uint32_t childIdx = begin; childIdx < end; ++childIdx) {
+                    const _Instance* child = children[childIdx];
+                    uint32_t revision = child->getRevision();
+                    if (revision == uploadedInstanceRevisions[childIdx])
+                        continue;
+                    child->fillInstance(&instances[childIdx]);
+                    uploadedInstanceRevisions[childIdx] = revision;
+                }
+            });
+    }
+
     void InstanceAccelerationStructure::Priv::markDirty(bool readyToBuild) {
+        bool wasReady = isReady();
         readyToBuild = readyToBuild;
         available = false;
+        compactedSizeReadbackPending = false;
         readyToCompact = false;
         compactedAvailable = false;
+        scene->onReadinessChanged(wasReady, false);
     }
 
     void InstanceAccelerationStructure::destroy() {
         if (m)
-            delete m;
+            m->scene->destroyObject(m);
         m = nullptr;
     }
 
@@ -2839,6 +5366,9 @@ namespace optixu {
         AllowUpdate allowUpdate,
         AllowCompaction allowCompaction,
         AllowRandomInstanceAccess allowRandomInstanceAccess) const {
+        m->throwRuntimeError(
+            allowUpdate || !m->updatePolicy,
+            "Update cannot be disallowed while an update policy is set.");
         bool changed = false;
         changed |= m->tradeoff != tradeoff;
         m->tradeoff = tradeoff;
@@ -2855,10 +5385,12 @@ namespace optixu {
 
     void InstanceAccelerationStructure::setMotionOptions(
         uint32_t numKeys, float timeBegin, float timeEnd, OptixMotionFlags flags) const {
+        bool hadMotion = m->hasMotion();
         m->buildOptions.motionOptions.numKeys = numKeys;
         m->buildOptions.motionOptions.timeBegin = timeBegin;
         m->buildOptions.motionOptions.timeEnd = timeEnd;
         m->buildOptions.motionOptions.flags = flags;
+        m->scene->onMotionChanged(hadMotion, m->hasMotion());
 
         m->markDirty(false);
     }
@@ -2895,19 +5427,86 @@ namespace optixu {
         m->markDirty(false);
     }
 
+    void InstanceAccelerationStructure::addChildren(const Instance* instances, uint32_t numInstances) const {
+        m->throwRuntimeError(
+            instances || numInstances == 0,
+            "Invalid instance array.");
+        if (numInstances == 0)
+            return;
+
+        std::vector<const _Instance*> keys(m->children.cbegin(), m->children.cend());
+        const _Instance* const* dupKey = validateChildBatch(
+            &keys, numInstances,
+            [this, instances](uint32_t i) {
+                const _Instance* _inst = extract(instances[i]);
+                m->throwRuntimeError(
+                    _inst,
+                    "Invalid instance %p at %u.",
+                    _inst, i);
+                m->throwRuntimeError(
+                    _inst->getScene() == m->scene,
+                    "Scene mismatch for the given instance %s.",
+                    _inst->getName().c_str());
+                return _inst;
+            });
+        m->throwRuntimeError(
+            dupKey == nullptr,
+            "Instance %s has been already added.",
+            dupKey ? (*dupKey)->getName().c_str() : "");
+
+        m->children.reserve(m->children.size() + numInstances);
+        for (uint32_t i = 0; i < numInstances; ++i)
+            m->children.push_back(extract(instances[i]));
+
+        m->markDirty(false);
+    }
+
     void InstanceAccelerationStructure::clearChildren() const {
         m->children.clear();
 
         m->markDirty(false);
     }
 
+    void InstanceAccelerationStructure::setChildTransforms(
+        const float (*transforms)[12], uint32_t numTransforms, uint32_t firstChildIndex) const {
+        uint32_t numChildren = static_cast<uint32_t>(m->children.size());
+        m->throwRuntimeError(
+            firstChildIndex <= numChildren && numTransforms <= numChildren - firstChildIndex,
+            "Range [%u, %u) is out of bounds [0, %u).",
+            firstChildIndex, firstChildIndex + numTransforms, numChildren);
+
+        _Instance* const* children = m->children.data() + firstChildIndex;
+        parallelFor(
+            m->getContext()->getThreadPool(), numTransforms, Priv::s_minNumInstancesPerTask,
+            [children, transforms](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; ++i)
+                    children[i]->setTransform(transforms[i] + 0, transforms[i] + 4, transforms[i] + 8);
+            });
+    }
+
+    void InstanceAccelerationStructure::setChildTransforms(
+        const float (*rows0)[4], const float (*rows1)[4], const float (*rows2)[4],
+        uint32_t numTransforms, uint32_t firstChildIndex) const {
+        uint32_t numChildren = static_cast<uint32_t>(m->children.size());
+        m->throwRuntimeError(
+            firstChildIndex <= numChildren && numTransforms <= numChildren - firstChildIndex,
+            "Range [%u, %u) is out of bounds [0, %u).",
+            firstChildIndex, firstChildIndex + numTransforms, numChildren);
+
+        _Instance* const* children = m->children.data() + firstChildIndex;
+        parallelFor(
+            m->getContext()->getThreadPool(), numTransforms, Priv::s_minNumInstancesPerTask,
+            [children, rows0, rows1, rows2](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; ++i)
+                    children[i]->setTransform(rows0[i], rows1[i], rows2[i]);
+            });
+    }
+
     void InstanceAccelerationStructure::markDirty() const {
         m->markDirty(false);
     }
 
     void InstanceAccelerationStructure::prepareForBuild(OptixAccelBufferSizes* memoryRequirement) const {
-        m->instances.resize(m->children.size());
-
         // Fill the build input.
         {
             m->buildInput = OptixBuildInput{};
@@ -2949,40 +5548,70 @@ namespace optixu {
         m->throwRuntimeError(
             scratchBuffer.sizeInBytes() >= m->memoryRequirement.tempSizeInBytes,
             "Size of the given scratch buffer is not enough.");
+        uint32_t numInstances = m->buildInput.instanceArray.numInstances;
         m->throwRuntimeError(
-            instanceBuffer.sizeInBytes() >= m->instances.size() * sizeof(OptixInstance),
+            numInstances == m->children.size(),
+            "The number of children has changed since prepareForBuild().");
+        m->throwRuntimeError(
+            instanceBuffer.sizeInBytes() >= numInstances * sizeof(OptixInstance),
             "Size of the given instance buffer is not enough.");
         m->throwRuntimeError(
             m->scene->sbtLayoutGenerationDone(),
             "Shader binding table layout generation has not been done.");
 
-        uint32_t childIdx = 0;
-        for (const _Instance* child : m->children)
-            child->fillInstance(&m->instances[childIdx++]);
-        CUDADRV_CHECK(cuMemcpyHtoDAsync(
-            instanceBuffer.getCUdeviceptr(), m->instances.data(),
-            m->instances.size() * sizeof(OptixInstance),
-            stream));
+        // JP: インスタンスごとの詰め込みは互いに独立なので並列に行える。
+        // EN: Filling each instance is independent of each other, so it can be done in parallel.
+        OptixInstance* instances = m->acquireStagingInstances(stream, numInstances);
+        m->uploadedInstanceRevisions.resize(numInstances);
+        parallelFor(
+            m->getContext()->getThreadPool(), numInstances, Priv::s_minNumInstancesPerTask,
+            [this, instances](uint32_t begin, uint32_t end) {
+                for (uint32_t childIdx = begin; childIdx < end; ++childIdx) {
+                    const _Instance* child = m->children[childIdx];
+                    m->uploadedInstanceRevisions[childIdx] = child->getRevision();
+                    child->fillInstance(&instances[childIdx]);
+                }
+            });
+        if (numInstances > 0) {
+            CUDADRV_CHECK(cuMemcpyHtoDAsync(
+                instanceBuffer.getCUdeviceptr(), instances,
+                numInstances * sizeof(OptixInstance),
+                stream));
+        }
+        m->recordStagingUse(stream);
         m->buildInput.instanceArray.instances = m->children.size() > 0 ? instanceBuffer.getCUdeviceptr() : 0;
 
         bool compactionEnabled = (m->buildOptions.buildFlags & OPTIX_BUILD_FLAG_ALLOW_COMPACTION) != 0;
 
+        if (m->updatePolicy)
+            m->updatePolicy->onRebuilt();
+
+        OptixAccelEmitDesc emitDescs[2];
+        bool emitsBounds;
+        uint32_t numEmitDescs = setUpASEmitDescs(
+            compactionEnabled ? &m->propertyCompactedSize : nullptr,
+            m->updatePolicy, m->buildOptions.motionOptions.numKeys,
+            emitDescs, &emitsBounds);
         m->buildOptions.operation = OPTIX_BUILD_OPERATION_BUILD;
         OPTIX_CHECK(optixAccelBuild(
             m->getRawContext(), stream, &m->buildOptions, &m->buildInput, 1,
             scratchBuffer.getCUdeviceptr(), scratchBuffer.sizeInBytes(),
             accelBuffer.getCUdeviceptr(), accelBuffer.sizeInBytes(),
             &m->handle,
-            compactionEnabled ? &m->propertyCompactedSize : nullptr,
-            compactionEnabled ? 1 : 0));
+            emitDescs, numEmitDescs));
         CUDADRV_CHECK(cuEventRecord(m->finishEvent, stream));
+        if (emitsBounds)
+            m->updatePolicy->requestBoundsReadback(stream);
 
+        bool wasReady = m->isReady();
         m->instanceBuffer = instanceBuffer;
         m->accelBuffer = accelBuffer;
         m->available = true;
+        m->compactedSizeReadbackPending = false;
         m->readyToCompact = false;
         m->compactedHandle = 0;
         m->compactedAvailable = false;
+        m->scene->onReadinessChanged(wasReady, true);
 
         return m->handle;
     }
@@ -2994,6 +5623,10 @@ namespace optixu {
 
         if (m->compactedAvailable)
             return;
+        if (m->readyToCompact) {
+            *compactedAccelBufferSize = m->compactedSize;
+            return;
+        }
 
         // JP: リビルド・アップデートの完了を待ってコンパクション後のサイズ情報を取得。
         // EN: Wait the completion of rebuild/update then obtain the size after coompaction.
@@ -3047,6 +5680,68 @@ namespace optixu {
         m->available = false;
     }
 
+    void InstanceAccelerationStructure::prepareForCompactAsync(CUstream stream) const {
+        m->throwRuntimeError(
+            m->compactionIsEnabled(),
+            "This AS does not allow compaction.");
+        m->throwRuntimeError(
+            m->available,
+            "Uncompacted AS has not been built yet.");
+
+        if (m->compactedAvailable || m->readyToCompact || m->compactedSizeReadbackPending)
+            return;
+
+        if (!m->compactedSizeReadbackEvent) {
+            CUDADRV_CHECK(cuEventCreate(&m->compactedSizeReadbackEvent, CU_EVENT_DISABLE_TIMING));
+            CUDADRV_CHECK(cuMemAllocHost(
+                reinterpret_cast<void**>(&m->compactedSizeOnHost), sizeof(*m->compactedSizeOnHost)));
+        }
+
+        // JP: リビルドの完了をストリーム上で待ってからサイズ情報を読み戻す。
+        // EN: Wait for the completion of rebuild on the stream, then read back the size.
+        CUDADRV_CHECK(cuStreamWaitEvent(stream, m->finishEvent, 0));
+        CUDADRV_CHECK(cuMemcpyDtoHAsync(
+            m->compactedSizeOnHost, m->compactedSizeOnDevice, sizeof(*m->compactedSizeOnHost), stream));
+        CUDADRV_CHECK(cuEventRecord(m->compactedSizeReadbackEvent, stream));
+        m->compactedSizeReadbackPending = true;
+    }
+
+    bool InstanceAccelerationStructure::compactedSizeIsReady(size_t* compactedAccelBufferSize) const {
+        if (!m->readyToCompact) {
+            m->throwRuntimeError(
+                m->compactedSizeReadbackPending,
+                "You need to call prepareForCompactAsync() before querying the compacted size.");
+            CUresult res = cuEventQuery(m->compactedSizeReadbackEvent);
+            if (res == CUDA_ERROR_NOT_READY)
+                return false;
+            CUDADRV_CHECK(res);
+            m->compactedSize = *m->compactedSizeOnHost;
+            m->compactedSizeReadbackPending = false;
+            m->readyToCompact = true;
+        }
+
+        *compactedAccelBufferSize = m->compactedSize;
+
+        return true;
+    }
+
+    bool InstanceAccelerationStructure::tryRemoveUncompacted() const {
+        if (!m->compactedAvailable || !m->compactionIsEnabled())
+            return false;
+
+        if (m->available) {
+            CUresult res = cuEventQuery(m->finishEvent);
+            if (res == CUDA_ERROR_NOT_READY)
+                return false;
+            CUDADRV_CHECK(res);
+        }
+
+        m->handle = 0;
+        m->available = false;
+
+        return true;
+    }
+
     void InstanceAccelerationStructure::update(CUstream stream, const BufferView &scratchBuffer) const {
         bool updateEnabled = (m->buildOptions.buildFlags & OPTIX_BUILD_FLAG_ALLOW_UPDATE) != 0;
         m->throwRuntimeError(
@@ -3059,100 +5754,518 @@ namespace optixu {
             scratchBuffer.sizeInBytes() >= m->memoryRequirement.tempUpdateSizeInBytes,
             "Size of the given scratch buffer is not enough.");
 
-        uint32_t childIdx = 0;
-        for (const _Instance* child : m->children)
-            child->updateInstance(&m->instances[childIdx++]);
-        CUDADRV_CHECK(cuMemcpyHtoDAsync(
-            m->instanceBuffer.getCUdeviceptr(), m->instances.data(),
-            m->instances.size() * sizeof(OptixInstance),
-            stream));
+        m->uploadDirtyInstances(stream);
+
+        const BufferView &accelBuffer = m->compactedAvailable ? m->compactedAccelBuffer : m->accelBuffer;
+        OptixTraversableHandle handle = m->compactedAvailable ? m->compactedHandle : m->handle;
+
+        OptixAccelEmitDesc emitDescs[2];
+        bool emitsBounds;
+        uint32_t numEmitDescs = setUpASEmitDescs(
+            nullptr, m->updatePolicy, m->buildOptions.motionOptions.numKeys,
+            emitDescs, &emitsBounds);
+        m->buildOptions.operation = OPTIX_BUILD_OPERATION_UPDATE;
+        OptixTraversableHandle tempHandle = handle;
+        OPTIX_CHECK(optixAccelBuild(
+            m->getRawContext(), stream,
+            &m->buildOptions, &m->buildInput, 1,
+            scratchBuffer.getCUdeviceptr(), scratchBuffer.sizeInBytes(),
+            accelBuffer.getCUdeviceptr(), accelBuffer.sizeInBytes(),
+            &tempHandle,
+            emitDescs, numEmitDescs));
+        if (emitsBounds)
+            m->updatePolicy->requestBoundsReadback(stream);
+        if (m->updatePolicy)
+            m->updatePolicy->onUpdated();
+        optixuAssert(
+            tempHandle == handle,
+            "IAS %s: Update should not change the handle itself, what's going on?",
+            getName());
+    }
+
+    void InstanceAccelerationStructure::setUpdatePolicy(AccelerationStructureUpdatePolicy policy) const {
+        AccelerationStructureUpdatePolicy::Priv* _policy = extract(policy);
+        if (_policy == m->updatePolicy)
+            return;
+        m->throwRuntimeError(
+            !_policy || m->allowUpdate,
+            "Update policy can be set only to an AS allowing update.");
+        m->throwRuntimeError(
+            !_policy || !_policy->hasOwner(),
+            "The given update policy has been already attached to another AS.");
+
+        m->detachUpdatePolicy();
+        m->updatePolicy = _policy;
+        if (_policy) {
+            _policy->setOwner(m);
+            // JP: 設定時点の状態を新たな基準とする。
+            // EN: Make the state at the time of attaching the new base.
+            _policy->onRebuilt();
+        }
+    }
+
+    OptixTraversableHandle InstanceAccelerationStructure::buildOrUpdate(
+        CUstream stream, const BufferView &scratchBuffer, bool* rebuilt) const {
+        m->throwRuntimeError(
+            m->updatePolicy,
+            "Update policy has not been set.");
+        m->throwRuntimeError(
+            m->available || m->compactedAvailable,
+            "AS has not been built yet.");
+
+        m->updatePolicy->pollBoundsReadback();
+        // JP: 非コンパクションASが削除済みの場合はリビルド先が無いのでアップデートする。
+        // EN: Update if the uncompacted AS has been removed since there is no destination for rebuild.
+        bool doRebuild = m->available && m->updatePolicy->shouldRebuild();
+        if (doRebuild)
+            rebuild(stream, m->instanceBuffer, m->accelBuffer, scratchBuffer);
+        else
+            update(stream, scratchBuffer);
+        if (rebuilt)
+            *rebuilt = doRebuild;
+
+        return getHandle();
+    }
+
+    bool InstanceAccelerationStructure::isReady() const {
+        return m->isReady();
+    }
+
+    OptixTraversableHandle InstanceAccelerationStructure::getHandle() const {
+        return m->getHandle();
+    }
+
+    void InstanceAccelerationStructure::getConfiguration(
+        ASTradeoff* tradeOff,
+        AllowUpdate* allowUpdate,
+        AllowCompaction* allowCompaction,
+        AllowRandomInstanceAccess* allowRandomInstanceAccess) const {
+        if (tradeOff)
+            *tradeOff = m->tradeoff;
+        if (allowUpdate)
+            *allowUpdate = AllowUpdate(m->allowUpdate);
+        if (allowCompaction)
+            *allowCompaction = AllowCompaction(m->allowCompaction);
+        if (allowRandomInstanceAccess)
+            *allowRandomInstanceAccess = AllowRandomInstanceAccess(m->allowRandomInstanceAccess);
+    }
+
+    void InstanceAccelerationStructure::getMotionOptions(
+        uint32_t* numKeys, float* timeBegin, float* timeEnd, OptixMotionFlags* flags) const {
+        if (numKeys)
+            *numKeys = m->buildOptions.motionOptions.numKeys;
+        if (timeBegin)
+            *timeBegin = m->buildOptions.motionOptions.timeBegin;
+        if (timeEnd)
+            *timeEnd = m->buildOptions.motionOptions.timeEnd;
+        if (flags)
+            *flags = static_cast<OptixMotionFlags>(m->buildOptions.motionOptions.flags);
+    }
+
+    uint32_t InstanceAccelerationStructure::getNumChildren() const {
+        return static_cast<uint32_t>(m->children.size());
+    }
+
+    uint32_t InstanceAccelerationStructure::findChildIndex(Instance instance) const {
+        _Instance* _inst = extract(instance);
+        m->throwRuntimeError(
+            _inst,
+            "Invalid instance %p.",
+            _inst);
+        m->throwRuntimeError(
+            _inst->getScene() == m->scene,
+            "Scene mismatch for the given instance %s.",
+            _inst->getName().c_str());
+        auto idx = std::find(m->children.cbegin(), m->children.cend(), _inst);
+        if (idx == m->children.cend())
+            return 0xFFFFFFFF;
+
+        return static_cast<uint32_t>(std::distance(m->children.cbegin(), idx));
+    }
+
+    Instance InstanceAccelerationStructure::getChild(uint32_t index) const {
+        uint32_t numChildren = static_cast<uint32_t>(m->children.size());
+        m->throwRuntimeError(
+            index < numChildren,
+            "Index is out of bounds [0, %u).]",
+            numChildren);
+        return m->children[index]->getPublicType();
+    }
+
+
+
+    PartitionedInstanceAccelerationStructure::Priv::Priv(
+        _Scene* _scene, AccelerationStructureMemoryAllocator* _allocator) :
+        scene(_scene), allocator(_allocator),
+        numStableFramesToBecomeStatic(60), minNumInstancesToMigrate(256),
+        maxTraversableGraphDepth(3),
+        staticCompactionState(CompactionState::None) {
+        OPTIX_CHECK(optixDeviceContextGetProperty(
+            scene->getRawContext(), OPTIX_DEVICE_PROPERTY_LIMIT_MAX_TRAVERSABLE_GRAPH_DEPTH,
+            &deviceMaxTraversableGraphDepth, sizeof(deviceMaxTraversableGraphDepth)));
+        traversableGraphDepthLimit = deviceMaxTraversableGraphDepth;
+
+        topLevelIAS = scene->createObject<_InstanceAccelerationStructure>();
+        topLevelIAS->getPublicType().setConfiguration(ASTradeoff::PreferFastBuild);
+        for (uint32_t partIdx = 0; partIdx < 2; ++partIdx) {
+            Partition &part = partitions[partIdx];
+            part.ias = scene->createObject<_InstanceAccelerationStructure>();
+            part.instance = scene->createObject<_Instance>();
+            part.instance->getPublicType().setChild(part.ias->getPublicType());
+            part.membershipChanged = true;
+        }
+        partitions[s_static].ias->getPublicType().setConfiguration(
+            ASTradeoff::PreferFastTrace, AllowUpdate::No, AllowCompaction::Yes);
+        partitions[s_dynamic].ias->getPublicType().setConfiguration(
+            ASTradeoff::PreferFastBuild, AllowUpdate::Yes, AllowCompaction::No);
+    }
+
+    PartitionedInstanceAccelerationStructure::Priv::~Priv() {
+        topLevelIAS->getPublicType().destroy();
+        for (uint32_t partIdx = 0; partIdx < 2; ++partIdx) {
+            partitions[partIdx].instance->getPublicType().destroy();
+            partitions[partIdx].ias->getPublicType().destroy();
+        }
+        if (scratchBuffer.isValid())
+            allocator->release(scratchBuffer);
+    }
+
+    void PartitionedInstanceAccelerationStructure::Priv::moveMember(uint32_t srcPartIdx, uint32_t index) {
+        Partition &srcPart = partitions[srcPartIdx];
+        Partition &dstPart = partitions[1 - srcPartIdx];
+        Member member = srcPart.members[index];
+        member.numStableFrames = 0;
+
+        srcPart.members[index] = srcPart.members.back();
+        srcPart.members.pop_back();
+        if (index < srcPart.members.size())
+            locations[srcPart.members[index].instance].second = index;
+
+        locations[member.instance] = std::make_pair(
+            1 - srcPartIdx, static_cast<uint32_t>(dstPart.members.size()));
+        dstPart.members.push_back(member);
+
+        srcPart.membershipChanged = true;
+        dstPart.membershipChanged = true;
+    }
+
+    const BufferView &PartitionedInstanceAccelerationStructure::Priv::acquireScratchBuffer(size_t size) {
+        if (!scratchBuffer.isValid() || scratchBuffer.sizeInBytes() < size) {
+            if (scratchBuffer.isValid())
+                allocator->release(scratchBuffer);
+            scratchBuffer = allocator->allocate(size, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+        }
+        return scratchBuffer;
+    }
+
+    void PartitionedInstanceAccelerationStructure::Priv::rebuild(
+        CUstream stream, _InstanceAccelerationStructure* ias) {
+        InstanceAccelerationStructure publicIAS = ias->getPublicType();
+        OptixAccelBufferSizes memReq;
+        publicIAS.prepareForBuild(&memReq);
+        ManagedASMemory &mem = ias->getManagedMemory();
+        mem.setAllocator(allocator);
+        mem.acquire(
+            &mem.auxBuffer, std::max<size_t>(ias->getNumChildren(), 1) * sizeof(OptixInstance),
+            OPTIX_INSTANCE_BYTE_ALIGNMENT);
+        mem.acquire(&mem.accelBuffer, memReq.outputSizeInBytes, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+        publicIAS.rebuild(
+            stream, mem.auxBuffer, mem.accelBuffer,
+            acquireScratchBuffer(std::max(memReq.tempSizeInBytes, memReq.tempUpdateSizeInBytes)));
+    }
+
+    uint32_t PartitionedInstanceAccelerationStructure::Priv::computeMaxTraversableGraphDepth() const {
+        // JP: 下位の子の深さはIASごとにメモ化して、共有されたIASを何度も辿らないようにする。
+        // EN: Memoize the depth of lower children per IAS to avoid traversing a shared IAS many times.
+        std::unordered_map<const _InstanceAccelerationStructure*, uint32_t> iasDepths;
+        std::function<uint32_t(const Instance &)> computeInstanceDepth;
+        const auto computeIASDepth = [&](const InstanceAccelerationStructure &ias) {
+            const _InstanceAccelerationStructure* _ias = optixu::extract(ias);
+            auto it = iasDepths.find(_ias);
+            if (it != iasDepths.cend())
+                return it->second;
+            uint32_t depth = 1;
+            for (uint32_t i = 0; i < ias.getNumChildren(); ++i)
+                depth = std::max(depth, 1 + computeInstanceDepth(ias.getChild(i)));
+            iasDepths[_ias] = depth;
+            return depth;
+        };
+        computeInstanceDepth = [&](const Instance &inst) {
+            ChildType childType = inst.getChildType();
+            uint32_t numTransforms = 0;
+            Transform xfm;
+            if (childType == ChildType::Transform) {
+                xfm = inst.getChild<Transform>();
+                while (true) {
+                    ++numTransforms;
+                    childType = xfm.getChildType();
+                    if (childType != ChildType::Transform)
+                        break;
+                    xfm = xfm.getChild<Transform>();
+                }
+            }
+            uint32_t depth = 1;
+            if (childType == ChildType::IAS) {
+                depth = computeIASDepth(
+                    numTransforms > 0 ?
+                    xfm.getChild<InstanceAccelerationStructure>() :
+                    inst.getChild<InstanceAccelerationStructure>());
+            }
+            return numTransforms + depth;
+        };
+
+        uint32_t maxChildDepth = 1;
+        for (uint32_t partIdx = 0; partIdx < 2; ++partIdx) {
+            for (const Member &member : partitions[partIdx].members)
+                maxChildDepth = std::max(maxChildDepth, computeInstanceDepth(member.instance->getPublicType()));
+        }
+        // JP: トップレベルIASと分割のIASの2段を加える。
+        // EN: Add two levels of the top-level IAS and a partition IAS.
+        return 2 + maxChildDepth;
+    }
+
+    void PartitionedInstanceAccelerationStructure::Priv::addChild(_Instance* instance) {
+        scene->throwRuntimeError(
+            instance,
+            "Invalid instance %p.",
+            instance);
+        scene->throwRuntimeError(
+            instance->getScene() == scene,
+            "Scene mismatch for the given instance %s.",
+            instance->getName().c_str());
+        Partition &part = partitions[s_static];
+        auto res = locations.emplace(
+            instance, std::make_pair(s_static, static_cast<uint32_t>(part.members.size())));
+        scene->throwRuntimeError(
+            res.second,
+            "Instance %s has been already added.",
+            instance->getName().c_str());
+        part.members.push_back(Member{ instance, instance->getRevision(), instance->getChildHandle(), 0 });
+        part.membershipChanged = true;
+    }
+
+    void PartitionedInstanceAccelerationStructure::Priv::removeChild(const _Instance* instance) {
+        auto it = locations.find(instance);
+        scene->throwRuntimeError(
+            it != locations.cend(),
+            "Instance %s is not a child.",
+            instance ? instance->getName().c_str() : "");
+        Partition &part = partitions[it->second.first];
+        uint32_t index = it->second.second;
+        locations.erase(it);
+
+        part.members[index] = part.members.back();
+        part.members.pop_back();
+        if (index < part.members.size())
+            locations[part.members[index].instance].second = index;
+        part.membershipChanged = true;
+    }
+
+    OptixTraversableHandle PartitionedInstanceAccelerationStructure::Priv::build(CUstream stream) {
+        Partition &staticPart = partitions[s_static];
+        Partition &dynamicPart = partitions[s_dynamic];
+
+        // JP: 変更された静的なインスタンスは動的な側へ移す。
+        //     後ろから処理して、末尾との入れ替えによる削除が未処理の要素に影響しないようにする。
+        // EN: Move changed static instances to the dynamic side.
+        //     Process from the back so that removal by swapping with the last doesn't affect unprocessed ones.
+        for (uint32_t i = static_cast<uint32_t>(staticPart.members.size()); i > 0; --i) {
+            Member &member = staticPart.members[i - 1];
+            uint32_t revision = member.instance->getRevision();
+            if (revision == member.revision)
+                continue;
+            member.revision = revision;
+            moveMember(s_static, i - 1);
+        }
+
+        // JP: 子の差し替えはアップデートでは反映されず、階層数も変わり得るので動的なIASをリビルドする。
+        //     ビルドが失敗しても次回に持ち越すよう、分割の状態として記録する。
+        // EN: Replacing a child isn't reflected by update and may change the depth, so rebuild the dynamic IAS.
+        //     Record it as the partition's state to carry it over to the next time even if the build fails.
+        bool dynamicChanged = false;
+        std::vector<uint32_t> stableIndices;
+        for (uint32_t i = 0; i < dynamicPart.members.size(); ++i) {
+            Member &member = dynamicPart.members[i];
+            uint32_t revision = member.instance->getRevision();
+            if (revision != member.revision) {
+                member.revision = revision;
+                member.numStableFrames = 0;
+                dynamicChanged = true;
+                OptixTraversableHandle childHandle = member.instance->getChildHandle();
+                if (childHandle != member.childHandle) {
+                    member.childHandle = childHandle;
+                    dynamicPart.membershipChanged = true;
+                }
+            }
+            else if (++member.numStableFrames >= numStableFramesToBecomeStatic) {
+                stableIndices.push_back(i);
+            }
+        }
+
+        // JP: 安定したインスタンスの移動は静的なIASのリビルドを伴うので、
+        //     リビルドが他の理由で必要な場合か、候補が十分に集まった場合にのみ行う。
+        // EN: Moving stable instances involves rebuilding the static IAS,
+        //     so do it only if the rebuild is needed for another reason or enough candidates have gathered.
+        bool rebuildStatic = staticPart.membershipChanged || !staticPart.ias->isReady();
+        if (!stableIndices.empty() &&
+            (rebuildStatic || stableIndices.size() >= minNumInstancesToMigrate)) {
+            for (auto it = stableIndices.crbegin(); it != stableIndices.crend(); ++it)
+                moveMember(s_dynamic, *it);
+            rebuildStatic = true;
+        }
+
+        const auto syncChildren = [](Partition &part) {
+            std::vector<Instance> children(part.members.size());
+            for (uint32_t i = 0; i < part.members.size(); ++i)
+                children[i] = part.members[i].instance->getPublicType();
+            InstanceAccelerationStructure publicIAS = part.ias->getPublicType();
+            publicIAS.clearChildren();
+            publicIAS.addChildren(children.data(), static_cast<uint32_t>(children.size()));
+            part.membershipChanged = false;
+        };
+
+        bool rebuildDynamic = dynamicPart.membershipChanged || !dynamicPart.ias->isReady();
+        if (rebuildStatic || rebuildDynamic)
+            maxTraversableGraphDepth = computeMaxTraversableGraphDepth();
+        scene->throwRuntimeError(
+            maxTraversableGraphDepth <= deviceMaxTraversableGraphDepth,
+            "Traversable graph depth %u exceeds the device limit %u.",
+            maxTraversableGraphDepth, deviceMaxTraversableGraphDepth);
+        scene->throwRuntimeError(
+            maxTraversableGraphDepth <= traversableGraphDepthLimit,
+            "Traversable graph depth %u exceeds the configured limit %u.",
+            maxTraversableGraphDepth, traversableGraphDepthLimit);
+
+        bool rebuildTopLevel = !topLevelIAS->isReady();
+        InstanceAccelerationStructure publicStaticIAS = staticPart.ias->getPublicType();
+        if (rebuildStatic) {
+            syncChildren(staticPart);
+            rebuild(stream, staticPart.ias);
+            staticCompactionState = CompactionState::None;
+            if (!staticPart.members.empty()) {
+                publicStaticIAS.prepareForCompactAsync(stream);
+                staticCompactionState = CompactionState::WaitingForSize;
+            }
+            rebuildTopLevel = true;
+        }
+        else if (staticCompactionState == CompactionState::WaitingForSize) {
+            size_t compactedSize;
+            if (publicStaticIAS.compactedSizeIsReady(&compactedSize)) {
+                ManagedASMemory &mem = staticPart.ias->getManagedMemory();
+                publicStaticIAS.compact(
+                    stream,
+                    mem.acquire(&mem.compactedAccelBuffer, compactedSize, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT));
+                staticCompactionState = CompactionState::WaitingForRemoval;
+                rebuildTopLevel = true;
+            }
+        }
+        else if (staticCompactionState == CompactionState::WaitingForRemoval) {
+            if (publicStaticIAS.tryRemoveUncompacted()) {
+                ManagedASMemory &mem = staticPart.ias->getManagedMemory();
+                mem.release(&mem.accelBuffer);
+                staticCompactionState = CompactionState::None;
+            }
+        }
+
+        if (rebuildDynamic) {
+            syncChildren(dynamicPart);
+            rebuild(stream, dynamicPart.ias);
+            rebuildTopLevel = true;
+        }
+        else if (dynamicChanged) {
+            dynamicPart.ias->getPublicType().update(stream, scratchBuffer);
+            rebuildTopLevel = true;
+        }
+
+        // JP: トップレベルIASは空でない分割のみを子に持つ。子が高々2つなので毎回リビルドする。
+        // EN: The top-level IAS has only non-empty partitions as children.
+        //     It has at most two children, so always rebuild instead of update.
+        if (rebuildTopLevel) {
+            InstanceAccelerationStructure publicTopLevelIAS = topLevelIAS->getPublicType();
+            publicTopLevelIAS.clearChildren();
+            for (uint32_t partIdx = 0; partIdx < 2; ++partIdx) {
+                if (!partitions[partIdx].members.empty())
+                    publicTopLevelIAS.addChild(partitions[partIdx].instance->getPublicType());
+            }
+            rebuild(stream, topLevelIAS);
+        }
+
+        return topLevelIAS->getHandle();
+    }
+
+    // static
+    PartitionedInstanceAccelerationStructure PartitionedInstanceAccelerationStructure::create(
+        Scene scene, AccelerationStructureMemoryAllocator* allocator) {
+        _Scene* _scene = extract(scene);
+        _scene->throwRuntimeError(
+            allocator,
+            "Allocator must be provided.");
+        PartitionedInstanceAccelerationStructure ret;
+        ret.m = new Priv(_scene, allocator);
+        return ret;
+    }
+
+    void PartitionedInstanceAccelerationStructure::destroy() {
+        if (m)
+            delete m;
+        m = nullptr;
+    }
+
+    void PartitionedInstanceAccelerationStructure::setMigrationOptions(
+        uint32_t numStableFramesToBecomeStatic, uint32_t minNumInstancesToMigrate) const {
+        m->setMigrationOptions(numStableFramesToBecomeStatic, minNumInstancesToMigrate);
+    }
 
-        const BufferView &accelBuffer = m->compactedAvailable ? m->compactedAccelBuffer : m->accelBuffer;
-        OptixTraversableHandle handle = m->compactedAvailable ? m->compactedHandle : m->handle;
+    void PartitionedInstanceAccelerationStructure::setTraversableGraphDepthLimit(uint32_t limit) const {
+        m->setTraversableGraphDepthLimit(limit);
+    }
 
-        m->buildOptions.operation = OPTIX_BUILD_OPERATION_UPDATE;
-        OptixTraversableHandle tempHandle = handle;
-        OPTIX_CHECK(optixAccelBuild(
-            m->getRawContext(), stream,
-            &m->buildOptions, &m->buildInput, 1,
-            scratchBuffer.getCUdeviceptr(), scratchBuffer.sizeInBytes(),
-            accelBuffer.getCUdeviceptr(), accelBuffer.sizeInBytes(),
-            &tempHandle,
-            nullptr, 0));
-        optixuAssert(
-            tempHandle == handle,
-            "IAS %s: Update should not change the handle itself, what's going on?",
-            getName());
+    void PartitionedInstanceAccelerationStructure::addChild(Instance instance) const {
+        m->addChild(extract(instance));
     }
 
-    bool InstanceAccelerationStructure::isReady() const {
-        return m->isReady();
+    void PartitionedInstanceAccelerationStructure::addChildren(
+        const Instance* instances, uint32_t numInstances) const {
+        for (uint32_t i = 0; i < numInstances; ++i)
+            m->addChild(extract(instances[i]));
     }
 
-    OptixTraversableHandle InstanceAccelerationStructure::getHandle() const {
-        return m->getHandle();
+    void PartitionedInstanceAccelerationStructure::removeChild(Instance instance) const {
+        m->removeChild(extract(instance));
     }
 
-    void InstanceAccelerationStructure::getConfiguration(
-        ASTradeoff* tradeOff,
-        AllowUpdate* allowUpdate,
-        AllowCompaction* allowCompaction,
-        AllowRandomInstanceAccess* allowRandomInstanceAccess) const {
-        if (tradeOff)
-            *tradeOff = m->tradeoff;
-        if (allowUpdate)
-            *allowUpdate = AllowUpdate(m->allowUpdate);
-        if (allowCompaction)
-            *allowCompaction = AllowCompaction(m->allowCompaction);
-        if (allowRandomInstanceAccess)
-            *allowRandomInstanceAccess = AllowRandomInstanceAccess(m->allowRandomInstanceAccess);
+    void PartitionedInstanceAccelerationStructure::markDirty() const {
+        m->markDirty();
     }
 
-    void InstanceAccelerationStructure::getMotionOptions(
-        uint32_t* numKeys, float* timeBegin, float* timeEnd, OptixMotionFlags* flags) const {
-        if (numKeys)
-            *numKeys = m->buildOptions.motionOptions.numKeys;
-        if (timeBegin)
-            *timeBegin = m->buildOptions.motionOptions.timeBegin;
-        if (timeEnd)
-            *timeEnd = m->buildOptions.motionOptions.timeEnd;
-        if (flags)
-            *flags = static_cast<OptixMotionFlags>(m->buildOptions.motionOptions.flags);
+    OptixTraversableHandle PartitionedInstanceAccelerationStructure::build(CUstream stream) const {
+        return m->build(stream);
     }
 
-    uint32_t InstanceAccelerationStructure::getNumChildren() const {
-        return static_cast<uint32_t>(m->children.size());
+    OptixTraversableHandle PartitionedInstanceAccelerationStructure::getHandle() const {
+        return m->getHandle();
     }
 
-    uint32_t InstanceAccelerationStructure::findChildIndex(Instance instance) const {
-        _Instance* _inst = extract(instance);
-        m->throwRuntimeError(
-            _inst,
-            "Invalid instance %p.",
-            _inst);
-        m->throwRuntimeError(
-            _inst->getScene() == m->scene,
-            "Scene mismatch for the given instance %s.",
-            _inst->getName().c_str());
-        auto idx = std::find(m->children.cbegin(), m->children.cend(), _inst);
-        if (idx == m->children.cend())
-            return 0xFFFFFFFF;
+    uint32_t PartitionedInstanceAccelerationStructure::getMaxTraversableGraphDepth() const {
+        return m->getMaxTraversableGraphDepth();
+    }
 
-        return static_cast<uint32_t>(std::distance(m->children.cbegin(), idx));
+    uint32_t PartitionedInstanceAccelerationStructure::getNumChildren() const {
+        return m->getNumChildren();
     }
 
-    Instance InstanceAccelerationStructure::getChild(uint32_t index) const {
-        uint32_t numChildren = static_cast<uint32_t>(m->children.size());
-        m->throwRuntimeError(
-            index < numChildren,
-            "Index is out of bounds [0, %u).]",
-            numChildren);
-        return m->children[index]->getPublicType();
+    uint32_t PartitionedInstanceAccelerationStructure::getNumDynamicChildren() const {
+        return m->getNumDynamicChildren();
+    }
+
+    bool PartitionedInstanceAccelerationStructure::isDynamicChild(Instance instance) const {
+        return m->isDynamicChild(extract(instance));
     }
 
 
 
     Pipeline::Priv::~Priv() {
+        releaseSBTRing();
         if (pipelineLinked)
             optixPipelineDestroy(rawPipeline);
         for (auto it = modulesForBuiltinIS.begin(); it != modulesForBuiltinIS.end(); ++it)
@@ -3172,33 +6285,92 @@ namespace optixu {
         int32_t maxRegisterCount,
         OptixCompileOptimizationLevel optLevel, OptixCompileDebugLevel debugLevel,
         OptixModuleCompileBoundValueEntry* boundValues, uint32_t numBoundValues,
-        const PayloadType* payloadTypes, uint32_t numPayloadTypes) {
-        std::vector<OptixPayloadType> optixPayloadTypes(numPayloadTypes);
+        const PayloadType* payloadTypes, uint32_t numPayloadTypes,
+        bool async) {
+        // JP: 非同期の場合、入力はタスクの実行中に参照され得るのでモジュールが保持するコピーを使う。
+        // EN: In the async case, inputs may be referenced while executing tasks,
+        //     so use copies held by the module.
+        _Module::CompileInputs syncInputs;
+        std::unique_ptr<_Module::CompileInputs> asyncInputs;
+        if (async)
+            asyncInputs = std::make_unique<_Module::CompileInputs>();
+        _Module::CompileInputs* inputs = async ? asyncInputs.get() : &syncInputs;
+        if (async) {
+            inputs->data.assign(data, data + size);
+            data = inputs->data.data();
+            inputs->boundValues.assign(boundValues, boundValues + numBoundValues);
+            inputs->boundValueData.resize(numBoundValues);
+            for (uint32_t i = 0; i < numBoundValues; ++i) {
+                OptixModuleCompileBoundValueEntry &entry = inputs->boundValues[i];
+                const uint8_t* value = reinterpret_cast<const uint8_t*>(entry.boundValuePtr);
+                inputs->boundValueData[i].assign(value, value + entry.sizeInBytes);
+                entry.boundValuePtr = inputs->boundValueData[i].data();
+            }
+            boundValues = inputs->boundValues.data();
+            inputs->payloadTypes.assign(payloadTypes, payloadTypes + numPayloadTypes);
+            payloadTypes = inputs->payloadTypes.data();
+        }
+
+        std::vector<OptixPayloadType> &optixPayloadTypes = inputs->rawPayloadTypes;
+        optixPayloadTypes.resize(numPayloadTypes);
         for (uint32_t i = 0; i < numPayloadTypes; ++i)
             optixPayloadTypes[i] = payloadTypes[i].getRawType();
 
-        OptixModuleCompileOptions moduleCompileOptions = {};
+        OptixModuleCompileOptions &moduleCompileOptions = inputs->compileOptions;
+        moduleCompileOptions = {};
         moduleCompileOptions.maxRegisterCount = maxRegisterCount;
         moduleCompileOptions.optLevel = optLevel;
         moduleCompileOptions.debugLevel = debugLevel;
-        moduleCompileOptions.boundValues = boundValues;
+        moduleCompileOptions.boundValues = numBoundValues ? boundValues : nullptr;
         moduleCompileOptions.numBoundValues = numBoundValues;
         moduleCompileOptions.payloadTypes = numPayloadTypes ? optixPayloadTypes.data() : nullptr;
         moduleCompileOptions.numPayloadTypes = numPayloadTypes;
 
         OptixModule rawModule;
 
+        // JP: キャッシュにヒットした場合は非同期の指定に関わらずコンパイル済みのモジュールを共有する。
+        //     非同期に生成したモジュールはキャッシュに登録しない。
+        // EN: On a cache hit, share the compiled module regardless of async.
+        //     Modules created asynchronously are not registered to the cache.
+        uint64_t cacheKey = 0;
+        bool cacheable = context->isProgramCacheEnabled();
+        if (cacheable) {
+            cacheKey = computeModuleCacheKey(data, size, moduleCompileOptions, pipelineCompileOptions);
+            if (context->acquireCachedModule(cacheKey, &rawModule))
+                return (new _Module(this, rawModule))->getPublicType();
+        }
+
         char log[4096];
         size_t logSize = sizeof(log);
-        OPTIX_CHECK_LOG(optixModuleCreate(
+        if (!async) {
+            OPTIX_CHECK_LOG(optixModuleCreate(
+                getRawContext(),
+                &moduleCompileOptions,
+                &pipelineCompileOptions,
+                data, size,
+                log, &logSize,
+                &rawModule));
+            if (cacheable)
+                rawModule = context->registerCachedModule(cacheKey, rawModule);
+
+            return (new _Module(this, rawModule))->getPublicType();
+        }
+
+        OptixTask firstTask;
+        OPTIX_CHECK_LOG(optixModuleCreateWithTasks(
             getRawContext(),
             &moduleCompileOptions,
             &pipelineCompileOptions,
             data, size,
             log, &logSize,
-            &rawModule));
+            &rawModule,
+            &firstTask));
 
-        return (new _Module(this, rawModule))->getPublicType();
+        static OptixModuleCompileTaskSource taskSource;
+        auto compileJob = std::make_shared<ModuleCompileJob>(getContext()->getThreadPool(), &taskSource);
+        compileJob->start(firstTask);
+
+        return (new _Module(this, rawModule, compileJob, std::move(asyncInputs)))->getPublicType();
     }
 
     OptixModule Pipeline::Priv::getModuleForBuiltin(
@@ -3246,31 +6418,280 @@ namespace optixu {
         return modulesForBuiltinIS.at(key)->getRawModule();
     }
 
-    void Pipeline::Priv::createProgram(
+    static uint32_t getEntryFunctionNameSlots(OptixProgramGroupDesc* desc, const char** slots[3]) {
+        switch (desc->kind) {
+        case OPTIX_PROGRAM_GROUP_KIND_RAYGEN:
+            slots[0] = &desc->raygen.entryFunctionName;
+            return 1;
+        case OPTIX_PROGRAM_GROUP_KIND_MISS:
+            slots[0] = &desc->miss.entryFunctionName;
+            return 1;
+        case OPTIX_PROGRAM_GROUP_KIND_EXCEPTION:
+            slots[0] = &desc->exception.entryFunctionName;
+            return 1;
+        case OPTIX_PROGRAM_GROUP_KIND_HITGROUP:
+            slots[0] = &desc->hitgroup.entryFunctionNameCH;
+            slots[1] = &desc->hitgroup.entryFunctionNameAH;
+            slots[2] = &desc->hitgroup.entryFunctionNameIS;
+            return 3;
+        case OPTIX_PROGRAM_GROUP_KIND_CALLABLES:
+            slots[0] = &desc->callables.entryFunctionNameDC;
+            slots[1] = &desc->callables.entryFunctionNameCC;
+            return 2;
+        default:
+            return 0;
+        }
+    }
+
+    template <typename PrivType, typename... ArgTypes>
+    PrivType* Pipeline::Priv::createProgram(
         const OptixProgramGroupDesc &desc, const OptixProgramGroupOptions &options,
-        OptixProgramGroup* group) {
-        char log[4096];
-        size_t logSize = sizeof(log);
-        OPTIX_CHECK_LOG(optixProgramGroupCreate(
-            getRawContext(),
-            &desc, 1, // num program groups
-            &options,
-            log, &logSize,
-            group));
-        programGroups.insert(*group);
+        const ArgTypes &... args) {
+        if (programGroupBatchIsOpen) {
+            PendingProgramGroup pending;
+            pending.desc = desc;
+            const char** slots[3];
+            uint32_t numSlots = getEntryFunctionNameSlots(&pending.desc, slots);
+            for (uint32_t i = 0; i < numSlots; ++i) {
+                if (*slots[i])
+                    pending.entryFunctionNames[i] = *slots[i];
+            }
+            if (options.payloadType) {
+                pending.payloadType.numDwords = options.payloadType->numPayloadValues;
+                for (uint32_t i = 0; i < pending.payloadType.numDwords; ++i)
+                    pending.payloadType.semantics[i] =
+                        static_cast<OptixPayloadSemantics>(options.payloadType->payloadSemantics[i]);
+            }
+
+            PrivType* program = new PrivType(this, nullptr, args...);
+            pending.target = program;
+            pendingProgramGroups.push_back(std::move(pending));
+
+            return program;
+        }
+
+        OptixProgramGroup group;
+        uint64_t cacheKey;
+        bool cacheable =
+            context->isProgramCacheEnabled() &&
+            context->computeProgramGroupCacheKey(desc, options, pipelineCompileOptions, &cacheKey);
+        if (!cacheable || !context->acquireCachedProgramGroup(cacheKey, &group)) {
+            char log[4096];
+            size_t logSize = sizeof(log);
+            OPTIX_CHECK_LOG(optixProgramGroupCreate(
+                getRawContext(),
+                &desc, 1, // num program groups
+                &options,
+                log, &logSize,
+                &group));
+            if (cacheable)
+                group = context->registerCachedProgramGroup(cacheKey, group);
+        }
+        ++programGroups[group];
+
+        markDirty();
+
+        return new PrivType(this, group, args...);
+    }
+
+    void Pipeline::Priv::beginProgramGroupBatch() {
+        throwRuntimeError(!programGroupBatchIsOpen, "A program group batch is already in progress.");
+        programGroupBatchIsOpen = true;
+    }
+
+    void Pipeline::Priv::endProgramGroupBatch() {
+        throwRuntimeError(programGroupBatchIsOpen, "No program group batch is in progress.");
+        if (pendingProgramGroups.empty()) {
+            programGroupBatchIsOpen = false;
+            return;
+        }
+
+        const uint32_t numGroups = static_cast<uint32_t>(pendingProgramGroups.size());
+
+        // JP: 全てのプログラムグループを生成・取得してから対象に設定する。
+        //     途中で失敗した場合は取得済みのものを解放し、保留中のリストとバッチの状態を保ったまま再送出する。
+        //     失敗したプログラムを破棄すれば、残りは再度のendProgramGroupBatch()で生成できる。
+        // EN: Set program groups to the targets after creating or acquiring all of them.
+        //     On a failure in between, release the acquired ones and rethrow keeping the pending list and
+        //     the batch state. Destroying the failed programs allows creating the rest by calling
+        //     endProgramGroupBatch() again.
+        std::vector<OptixProgramGroup> groups(numGroups, nullptr);
+        try {
+            // JP: optixProgramGroupCreate()のオプションは全ての記述子に共通なので、
+            //     ペイロードタイプが同じプログラムグループごとに1回呼び出す。
+            // EN: Options of optixProgramGroupCreate() are common to all the descs,
+            //     so call it once per set of program groups with the same payload type.
+            std::vector<uint64_t> cacheKeys(numGroups);
+            std::vector<uint8_t> cacheables(numGroups, false);
+            std::map<std::vector<uint32_t>, std::vector<uint32_t>> groupIndicesPerPayloadType;
+            for (uint32_t i = 0; i < numGroups; ++i) {
+                PendingProgramGroup &pending = pendingProgramGroups[i];
+                const char** slots[3];
+                uint32_t numSlots = getEntryFunctionNameSlots(&pending.desc, slots);
+                for (uint32_t j = 0; j < numSlots; ++j) {
+                    if (*slots[j])
+                        *slots[j] = pending.entryFunctionNames[j].c_str();
+                }
+
+                OptixProgramGroupOptions options = {};
+                OptixPayloadType optixPayloadType = pending.payloadType.getRawType();
+                if (pending.payloadType.numDwords > 0)
+                    options.payloadType = &optixPayloadType;
+                cacheables[i] =
+                    context->isProgramCacheEnabled() &&
+                    context->computeProgramGroupCacheKey(
+                        pending.desc, options, pipelineCompileOptions, &cacheKeys[i]);
+                if (cacheables[i] && context->acquireCachedProgramGroup(cacheKeys[i], &groups[i]))
+                    continue;
+
+                std::vector<uint32_t> payloadTypeKey(1 + pending.payloadType.numDwords);
+                payloadTypeKey[0] = pending.payloadType.numDwords;
+                for (uint32_t j = 0; j < pending.payloadType.numDwords; ++j)
+                    payloadTypeKey[1 + j] = pending.payloadType.semantics[j];
+                groupIndicesPerPayloadType[payloadTypeKey].push_back(i);
+            }
+
+            for (const auto &payloadTypeAndIndices : groupIndicesPerPayloadType) {
+                const std::vector<uint32_t> &indices = payloadTypeAndIndices.second;
+                std::vector<OptixProgramGroupDesc> descs(indices.size());
+                for (uint32_t j = 0; j < indices.size(); ++j)
+                    descs[j] = pendingProgramGroups[indices[j]].desc;
+
+                const PayloadType &payloadType = pendingProgramGroups[indices[0]].payloadType;
+                OptixProgramGroupOptions options = {};
+                OptixPayloadType optixPayloadType = payloadType.getRawType();
+                if (payloadType.numDwords > 0)
+                    options.payloadType = &optixPayloadType;
+
+                std::vector<OptixProgramGroup> createdGroups(indices.size());
+                char log[4096];
+                size_t logSize = sizeof(log);
+                OPTIX_CHECK_LOG(optixProgramGroupCreate(
+                    getRawContext(),
+                    descs.data(), static_cast<uint32_t>(descs.size()),
+                    &options,
+                    log, &logSize,
+                    createdGroups.data()));
+                for (uint32_t j = 0; j < indices.size(); ++j) {
+                    uint32_t groupIdx = indices[j];
+                    groups[groupIdx] = cacheables[groupIdx] ?
+                        context->registerCachedProgramGroup(cacheKeys[groupIdx], createdGroups[j]) :
+                        createdGroups[j];
+                }
+            }
+
+            for (uint32_t i = 0; i < numGroups; ++i) {
+                std::visit([&groups, i](auto program) {
+                    program->setRawProgramGroup(groups[i]);
+                }, pendingProgramGroups[i].target);
+            }
+        }
+        catch (...) {
+            for (uint32_t i = 0; i < numGroups; ++i) {
+                std::visit([](auto program) {
+                    program->setRawProgramGroup(nullptr);
+                }, pendingProgramGroups[i].target);
+                if (groups[i] && !context->releaseCachedProgramGroup(groups[i]))
+                    OPTIX_CHECK(optixProgramGroupDestroy(groups[i]));
+            }
+            throw;
+        }
+
+        for (uint32_t i = 0; i < numGroups; ++i)
+            ++programGroups[groups[i]];
+        pendingProgramGroups.clear();
+        programGroupBatchIsOpen = false;
 
         markDirty();
     }
 
+    void Pipeline::Priv::cancelPendingProgramGroup(
+        const std::variant<_Program*, _HitProgramGroup*, _CallableProgramGroup*> &target) {
+        auto it = std::find_if(
+            pendingProgramGroups.begin(), pendingProgramGroups.end(),
+            [&target](const PendingProgramGroup &pending) {
+                return pending.target == target;
+            });
+        optixuAssert(it != pendingProgramGroups.end(), "This program group has not been registered.");
+        pendingProgramGroups.erase(it);
+    }
+
     void Pipeline::Priv::destroyProgram(OptixProgramGroup group) {
         optixuAssert(programGroups.count(group) > 0, "This program group has not been registered.");
-        programGroups.erase(group);
-        OPTIX_CHECK(optixProgramGroupDestroy(group));
+        if (--programGroups.at(group) == 0)
+            programGroups.erase(group);
+        if (!context->releaseCachedProgramGroup(group))
+            OPTIX_CHECK(optixProgramGroupDestroy(group));
 
         markDirty();
     }
 
+    void Pipeline::Priv::releaseSBTRing() {
+        for (SBTRingSlot &slot : sbtRing) {
+            cuEventSynchronize(slot.launchEvent);
+            if (slot.sbtMem)
+                cuMemFree(slot.sbtMem);
+            if (slot.sbtHostMem)
+                cuMemFreeHost(slot.sbtHostMem);
+            if (slot.hitGroupSbtMem)
+                cuMemFree(slot.hitGroupSbtMem);
+            if (slot.hitGroupSbtHostMem)
+                cuMemFreeHost(slot.hitGroupSbtHostMem);
+            cuEventDestroy(slot.launchEvent);
+        }
+        sbtRing.clear();
+        sbtRingIndex = 0;
+    }
+
+    void Pipeline::Priv::acquireSBTRingSlot() {
+        sbtRingIndex = (sbtRingIndex + 1) % static_cast<uint32_t>(sbtRing.size());
+        SBTRingSlot &slot = sbtRing[sbtRingIndex];
+
+        // JP: このスロットを読む過去のローンチの完了を待つ。
+        //     リングの深さ分前のローンチなので、通常は既に完了している。
+        // EN: Wait for the completion of the past launch reading this slot.
+        //     It is the launch the ring depth before, so it has usually already completed.
+        CUDADRV_CHECK(cuEventSynchronize(slot.launchEvent));
+
+        if (slot.sbtCapacity < sbtSize) {
+            if (slot.sbtMem)
+                CUDADRV_CHECK(cuMemFree(slot.sbtMem));
+            if (slot.sbtHostMem)
+                CUDADRV_CHECK(cuMemFreeHost(slot.sbtHostMem));
+            CUDADRV_CHECK(cuMemAlloc(&slot.sbtMem, sbtSize));
+            CUDADRV_CHECK(cuMemAllocHost(&slot.sbtHostMem, sbtSize));
+            slot.sbtCapacity = sbtSize;
+        }
+
+        size_t hitGroupSbtSize = scene->getHitGroupSBTSize();
+        if (slot.hitGroupSbtCapacity < hitGroupSbtSize) {
+            if (slot.hitGroupSbtMem)
+                CUDADRV_CHECK(cuMemFree(slot.hitGroupSbtMem));
+            if (slot.hitGroupSbtHostMem)
+                CUDADRV_CHECK(cuMemFreeHost(slot.hitGroupSbtHostMem));
+            CUDADRV_CHECK(cuMemAlloc(&slot.hitGroupSbtMem, hitGroupSbtSize));
+            CUDADRV_CHECK(cuMemAllocHost(&slot.hitGroupSbtHostMem, hitGroupSbtSize));
+            slot.hitGroupSbtCapacity = hitGroupSbtSize;
+            slot.hitGroupSbtSyncState = HitGroupSBTSyncState();
+        }
+
+        sbt = BufferView(slot.sbtMem, sbtSize, 1);
+        sbtHostMem = slot.sbtHostMem;
+        hitGroupSbt = BufferView(slot.hitGroupSbtMem, hitGroupSbtSize, 1);
+        hitGroupSbtHostMem = slot.hitGroupSbtHostMem;
+
+        // JP: スロットの内容は古いので両方のテーブルをセットアップし直す。
+        //     ヒットグループSBTはスロットごとの同期状態を基に差分更新される。
+        // EN: Contents of the slot are stale, so set up both tables again.
+        //     The hit group SBT is incrementally updated based on the per-slot sync state.
+        sbtIsUpToDate = false;
+        hitGroupSbtIsUpToDate = false;
+    }
+
     void Pipeline::Priv::setupShaderBindingTable(CUstream stream) {
+        if (!sbtRing.empty() && (!sbtIsUpToDate || !hitGroupSbtIsUpToDate))
+            acquireSBTRingSlot();
+
         if (!sbtIsUpToDate) {
             throwRuntimeError(rayGenProgram, "Ray generation program is not set.");
             for (uint32_t i = 0; i < numMissRayTypes; ++i)
@@ -3318,7 +6739,9 @@ namespace optixu {
         }
 
         if (!hitGroupSbtIsUpToDate) {
-            scene->setupHitGroupSBT(stream, this, hitGroupSbt, hitGroupSbtHostMem);
+            HitGroupSBTSyncState* syncState = sbtRing.empty() ?
+                &hitGroupSbtSyncState : &sbtRing[sbtRingIndex].hitGroupSbtSyncState;
+            scene->setupHitGroupSBT(stream, this, hitGroupSbt, hitGroupSbtHostMem, syncState);
 
             sbtParams.hitgroupRecordBase = hitGroupSbt.getCUdeviceptr();
             sbtParams.hitgroupRecordStrideInBytes = scene->getSingleRecordSize();
@@ -3371,7 +6794,8 @@ namespace optixu {
             maxRegisterCount,
             optLevel, debugLevel,
             boundValues, numBoundValues,
-            payloadTypes, numPayloadTypes);
+            payloadTypes, numPayloadTypes,
+            false);
     }
 
     Module Pipeline::createModuleFromOptixIR(
@@ -3384,7 +6808,36 @@ namespace optixu {
             maxRegisterCount,
             optLevel, debugLevel,
             boundValues, numBoundValues,
-            payloadTypes, numPayloadTypes);
+            payloadTypes, numPayloadTypes,
+            false);
+    }
+
+    Module Pipeline::createModuleFromPTXStringAsync(
+        const std::string &ptxString, int32_t maxRegisterCount,
+        OptixCompileOptimizationLevel optLevel, OptixCompileDebugLevel debugLevel,
+        OptixModuleCompileBoundValueEntry* boundValues, uint32_t numBoundValues,
+        const PayloadType* payloadTypes, uint32_t numPayloadTypes) const {
+        return m->createModule(
+            ptxString.c_str(), ptxString.size(),
+            maxRegisterCount,
+            optLevel, debugLevel,
+            boundValues, numBoundValues,
+            payloadTypes, numPayloadTypes,
+            true);
+    }
+
+    Module Pipeline::createModuleFromOptixIRAsync(
+        const std::vector<char> &irBin, int32_t maxRegisterCount,
+        OptixCompileOptimizationLevel optLevel, OptixCompileDebugLevel debugLevel,
+        OptixModuleCompileBoundValueEntry* boundValues, uint32_t numBoundValues,
+        const PayloadType* payloadTypes, uint32_t numPayloadTypes) const {
+        return m->createModule(
+            irBin.data(), irBin.size(),
+            maxRegisterCount,
+            optLevel, debugLevel,
+            boundValues, numBoundValues,
+            payloadTypes, numPayloadTypes,
+            true);
     }
 
     Program Pipeline::createRayGenProgram(Module module, const char* entryFunctionName) const {
@@ -3404,10 +6857,7 @@ namespace optixu {
 
         OptixProgramGroupOptions options = {};
 
-        OptixProgramGroup group;
-        m->createProgram(desc, options, &group);
-
-        return (new _Program(m, group, desc.kind))->getPublicType();
+        return m->createProgram<_Program>(desc, options, desc.kind)->getPublicType();
     }
 
     Program Pipeline::createExceptionProgram(Module module, const char* entryFunctionName) const {
@@ -3427,10 +6877,7 @@ namespace optixu {
 
         OptixProgramGroupOptions options = {};
 
-        OptixProgramGroup group;
-        m->createProgram(desc, options, &group);
-
-        return (new _Program(m, group, desc.kind))->getPublicType();
+        return m->createProgram<_Program>(desc, options, desc.kind)->getPublicType();
     }
 
     Program Pipeline::createMissProgram(
@@ -3457,10 +6904,7 @@ namespace optixu {
         if (payloadType.numDwords > 0)
             options.payloadType = &optixPayloadType;
 
-        OptixProgramGroup group;
-        m->createProgram(desc, options, &group);
-
-        return (new _Program(m, group, desc.kind))->getPublicType();
+        return m->createProgram<_Program>(desc, options, desc.kind)->getPublicType();
     }
 
     HitProgramGroup Pipeline::createHitProgramGroupForTriangleIS(
@@ -3505,10 +6949,7 @@ namespace optixu {
         if (payloadType.numDwords > 0)
             options.payloadType = &optixPayloadType;
 
-        OptixProgramGroup group;
-        m->createProgram(desc, options, &group);
-
-        return (new _HitProgramGroup(m, group))->getPublicType();
+        return m->createProgram<_HitProgramGroup>(desc, options)->getPublicType();
     }
 
     HitProgramGroup Pipeline::createHitProgramGroupForCurveIS(
@@ -3568,10 +7009,7 @@ namespace optixu {
         if (payloadType.numDwords > 0)
             options.payloadType = &optixPayloadType;
 
-        OptixProgramGroup group;
-        m->createProgram(desc, options, &group);
-
-        return (new _HitProgramGroup(m, group))->getPublicType();
+        return m->createProgram<_HitProgramGroup>(desc, options)->getPublicType();
     }
 
     HitProgramGroup Pipeline::createHitProgramGroupForSphereIS(
@@ -3622,10 +7060,7 @@ namespace optixu {
         if (payloadType.numDwords > 0)
             options.payloadType = &optixPayloadType;
 
-        OptixProgramGroup group;
-        m->createProgram(desc, options, &group);
-
-        return (new _HitProgramGroup(m, group))->getPublicType();
+        return m->createProgram<_HitProgramGroup>(desc, options)->getPublicType();
     }
 
     HitProgramGroup Pipeline::createHitProgramGroupForCustomIS(
@@ -3681,10 +7116,7 @@ namespace optixu {
         if (payloadType.numDwords > 0)
             options.payloadType = &optixPayloadType;
 
-        OptixProgramGroup group;
-        m->createProgram(desc, options, &group);
-
-        return (new _HitProgramGroup(m, group))->getPublicType();
+        return m->createProgram<_HitProgramGroup>(desc, options)->getPublicType();
     }
 
     HitProgramGroup Pipeline::createEmptyHitProgramGroup() const {
@@ -3692,10 +7124,7 @@ namespace optixu {
 
         OptixProgramGroupOptions options = {};
 
-        OptixProgramGroup group;
-        m->createProgram(desc, options, &group);
-
-        return (new _HitProgramGroup(m, group))->getPublicType();
+        return m->createProgram<_HitProgramGroup>(desc, options)->getPublicType();
     }
 
     CallableProgramGroup Pipeline::createCallableProgramGroup(
@@ -3740,21 +7169,30 @@ namespace optixu {
         if (payloadType.numDwords > 0)
             options.payloadType = &optixPayloadType;
 
-        OptixProgramGroup group;
-        m->createProgram(desc, options, &group);
+        return m->createProgram<_CallableProgramGroup>(desc, options)->getPublicType();
+    }
+
+    void Pipeline::beginProgramGroupBatch() const {
+        m->beginProgramGroupBatch();
+    }
 
-        return (new _CallableProgramGroup(m, group))->getPublicType();
+    void Pipeline::endProgramGroupBatch() const {
+        m->endProgramGroupBatch();
     }
 
     void Pipeline::link(uint32_t maxTraceDepth) const {
         m->throwRuntimeError(!m->pipelineLinked, "This pipeline has been already linked.");
+        m->throwRuntimeError(
+            !m->programGroupBatchIsOpen,
+            "A program group batch is in progress. Call endProgramGroupBatch() before linking.");
 
         OptixPipelineLinkOptions pipelineLinkOptions = {};
         pipelineLinkOptions.maxTraceDepth = maxTraceDepth;
 
         std::vector<OptixProgramGroup> groups;
-        groups.resize(m->programGroups.size());
-        std::copy(m->programGroups.cbegin(), m->programGroups.cend(), groups.begin());
+        groups.reserve(m->programGroups.size());
+        for (const std::pair<const OptixProgramGroup, uint32_t> &group : m->programGroups)
+            groups.push_back(group.first);
 
         char log[4096];
         size_t logSize = sizeof(log);
@@ -3805,6 +7243,10 @@ namespace optixu {
             _program->getPipeline() == m,
             "Pipeline mismatch for the given program %s.",
             _program->getName().c_str());
+        m->throwRuntimeError(
+            !_program->isPending(),
+            "The program %s is still pending in a program group batch.",
+            _program->getName().c_str());
 
         m->rayGenProgram = _program;
         m->sbtIsUpToDate = false;
@@ -3820,6 +7262,10 @@ namespace optixu {
             _program->getPipeline() == m,
             "Pipeline mismatch for the given program %s.",
             _program->getName().c_str());
+        m->throwRuntimeError(
+            !_program->isPending(),
+            "The program %s is still pending in a program group batch.",
+            _program->getName().c_str());
 
         m->exceptionProgram = _program;
         m->sbtIsUpToDate = false;
@@ -3838,6 +7284,10 @@ namespace optixu {
             _program->getPipeline() == m,
             "Pipeline mismatch for the given program %s.",
             _program->getName().c_str());
+        m->throwRuntimeError(
+            !_program->isPending(),
+            "The program %s is still pending in a program group batch.",
+            _program->getName().c_str());
 
         m->missPrograms[rayType] = _program;
         m->sbtIsUpToDate = false;
@@ -3855,12 +7305,19 @@ namespace optixu {
             _program->getPipeline() == m,
             "Pipeline mismatch for the given program group %s.",
             _program->getName().c_str());
+        m->throwRuntimeError(
+            !_program->isPending(),
+            "The program group %s is still pending in a program group batch.",
+            _program->getName().c_str());
 
         m->callablePrograms[index] = _program;
         m->sbtIsUpToDate = false;
     }
 
     void Pipeline::setShaderBindingTable(const BufferView &shaderBindingTable, void* hostMem) const {
+        m->throwRuntimeError(
+            m->sbtRing.empty(),
+            "SBT is owned by the pipeline's SBT ring.");
         m->throwRuntimeError(
             shaderBindingTable.sizeInBytes() >= m->sbtSize,
             "Hit group shader binding table size is not enough.");
@@ -3875,14 +7332,24 @@ namespace optixu {
     void Pipeline::setScene(const Scene &scene) const {
         m->scene = extract(scene);
         m->hitGroupSbt = BufferView();
+        m->hitGroupSbtSyncState = HitGroupSBTSyncState();
+        for (Priv::SBTRingSlot &slot : m->sbtRing)
+            slot.hitGroupSbtSyncState = HitGroupSBTSyncState();
         m->hitGroupSbtIsUpToDate = false;
     }
 
     void Pipeline::setHitGroupShaderBindingTable(
         const BufferView &shaderBindingTable, void* hostMem) const {
+        m->throwRuntimeError(
+            m->sbtRing.empty(),
+            "Hit group SBT is owned by the pipeline's SBT ring.");
         m->throwRuntimeError(
             hostMem,
             "Host-side hit group SBT counterpart must be provided.");
+        // JP: 異なるバッファーに対しては差分更新を行えない。
+        // EN: Incremental update is not possible for a different buffer.
+        if (!(shaderBindingTable == m->hitGroupSbt) || hostMem != m->hitGroupSbtHostMem)
+            m->hitGroupSbtSyncState = HitGroupSBTSyncState();
         m->hitGroupSbt = shaderBindingTable;
         m->hitGroupSbtHostMem = hostMem;
         m->hitGroupSbtIsUpToDate = false;
@@ -3892,6 +7359,33 @@ namespace optixu {
         m->hitGroupSbtIsUpToDate = false;
     }
 
+    void Pipeline::setShaderBindingTableRingDepth(uint32_t depth) const {
+        m->releaseSBTRing();
+        m->sbtRing.resize(depth);
+        for (Priv::SBTRingSlot &slot : m->sbtRing) {
+            slot.sbtMem = 0;
+            slot.sbtHostMem = nullptr;
+            slot.sbtCapacity = 0;
+            slot.hitGroupSbtMem = 0;
+            slot.hitGroupSbtHostMem = nullptr;
+            slot.hitGroupSbtCapacity = 0;
+            CUDADRV_CHECK(cuEventCreate(&slot.launchEvent, CU_EVENT_DISABLE_TIMING));
+        }
+        // JP: ユーザーが設定したバッファーとリングのバッファーは混在させない。
+        // EN: Don't mix user-set buffers with buffers of the ring.
+        m->sbt = BufferView();
+        m->sbtHostMem = nullptr;
+        m->hitGroupSbt = BufferView();
+        m->hitGroupSbtHostMem = nullptr;
+        m->hitGroupSbtSyncState = HitGroupSBTSyncState();
+        m->sbtIsUpToDate = false;
+        m->hitGroupSbtIsUpToDate = false;
+    }
+
+    uint32_t Pipeline::getShaderBindingTableRingDepth() const {
+        return static_cast<uint32_t>(m->sbtRing.size());
+    }
+
     void Pipeline::setStackSize(
         uint32_t directCallableStackSizeFromTraversal,
         uint32_t directCallableStackSizeFromState,
@@ -3911,17 +7405,46 @@ namespace optixu {
             maxTraversableGraphDepth));
     }
 
+    void Pipeline::computeStackSizes(
+        uint32_t maxTraceDepth, uint32_t maxCCDepth, uint32_t maxDCDepth,
+        uint32_t maxTraversableGraphDepth) const {
+        m->throwRuntimeError(m->pipelineLinked, "Pipeline must be linked before computing stack sizes.");
+
+        OptixStackSizes accumulatedStackSizes = {};
+        for (const std::pair<const OptixProgramGroup, uint32_t> &group : m->programGroups) {
+            OptixStackSizes stackSizes;
+            OPTIX_CHECK(optixProgramGroupGetStackSize(group.first, &stackSizes, m->rawPipeline));
+            accumulateStackSizes(stackSizes, &accumulatedStackSizes);
+        }
+
+        uint32_t directCallableStackSizeFromTraversal;
+        uint32_t directCallableStackSizeFromState;
+        uint32_t continuationStackSize;
+        calcPipelineStackSizes(
+            accumulatedStackSizes,
+            maxTraceDepth, maxCCDepth, maxDCDepth,
+            &directCallableStackSizeFromTraversal,
+            &directCallableStackSizeFromState,
+            &continuationStackSize);
+        setStackSize(
+            directCallableStackSizeFromTraversal,
+            directCallableStackSizeFromState,
+            continuationStackSize,
+            maxTraversableGraphDepth);
+    }
+
     void Pipeline::launch(
         CUstream stream, CUdeviceptr plpOnDevice,
         uint32_t dimX, uint32_t dimY, uint32_t dimZ) const {
+        bool usesSBTRing = !m->sbtRing.empty();
         m->throwRuntimeError(
             m->sbtLayoutIsUpToDate,
             "Shader binding table layout is outdated.");
         m->throwRuntimeError(
-            m->sbt.isValid(),
+            usesSBTRing || m->sbt.isValid(),
             "Shader binding table is not set.");
         m->throwRuntimeError(
-            m->sbt.sizeInBytes() >= m->sbtSize,
+            usesSBTRing || m->sbt.sizeInBytes() >= m->sbtSize,
             "Shader binding table size is not enough.");
         m->throwRuntimeError(
             m->scene,
@@ -3934,17 +7457,29 @@ namespace optixu {
             m->pipelineCompileOptions.usesMotionBlur || !hasMotionAS,
             "Scene has a motion AS but the pipeline has not been configured for motion.");
         m->throwRuntimeError(
-            m->hitGroupSbt.isValid(),
+            usesSBTRing || m->hitGroupSbt.isValid(),
             "Hitgroup shader binding table is not set.");
         m->throwRuntimeError(
             m->pipelineLinked,
             "Pipeline has not been linked yet.");
+        if (usesSBTRing) {
+            // JP: リングはスロットの確保で同期とメモリ確保を行い、キャプチャーしたグラフは単一のスロットを再利用し続ける。
+            // EN: The ring synchronizes and allocates memory when acquiring a slot,
+            //     and a captured graph would keep reusing a single slot.
+            CUstreamCaptureStatus captureStatus;
+            CUDADRV_CHECK(cuStreamIsCapturing(stream, &captureStatus));
+            m->throwRuntimeError(
+                captureStatus == CU_STREAM_CAPTURE_STATUS_NONE,
+                "SBT ring cannot be used during stream capture.");
+        }
 
         m->setupShaderBindingTable(stream);
 
         OPTIX_CHECK(optixLaunch(
             m->rawPipeline, stream, plpOnDevice, m->sizeOfPipelineLaunchParams,
             &m->sbtParams, dimX, dimY, dimZ));
+        if (usesSBTRing)
+            CUDADRV_CHECK(cuEventRecord(m->sbtRing[m->sbtRingIndex].launchEvent, stream));
     }
 
     Scene Pipeline::getScene() const {
@@ -3956,9 +7491,28 @@ namespace optixu {
 
 
 
+    void Module::Priv::waitForCompilation() {
+        if (!compileJob)
+            return;
+        compileJob->wait();
+        OptixModuleCompileState state;
+        OPTIX_CHECK(optixModuleGetCompilationState(rawModule, &state));
+        if (state != OPTIX_MODULE_COMPILE_STATE_COMPLETED)
+            _throwRuntimeError("Module %s: Compilation failed.", getName().c_str());
+        compileJob.reset();
+        compileInputs.reset();
+    }
+
     void Module::destroy() {
         if (m) {
-            OPTIX_CHECK(optixModuleDestroy(m->rawModule));
+            // JP: 破棄時はコンパイルの失敗を無視して完了のみを待つ。
+            // EN: Only wait for the completion ignoring compilation failure on destruction.
+            try {
+                m->waitForCompilation();
+            }
+            catch (...) {}
+            if (!m->getContext()->releaseCachedModule(m->rawModule))
+                OPTIX_CHECK(optixModuleDestroy(m->rawModule));
             delete m;
         }
         m = nullptr;
@@ -3966,9 +7520,22 @@ namespace optixu {
 
 
 
+    bool Module::isReady() const {
+        return m->isReady();
+    }
+
+    void Module::wait() const {
+        m->waitForCompilation();
+    }
+
+
+
     void Program::destroy() {
         if (m) {
-            m->pipeline->destroyProgram(m->rawGroup);
+            if (m->rawGroup)
+                m->pipeline->destroyProgram(m->rawGroup);
+            else
+                m->pipeline->cancelPendingProgramGroup(m);
             delete m;
         }
         m = nullptr;
@@ -3982,7 +7549,10 @@ namespace optixu {
 
     void HitProgramGroup::destroy() {
         if (m) {
-            m->pipeline->destroyProgram(m->rawGroup);
+            if (m->rawGroup)
+                m->pipeline->destroyProgram(m->rawGroup);
+            else
+                m->pipeline->cancelPendingProgramGroup(m);
             delete m;
         }
         m = nullptr;
@@ -4004,7 +7574,10 @@ namespace optixu {
 
     void CallableProgramGroup::destroy() {
         if (m) {
-            m->pipeline->destroyProgram(m->rawGroup);
+            if (m->rawGroup)
+                m->pipeline->destroyProgram(m->rawGroup);
+            else
+                m->pipeline->cancelPendingProgramGroup(m);
             delete m;
         }
         m = nullptr;
@@ -4390,4 +7963,123 @@ namespace optixu {
             offsetXInWorkingTile, offsetYInWorkingTile,
             m->scratchBuffer.getCUdeviceptr(), m->scratchBuffer.sizeInBytes()));
     }
+
+
+
+    void LaunchGraph::Priv::releaseGraph() {
+        stagingIASes.clear();
+        if (graphExec)
+            cuGraphExecDestroy(graphExec);
+        graphExec = nullptr;
+        if (graph)
+            cuGraphDestroy(graph);
+        graph = nullptr;
+    }
+
+    uint64_t LaunchGraph::Priv::computeStateHash() const {
+        ContentHasher hasher;
+        for (const _Pipeline* pipeline : pipelines)
+            pipeline->hashLaunchState(&hasher);
+        for (const _GeometryAccelerationStructure* gas : gases)
+            hasher.add(gas->isReady() ? gas->getHandle() : 0);
+        // JP: インスタンスの変更はグラフの実行前にステージングメモリへ詰め直されるので、ハッシュには含めない。
+        // EN: Changes of instances are refilled into staging memory before launching the graph,
+        //     so they are not included in the hash.
+        for (const _InstanceAccelerationStructure* ias : iases)
+            ias->hashLaunchState(&hasher);
+        return hasher.getValue();
+    }
+
+    void LaunchGraph::Priv::launch(CUstream stream, const std::function<void(CUstream)> &recordFunc) {
+        if (!graphExec || computeStateHash() != capturedStateHash) {
+            releaseGraph();
+
+            for (const _Pipeline* pipeline : pipelines) {
+                pipeline->throwRuntimeError(
+                    !pipeline->usesSBTRing(),
+                    "SBT ring cannot be used with LaunchGraph.");
+            }
+            // JP: キャプチャー中は同期とメモリ確保ができないので、IASのステージングメモリを事前に準備する。
+            // EN: Synchronization and memory allocation are not allowed during capture,
+            //     so prepare staging memory of IASs in advance.
+            for (_InstanceAccelerationStructure* ias : iases)
+                ias->prepareStagingForCapture(stream);
+
+            // JP: キャプチャー中にSBTのセットアップなどが行われ得るので、状態のハッシュはキャプチャー後に計算する。
+            // EN: SBT setup and so on may happen during the capture, so compute the state hash after the capture.
+            CUDADRV_CHECK(cuStreamBeginCapture(stream, CU_STREAM_CAPTURE_MODE_THREAD_LOCAL));
+            try {
+                recordFunc(stream);
+            }
+            catch (...) {
+                CUgraph discardedGraph = nullptr;
+                cuStreamEndCapture(stream, &discardedGraph);
+                if (discardedGraph)
+                    cuGraphDestroy(discardedGraph);
+                for (_InstanceAccelerationStructure* ias : iases)
+                    ias->finishStagingCapture();
+                throw;
+            }
+            for (_InstanceAccelerationStructure* ias : iases) {
+                if (ias->finishStagingCapture())
+                    stagingIASes.push_back(ias);
+            }
+            CUDADRV_CHECK(cuStreamEndCapture(stream, &graph));
+            CUDADRV_CHECK(cuGraphInstantiate(&graphExec, graph, 0));
+            capturedStateHash = computeStateHash();
+            ++numInstantiations;
+        }
+        else {
+            // JP: キャプチャー時はrecordFunc内で詰め込まれているので、再実行時のみ詰め直す。
+            // EN: Filling is done in recordFunc at a capture, so refill only for a replay.
+            for (_InstanceAccelerationStructure* ias : stagingIASes)
+                ias->refillStagingForGraph(stream);
+        }
+
+        CUDADRV_CHECK(cuGraphLaunch(graphExec, stream));
+        // JP: グラフはステージングメモリから読むので、次の詰め直しがグラフの完了を待つようにする。
+        // EN: The graph reads from staging memory, so make the next refill wait for the completion of the graph.
+        for (_InstanceAccelerationStructure* ias : iases)
+            ias->recordStagingUse(stream);
+    }
+
+    // static
+    LaunchGraph LaunchGraph::create() {
+        LaunchGraph ret;
+        ret.m = new Priv();
+        return ret;
+    }
+
+    void LaunchGraph::destroy() {
+        if (m)
+            delete m;
+        m = nullptr;
+    }
+
+    void LaunchGraph::addPipeline(Pipeline pipeline) const {
+        m->pipelines.push_back(extract(pipeline));
+        m->releaseGraph();
+    }
+
+    void LaunchGraph::addAccelerationStructure(GeometryAccelerationStructure gas) const {
+        m->gases.push_back(extract(gas));
+        m->releaseGraph();
+    }
+
+    void LaunchGraph::addAccelerationStructure(InstanceAccelerationStructure ias) const {
+        m->iases.push_back(extract(ias));
+        m->releaseGraph();
+    }
+
+    void LaunchGraph::invalidate() const {
+        m->releaseGraph();
+    }
+
+    void LaunchGraph::launch(CUstream stream, const std::function<void(CUstream)> &recordFunc) const {
+        m->launch(stream, recordFunc);
+    }
+
+    uint32_t LaunchGraph::getNumInstantiations() const {
+        return m->numInstantiations;
+    }
 }
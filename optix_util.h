@@ -31,6 +31,122 @@ EN:
 - In Visual Studio, does the CUDA property "Use Fast Math" not work for ptx compilation??
 
 変更履歴 / Update History:
+- JP: - 1フレーム分のコマンド列をCUDAグラフとしてキャプチャー・再実行するLaunchGraphを追加。
+  EN: - Added LaunchGraph to capture and replay a command sequence of a frame as a CUDA graph.
+
+- JP: - プログラムグループのスタックサイズからパイプラインのスタックサイズを計算して設定する
+        Pipeline::computeStackSizes()を追加。
+  EN: - Added Pipeline::computeStackSizes() to compute and set the pipeline stack sizes
+        from stack sizes of program groups.
+
+- JP: - Pipeline::begin/endProgramGroupBatch()を追加。
+        複数のプログラムグループを1回のoptixProgramGroupCreate()で生成する。
+  EN: - Added Pipeline::begin/endProgramGroupBatch()
+        to create multiple program groups by a single optixProgramGroupCreate() call.
+
+- JP: - Context::setDiskCache()でOptiXのディスクキャッシュを設定できるようにした。
+      - Context::setProgramCacheEnabled()で同一内容のモジュールとプログラムをパイプライン間で共有する
+        プロセス内キャッシュを追加。
+  EN: - Added Context::setDiskCache() to configure OptiX's disk cache.
+      - Added an in-process cache sharing modules and programs with identical contents among pipelines
+        enabled by Context::setProgramCacheEnabled().
+
+- JP: - モジュールのコンパイルをタスクに分割してスレッドプール上で非同期に行う
+        createModuleFromPTXStringAsync(), createModuleFromOptixIRAsync()を追加。
+  EN: - Added createModuleFromPTXStringAsync() and createModuleFromOptixIRAsync() compiling a module
+        asynchronously on the thread pool by splitting it into tasks.
+
+- JP: - インスタンスを静的・動的なIASに分割して2段のIASを管理するPartitionedInstanceAccelerationStructureを追加。
+  EN: - Added PartitionedInstanceAccelerationStructure managing a two-level IAS
+        with instances partitioned into static and dynamic IASs.
+
+- JP: - GASのビルドをフレームごとのGPU時間の予算内に分散させるAccelerationStructureBuildQueueを追加。
+  EN: - Added AccelerationStructureBuildQueue to distribute GAS builds within a per-frame GPU time budget.
+
+- JP: - アップデート可能なGAS/IASでアップデートとリビルドを自動で選択するAccelerationStructureUpdatePolicyと
+        GAS/IAS::buildOrUpdate()を追加。
+  EN: - Added AccelerationStructureUpdatePolicy and GAS/IAS::buildOrUpdate() to automatically choose
+        between update and rebuild for an updatable GAS/IAS.
+
+- JP: - マテリアルとシーンに属するオブジェクトの内部オブジェクトを、コンテキスト/シーンごとの型別プールから
+        確保するように変更。
+  EN: - Internal objects of materials and of objects belonging to a scene are now allocated from
+        per-context/per-scene typed pools.
+
+- JP: - インスタンスの一括生成Scene::createInstances()と、子の一括追加GAS/IAS::addChildren()を追加。
+        インスタンスの内部オブジェクトはシーンごとのプールから確保する。
+  EN: - Added Scene::createInstances() for bulk instance creation and GAS/IAS::addChildren()
+        for bulk child attachment. Internal objects of instances are allocated from a per-scene pool.
+
+- JP: - IASのリビルドがインスタンスをスレッドプール上で並列にピン留めされたメモリに詰め、
+        非同期にアップロードするように変更。
+  EN: - IAS rebuild now fills instances into pinned memory in parallel on the thread pool
+        and uploads them asynchronously.
+
+- JP: - 子インスタンスの変換をまとめて設定するIAS::setChildTransforms()を追加。
+  EN: - Added IAS::setChildTransforms() to set the transforms of child instances at once.
+
+- JP: - IASのupdate()がインスタンスバッファーのうち変更されたインスタンスの範囲のみを
+        アップロードするように変更。
+  EN: - IAS's update() now uploads only the ranges of changed instances in the instance buffer.
+
+- JP: - ビルド入力の内容のハッシュをキーとしてGASのビルド結果をディスクにキャッシュする
+        AccelerationStructureCacheを追加。
+  EN: - Added AccelerationStructureCache that caches GAS build results on disk
+        keyed by a hash of the build input contents.
+
+- JP: - GASをoptixAccelRelocate()で移動してメモリの隙間を詰める
+        Scene::defragmentAccelerationStructures()を追加。
+  EN: - Added Scene::defragmentAccelerationStructures() to close memory gaps
+        by moving GASs with optixAccelRelocate().
+
+- JP: - ASのメモリを大きなブロックから切り出すAccelerationStructureMemoryArenaを追加。
+  EN: - Added AccelerationStructureMemoryArena that carves AS memory out of large blocks.
+
+- JP: - ホスト側で待たないコンパクションのAPIをGAS, IASに追加
+        (prepareForCompactAsync(), compactedSizeIsReady(), tryRemoveUncompacted())。
+  EN: - Added compaction APIs that don't wait on the host to GAS and IAS
+        (prepareForCompactAsync(), compactedSizeIsReady(), tryRemoveUncompacted()).
+
+- JP: - dirty状態のASをボトムアップにまとめてビルドするScene::buildDirty()と
+        そのためのアロケーターのインターフェースAccelerationStructureMemoryAllocatorを追加。
+  EN: - Added Scene::buildDirty() to build dirty ASs together in bottom-up order and
+        AccelerationStructureMemoryAllocator, the allocator interface for it.
+
+- JP: - パイプラインが所有するNスロットのSBTリングを追加(Pipeline::setShaderBindingTableRingDepth())。
+        ローンチごとのイベントで使用中のスロットを追跡する。
+  EN: - Added an N-slot SBT ring owned by the pipeline (Pipeline::setShaderBindingTableRingDepth()).
+        In-flight slots are tracked by a per-launch event.
+
+- JP: - SBTレイアウトの統計情報を取得するScene::getShaderBindingTableLayoutStats()を追加。
+  EN: - Added Scene::getShaderBindingTableLayoutStats() to get statistics of an SBT layout.
+
+- JP: - マテリアルのユーザーデータをSBTとは別のバッファーに置き、SBTレコードにはそのアドレスのみを置く
+        間接参照モードを追加(Scene::setConfiguration())。デバイス側ではMaterialUserDataRefで参照する。
+  EN: - Added the indirect material user data mode (Scene::setConfiguration()) that places material user data
+        in a buffer separate from the SBT and only its address in SBT records.
+        Device code refers to it via MaterialUserDataRef.
+
+- JP: - Sceneが保持するGAS, Transform, IASをフリーリスト付きの密な配列で管理するようにした。
+        破棄されたGASのシリアルIDは再利用される。SBTオフセットはGASごとに連続した表に格納される。
+  EN: - Scene now manages GASes, transforms and IASes in dense arrays with free lists.
+        Serial IDs of destroyed GASes are reused. SBT offsets are stored in a table contiguous per GAS.
+
+- JP: - Pipeline::launch()におけるシーンのレディ判定を、各トラバーサブルの状態変化から維持するカウンターを用いた
+        O(1)の処理にした。アサート有効時は全走査の結果と突き合わせる。
+  EN: - Made the scene readiness check in Pipeline::launch() O(1) using counters maintained from
+        state transitions of each traversable. Cross-checked against a full walk when assertion is enabled.
+
+- JP: - ホスト側の並列処理に使うスレッドプールをContextに設定できるようにした。
+        ヒットグループのSBTレコードの詰め込みはGASごとに並列に行われる。
+  EN: - Made it possible to set a thread pool used for host-side parallel processing to the context.
+        Packing hit group SBT records is processed in parallel across GASes.
+
+- JP: - ヒットグループのシェーダーバインディングテーブルの差分更新をサポート。
+        レイアウトが変わっていない場合は変更のあったレコードのみを詰め直して転送する。
+  EN: - Supported incremental update of the hit group shader binding table.
+        Only the edited records are re-packed and transferred when the layout is unchanged.
+
 - JP: - Displacement Micro-Mapをサポート。
   EN: - Supported displacement micro-map.
 
@@ -240,6 +356,7 @@ TODO:
 #include <string>
 #include <vector>
 #include <initializer_list>
+#include <functional>
 #endif
 
 #if defined(OPTIXU_Platform_Windows_MSVC)
@@ -455,6 +572,25 @@ namespace optixu {
 #endif
     };
 
+    // JP: マテリアルのユーザーデータの間接参照モードにおいて、
+    //     SBTレコード中のマテリアルのユーザーデータの位置に置かれる参照。
+    // EN: A reference placed at the position of material user data in an SBT record
+    //     in the indirect material user data mode.
+    template <typename T>
+    class MaterialUserDataRef {
+        const T* m_data;
+
+    public:
+#if defined(__CUDA_ARCH__) || defined(OPTIXU_Platform_CodeCompletion)
+        RT_DEVICE_FUNCTION RT_INLINE const T &operator*() const {
+            return *m_data;
+        }
+        RT_DEVICE_FUNCTION RT_INLINE const T* operator->() const {
+            return m_data;
+        }
+#endif
+    };
+
 
 
     template <typename... PayloadTypes>
@@ -988,6 +1124,11 @@ namespace optixu {
              |
              optixGetSbtDataPointer()
 
+    SBT Record (Indirect Material User Data Mode)
+    <-- SBT Record Stride (Globally Common) --------------------------------->
+    | Header | GAS       | GAS Child | GeomInst  | MaterialUserDataRef | Pad |
+    |        | User Data | User Data | User Data | (8 bytes)           |     |
+
     JP: CH/AH/ISプログラムにてoptixGetSbtDataPointer()で取得できるポインターの位置に
         GeometryInstanceAccelerationStructureのsetUserData(), setChildUserData(),
         GeometryInstanceのsetUserData(), MaterialのsetUserData()
@@ -1147,6 +1288,7 @@ namespace optixu {
     OPTIXU_DECLARE_TYPED_BOOL(UseMotionBlur);
     OPTIXU_DECLARE_TYPED_BOOL(UseOpacityMicroMaps);
     OPTIXU_DECLARE_TYPED_BOOL(IsFirstFrame);
+    OPTIXU_DECLARE_TYPED_BOOL(IndirectMaterialUserData);
 
 #undef OPTIXU_DECLARE_TYPED_BOOL
 
@@ -1154,6 +1296,80 @@ namespace optixu {
 
 
 
+    // JP: ライブラリがホスト側の並列処理に使用するスレッドプールのインターフェース。
+    //     ユーザーが所有するスレッドプールを使う場合はこれを実装してContextにセットする。
+    // EN: Interface of a thread pool the library uses for host-side parallel processing.
+    //     Implement this and set it to the context to use a user-owned thread pool.
+    class ThreadPool {
+    public:
+        virtual ~ThreadPool() {}
+
+        // JP: タスクを処理するワーカースレッドの数。
+        // EN: The number of worker threads processing tasks.
+        virtual uint32_t getNumThreads() const = 0;
+        // JP: タスクをキューに積む。タスクはいずれかのワーカースレッドで非同期に実行される必要がある。
+        // EN: Enqueue a task. The task must be executed asynchronously on one of the worker threads.
+        virtual void enqueue(const std::function<void()> &task) = 0;
+    };
+
+
+
+    // JP: Scene::buildDirty()がASとスクラッチのメモリを確保するためのアロケーターのインターフェース。
+    // EN: Interface of an allocator Scene::buildDirty() uses to allocate memory for ASs and scratch.
+    class AccelerationStructureMemoryAllocator {
+    public:
+        virtual ~AccelerationStructureMemoryAllocator() {}
+
+        // JP: 指定したアラインメントを満たすデバイスメモリを確保する。
+        // EN: Allocate device memory satisfying the given alignment.
+        virtual BufferView allocate(size_t size, size_t alignment) = 0;
+        // JP: allocate()で確保したメモリを解放する。
+        // EN: Release memory allocated by allocate().
+        virtual void release(const BufferView &buffer) = 0;
+    };
+
+    struct AccelerationStructureMemoryArenaStats {
+        uint32_t numBlocks;
+        uint32_t numAllocations;
+        uint32_t numFreeRanges;
+        size_t reservedSize;
+        size_t usedSize;
+        size_t largestFreeRangeSize;
+        // JP: 1 - 最大の空き範囲のサイズ / 空き容量の合計。0は断片化が無いことを表す。
+        // EN: 1 - the largest free range size / the total free size. 0 means no fragmentation.
+        float fragmentation;
+    };
+
+    // JP: AS, コンパクション後のAS, インスタンスバッファー, スクラッチなどを
+    //     大きなデバイスメモリのブロックから切り出して確保するアロケーター。
+    //     ブロックより大きな要求には専用のブロックを確保する。
+    //     確保されたメモリは要求されたアラインメントを満たし、サイズもアラインメントの倍数に切り上げられる。
+    //     ブロックはdestroy()で全て解放される。trim()で空のブロックのみを先に解放することもできる。
+    // EN: An allocator that carves ASs, compacted ASs, instance buffers, scratch and so on
+    //     out of large device memory blocks.
+    //     A dedicated block is allocated for a request larger than the block size.
+    //     Allocated memory satisfies the requested alignment and its size is also rounded up to the alignment.
+    //     All the blocks are freed by destroy(). trim() can free only empty blocks earlier.
+    class AccelerationStructureMemoryArena : public AccelerationStructureMemoryAllocator {
+    public:
+        class Priv;
+    private:
+        Priv* m = nullptr;
+
+    public:
+        [[nodiscard]]
+        static AccelerationStructureMemoryArena create(size_t blockSize = 64 * 1024 * 1024);
+        void destroy();
+
+        BufferView allocate(size_t size, size_t alignment) override;
+        void release(const BufferView &buffer) override;
+
+        void trim() const;
+        void getStats(AccelerationStructureMemoryArenaStats* stats) const;
+    };
+
+
+
     class Context {
     public:
         class Priv;
@@ -1172,6 +1388,49 @@ namespace optixu {
 
         void setLogCallback(OptixLogCallback callback, void* callbackData, uint32_t logLevel) const;
 
+        // JP: ホスト側の並列処理(SBTレコードの詰め込みなど)に使用するスレッドプールを設定する。
+        //     ユーザーが所有するスレッドプールはContextの破棄まで有効である必要がある。
+        //     nullptrを渡すとライブラリ内部のスレッドプールを使用する。
+        // EN: Set a thread pool used for host-side parallel processing (e.g. packing SBT records).
+        //     A user-owned thread pool must be alive until the context is destroyed.
+        //     Passing nullptr makes the library use its internal thread pool.
+        void setThreadPool(ThreadPool* threadPool) const;
+        // JP: ライブラリ内部のスレッドプールのワーカースレッド数を設定する。
+        //     0の場合(デフォルト)は内部スレッドプールを持たず、並列処理を行わない。
+        // EN: Set the number of worker threads of the library's internal thread pool.
+        //     In the case of 0 (default), the context has no internal thread pool and doesn't process in parallel.
+        void setNumWorkerThreads(uint32_t numThreads) const;
+
+        // JP: OptiXのディスクキャッシュ(コンパイル済みモジュールのプロセス間キャッシュ)を設定する。
+        //     複数のプロセスで同じ場所を指定すると、2回目以降の起動ではコンパイルがキャッシュから読み込まれる。
+        //     locationにnullptrを渡すと場所を変更しない。highWaterMarkが0の場合はサイズを変更しない。
+        //     環境変数OPTIX_CACHE_PATH, OPTIX_CACHE_MAXSIZEはこの設定より優先される。
+        // EN: Configure OptiX's disk cache (inter-process cache of compiled modules).
+        //     Specifying the same location among processes makes the second and later launches load
+        //     compilation results from the cache.
+        //     Passing nullptr as location keeps the location. highWaterMark = 0 keeps the sizes.
+        //     Environment variables OPTIX_CACHE_PATH and OPTIX_CACHE_MAXSIZE take precedence over this setting.
+        void setDiskCache(
+            bool enable, const char* location = nullptr,
+            size_t lowWaterMark = 0, size_t highWaterMark = 0) const;
+        // JP: ディスクキャッシュが有効かを返す。その他の引数がnullptrでなければ現在の設定を書き込む。
+        // EN: Return whether the disk cache is enabled. Write the current settings to the other arguments
+        //     unless they are nullptr.
+        bool getDiskCache(
+            std::string* location = nullptr,
+            size_t* lowWaterMark = nullptr, size_t* highWaterMark = nullptr) const;
+        // JP: プロセス内のプログラムキャッシュを有効化する(デフォルトは無効)。
+        //     入力のバイト列、コンパイルオプション、パイプラインのコンパイルオプションが同一のモジュール、
+        //     およびそれらのモジュールとエントリー関数名が同一のプログラム(グループ)はパイプライン間で共有され、
+        //     再生成をスキップする。非同期に生成したモジュールはキャッシュに登録されない。
+        // EN: Enable the in-process program cache (disabled by default).
+        //     Modules with identical input bytes, compile options and pipeline compile options,
+        //     and programs (groups) with identical those modules and entry function names are shared
+        //     among pipelines, skipping recreation.
+        //     Modules created asynchronously are not registered to the cache.
+        void setProgramCacheEnabled(bool enable) const;
+        void getProgramCacheStats(uint32_t* numModules, uint32_t* numProgramGroups) const;
+
         [[nodiscard]]
         Pipeline createPipeline() const;
         [[nodiscard]]
@@ -1233,13 +1492,11 @@ namespace optixu {
         // JP: 以下のAPIを呼んだ場合はシェーダーバインディングテーブルを更新する必要がある。
         //     パイプラインのmarkHitGroupShaderBindingTableDirty()を呼べばローンチ時にセットアップされる。
         //     シェーダーバインディングテーブルのレイアウト生成後に、再度ユーザーデータのサイズや
-        //     アラインメントを変更する場合には、レイアウトをシーンのmarkShaderBindingTableLayoutDirty()を
-        //     呼んで無効化する必要もある。
+        //     アラインメントを変更する場合、マテリアルを使用するシーンのレイアウトが自動で無効化される。
         // EN: Updating a shader binding table is required when calling the following APIs.
         //     Calling pipeline's markHitGroupShaderBindingTableDirty() triggers re-setup of the table at launch.
         //     In the case where user data size and/or alignment changes again after generating the layout of
-        //     a shader binding table, the invalidation of the layout is required as well by calling
-        //     scene's markShaderBindingTableLayoutDirty().
+        //     a shader binding table, the layouts of the scenes using the material are automatically invalidated.
         void setHitGroup(uint32_t rayType, HitProgramGroup hitGroup) const;
         void setUserData(const void* data, uint32_t size, uint32_t alignment) const;
         template <typename T>
@@ -1257,8 +1514,16 @@ namespace optixu {
 
 
 
+    struct ShaderBindingTableLayoutStats;
+    class AccelerationStructureUpdatePolicy;
+
     class Scene : public Object<Scene> {
     public:
+        // JP: シーンに属するオブジェクトはシーンごとのプールから確保され、シーンの破棄時にページ単位でまとめて解放される。
+        //     シーンより後まで残っていたオブジェクトの領域は個別の破棄処理を経ずに解放される。
+        // EN: Objects belonging to a scene are allocated from per-scene pools, which are freed page by page
+        //     when the scene is destroyed.
+        //     Storage of objects still alive at that time is released without their individual destruction.
         void destroy();
 
         [[nodiscard]]
@@ -1275,6 +1540,11 @@ namespace optixu {
         Transform createTransform() const;
         [[nodiscard]]
         Instance createInstance() const;
+        // JP: numInstances個のインスタンスをまとめて生成しinstancesに書き込む。
+        //     内部オブジェクトは連続した領域から確保される。
+        // EN: Create numInstances instances at once and write them to instances.
+        //     Internal objects are allocated from a contiguous range.
+        void createInstances(uint32_t numInstances, Instance* instances) const;
         [[nodiscard]]
         InstanceAccelerationStructure createInstanceAccelerationStructure() const;
 
@@ -1285,6 +1555,60 @@ namespace optixu {
         void generateShaderBindingTableLayout(size_t* memorySize) const;
 
         bool shaderBindingTableLayoutIsReady() const;
+
+        // JP: 生成済みのSBTレイアウトの統計情報を取得する。デバイスにはアクセスしない。
+        // EN: Get statistics of the generated SBT layout. This doesn't access the device.
+        void getShaderBindingTableLayoutStats(ShaderBindingTableLayoutStats* stats) const;
+
+        // JP: マテリアルのユーザーデータの間接参照モードを有効にすると、マテリアルのユーザーデータは
+        //     SBTとは別のバッファーに格納され、SBTレコードにはそのアドレス(MaterialUserDataRef)のみが置かれる。
+        //     大きなユーザーデータを持つマテリアルがある場合にSBTのストライドを縮められる。
+        //     モードの変更はSBTレイアウトをdirty状態にする。
+        // EN: Enabling the indirect material user data mode stores material user data in a buffer
+        //     separate from the SBT and places only its address (MaterialUserDataRef) in SBT records.
+        //     This can shrink the SBT stride when some materials have large user data.
+        //     Changing the mode marks the SBT layout dirty.
+        void setConfiguration(
+            OPTIXU_EN_PRM(IndirectMaterialUserData, indirectMaterialUserData, No)) const;
+        void getConfiguration(IndirectMaterialUserData* indirectMaterialUserData) const;
+
+        // JP: SBTレイアウト生成後に呼ぶ。間接参照モードで必要なバッファーのサイズを返す。
+        // EN: Call after the SBT layout generation. Returns the buffer size required in the indirect mode.
+        size_t getMaterialUserDataBufferSize() const;
+        // JP: 間接参照モードでマテリアルのユーザーデータを格納するバッファーとそのホスト側の対応物を設定する。
+        //     バッファーを変更した場合はパイプラインのヒットグループSBTをdirty状態にする必要がある。
+        // EN: Set a buffer to store material user data in the indirect mode and its host-side counterpart.
+        //     Pipelines' hit group SBTs need to be marked dirty when changing the buffer.
+        void setMaterialUserDataBuffer(const BufferView &buffer, void* hostMem) const;
+
+        // JP: dirty状態の全てのGAS, Transform, IASをボトムアップの順にまとめてビルドする。
+        //     スクラッチバッファーは全ASの最大の要求サイズで1つだけ確保して共有し、ビルドは連続して発行される。
+        //     コンパクションが許可されたASは階層ごとに1回の読み戻しでサイズを取得した後にコンパクションされる。
+        //     ASのバッファーはallocatorから確保されてASが所有し、次回のビルドで可能なら再利用される。
+        //     IASを含む場合はSBTレイアウトの生成後に呼ぶ必要がある。関数から戻る時点でストリーム上の処理は完了している。
+        // EN: Build all the dirty GASs, transforms and IASs together in bottom-up order.
+        //     Only one scratch buffer is allocated with the maximum requirement among all the ASs and shared,
+        //     and builds are issued back-to-back.
+        //     ASs allowing compaction are compacted after obtaining their sizes with one readback per level.
+        //     Buffers for ASs are allocated from the allocator and owned by the ASs,
+        //     and reused in the next build if possible.
+        //     This needs to be called after the SBT layout generation when IASs are included.
+        //     Work on the stream has been completed when this function returns.
+        void buildDirty(CUstream stream, AccelerationStructureMemoryAllocator* allocator) const;
+
+        // JP: buildDirty()で確保されたGASのメモリを、そのアロケーターから新たに確保したより低いアドレスへ
+        //     optixAccelRelocate()で移動して隙間を詰める。移動したGASの数を返す。
+        //     移動したGASを(間接的に)参照するTransformとIASはdirty状態になるため、この後にbuildDirty()を呼ぶ必要がある。
+        //     dirty状態になったIASのメモリはアロケーターに返却され、次のbuildDirty()で確保し直される。
+        //     処理はストリーム上の順序のみで保護されるので、移動するASを使う処理がデバイス上に残っていてはならない。
+        // EN: Move GAS memory allocated by buildDirty() to a lower address newly allocated from the same allocator
+        //     with optixAccelRelocate() to close gaps. Returns the number of moved GASs.
+        //     Transforms and IASs (indirectly) referring to a moved GAS become dirty,
+        //     so buildDirty() needs to be called after this.
+        //     Memory of IASs which became dirty is returned to the allocator and reallocated by the next buildDirty().
+        //     The work is protected only by ordering on the stream,
+        //     so there must be no remaining work on the device using ASs to be moved.
+        uint32_t defragmentAccelerationStructures(CUstream stream) const;
     };
 
 
@@ -1476,6 +1800,12 @@ namespace optixu {
         void addChild(GeometryInstance geomInst, CUdeviceptr preTransform, const T &data) const {
             addChild(geomInst, preTransform, &data, sizeof(T), alignof(T));
         }
+        // JP: 複数のジオメトリーインスタンスをまとめて追加する。検証はバッチ全体に対して一度だけ行う。
+        //     preTransformsはnullptrでも良い。子ごとのユーザーデータは空になる。
+        // EN: Add multiple geometry instances at once. Validation is done once for the whole batch.
+        //     preTransforms can be nullptr. Per-child user data is left empty.
+        void addChildren(
+            const GeometryInstance* geomInsts, const CUdeviceptr* preTransforms, uint32_t numChildren) const;
         void removeChildAt(uint32_t index) const;
         void clearChildren() const;
 
@@ -1506,12 +1836,42 @@ namespace optixu {
         // EN: Wait on the host until compact operation finishes.
         void removeUncompacted() const;
 
+        // JP: prepareForCompact()とremoveUncompacted()の、ホスト側で待たない版。
+        //     prepareForCompactAsync()はコンパクション後のサイズをピン留めされたホストメモリに非同期に読み戻す。
+        //     compactedSizeIsReady()はサイズが届いていればtrueを返し、その後にcompact()を呼べる。
+        //     tryRemoveUncompacted()はデバイス上でコンパクションが完了していれば
+        //     コンパクション前のASを取り除いてtrueを返す。その後にコンパクション前のバッファーを解放できる。
+        // EN: Versions of prepareForCompact() and removeUncompacted() that don't wait on the host.
+        //     prepareForCompactAsync() asynchronously reads back the compacted size into pinned host memory.
+        //     compactedSizeIsReady() returns true once the size has arrived, then compact() can be called.
+        //     tryRemoveUncompacted() removes the uncompacted AS and returns true
+        //     if compaction has finished on the device. The uncompacted buffer can be freed after that.
+        void prepareForCompactAsync(CUstream stream) const;
+        bool compactedSizeIsReady(size_t* compactedAccelBufferSize) const;
+        bool tryRemoveUncompacted() const;
+
         // JP: アップデートを行った場合はこのGASが(間接的に)所属するTraversable (例: IAS)
         //     もアップデートもしくはリビルドする必要がある。
         // EN: Updating or rebuilding a traversable (e.g. IAS) to which this GAS (indirectly) belongs
         //     is required when performing update.
         void update(CUstream stream, const BufferView &scratchBuffer) const;
 
+        // JP: アップデート可能なGASにアップデートポリシーを設定する。空のポリシーを渡すと解除する。
+        //     アップデートを許可していないGASには設定できない。
+        //     ポリシーは一つのASにのみ設定でき、設定中のポリシーを破棄するとGASから外れる。
+        // EN: Set an update policy to an updatable GAS. Passing an empty policy detaches it.
+        //     A policy cannot be set to a GAS not allowing update.
+        //     A policy can be attached to only one AS, and destroying an attached policy detaches it from the GAS.
+        void setUpdatePolicy(AccelerationStructureUpdatePolicy policy) const;
+        // JP: 設定されたポリシーに従ってアップデートかリビルドを行う。
+        //     リビルドは前回のリビルド時のバッファーに対して行うため、scratchBufferはリビルドに足るサイズが必要。
+        //     コンパクション後の非コンパクションASを削除済みの場合は常にアップデートを行う。
+        // EN: Perform update or rebuild according to the attached policy.
+        //     Rebuild reuses the buffer of the last rebuild, so scratchBuffer needs the size enough for rebuild.
+        //     Always performs update if the uncompacted AS has been removed after compaction.
+        OptixTraversableHandle buildOrUpdate(
+            CUstream stream, const BufferView &scratchBuffer, bool* rebuilt = nullptr) const;
+
         /*
         JP: 以下のAPIを呼んだ場合はシェーダーバインディングテーブルを更新する必要がある。
             パイプラインのmarkHitGroupShaderBindingTableDirty()を呼べばローンチ時にセットアップされる。
@@ -1562,6 +1922,157 @@ namespace optixu {
 
 
 
+    struct ShaderBindingTableLayoutStats {
+        // JP: GASのマテリアルセットごとのレコード数と、実サイズに対してストライドが無駄にしているバイト数。
+        // EN: Number of records and bytes wasted by the stride relative to actual sizes
+        //     per material set of a GAS.
+        struct MaterialSetEntry {
+            GeometryAccelerationStructure gas;
+            uint32_t materialSetIndex;
+            uint32_t numRecords;
+            size_t paddingBytes;
+        };
+        std::vector<MaterialSetEntry> materialSetEntries;
+        uint32_t numRecords;
+        uint32_t recordStride;
+        // JP: 実サイズが最大のレコードとそれを構成するオブジェクト。
+        // EN: The record with the maximum actual size and objects composing it.
+        uint32_t maxRecordSize;
+        GeometryAccelerationStructure maxRecordGAS;
+        uint32_t maxRecordMaterialSetIndex;
+        GeometryInstance maxRecordGeometryInstance;
+        Material maxRecordMaterial;
+        size_t totalPaddingBytes;
+    };
+
+
+
+    // JP: GASのビルド結果をディスクにキャッシュする。
+    //     キーはビルド入力の内容(頂点・インデックスなどのバッファーの中身、フォーマット、ビルドフラグ、
+    //     モーションオプション)のハッシュで、キャッシュファイルはディレクトリ内にハッシュごとに置かれる。
+    //     ファイルにはoptixAccelGetRelocationInfo()の情報が含まれ、互換性の無いデバイスでは使われない。
+    // EN: Caches GAS build results on disk.
+    //     The key is a hash of the build input contents (contents of vertex, index and other buffers,
+    //     formats, build flags and motion options), and a cache file per hash is placed in the directory.
+    //     Files contain information from optixAccelGetRelocationInfo() and aren't used on incompatible devices.
+    class AccelerationStructureCache {
+    public:
+        class Priv;
+    private:
+        Priv* m = nullptr;
+
+    public:
+        // JP: ディレクトリは事前に存在している必要がある。
+        // EN: The directory needs to exist in advance.
+        [[nodiscard]]
+        static AccelerationStructureCache create(const std::string &directory);
+        void destroy();
+
+        // JP: キャッシュにヒットした場合はコンパクション済みのASをディスクから読み込んで
+        //     optixAccelRelocate()で配置し、ミスした場合はビルド(とコンパクション)を行って結果を保存する。
+        //     ASのメモリはallocatorから確保されてGASが所有する。ヒットした場合にtrueを返す。
+        //     ハッシュの計算にバッファーの中身を読み戻すため、ストリーム上の処理は戻る前に完了する。
+        //     OMM, DMMを使うGASはキャッシュされず常にビルドされる。
+        // EN: On a hit, loads the compacted AS from disk and places it by optixAccelRelocate(),
+        //     on a miss, builds (and compacts) the GAS and stores the result.
+        //     The AS memory is allocated from the allocator and owned by the GAS. Returns true on a hit.
+        //     Hashing reads back buffer contents, so work on the stream completes before returning.
+        //     A GAS using OMMs or DMMs is never cached and is always built.
+        bool buildOrLoad(
+            GeometryAccelerationStructure gas,
+            CUstream stream, AccelerationStructureMemoryAllocator* allocator) const;
+    };
+
+
+
+    // JP: アップデート可能なGAS/IASに対して、フレームごとにアップデートとリビルドのどちらを行うかを決めるポリシー。
+    //     品質の目安として、ビルドのたびに出力させて非同期に読み戻したASの境界の表面積が
+    //     前回のリビルド後から増加した割合と、ユーザーが報告する変位の上限の累積を用いる。
+    //     読み戻しのためにホストが待つことはなく、判定には完了済みの最新の結果を使う。
+    // EN: A policy to decide per frame between update and rebuild for an updatable GAS/IAS.
+    //     As quality proxies, it uses the growth ratio of the surface area of the AS bounds since the last rebuild,
+    //     which are emitted at every build and read back asynchronously,
+    //     and the accumulated displacement bound reported by the user.
+    //     The host never waits for the readback, the decision uses the latest completed result.
+    class AccelerationStructureUpdatePolicy {
+    public:
+        class Priv;
+    private:
+        Priv* m = nullptr;
+
+    public:
+        [[nodiscard]]
+        static AccelerationStructureUpdatePolicy create();
+        void destroy();
+
+        // JP: 境界の表面積の増加率がmaxSurfaceAreaGrowth、
+        //     累積変位と境界の対角線の長さの比がmaxRelativeDisplacementを超えた場合、
+        //     もしくは前回のリビルドからのアップデート回数がmaxNumUpdatesに達した場合にリビルドする。
+        // EN: Rebuild when the growth ratio of the bounds' surface area exceeds maxSurfaceAreaGrowth,
+        //     the ratio of the accumulated displacement to the bounds' diagonal length exceeds
+        //     maxRelativeDisplacement, or the number of updates since the last rebuild reaches maxNumUpdates.
+        void setThresholds(
+            float maxSurfaceAreaGrowth, float maxRelativeDisplacement,
+            uint32_t maxNumUpdates = 0xFFFFFFFF) const;
+        // JP: 前回の報告以降に頂点やインスタンスが移動した距離の上限を報告する。
+        // EN: Report an upper bound of the distance that vertices or instances have moved since the last report.
+        void addDisplacementBound(float distance) const;
+
+        float getSurfaceAreaGrowth() const;
+        float getRelativeDisplacement() const;
+        uint32_t getNumUpdatesSinceRebuild() const;
+    };
+
+
+
+    // JP: 多数のGASのビルドを複数フレームに分散させるキュー。
+    //     processFrame()はプリミティブ数と過去の計測から見積もったGPU時間がフレームの予算に収まる分だけ
+    //     ビルドを発行する。GPU時間はビルドの前後に記録したイベントで計測し、ホストは待たない。
+    //     コンパクションが有効なGASは後のフレームでコンパクションされ、非コンパクションASは削除される。
+    //     ASのメモリはallocatorから確保されてGASが所有する。キューに入っている間はGASを破棄しないこと。
+    // EN: A queue that distributes builds of many GASs over multiple frames.
+    //     processFrame() issues builds as many as their GPU time, estimated from the primitive count and
+    //     past measurements, fits the frame budget. GPU time is measured by events recorded around builds,
+    //     and the host never waits.
+    //     A GAS with compaction enabled is compacted in a later frame, then the uncompacted AS is removed.
+    //     The AS memory is allocated from the allocator and owned by the GAS.
+    //     Don't destroy a GAS while it is in the queue.
+    class AccelerationStructureBuildQueue {
+    public:
+        class Priv;
+    private:
+        Priv* m = nullptr;
+
+    public:
+        [[nodiscard]]
+        static AccelerationStructureBuildQueue create(AccelerationStructureMemoryAllocator* allocator);
+        void destroy();
+
+        // JP: 1フレームあたりのビルドのGPU時間の予算[ms]。デフォルトは4ms。
+        // EN: The budget of GPU time of builds per frame in ms. The default is 4 ms.
+        void setFrameBudget(float budgetInMs) const;
+        // JP: コストモデルの初期値[ms]。1プリミティブあたりのコストは計測によって更新される。
+        // EN: The initial values of the cost model in ms. The per-primitive cost is updated by measurements.
+        void setCostModel(float fixedCostInMs, float costPerPrimitiveInMs) const;
+        float estimateBuildCost(uint32_t numPrimitives) const;
+
+        void enqueue(GeometryAccelerationStructure gas) const;
+        // JP: 1フレーム分のビルドとコンパクションを発行し、このフレームでハンドルが有効になった、
+        //     もしくは変わったGASをreadyGASesに返す。返されたGASを参照するIASは同じストリームで
+        //     アップデートもしくはリビルドする必要がある。
+        // EN: Issue builds and compactions for one frame, and return GASs whose handles became valid
+        //     or changed in this frame in readyGASes. IASs referring to the returned GASs need to be
+        //     updated or rebuilt on the same stream.
+        void processFrame(CUstream stream, std::vector<GeometryAccelerationStructure>* readyGASes) const;
+        uint32_t getNumQueuedBuilds() const;
+        // JP: キューに残っているビルドに加え、計測やコンパクションの途中のものが無ければtrueを返す。
+        // EN: Returns true if nothing is in progress including measurements and compactions
+        //     in addition to builds remaining in the queue.
+        bool isIdle() const;
+    };
+
+
+
     class Transform : public Object<Transform> {
     public:
         void destroy();
@@ -1662,9 +2173,25 @@ namespace optixu {
             OPTIXU_EN_PRM(AllowRandomInstanceAccess, allowRandomInstanceAccess, No)) const;
         void setMotionOptions(uint32_t numKeys, float timeBegin, float timeEnd, OptixMotionFlags flags) const;
         void addChild(Instance instance) const;
+        // JP: 複数のインスタンスをまとめて追加する。検証と重複判定はバッチ全体に対して一度だけ行う。
+        // EN: Add multiple instances at once. Validation and duplicate check are done once for the whole batch.
+        void addChildren(const Instance* instances, uint32_t numInstances) const;
         void removeChildAt(uint32_t index) const;
         void clearChildren() const;
 
+        // JP: 子インスタンス[firstChildIndex, firstChildIndex + numTransforms)の変換をまとめて設定する。
+        //     各インスタンスのsetTransform()を呼ぶのと同じ効果を持ち、数が多い場合はスレッドプールで並列に処理する。
+        // EN: Set the transforms of child instances [firstChildIndex, firstChildIndex + numTransforms) at once.
+        //     This has the same effect as calling setTransform() of each instance and
+        //     is processed in parallel on the thread pool for a large number.
+        void setChildTransforms(
+            const float (*transforms)[12], uint32_t numTransforms, uint32_t firstChildIndex = 0) const;
+        // JP: 行ごとに分かれた配列から変換を設定する。rowsN[i]は子iの変換行列のN行目。
+        // EN: Set the transforms from arrays split per row. rowsN[i] is the N-th row of child i's transform.
+        void setChildTransforms(
+            const float (*rows0)[4], const float (*rows1)[4], const float (*rows2)[4],
+            uint32_t numTransforms, uint32_t firstChildIndex = 0) const;
+
         // JP: IASをdirty状態にする。
         // EN: Mark the IAS dirty.
         void markDirty() const;
@@ -1685,12 +2212,46 @@ namespace optixu {
         // EN: Wait on the host until compact operation finishes.
         void removeUncompacted() const;
 
+        // JP: prepareForCompact()とremoveUncompacted()の、ホスト側で待たない版。
+        //     prepareForCompactAsync()はコンパクション後のサイズをピン留めされたホストメモリに非同期に読み戻す。
+        //     compactedSizeIsReady()はサイズが届いていればtrueを返し、その後にcompact()を呼べる。
+        //     tryRemoveUncompacted()はデバイス上でコンパクションが完了していれば
+        //     コンパクション前のASを取り除いてtrueを返す。その後にコンパクション前のバッファーを解放できる。
+        // EN: Versions of prepareForCompact() and removeUncompacted() that don't wait on the host.
+        //     prepareForCompactAsync() asynchronously reads back the compacted size into pinned host memory.
+        //     compactedSizeIsReady() returns true once the size has arrived, then compact() can be called.
+        //     tryRemoveUncompacted() removes the uncompacted AS and returns true
+        //     if compaction has finished on the device. The uncompacted buffer can be freed after that.
+        void prepareForCompactAsync(CUstream stream) const;
+        bool compactedSizeIsReady(size_t* compactedAccelBufferSize) const;
+        bool tryRemoveUncompacted() const;
+
         // JP: アップデートを行った場合はこのIASが(間接的に)所属するTraversable (例: IAS)
         //     もアップデートもしくはリビルドする必要がある。
         // EN: Updating or rebuilding a traversable (e.g. IAS) to which this IAS (indirectly) belongs
         //     is required when performing update.
+        // JP: インスタンスバッファーには前回のビルド・アップデート以降に変更されたインスタンスの範囲のみを
+        //     アップロードする。
+        // EN: Only the ranges of instances changed since the last build or update are uploaded
+        //     to the instance buffer.
         void update(CUstream stream, const BufferView &scratchBuffer) const;
 
+        // JP: アップデート可能なIASにアップデートポリシーを設定する。空のポリシーを渡すと解除する。
+        //     アップデートを許可していないIASには設定できない。
+        //     ポリシーは一つのASにのみ設定でき、設定中のポリシーを破棄するとIASから外れる。
+        // EN: Set an update policy to an updatable IAS. Passing an empty policy detaches it.
+        //     A policy cannot be set to an IAS not allowing update.
+        //     A policy can be attached to only one AS, and destroying an attached policy detaches it from the IAS.
+        void setUpdatePolicy(AccelerationStructureUpdatePolicy policy) const;
+        // JP: 設定されたポリシーに従ってアップデートかリビルドを行う。
+        //     リビルドは前回のリビルド時のインスタンスバッファーとバッファーに対して行うため、scratchBufferはリビルドに足るサイズが必要。
+        //     コンパクション後の非コンパクションASを削除済みの場合は常にアップデートを行う。
+        // EN: Perform update or rebuild according to the attached policy.
+        //     Rebuild reuses the instance buffer and the buffer of the last rebuild, so scratchBuffer needs the size enough for rebuild.
+        //     Always performs update if the uncompacted AS has been removed after compaction.
+        OptixTraversableHandle buildOrUpdate(
+            CUstream stream, const BufferView &scratchBuffer, bool* rebuilt = nullptr) const;
+
         bool isReady() const;
         OptixTraversableHandle getHandle() const;
 
@@ -1708,6 +2269,77 @@ namespace optixu {
 
 
 
+    // JP: インスタンスの集合を、一度だけビルドしてコンパクションする静的なIASと
+    //     毎フレームアップデートもしくはリビルドする動的なIASに分割し、小さなトップレベルIASで束ねるヘルパー。
+    //     build()は前回から変更されたインスタンスを検出し、変更された静的なインスタンスを動的な側へ、
+    //     一定フレーム変更されなかった動的なインスタンスを静的な側へ移す。追加されたインスタンスは静的な側から始まる。
+    //     階層が2段増えるので、パイプラインのtraversableGraphFlagsはALLOW_ANYとし、
+    //     getMaxTraversableGraphDepth()の値をPipeline::setStackSize()に渡すこと。
+    //     インスタンスは下位のIASに属するため、optixGetInstanceIndex()の値は分割によって変わる。IDは保たれる。
+    //     build()は子のGASなどが準備完了になった後に呼ぶこと。ここで作られるIASはbuild()が必要に応じてビルドする。
+    //     シーンより先に破棄する必要がある。
+    // EN: A helper that partitions a set of instances into a static IAS built once and compacted,
+    //     and a dynamic IAS updated or rebuilt every frame, joined under a tiny top-level IAS.
+    //     build() detects instances changed since the last call, moves changed static instances to the
+    //     dynamic side, and dynamic instances unchanged for a number of frames to the static side.
+    //     Added instances start in the static side.
+    //     This adds two levels, so the pipeline's traversableGraphFlags needs to be ALLOW_ANY,
+    //     and the value of getMaxTraversableGraphDepth() should be passed to Pipeline::setStackSize().
+    //     Instances belong to the lower IASs, so the value of optixGetInstanceIndex() changes by partitioning.
+    //     IDs are preserved.
+    //     Call build() after GASs and so on of the children become ready.
+    //     The IASs created here are built by build() as needed.
+    //     This needs to be destroyed before the scene.
+    class PartitionedInstanceAccelerationStructure {
+    public:
+        class Priv;
+    private:
+        Priv* m = nullptr;
+
+    public:
+        [[nodiscard]]
+        static PartitionedInstanceAccelerationStructure create(
+            Scene scene, AccelerationStructureMemoryAllocator* allocator);
+        void destroy();
+
+        // JP: 動的なインスタンスが静的な側に移るまでの無変更のフレーム数と、
+        //     静的なIASのリビルドを伴う移動を行うために必要な候補数。
+        //     静的なIASが他の理由でリビルドされる場合は候補数によらず移動する。
+        // EN: The number of unchanged frames until a dynamic instance moves to the static side,
+        //     and the number of candidates required to perform the move that rebuilds the static IAS.
+        //     Candidates move regardless of their number if the static IAS is rebuilt for another reason.
+        void setMigrationOptions(uint32_t numStableFramesToBecomeStatic, uint32_t minNumInstancesToMigrate) const;
+        // JP: パイプラインに設定した最大の階層数。build()は階層数がこれを超える場合に例外を投げる。
+        //     デフォルトはデバイスの上限。
+        // EN: The maximum depth configured to pipelines. build() throws if the depth exceeds this.
+        //     The default is the device limit.
+        void setTraversableGraphDepthLimit(uint32_t limit) const;
+
+        void addChild(Instance instance) const;
+        void addChildren(const Instance* instances, uint32_t numInstances) const;
+        void removeChild(Instance instance) const;
+        // JP: 子のGASのリビルドなど、インスタンスのリビジョンに現れない変更の後に呼ぶ。両方のIASをリビルドする。
+        // EN: Call this after changes not appearing in instance revisions like rebuilding a child GAS.
+        //     Both IASs will be rebuilt.
+        void markDirty() const;
+
+        // JP: 1フレーム分の分割の更新とビルドを行い、トップレベルIASのハンドルを返す。
+        //     静的なIASのコンパクションは後のフレームのbuild()で非同期に進む。
+        // EN: Update the partitions and build for one frame, then return the handle of the top-level IAS.
+        //     Compaction of the static IAS proceeds asynchronously in build() of later frames.
+        OptixTraversableHandle build(CUstream stream) const;
+
+        OptixTraversableHandle getHandle() const;
+        // JP: 最後のbuild()時点での、トップレベルIASからGASまでの最大の階層数。
+        // EN: The maximum number of levels from the top-level IAS to GASs as of the last build().
+        uint32_t getMaxTraversableGraphDepth() const;
+        uint32_t getNumChildren() const;
+        uint32_t getNumDynamicChildren() const;
+        bool isDynamicChild(Instance instance) const;
+    };
+
+
+
     class Pipeline : public Object<Pipeline> {
     public:
         void destroy();
@@ -1733,6 +2365,26 @@ namespace optixu {
             OptixCompileOptimizationLevel optLevel, OptixCompileDebugLevel debugLevel,
             OptixModuleCompileBoundValueEntry* boundValues = nullptr, uint32_t numBoundValues = 0,
             const PayloadType* payloadTypes = nullptr, uint32_t numPayloadTypes = 0) const;
+        // JP: コンパイルをタスクに分割し、Contextのスレッドプール上で非同期に行う。
+        //     複数のモジュールのコンパイル、および1つのモジュール内のタスクが並行に処理される。
+        //     返されたモジュールはプログラムの生成時に自動でコンパイルの完了を待つ。
+        //     スレッドプールが無い場合は完了を待つ際に呼び出し元スレッドでコンパイルされる。
+        // EN: Split compilation into tasks and perform it asynchronously on the context's thread pool.
+        //     Compilation of multiple modules, and tasks within a module are processed concurrently.
+        //     The returned module automatically waits for the compilation to complete when creating programs.
+        //     If there is no thread pool, compilation is done on the calling thread when waiting for completion.
+        [[nodiscard]]
+        Module createModuleFromPTXStringAsync(
+            const std::string &ptxString, int32_t maxRegisterCount,
+            OptixCompileOptimizationLevel optLevel, OptixCompileDebugLevel debugLevel,
+            OptixModuleCompileBoundValueEntry* boundValues = nullptr, uint32_t numBoundValues = 0,
+            const PayloadType* payloadTypes = nullptr, uint32_t numPayloadTypes = 0) const;
+        [[nodiscard]]
+        Module createModuleFromOptixIRAsync(
+            const std::vector<char> &irBin, int32_t maxRegisterCount,
+            OptixCompileOptimizationLevel optLevel, OptixCompileDebugLevel debugLevel,
+            OptixModuleCompileBoundValueEntry* boundValues = nullptr, uint32_t numBoundValues = 0,
+            const PayloadType* payloadTypes = nullptr, uint32_t numPayloadTypes = 0) const;
 
         [[nodiscard]]
         Program createRayGenProgram(Module module, const char* entryFunctionName) const;
@@ -1780,6 +2432,22 @@ namespace optixu {
             Module module_CC, const char* entryFunctionNameCC,
             const PayloadType &payloadType = PayloadType()) const;
 
+        // JP: begin/end間のcreate*Program(Group)()の呼び出しを記録し、
+        //     endProgramGroupBatch()でまとめてoptixProgramGroupCreate()を呼び出す。
+        //     パイプラインの無効化もバッチごとに1回となる。
+        //     バッチ中に生成したプログラム(グループ)はendProgramGroupBatch()まで使用できない(破棄は可能)。
+        //     endProgramGroupBatch()が失敗した場合はいずれのプログラム(グループ)も生成されず、バッチは継続する。
+        //     原因のプログラムを破棄してから再度endProgramGroupBatch()を呼ぶことができる。
+        // EN: Record calls to create*Program(Group)() between begin/end,
+        //     then call optixProgramGroupCreate() at once in endProgramGroupBatch().
+        //     Invalidation of the pipeline also happens once per batch.
+        //     Programs (groups) created during a batch cannot be used until endProgramGroupBatch()
+        //     (but can be destroyed).
+        //     If endProgramGroupBatch() fails, none of the programs (groups) is created and the batch continues.
+        //     endProgramGroupBatch() can be called again after destroying the offending programs.
+        void beginProgramGroupBatch() const;
+        void endProgramGroupBatch() const;
+
         void link(uint32_t maxTraceDepth) const;
 
         // JP: 以下のAPIを呼んだ場合は(非ヒットグループの)シェーダーバインディングテーブルレイアウトが
@@ -1823,14 +2491,43 @@ namespace optixu {
         void setHitGroupShaderBindingTable(const BufferView &shaderBindingTable, void* hostMem) const;
 
         // JP: ヒットグループのシェーダーバインディングテーブルをdirty状態にする。
+        //     同じSBTバッファーに対する前回のセットアップ以降にレイアウトが変わっていない場合、
+        //     ローンチ時には変更のあったレコードのみが詰め直され転送される。
         // EN: Mark the hit group's shader binding table dirty.
+        //     When the layout hasn't changed since the previous setup for the same SBT buffer,
+        //     only the edited records are re-packed and transferred at launch.
         void markHitGroupShaderBindingTableDirty() const;
 
+        // JP: パイプライン自身が所有するSBTバッファーのリングを有効化する(0で無効化)。
+        //     有効な場合、SBTの再セットアップが必要なローンチごとにリング内の次のスロット
+        //     (デバイスメモリとピン留めされたホストメモリの組)が使われる。
+        //     各ローンチ後にはイベントが記録され、スロット再利用時にはそのスロットを読む過去の
+        //     ローンチの完了のみを待つため、ユーザーによるダブルバッファリングは不要になる。
+        //     リングが有効な間はsetShaderBindingTable()/setHitGroupShaderBindingTable()は使用できない。
+        // EN: Enable the ring of SBT buffers owned by the pipeline itself (0 disables it).
+        //     When enabled, each launch requiring SBT re-setup uses the next slot in the ring
+        //     (a pair of device memory and pinned host memory).
+        //     An event is recorded after each launch and reusing a slot waits only for the completion of
+        //     the past launch reading that slot, so user-side double buffering becomes unnecessary.
+        //     setShaderBindingTable()/setHitGroupShaderBindingTable() cannot be used while the ring is enabled.
+        void setShaderBindingTableRingDepth(uint32_t depth) const;
+        uint32_t getShaderBindingTableRingDepth() const;
+
         void setStackSize(
             uint32_t directCallableStackSizeFromTraversal,
             uint32_t directCallableStackSizeFromState,
             uint32_t continuationStackSize,
             uint32_t maxTraversableGraphDepth) const;
+        // JP: パイプライン中の全プログラムグループのスタックサイズを集計してスタックサイズを計算し、設定する。
+        //     maxCCDepth, maxDCDepthはそれぞれcontinuation callable, direct callableの呼び出しの最大深さ。
+        //     リンク後に呼ぶ必要がある。
+        // EN: Compute stack sizes by accumulating stack sizes of all the program groups in the pipeline,
+        //     then set them.
+        //     maxCCDepth and maxDCDepth are the maximum depths of continuation callable and direct callable calls.
+        //     This needs to be called after linking.
+        void computeStackSizes(
+            uint32_t maxTraceDepth, uint32_t maxCCDepth, uint32_t maxDCDepth,
+            uint32_t maxTraversableGraphDepth = 2) const;
 
         // JP: セットされたシーンを基にシェーダーバインディングテーブルのセットアップを行い、
         //     Ray Generationシェーダーを起動する。
@@ -1849,6 +2546,13 @@ namespace optixu {
     class Module : public Object<Module> {
     public:
         void destroy();
+
+        // JP: 非同期に生成されたモジュールのコンパイルが完了していればtrueを返す。ブロックしない。
+        // EN: Returns true if the compilation of an asynchronously created module has completed. Doesn't block.
+        bool isReady() const;
+        // JP: コンパイルの完了を待つ。コンパイルが失敗していた場合は例外を送出する。
+        // EN: Wait for the compilation to complete. Throws if the compilation failed.
+        void wait() const;
     };
 
 
@@ -1939,6 +2643,53 @@ namespace optixu {
             const BufferView &internalGuideLayerForNextFrame) const;
     };
 
+
+
+    // JP: 1フレーム分の固定的なコマンド列(ASのアップデート、複数のPipeline::launch()、デノイザーの実行など)を
+    //     CUDAグラフとしてキャプチャーし、以降のフレームではグラフを再実行してCPUの発行コストを削減する。
+    //     launch()はグラフが無い、もしくは登録したパイプラインのSBTやASのハンドル、IASの子の数が
+    //     前回のキャプチャーから変わった場合にのみrecordFuncの呼び出しを再キャプチャーしてグラフを生成し直す。
+    //     インスタンスの変更は再キャプチャーを必要とせず、グラフの実行前にホスト側で詰め直される。
+    //     recordFunc内でアップデート・ビルドするIASは登録が必要。SBTリングを使うパイプラインは記録できない。
+    //     グラフはデバイス上の起動パラメーター(plpOnDevice)のアドレスを焼き込むので、
+    //     パラメーターの更新はlaunch()の前に同じストリーム上で同じアドレスにコピーすること。
+    //     recordFuncはストリームの同期などキャプチャーできない呼び出しを含んではならない。
+    //     登録したオブジェクトより先に破棄する必要がある。
+    // EN: Capture a fixed command sequence of a frame (AS updates, multiple Pipeline::launch() calls,
+    //     denoiser invocations and so on) as a CUDA graph, and replay the graph in later frames
+    //     to reduce the CPU submission overhead.
+    //     launch() recaptures calls in recordFunc and recreates the graph only when there is no graph yet,
+    //     or SBTs or AS handles of the registered pipelines/ASs, or the number of children of the registered IASs
+    //     have changed since the last capture.
+    //     Changes of instances don't require recapture and are refilled on the host before launching the graph.
+    //     IASs updated or built in recordFunc must be registered.
+    //     Pipelines using the SBT ring cannot be recorded.
+    //     The graph bakes in the addresses of launch parameters on the device (plpOnDevice),
+    //     so update the parameters by copying to the same addresses on the same stream before launch().
+    //     recordFunc must not contain calls that cannot be captured, e.g. stream synchronization.
+    //     This needs to be destroyed before the registered objects.
+    class LaunchGraph {
+    public:
+        class Priv;
+    private:
+        Priv* m = nullptr;
+
+    public:
+        [[nodiscard]]
+        static LaunchGraph create();
+        void destroy();
+
+        void addPipeline(Pipeline pipeline) const;
+        void addAccelerationStructure(GeometryAccelerationStructure gas) const;
+        void addAccelerationStructure(InstanceAccelerationStructure ias) const;
+        // JP: 次のlaunch()で再キャプチャーさせる。登録していない状態が変わった場合に呼ぶ。
+        // EN: Make the next launch() recapture. Call this when an unregistered state has changed.
+        void invalidate() const;
+
+        void launch(CUstream stream, const std::function<void(CUstream)> &recordFunc) const;
+        uint32_t getNumInstantiations() const;
+    };
+
 #undef OPTIXU_EN_PRM
 
 #endif // #if !defined(__CUDA_ARCH__)
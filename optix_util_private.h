@@ -44,8 +44,23 @@
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
+#include <map>
 #include <algorithm>
 #include <variant>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <istream>
+#include <ostream>
+#include <fstream>
+#include <cstdio>
+#include <new>
+#include <tuple>
+#include <limits>
+#include <cmath>
+#include <memory>
 
 #if __cplusplus <= 199711L
 #   if defined(OPTIXU_Platform_Windows_MSVC)
@@ -61,6 +76,11 @@
 #include <intrin.h>
 #endif
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#   define OPTIXU_ENABLE_SSE
+#   include <immintrin.h>
+#endif
+
 #include <stdexcept>
 
 #define CUDADRV_CHECK(call) \
@@ -130,6 +150,21 @@ namespace optixu {
     using std::countr_zero;
 #endif
 
+    // JP: 行ごとに与えられた3x4行列を連続した12要素に詰める。
+    // EN: Pack a 3x4 matrix given per row into contiguous 12 elements.
+    inline void packTransform(
+        const float row0[4], const float row1[4], const float row2[4], float dst[12]) {
+#if defined(OPTIXU_ENABLE_SSE)
+        _mm_storeu_ps(dst + 0, _mm_loadu_ps(row0));
+        _mm_storeu_ps(dst + 4, _mm_loadu_ps(row1));
+        _mm_storeu_ps(dst + 8, _mm_loadu_ps(row2));
+#else
+        std::copy_n(row0, 4, dst + 0);
+        std::copy_n(row1, 4, dst + 4);
+        std::copy_n(row2, 4, dst + 8);
+#endif
+    }
+
 
 
     using _Context = Context::Priv;
@@ -209,24 +244,837 @@ namespace optixu {
 
 
 
+    // JP: ヒットグループSBT中のレコード範囲(レコード単位)。
+    // EN: A range of records (in records) in a hit group SBT.
+    struct SBTRecordRange {
+        uint32_t offset;
+        uint32_t count;
+
+        bool operator<(const SBTRecordRange &r) const {
+            return offset < r.offset;
+        }
+    };
+
+    // JP: パイプラインごとの、シーンのヒットグループSBTの内容の同期状態。
+    //     シーンは変更履歴のうち全ての同期状態が反映済みの先頭部分を捨てるために、有効な同期状態を登録して把握する。
+    //     コピーや代入は登録を引き継がず、未同期の状態になる。
+    // EN: Per-pipeline synchronization state of the contents of a scene's hit group SBT.
+    //     A scene registers valid sync states to drop the head of the edit log already reflected by all of them.
+    //     Copy and assignment don't take over the registration and result in an unsynced state.
+    struct HitGroupSBTSyncState {
+        _Scene* scene;
+        uint32_t epoch;
+        // JP: 反映済みの変更の数。履歴の先頭が捨てられても変わらない通し番号で数える。
+        // EN: The number of reflected edits. Counted in serial numbers unchanged by dropping the head of the log.
+        uint32_t numSyncedEdits;
+        bool valid;
+
+        HitGroupSBTSyncState() : scene(nullptr), epoch(0), numSyncedEdits(0), valid(false) {}
+        HitGroupSBTSyncState(const HitGroupSBTSyncState &) : HitGroupSBTSyncState() {}
+        ~HitGroupSBTSyncState() {
+            reset();
+        }
+        HitGroupSBTSyncState &operator=(const HitGroupSBTSyncState &) {
+            reset();
+            return *this;
+        }
+
+        void reset();
+    };
+
+    // JP: Scene::buildDirty()がアロケーターから確保し、ASが所有するメモリ。
+    //     ASの破棄時、もしくは別のアロケーターが使われた時にアロケーターに返却される。
+    // EN: Memory allocated from an allocator by Scene::buildDirty() and owned by an AS.
+    //     Returned to the allocator when the AS is destroyed or a different allocator is used.
+    struct ManagedASMemory {
+        AccelerationStructureMemoryAllocator* allocator;
+        BufferView accelBuffer;
+        BufferView compactedAccelBuffer;
+        // JP: IASではインスタンスバッファー、Transformでは変換データのバッファー。
+        // EN: The instance buffer for an IAS, the transform data buffer for a transform.
+        BufferView auxBuffer;
+
+        ManagedASMemory() : allocator(nullptr) {}
+
+        void setAllocator(AccelerationStructureMemoryAllocator* _allocator) {
+            if (allocator == _allocator)
+                return;
+            releaseAll();
+            allocator = _allocator;
+        }
+        // JP: 既存のバッファーが十分な大きさであればそれを再利用する。
+        // EN: Reuse the existing buffer if it is large enough.
+        const BufferView &acquire(BufferView* buffer, size_t size, size_t alignment) {
+            if (buffer->isValid() && buffer->sizeInBytes() >= size)
+                return *buffer;
+            release(buffer);
+            if (size > 0)
+                *buffer = allocator->allocate(size, alignment);
+            return *buffer;
+        }
+        void release(BufferView* buffer) {
+            if (buffer->isValid())
+                allocator->release(*buffer);
+            *buffer = BufferView();
+        }
+        void releaseAll() {
+            release(&accelBuffer);
+            release(&compactedAccelBuffer);
+            release(&auxBuffer);
+        }
+    };
+
+    // JP: 解放されたスロットをフリーリストで再利用するオブジェクトの密な配列。
+    //     スロット番号はオブジェクトの生存中は変わらない。
+    // EN: A dense array of objects reusing released slots via a free list.
+    //     The slot index doesn't change during the lifetime of an object.
+    template <typename T>
+    class SlotArray {
+        std::vector<T*> slots;
+        std::vector<uint32_t> freeSlots;
+
+    public:
+        uint32_t allocate(T* obj) {
+            uint32_t slot;
+            if (freeSlots.empty()) {
+                slot = static_cast<uint32_t>(slots.size());
+                slots.push_back(obj);
+            }
+            else {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+                slots[slot] = obj;
+            }
+            return slot;
+        }
+        void release(uint32_t slot) {
+            slots[slot] = nullptr;
+            freeSlots.push_back(slot);
+        }
+
+        uint32_t getNumSlots() const {
+            return static_cast<uint32_t>(slots.size());
+        }
+        uint32_t getNumObjects() const {
+            return static_cast<uint32_t>(slots.size() - freeSlots.size());
+        }
+        // JP: 空きスロットと範囲外のスロットに対してはnullptrを返す。
+        // EN: Returns nullptr for an empty or out-of-range slot.
+        T* get(uint32_t slot) const {
+            return slot < slots.size() ? slots[slot] : nullptr;
+        }
+
+        template <typename Func>
+        void forEach(Func func) const {
+            for (T* obj : slots) {
+                if (obj)
+                    func(obj);
+            }
+        }
+    };
+
+
+    // JP: 同一型のオブジェクトをページ単位で確保するプール。
+    //     解放されたオブジェクトの領域はフリーリストで再利用し、まとめて確保する場合は連続した領域を使う。
+    //     ページはプールの破棄時にまとめて解放する。
+    // EN: A pool allocating objects of a single type in units of pages.
+    //     Storage of released objects is reused via a free list, and bulk allocation uses a contiguous range.
+    //     Pages are freed together when the pool is destroyed.
+    template <typename T>
+    class ObjectPool {
+        static constexpr uint32_t s_numObjectsPerPage = 256;
+
+        std::vector<void*> pages;
+        void* freeList;
+        uint8_t* unusedBegin;
+        uint8_t* unusedEnd;
+        uint32_t numObjects;
+
+        static constexpr size_t getSlotSize() {
+            return (std::max(sizeof(T), sizeof(void*)) + alignof(T) - 1) / alignof(T) * alignof(T);
+        }
+        static void* &nextFreeOf(void* slot) {
+            return *reinterpret_cast<void**>(slot);
+        }
+
+        void* allocateSlots(uint32_t numSlots) {
+            constexpr size_t slotSize = getSlotSize();
+            if (static_cast<size_t>(unusedEnd - unusedBegin) < numSlots * slotSize) {
+                // JP: 現在のページの残りはフリーリストに回す。
+                // EN: Move the rest of the current page to the free list.
+                for (; unusedBegin < unusedEnd; unusedBegin += slotSize) {
+                    nextFreeOf(unusedBegin) = freeList;
+                    freeList = unusedBegin;
+                }
+                const size_t pageSize = std::max(numSlots, s_numObjectsPerPage) * slotSize;
+                static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned type is not supported.");
+                void* page = ::operator new(pageSize);
+                pages.push_back(page);
+                unusedBegin = static_cast<uint8_t*>(page);
+                unusedEnd = unusedBegin + pageSize;
+            }
+            void* ret = unusedBegin;
+            unusedBegin += numSlots * slotSize;
+            return ret;
+        }
+
+    public:
+        ObjectPool() : freeList(nullptr), unusedBegin(nullptr), unusedEnd(nullptr), numObjects(0) {}
+        ~ObjectPool() {
+            for (void* page : pages)
+                ::operator delete(page);
+        }
+        ObjectPool(const ObjectPool &) = delete;
+        ObjectPool &operator=(const ObjectPool &) = delete;
+
+        template <typename... Args>
+        T* create(Args &&... args) {
+            void* slot;
+            if (freeList) {
+                slot = freeList;
+                freeList = nextFreeOf(slot);
+            }
+            else {
+                slot = allocateSlots(1);
+            }
+            ++numObjects;
+            return new (slot) T(std::forward<Args>(args)...);
+        }
+        // JP: numObjects個のオブジェクトを連続した領域に生成する。
+        // EN: Create numObjects objects in a contiguous range.
+        template <typename... Args>
+        void createContiguous(uint32_t _numObjects, T** objects, const Args &... args) {
+            if (_numObjects == 0)
+                return;
+            auto slots = static_cast<uint8_t*>(allocateSlots(_numObjects));
+            for (uint32_t i = 0; i < _numObjects; ++i)
+                objects[i] = new (slots + i * getSlotSize()) T(args...);
+            numObjects += _numObjects;
+        }
+        void destroy(T* obj) {
+            obj->~T();
+            void* slot = obj;
+            nextFreeOf(slot) = freeList;
+            freeList = slot;
+            --numObjects;
+        }
+
+        uint32_t getNumObjects() const {
+            return numObjects;
+        }
+        uint32_t getNumPages() const {
+            return static_cast<uint32_t>(pages.size());
+        }
+    };
+
+
+
     static constexpr inline IndexSize convertToIndexSizeEnum(uint32_t indexSize) {
         return indexSize > 0 ? static_cast<IndexSize>(countr_zero(indexSize)) : IndexSize::None;
     }
 
 
 
+    // JP: ユーザーがスレッドプールを与えない場合に使うライブラリ内部のスレッドプール。
+    // EN: The library's internal thread pool used when the user doesn't provide a thread pool.
+    class WorkerThreadPool : public ThreadPool {
+        std::vector<std::thread> threads;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stop;
+
+        void work();
+
+    public:
+        WorkerThreadPool(uint32_t numThreads);
+        ~WorkerThreadPool();
+
+        uint32_t getNumThreads() const override {
+            return static_cast<uint32_t>(threads.size());
+        }
+        void enqueue(const std::function<void()> &task) override;
+    };
+
+    // JP: [0, numItems)を範囲に分割してスレッドプール上で処理する。
+    //     呼び出し元スレッドも処理に参加し、全範囲の処理が終わるまで戻らない。
+    //     処理中に送出された例外は呼び出し元スレッドで再送出される。
+    // EN: Split [0, numItems) into ranges and process them on the thread pool.
+    //     The calling thread also takes part in the processing and doesn't return until all the ranges finish.
+    //     An exception thrown during the processing is rethrown on the calling thread.
+    void parallelFor(
+        ThreadPool* threadPool, uint32_t numItems, uint32_t minNumItemsPerTask,
+        const std::function<void(uint32_t, uint32_t)> &func);
+
+    // JP: モジュールのコンパイルタスクを実行するインターフェース。ホスト上のテストでは偽物に置き換えられる。
+    // EN: Interface executing module compile tasks. Replaced with a fake in host tests.
+    class ModuleCompileTaskSource {
+    public:
+        virtual ~ModuleCompileTaskSource() {}
+
+        // JP: タスクを実行し、新たに生成されたタスクを最大maxNumNewTasks個newTasksに書き込む。
+        // EN: Execute a task and write newly created tasks up to maxNumNewTasks into newTasks.
+        virtual void execute(
+            OptixTask task, OptixTask* newTasks, uint32_t maxNumNewTasks, uint32_t* numNewTasks) = 0;
+    };
+
+    // JP: 1つのモジュールのコンパイルタスク群をスレッドプール上で実行する。
+    //     タスクの実行が生成した新たなタスクもスレッドプールに積まれる。
+    //     スレッドプールが無い場合、もしくは待機中は呼び出し元スレッドも処理に参加する。
+    //     処理中に送出された例外は残りのタスクを破棄し、wait()で再送出される。
+    // EN: Execute the compile tasks of a module on the thread pool.
+    //     New tasks created by executing a task are also enqueued to the thread pool.
+    //     The calling thread also takes part in the processing while waiting or if there is no thread pool.
+    //     An exception thrown during the processing discards the remaining tasks and is rethrown in wait().
+    class ModuleCompileJob : public std::enable_shared_from_this<ModuleCompileJob> {
+        ThreadPool* threadPool;
+        ModuleCompileTaskSource* taskSource;
+        uint32_t maxNumNewTasksPerExecution;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<OptixTask> queuedTasks;
+        // JP: キューにあるタスクと実行中のタスクの数。
+        // EN: The number of queued and executing tasks.
+        uint32_t numUnfinishedTasks;
+        std::exception_ptr exception;
+
+        void dispatch(uint32_t numTasks);
+        bool executeOne();
+
+    public:
+        ModuleCompileJob(ThreadPool* _threadPool, ModuleCompileTaskSource* _taskSource) :
+            threadPool(_threadPool), taskSource(_taskSource),
+            maxNumNewTasksPerExecution(std::max(threadPool ? threadPool->getNumThreads() : 1u, 1u)),
+            numUnfinishedTasks(0) {}
+
+        void start(OptixTask firstTask);
+        bool isFinished() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return numUnfinishedTasks == 0;
+        }
+        void wait();
+    };
+
+    class OptixModuleCompileTaskSource : public ModuleCompileTaskSource {
+    public:
+        void execute(
+            OptixTask task, OptixTask* newTasks, uint32_t maxNumNewTasks, uint32_t* numNewTasks) override {
+            OPTIX_CHECK(optixTaskExecute(task, newTasks, maxNumNewTasks, numNewTasks));
+        }
+    };
+
+    // JP: 大きなブロックから範囲を切り出すサブアロケーターの中核。
+    //     デバイスには直接触れず、ブロックの確保と解放はヒープのインターフェースを通じて行う。
+    // EN: The core of a suballocator carving ranges out of large blocks.
+    //     This doesn't touch the device directly and allocates/frees blocks through the heap interface.
+    class MemoryArenaCore {
+    public:
+        class Heap {
+        public:
+            virtual ~Heap() {}
+
+            virtual CUdeviceptr allocate(size_t size) = 0;
+            virtual void release(CUdeviceptr ptr) = 0;
+        };
+
+    private:
+        struct Block {
+            size_t size;
+            // JP: ブロック先頭からのオフセットをキーとする空き範囲。隣接する空き範囲は常に結合されている。
+            // EN: Free ranges keyed by the offset from the block head. Adjacent free ranges are always merged.
+            std::map<size_t, size_t> freeRanges;
+            uint32_t numAllocations;
+        };
+
+        Heap* heap;
+        size_t blockSize;
+        std::map<CUdeviceptr, Block> blocks;
+        std::unordered_map<CUdeviceptr, size_t> allocationSizes;
+
+        bool allocateFromBlock(CUdeviceptr base, Block* block, size_t size, size_t alignment, CUdeviceptr* ptr);
+
+    public:
+        MemoryArenaCore(Heap* _heap, size_t _blockSize) :
+            heap(_heap), blockSize(_blockSize) {}
+        ~MemoryArenaCore() {
+            releaseAll();
+        }
+
+        CUdeviceptr allocate(size_t size, size_t alignment);
+        void release(CUdeviceptr ptr);
+        void trim();
+        void releaseAll();
+        void getStats(AccelerationStructureMemoryArenaStats* stats) const;
+    };
+
+
+
+    class AccelerationStructureMemoryArena::Priv {
+        struct DeviceHeap : public MemoryArenaCore::Heap {
+            CUdeviceptr allocate(size_t size) override {
+                CUdeviceptr ptr;
+                CUDADRV_CHECK(cuMemAlloc(&ptr, size));
+                return ptr;
+            }
+            void release(CUdeviceptr ptr) override {
+                CUDADRV_CHECK(cuMemFree(ptr));
+            }
+        };
+
+        DeviceHeap heap;
+        MemoryArenaCore core;
+
+    public:
+        Priv(size_t blockSize) : core(&heap, blockSize) {}
+
+        MemoryArenaCore &getCore() {
+            return core;
+        }
+    };
+
+
+
+    // JP: 64-bitのコンテンツハッシュ。add()を呼んだ順序とバイト列の区切り方もハッシュ値に影響する。
+    // EN: A 64-bit content hash. The order of add() calls and how bytes are split also affect the value.
+    class ContentHasher {
+        uint64_t state;
+
+    public:
+        ContentHasher() : state(0xcbf29ce484222325ull) {}
+
+        void add(const void* data, size_t size);
+        template <typename T>
+        void add(const T &value) {
+            static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable.");
+            add(&value, sizeof(value));
+        }
+
+        uint64_t getValue() const {
+            return state;
+        }
+    };
+
+    // JP: ASキャッシュファイルはヘッダーとASのデータで構成される。
+    //     ヘッダーやデータの解釈を変える場合はバージョンを上げる。
+    // EN: An AS cache file consists of a header and AS data.
+    //     Bump the version when changing how the header or the data are interpreted.
+    static constexpr char s_asCacheFileMagic[8] = { 'O', 'P', 'T', 'I', 'X', 'U', 'A', 'S' };
+    static constexpr uint32_t s_asCacheFileVersion = 1;
+
+    struct ASCacheFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t optixVersion;
+        uint64_t contentHash;
+        uint64_t dataSize;
+        uint64_t dataHash;
+        // JP: 読み込み時にoptixCheckRelocationCompatibility()でデバイスとの互換性を確認するための情報。
+        // EN: Used to check compatibility with the device by optixCheckRelocationCompatibility() on load.
+        OptixRelocationInfo relocationInfo;
+    };
+
+    std::string getASCacheFileName(uint64_t contentHash);
+    void writeASCacheFile(
+        std::ostream &out, uint64_t contentHash, const OptixRelocationInfo &relocationInfo,
+        const void* data, size_t size);
+    // JP: 指定したハッシュに対する有効なエントリーでない場合(別のバージョン、破損、ハッシュの不一致)はfalseを返す。
+    // EN: Returns false if the stream isn't a valid entry for the given hash
+    //     (another version, corruption, hash mismatch).
+    bool readASCacheFile(
+        std::istream &in, uint64_t contentHash,
+        OptixRelocationInfo* relocationInfo, std::vector<uint8_t>* data);
+
+
+
+    class AccelerationStructureCache::Priv {
+        std::string directory;
+
+    public:
+        Priv(const std::string &_directory) : directory(_directory) {}
+
+        std::string getFilePath(uint64_t contentHash) const {
+            return directory + "/" + getASCacheFileName(contentHash);
+        }
+
+        bool load(
+            _GeometryAccelerationStructure* gas, uint64_t contentHash,
+            CUstream stream, AccelerationStructureMemoryAllocator* allocator) const;
+        void build(
+            _GeometryAccelerationStructure* gas,
+            CUstream stream, AccelerationStructureMemoryAllocator* allocator) const;
+        void store(_GeometryAccelerationStructure* gas, uint64_t contentHash) const;
+    };
+
+
+    // JP: AABBの表面積と対角線の長さ。
+    // EN: Surface area and diagonal length of an AABB.
+    inline float computeSurfaceArea(const OptixAabb &aabb) {
+        const float dx = std::max(aabb.maxX - aabb.minX, 0.0f);
+        const float dy = std::max(aabb.maxY - aabb.minY, 0.0f);
+        const float dz = std::max(aabb.maxZ - aabb.minZ, 0.0f);
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+    inline float computeDiagonalLength(const OptixAabb &aabb) {
+        const float dx = std::max(aabb.maxX - aabb.minX, 0.0f);
+        const float dy = std::max(aabb.maxY - aabb.minY, 0.0f);
+        const float dz = std::max(aabb.maxZ - aabb.minZ, 0.0f);
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    class AccelerationStructureUpdatePolicy::Priv {
+        float maxSurfaceAreaGrowth;
+        float maxRelativeDisplacement;
+        uint32_t maxNumUpdates;
+
+        // JP: 直近のリビルド後に得た境界の表面積と対角線の長さ、及び最新の境界の表面積。
+        // EN: Surface area and diagonal length of the bounds obtained after the last rebuild,
+        //     and surface area of the latest bounds.
+        float baseSurfaceArea;
+        float baseDiagonalLength;
+        float latestSurfaceArea;
+        float accumulatedDisplacement;
+        uint32_t numUpdatesSinceRebuild;
+        uint32_t numRebuilds;
+
+        // JP: ビルド時に出力させるAABBの非同期の読み戻し用。初回使用時に確保する。
+        // EN: For asynchronous readback of AABBs emitted at build. Allocated at the first use.
+        CUdeviceptr aabbsOnDevice;
+        OptixAabb* aabbsOnHost;
+        uint32_t aabbCapacity;
+        uint32_t numReadbackAabbs;
+        uint32_t readbackRebuildIndex;
+        CUevent readbackEvent;
+
+        // JP: ポリシーを設定しているAS。ポリシーの破棄時にASから外すために型付きで保持する。
+        // EN: The AS to which the policy is attached. Held typed to detach the policy from the AS at destruction.
+        std::variant<
+            void*,
+            _GeometryAccelerationStructure*,
+            _InstanceAccelerationStructure*
+        > owner;
+        struct {
+            unsigned int baseBoundsAreKnown : 1;
+            unsigned int readbackPending : 1;
+        };
+
+    public:
+        OPTIXU_OPAQUE_BRIDGE(AccelerationStructureUpdatePolicy);
+
+        Priv() :
+            maxSurfaceAreaGrowth(1.5f), maxRelativeDisplacement(0.25f), maxNumUpdates(0xFFFFFFFF),
+            baseSurfaceArea(0.0f), baseDiagonalLength(0.0f), latestSurfaceArea(0.0f),
+            accumulatedDisplacement(0.0f), numUpdatesSinceRebuild(0), numRebuilds(0),
+            aabbsOnDevice(0), aabbsOnHost(nullptr), aabbCapacity(0), numReadbackAabbs(0),
+            readbackRebuildIndex(0), readbackEvent(nullptr),
+            owner(static_cast<void*>(nullptr)),
+            baseBoundsAreKnown(false), readbackPending(false) {}
+        ~Priv() {
+            detachFromOwner();
+            releaseReadbackResources();
+        }
+
+        void releaseReadbackResources() {
+            if (readbackEvent) {
+                cuEventSynchronize(readbackEvent);
+                cuEventDestroy(readbackEvent);
+                cuMemFreeHost(aabbsOnHost);
+                cuMemFree(aabbsOnDevice);
+            }
+            readbackEvent = nullptr;
+            aabbsOnHost = nullptr;
+            aabbsOnDevice = 0;
+            aabbCapacity = 0;
+            readbackPending = false;
+        }
+
+        void setThresholds(float _maxSurfaceAreaGrowth, float _maxRelativeDisplacement, uint32_t _maxNumUpdates) {
+            maxSurfaceAreaGrowth = _maxSurfaceAreaGrowth;
+            maxRelativeDisplacement = _maxRelativeDisplacement;
+            maxNumUpdates = _maxNumUpdates;
+        }
+
+        bool hasOwner() const {
+            return !std::holds_alternative<void*>(owner);
+        }
+        void setOwner(_GeometryAccelerationStructure* gas) {
+            owner = gas;
+        }
+        void setOwner(_InstanceAccelerationStructure* ias) {
+            owner = ias;
+        }
+        void clearOwner() {
+            owner = static_cast<void*>(nullptr);
+        }
+        void detachFromOwner();
+
+        // JP: 以下はデバイスに依存しない判定処理。
+        // EN: The followings are the device-independent decision logic.
+        void onRebuilt() {
+            ++numRebuilds;
+            baseBoundsAreKnown = false;
+            accumulatedDisplacement = 0.0f;
+            numUpdatesSinceRebuild = 0;
+        }
+        void onUpdated() {
+            ++numUpdatesSinceRebuild;
+        }
+        void addDisplacement(float distance) {
+            accumulatedDisplacement += distance;
+        }
+        // JP: モーションASでは全キーの境界の和を使う。
+        //     リビルド後に最初に得た境界を基準とするので、リビルドで読み戻しができなかった場合は
+        //     その後最初のアップデートの結果が基準になる。
+        // EN: Use the union of the bounds of all keys for a motion AS.
+        //     The first bounds obtained after a rebuild become the base, so if the readback couldn't be done
+        //     at the rebuild, the result of the first update after that becomes the base.
+        void reportBounds(const OptixAabb* aabbs, uint32_t numAabbs);
+        float getSurfaceAreaGrowth() const {
+            if (!baseBoundsAreKnown)
+                return 1.0f;
+            if (baseSurfaceArea <= 0.0f)
+                return latestSurfaceArea > 0.0f ? std::numeric_limits<float>::infinity() : 1.0f;
+            return latestSurfaceArea / baseSurfaceArea;
+        }
+        float getRelativeDisplacement() const {
+            if (!baseBoundsAreKnown)
+                return 0.0f;
+            if (baseDiagonalLength <= 0.0f)
+                return accumulatedDisplacement > 0.0f ? std::numeric_limits<float>::infinity() : 0.0f;
+            return accumulatedDisplacement / baseDiagonalLength;
+        }
+        uint32_t getNumUpdatesSinceRebuild() const {
+            return numUpdatesSinceRebuild;
+        }
+        bool shouldRebuild() const {
+            return numUpdatesSinceRebuild >= maxNumUpdates ||
+                getSurfaceAreaGrowth() > maxSurfaceAreaGrowth ||
+                getRelativeDisplacement() > maxRelativeDisplacement;
+        }
+
+        // JP: 前回の読み戻しが完了していればその結果を反映する。ホストは待たない。
+        // EN: Reflect the result of the previous readback if it has completed. The host doesn't wait.
+        void pollBoundsReadback();
+        // JP: 前回の読み戻しが終わっていない場合はfalseを返し、今回のビルドではAABBを出力させない。
+        // EN: Returns false if the previous readback hasn't completed, then AABBs aren't emitted at this build.
+        bool prepareBoundsEmission(uint32_t numAabbs, OptixAccelEmitDesc* emitDesc);
+        void requestBoundsReadback(CUstream stream);
+    };
+
+    // JP: ビルド時に出力させるプロパティを列挙する。更新ポリシーが設定されていれば境界も出力させる。
+    // EN: Enumerate properties emitted at build. Also emit the bounds if an update policy is attached.
+    inline uint32_t setUpASEmitDescs(
+        const OptixAccelEmitDesc* propertyCompactedSize,
+        AccelerationStructureUpdatePolicy::Priv* updatePolicy, uint32_t numMotionKeys,
+        OptixAccelEmitDesc emitDescs[2], bool* emitsBounds) {
+        uint32_t numEmitDescs = 0;
+        if (propertyCompactedSize)
+            emitDescs[numEmitDescs++] = *propertyCompactedSize;
+        *emitsBounds = updatePolicy &&
+            updatePolicy->prepareBoundsEmission(std::max(numMotionKeys, 1u), &emitDescs[numEmitDescs]);
+        if (*emitsBounds)
+            ++numEmitDescs;
+        return numEmitDescs;
+    }
+
+    // JP: GASのビルドのGPU時間をプリミティブ数から見積もるコストモデルと、
+    //     フレームごとの予算に収まる分だけキューからビルドを取り出すスケジューラー。デバイスに依存しない。
+    //     コストは固定費とプリミティブあたりのコストの和とし、後者を計測結果の指数移動平均で学習する。
+    // EN: A cost model estimating GPU time of GAS builds from the primitive count, and a scheduler
+    //     taking builds out of the queue as many as fit the per-frame budget. Device independent.
+    //     The cost is the sum of a fixed cost and a per-primitive cost,
+    //     and the latter is learned by an exponential moving average of measurements.
+    template <typename T>
+    class ASBuildScheduler {
+    public:
+        struct Entry {
+            T item;
+            uint32_t numPrimitives;
+        };
+
+    private:
+        std::deque<Entry> queue;
+        float fixedCost;
+        float costPerPrimitive;
+        float learningRate;
+        uint32_t numMeasurements;
+
+    public:
+        ASBuildScheduler() :
+            fixedCost(0.01f), costPerPrimitive(1e-5f), learningRate(0.25f), numMeasurements(0) {}
+
+        void setCostModel(float _fixedCost, float _costPerPrimitive) {
+            fixedCost = _fixedCost;
+            costPerPrimitive = _costPerPrimitive;
+            numMeasurements = 0;
+        }
+        float getCostPerPrimitive() const {
+            return costPerPrimitive;
+        }
+        float estimateCost(uint32_t numPrimitives) const {
+            return fixedCost + costPerPrimitive * numPrimitives;
+        }
+        // JP: 最初の計測結果は初期値を置き換える。
+        // EN: The first measurement replaces the initial value.
+        void addMeasurement(uint32_t numPrimitives, float cost) {
+            if (numPrimitives == 0)
+                return;
+            const float observed = std::max(cost - fixedCost, 0.0f) / numPrimitives;
+            if (numMeasurements == 0)
+                costPerPrimitive = observed;
+            else
+                costPerPrimitive += learningRate * (observed - costPerPrimitive);
+            ++numMeasurements;
+        }
+
+        void enqueue(const T &item, uint32_t numPrimitives) {
+            queue.push_back(Entry{ item, numPrimitives });
+        }
+        uint32_t getNumQueued() const {
+            return static_cast<uint32_t>(queue.size());
+        }
+
+        // JP: 見積もりコストの合計が予算を超えない範囲でキューの先頭から取り出してfuncを呼ぶ。
+        //     先頭のビルドが単独で予算を超える場合も進行を保証するため、それだけは取り出す。
+        //     取り出したビルドの見積もりコストの合計を返す。
+        // EN: Take builds out from the head of the queue and call func while the sum of
+        //     estimated costs doesn't exceed the budget.
+        //     Even if the head build alone exceeds the budget, take out only it to guarantee progress.
+        //     Returns the sum of estimated costs of the taken builds.
+        template <typename Func>
+        float dequeueWithinBudget(float budget, Func func) {
+            float sumCost = 0.0f;
+            while (!queue.empty()) {
+                const Entry entry = queue.front();
+                const float cost = estimateCost(entry.numPrimitives);
+                if (sumCost > 0.0f && sumCost + cost > budget)
+                    break;
+                queue.pop_front();
+                sumCost += cost;
+                func(entry.item, entry.numPrimitives);
+            }
+            return sumCost;
+        }
+    };
+
+    class AccelerationStructureBuildQueue::Priv {
+        struct InFlightBuild {
+            _GeometryAccelerationStructure* gas;
+            uint32_t numPrimitives;
+            CUevent startEvent;
+            CUevent endEvent;
+            BufferView scratchBuffer;
+        };
+
+        AccelerationStructureMemoryAllocator* allocator;
+        float frameBudget;
+        ASBuildScheduler<_GeometryAccelerationStructure*> scheduler;
+        // JP: 発行順に並んだ計測待ちのビルド。
+        // EN: Builds waiting for measurement in issue order.
+        std::deque<InFlightBuild> inFlightBuilds;
+        std::vector<_GeometryAccelerationStructure*> pendingCompactions;
+        std::vector<_GeometryAccelerationStructure*> pendingUncompactedRemovals;
+        std::vector<CUevent> freeEvents;
+
+        CUevent acquireEvent() {
+            if (freeEvents.empty()) {
+                CUevent event;
+                CUDADRV_CHECK(cuEventCreate(&event, CU_EVENT_DEFAULT));
+                return event;
+            }
+            CUevent event = freeEvents.back();
+            freeEvents.pop_back();
+            return event;
+        }
+
+        void issueBuild(CUstream stream, _GeometryAccelerationStructure* gas, uint32_t numPrimitives);
+        void collectMeasurements();
+
+    public:
+        OPTIXU_OPAQUE_BRIDGE(AccelerationStructureBuildQueue);
+
+        Priv(AccelerationStructureMemoryAllocator* _allocator) :
+            allocator(_allocator), frameBudget(4.0f) {}
+        ~Priv();
+
+        void setFrameBudget(float budget) {
+            frameBudget = budget;
+        }
+        ASBuildScheduler<_GeometryAccelerationStructure*> &getScheduler() {
+            return scheduler;
+        }
+
+        void processFrame(CUstream stream, std::vector<GeometryAccelerationStructure>* readyGASes);
+        bool isIdle() const {
+            return scheduler.getNumQueued() == 0 && inFlightBuilds.empty() &&
+                pendingCompactions.empty() && pendingUncompactedRemovals.empty();
+        }
+    };
+
+
+
+    // JP: プロセス内のプログラムキャッシュのキー。
+    //     入力のバイト列、モジュールとパイプラインのコンパイルオプション、エントリー関数名から計算する。
+    // EN: Keys of the in-process program cache.
+    //     Computed from the input bytes, module and pipeline compile options and entry function names.
+    void hashPipelineCompileOptions(ContentHasher* hasher, const OptixPipelineCompileOptions &options);
+    uint64_t computeModuleCacheKey(
+        const char* data, size_t size,
+        const OptixModuleCompileOptions &moduleCompileOptions,
+        const OptixPipelineCompileOptions &pipelineCompileOptions);
+    // JP: キャッシュされていないモジュールを参照している場合はfalseを返す。
+    // EN: Return false if the desc refers to a module not in the cache.
+    bool computeProgramGroupCacheKey(
+        const OptixProgramGroupDesc &desc, const OptixProgramGroupOptions &options,
+        const OptixPipelineCompileOptions &pipelineCompileOptions,
+        const std::unordered_map<OptixModule, uint64_t> &moduleKeys,
+        uint64_t* key);
+
+    // JP: OptiXのスタックサイズユーティリティ(optix_stack_size.h)と同じ方法で
+    //     プログラムグループのスタックサイズを集計し、パイプラインのスタックサイズを計算する。
+    // EN: Accumulate stack sizes of program groups and compute the pipeline stack sizes
+    //     in the same way as OptiX's stack size utilities (optix_stack_size.h).
+    void accumulateStackSizes(const OptixStackSizes &stackSizes, OptixStackSizes* accumulated);
+    void calcPipelineStackSizes(
+        const OptixStackSizes &stackSizes,
+        uint32_t maxTraceDepth, uint32_t maxCCDepth, uint32_t maxDCDepth,
+        uint32_t* directCallableStackSizeFromTraversal,
+        uint32_t* directCallableStackSizeFromState,
+        uint32_t* continuationStackSize);
+
+
+
     class Context::Priv {
+        // JP: 同一のキーを持つモジュールやプログラムグループは参照カウント付きで共有される。
+        // EN: Modules and program groups with the same key are shared with reference counts.
+        template <typename RawType>
+        struct CachedEntry {
+            RawType rawObject;
+            uint32_t refCount;
+        };
+
         CUcontext cuContext;
         OptixDeviceContext rawContext;
         uint32_t maxInstanceID;
         uint32_t numVisibilityMaskBits;
         std::unordered_map<const void*, std::string> registeredNames;
+        ThreadPool* userThreadPool;
+        WorkerThreadPool* workerThreadPool;
+        ObjectPool<_Material> materialPool;
+
+        std::mutex programCacheMutex;
+        std::unordered_map<uint64_t, CachedEntry<OptixModule>> cachedModules;
+        std::unordered_map<OptixModule, uint64_t> cachedModuleKeys;
+        std::unordered_map<uint64_t, CachedEntry<OptixProgramGroup>> cachedProgramGroups;
+        std::unordered_map<OptixProgramGroup, uint64_t> cachedProgramGroupKeys;
+        bool programCacheEnabled;
 
     public:
         OPTIXU_OPAQUE_BRIDGE(Context);
 
         Priv(CUcontext _cuContext, uint32_t logLevel, EnableValidation enableValidation) :
-            cuContext(_cuContext) {
+            cuContext(_cuContext),
+            userThreadPool(nullptr), workerThreadPool(nullptr),
+            programCacheEnabled(false) {
             throwRuntimeError(logLevel <= 4, "Valid range for logLevel is [0, 4].");
             OPTIX_CHECK(optixInit());
 
@@ -246,6 +1094,8 @@ namespace optixu {
                 &numVisibilityMaskBits, sizeof(numVisibilityMaskBits)));
         }
         ~Priv() {
+            if (workerThreadPool)
+                delete workerThreadPool;
             optixDeviceContextDestroy(rawContext);
         }
 
@@ -262,6 +1112,40 @@ namespace optixu {
         OptixDeviceContext getRawContext() const {
             return rawContext;
         }
+        ThreadPool* getThreadPool() const {
+            if (userThreadPool)
+                return userThreadPool;
+            return workerThreadPool;
+        }
+
+        _Material* createMaterial();
+        void destroyMaterial(_Material* mat);
+
+        bool isProgramCacheEnabled() const {
+            return programCacheEnabled;
+        }
+        // JP: ヒットした場合は参照カウントを増やしてtrueを返す。
+        // EN: Increment the reference count and return true on a hit.
+        bool acquireCachedModule(uint64_t key, OptixModule* rawModule);
+        // JP: 他のスレッドが同じキーを先に登録していた場合は与えたモジュールを破棄して既存のものを返す。
+        // EN: If another thread has registered the same key first,
+        //     destroy the given module and return the existing one.
+        OptixModule registerCachedModule(uint64_t key, OptixModule rawModule);
+        // JP: キャッシュされたモジュールでなければfalseを返し、破棄は呼び出し側が行う。
+        // EN: Return false if the module isn't a cached one, then the caller is responsible for destruction.
+        bool releaseCachedModule(OptixModule rawModule);
+        bool computeProgramGroupCacheKey(
+            const OptixProgramGroupDesc &desc, const OptixProgramGroupOptions &options,
+            const OptixPipelineCompileOptions &pipelineCompileOptions,
+            uint64_t* key);
+        bool acquireCachedProgramGroup(uint64_t key, OptixProgramGroup* rawGroup);
+        OptixProgramGroup registerCachedProgramGroup(uint64_t key, OptixProgramGroup rawGroup);
+        bool releaseCachedProgramGroup(OptixProgramGroup rawGroup);
+        void getProgramCacheStats(uint32_t* numModules, uint32_t* numProgramGroups) {
+            std::lock_guard<std::mutex> lock(programCacheMutex);
+            *numModules = static_cast<uint32_t>(cachedModules.size());
+            *numProgramGroups = static_cast<uint32_t>(cachedProgramGroups.size());
+        }
 
         void registerName(const void* p, const std::string &name) {
             optixuAssert(p, "Object must not be nullptr.");
@@ -372,14 +1256,19 @@ namespace optixu {
 
         std::unordered_map<Key, _HitProgramGroup*, Key::Hash> programs;
 
+        // JP: このマテリアルを参照するGeometryInstanceとその参照数。
+        // EN: Geometry instances referring this material and their reference counts.
+        std::unordered_map<_GeometryInstance*, uint32_t> users;
+        // JP: 間接参照モードでこのマテリアルのユーザーデータの領域を割り当てたシーン。
+        // EN: Scenes that allocated a region for the user data of this material in the indirect mode.
+        mutable std::unordered_set<_Scene*> userDataScenes;
+
     public:
         OPTIXU_OPAQUE_BRIDGE(Material);
 
         Priv(_Context* ctxt) :
             context(ctxt), userData(sizeof(uint32_t)) {}
-        ~Priv() {
-            context->unregisterName(this);
-        }
+        ~Priv();
 
         _Context* getContext() const {
             return context;
@@ -389,67 +1278,136 @@ namespace optixu {
         SizeAlign getUserDataSizeAlign() const {
             return userDataSizeAlign;
         }
+        const uint8_t* getUserData() const {
+            return userData.data();
+        }
         void setRecordHeader(
             const _Pipeline* pipeline, uint32_t rayType, uint8_t* record, SizeAlign* curSizeAlign) const;
         void setRecordData(uint8_t* record, SizeAlign* curSizeAlign) const;
+
+        void addUser(_GeometryInstance* geomInst) {
+            ++users[geomInst];
+        }
+        void removeUser(_GeometryInstance* geomInst, bool all) {
+            auto it = users.find(geomInst);
+            if (it == users.end())
+                return;
+            if (all || --it->second == 0)
+                users.erase(it);
+        }
+        void addUserDataScene(_Scene* scene) const {
+            userDataScenes.insert(scene);
+        }
+        void removeUserDataScene(_Scene* scene) const {
+            userDataScenes.erase(scene);
+        }
+        void markSBTLayoutDirty() const;
+        void markSBTRecordsDirty() const;
+        void markUserDataDirty() const;
     };
 
 
 
     template <>
     class Object<Scene>::Priv : public PrivateObject {
-        struct SBTOffsetKey {
+        // JP: GASのマテリアルセットごとのSBTオフセットの、連続したオフセット表中の範囲。
+        // EN: Range in the contiguous offset table of SBT offsets per material set of a GAS.
+        struct GASSBTOffsetRange {
+            uint32_t firstIndex;
+            uint32_t numMaterialSets;
+        };
+
+    public:
+        // JP: SBTレイアウト生成後のレコード内容の変更。
+        //     childIndexが0xFFFFFFFFの場合はGASのマテリアルセット全体を表す。
+        // EN: An edit of record contents after SBT layout generation.
+        //     childIndex 0xFFFFFFFF means the whole material set of the GAS.
+        struct SBTRecordEdit {
             uint32_t gasSerialID;
             uint32_t matSetIndex;
-
-            bool operator<(const SBTOffsetKey &rKey) const {
-                if (gasSerialID < rKey.gasSerialID) {
-                    return true;
-                }
-                else if (gasSerialID == rKey.gasSerialID) {
-                    if (matSetIndex < rKey.matSetIndex)
-                        return true;
-                }
-                return false;
+            uint32_t childIndex;
+
+            bool operator<(const SBTRecordEdit &r) const {
+                if (gasSerialID != r.gasSerialID)
+                    return gasSerialID < r.gasSerialID;
+                if (matSetIndex != r.matSetIndex)
+                    return matSetIndex < r.matSetIndex;
+                return childIndex < r.childIndex;
             }
-
-            struct Hash {
-                typedef std::size_t result_type;
-
-                std::size_t operator()(const SBTOffsetKey& key) const {
-                    size_t seed = 0;
-                    auto hash0 = std::hash<uint32_t>()(key.gasSerialID);
-                    auto hash1 = std::hash<uint32_t>()(key.matSetIndex);
-                    seed ^= hash0 + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-                    seed ^= hash1 + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-                    return seed;
-                }
-            };
-            bool operator==(const SBTOffsetKey &rKey) const {
-                return gasSerialID == rKey.gasSerialID && matSetIndex == rKey.matSetIndex;
+            bool operator==(const SBTRecordEdit &r) const {
+                return gasSerialID == r.gasSerialID &&
+                    matSetIndex == r.matSetIndex &&
+                    childIndex == r.childIndex;
             }
         };
-
+        // JP: 変更履歴がこの数を超えた場合は全体のセットアップに切り替える。
+        // EN: Switch to the whole setup when the edit log exceeds this number.
+        static constexpr uint32_t s_maxNumSBTRecordEdits = 4096;
+        // JP: SBTレコードの並列な詰め込みにおけるタスクあたりの最小の詰め込み単位数。
+        // EN: The minimum number of packing units per task in parallel SBT record packing.
+        static constexpr uint32_t s_minNumSBTPackingUnitsPerTask = 64;
+
+    private:
         _Context* context;
-        std::unordered_map<uint32_t, _GeometryAccelerationStructure*> geomASs;
-        std::unordered_map<SBTOffsetKey, uint32_t, SBTOffsetKey::Hash> sbtOffsets;
-        uint32_t nextGeomASSerialID;
+        // JP: GASのシリアルIDはスロット番号そのものである。
+        // EN: The serial ID of a GAS is its slot index itself.
+        SlotArray<_GeometryAccelerationStructure> geomASs;
+        std::vector<GASSBTOffsetRange> gasSBTOffsetRanges;
+        std::vector<uint32_t> sbtOffsets;
         uint32_t singleRecordSize;
         uint32_t numSBTRecords;
-        std::unordered_set<_Transform*> transforms;
-        std::unordered_set<_InstanceAccelerationStructure*> instASs;
+        std::vector<SBTRecordEdit> sbtRecordEdits;
+        // JP: 変更履歴の先頭から捨てた変更の数。
+        // EN: The number of edits dropped from the head of the edit log.
+        uint32_t sbtRecordEditBase;
+        uint32_t sbtEpoch;
+        std::unordered_set<HitGroupSBTSyncState*> sbtSyncStates;
+        SlotArray<_Transform> transforms;
+        SlotArray<_InstanceAccelerationStructure> instASs;
+        // JP: シーンに属するオブジェクトの型ごとのプール。
+        // EN: Per-type pools of objects belonging to the scene.
+        std::tuple<
+            ObjectPool<_OpacityMicroMapArray>,
+            ObjectPool<_DisplacementMicroMapArray>,
+            ObjectPool<_GeometryInstance>,
+            ObjectPool<_GeometryAccelerationStructure>,
+            ObjectPool<_Transform>,
+            ObjectPool<_Instance>,
+            ObjectPool<_InstanceAccelerationStructure>
+        > objectPools;
+        uint32_t numNotReadyTraversables;
+        uint32_t numMotionASs;
+
+        // JP: マテリアルのユーザーデータの間接参照モードにおける、各マテリアルのデータの配置。
+        // EN: Placement of each material's data in the indirect material user data mode.
+        std::unordered_map<const _Material*, uint32_t> materialUserDataOffsets;
+        SizeAlign materialUserDataSizeAlign;
+        BufferView materialUserDataBuffer;
+        void* materialUserDataHostMem;
+
         struct {
             unsigned int sbtLayoutIsUpToDate : 1;
+            unsigned int indirectMaterialUserData : 1;
+            unsigned int materialUserDataIsUpToDate : 1;
         };
 
     public:
         OPTIXU_OPAQUE_BRIDGE(Scene);
 
         Priv(_Context* ctxt) : context(ctxt),
-            nextGeomASSerialID(0),
             singleRecordSize(OPTIX_SBT_RECORD_HEADER_SIZE), numSBTRecords(0),
-            sbtLayoutIsUpToDate(false) {}
+            sbtRecordEditBase(0), sbtEpoch(0),
+            numNotReadyTraversables(0), numMotionASs(0),
+            materialUserDataHostMem(nullptr),
+            sbtLayoutIsUpToDate(false),
+            indirectMaterialUserData(false), materialUserDataIsUpToDate(false) {}
         ~Priv() {
+            for (HitGroupSBTSyncState* syncState : sbtSyncStates) {
+                syncState->scene = nullptr;
+                syncState->valid = false;
+            }
+            detachUpdatePolicies();
+            clearMaterialUserDataLayout();
             context->unregisterName(this);
         }
 
@@ -460,33 +1418,124 @@ namespace optixu {
 
 
 
-        void addGAS(_GeometryAccelerationStructure* gas);
+        uint32_t addGAS(_GeometryAccelerationStructure* gas);
         void removeGAS(_GeometryAccelerationStructure* gas);
-        void addTransform(_Transform* tr) {
-            transforms.insert(tr);
-        }
-        void removeTransform(_Transform* tr) {
-            transforms.erase(tr);
-        }
-        void addIAS(_InstanceAccelerationStructure* ias) {
-            instASs.insert(ias);
+        uint32_t addTransform(_Transform* tr);
+        void removeTransform(_Transform* tr);
+        uint32_t addIAS(_InstanceAccelerationStructure* ias);
+        void removeIAS(_InstanceAccelerationStructure* ias);
+        // JP: シーンの破棄時に個別の破棄を経ずに解放されるASからアップデートポリシーを外す。
+        // EN: Detach update policies from ASs released without their individual destruction at scene destruction.
+        void detachUpdatePolicies();
+
+        template <typename T, typename... Args>
+        T* createObject(Args &&... args) {
+            return std::get<ObjectPool<T>>(objectPools).create(this, std::forward<Args>(args)...);
+        }
+        template <typename T>
+        void createObjects(uint32_t numObjects, T** objects) {
+            std::get<ObjectPool<T>>(objectPools).createContiguous(numObjects, objects, this);
+        }
+        template <typename T>
+        void destroyObject(T* obj) {
+            std::get<ObjectPool<T>>(objectPools).destroy(obj);
+        }
+        template <typename T>
+        const ObjectPool<T> &getObjectPool() const {
+            return std::get<ObjectPool<T>>(objectPools);
+        }
+
+        // JP: 各トラバーサブルの状態変化をシーンのカウンターに反映する。
+        // EN: Reflect a state transition of each traversable to the counters of the scene.
+        void onReadinessChanged(bool wasReady, bool nowReady) {
+            if (wasReady == nowReady)
+                return;
+            if (nowReady)
+                --numNotReadyTraversables;
+            else
+                ++numNotReadyTraversables;
         }
-        void removeIAS(_InstanceAccelerationStructure* ias) {
-            instASs.erase(ias);
+        void onMotionChanged(bool hadMotion, bool nowHasMotion) {
+            if (hadMotion == nowHasMotion)
+                return;
+            if (nowHasMotion)
+                ++numMotionASs;
+            else
+                --numMotionASs;
         }
 
         bool sbtLayoutGenerationDone() const {
             return sbtLayoutIsUpToDate;
         }
         void markSBTLayoutDirty();
+        bool hasSBTOffset(uint32_t gasSerialID, uint32_t matSetIdx) const {
+            return gasSerialID < gasSBTOffsetRanges.size() &&
+                matSetIdx < gasSBTOffsetRanges[gasSerialID].numMaterialSets;
+        }
+        uint32_t lookUpSBTOffset(uint32_t gasSerialID, uint32_t matSetIdx) const {
+            return sbtOffsets[gasSBTOffsetRanges[gasSerialID].firstIndex + matSetIdx];
+        }
         uint32_t getSBTOffset(_GeometryAccelerationStructure* gas, uint32_t matSetIdx);
 
+        void markSBTRecordsDirty(const _GeometryInstance* geomInst);
+        void markSBTRecordsDirty(const _GeometryAccelerationStructure* gas, uint32_t childIndex);
+        uint32_t getSBTEpoch() const {
+            return sbtEpoch;
+        }
+        uint32_t getNumSBTRecordEdits() const {
+            return sbtRecordEditBase + static_cast<uint32_t>(sbtRecordEdits.size());
+        }
+        uint32_t getNumRetainedSBTRecordEdits() const {
+            return static_cast<uint32_t>(sbtRecordEdits.size());
+        }
+        // JP: 変更履歴を捨てて全体のセットアップを強制する。
+        // EN: Discard the edit log and force the whole setup.
+        void resetSBTRecordEdits() {
+            sbtRecordEdits.clear();
+            sbtRecordEditBase = 0;
+            ++sbtEpoch;
+        }
+        void unregisterSBTSyncState(HitGroupSBTSyncState* syncState) {
+            sbtSyncStates.erase(syncState);
+        }
+        bool collectSBTRecordEdits(
+            const HitGroupSBTSyncState &syncState,
+            std::vector<SBTRecordEdit>* edits, std::vector<SBTRecordRange>* ranges) const;
+
         uint32_t getSingleRecordSize() const {
             return singleRecordSize;
         }
-        void setupHitGroupSBT(CUstream stream, const _Pipeline* pipeline, const BufferView &sbt, void* hostMem);
+        size_t getHitGroupSBTSize() const {
+            return static_cast<size_t>(singleRecordSize) * std::max(numSBTRecords, 1u);
+        }
 
-        bool isReady(bool* hasMotionAS);
+        bool usesIndirectMaterialUserData() const {
+            return indirectMaterialUserData;
+        }
+        void allocateMaterialUserData(const _Material* mat);
+        void releaseMaterialUserData(const _Material* mat);
+        void clearMaterialUserDataLayout();
+        CUdeviceptr getMaterialUserDataAddress(const _Material* mat) const {
+            return materialUserDataBuffer.getCUdeviceptr() + materialUserDataOffsets.at(mat);
+        }
+        void markMaterialUserDataDirty() {
+            materialUserDataIsUpToDate = false;
+        }
+        void setupMaterialUserData(CUstream stream);
+
+        void setupHitGroupSBT(
+            CUstream stream, const _Pipeline* pipeline, const BufferView &sbt, void* hostMem,
+            HitGroupSBTSyncState* syncState);
+
+        // JP: カウンターを用いてO(1)で判定する。
+        //     アサート有効時は全走査の結果と突き合わせる。
+        // EN: Determine in O(1) using the counters.
+        //     Cross-check against the result of the full walk when assertion is enabled.
+        bool isReady(bool* hasMotionAS) const;
+        bool isReadyByFullWalk(bool* hasMotionAS) const;
+
+        void buildDirty(CUstream stream, AccelerationStructureMemoryAllocator* allocator);
+        uint32_t defragmentAccelerationStructures(CUstream stream);
     };
 
 
@@ -665,6 +1714,7 @@ namespace optixu {
         std::vector<OptixGeometryFlags> buildInputFlags; // per SBT record
 
         std::vector<std::vector<_Material*>> materials;
+        std::unordered_map<_GeometryAccelerationStructure*, uint32_t> parentGASs;
 
     public:
         OPTIXU_OPAQUE_BRIDGE(GeometryInstance);
@@ -769,12 +1819,22 @@ namespace optixu {
             else {
                 optixuAssert_ShouldNotBeCalled();
             }
+            for (std::vector<_Material*> &matSets : materials) {
+                for (_Material* mat : matSets) {
+                    if (mat)
+                        mat->removeUser(this, true);
+                }
+            }
+            releaseParentGASs();
             getContext()->unregisterName(this);
         }
 
         const _Scene* getScene() const {
             return scene;
         }
+        _Scene* getScene() {
+            return scene;
+        }
         _Context* getContext() const override {
             return scene->getContext();
         }
@@ -790,6 +1850,45 @@ namespace optixu {
         }
         void fillBuildInput(OptixBuildInput* input, CUdeviceptr preTransform) const;
         void updateBuildInput(OptixBuildInput* input, CUdeviceptr preTransform) const;
+        // JP: バッファーの中身を含むビルド入力をハッシュに加える。キャッシュできない場合はfalseを返す。
+        // EN: Add the build input including buffer contents to the hash. Returns false if not cacheable.
+        bool hashBuildInput(ContentHasher* hasher) const;
+        uint32_t getNumPrimitives() const;
+
+        void addParentGAS(_GeometryAccelerationStructure* gas) {
+            ++parentGASs[gas];
+        }
+        void removeParentGAS(_GeometryAccelerationStructure* gas) {
+            auto it = parentGASs.find(gas);
+            if (it != parentGASs.end() && --it->second == 0)
+                parentGASs.erase(it);
+        }
+        const std::unordered_map<_GeometryAccelerationStructure*, uint32_t> &getParentGASs() const {
+            return parentGASs;
+        }
+        void releaseParentGASs();
+        _Material* getMaterial(uint32_t gasMatSetIdx, uint32_t matIdx) const {
+            throwRuntimeError(
+                materials[matIdx][0],
+                "Default material (== material set 0) is not set for the slot %u.",
+                matIdx);
+            uint32_t matSetIdx = gasMatSetIdx < materials[matIdx].size() ? gasMatSetIdx : 0;
+            _Material* mat = materials[matIdx][matSetIdx];
+            if (!mat)
+                mat = materials[matIdx][0];
+            return mat;
+        }
+        void releaseMaterial(const _Material* mat) {
+            for (std::vector<_Material*> &matSets : materials) {
+                for (_Material* &m : matSets) {
+                    if (m == mat)
+                        m = nullptr;
+                }
+            }
+        }
+        uint32_t getNumSBTRecords() const {
+            return static_cast<uint32_t>(buildInputFlags.size());
+        }
 
         void calcSBTRequirements(
             uint32_t gasMatSetIdx,
@@ -801,6 +1900,13 @@ namespace optixu {
             const void* gasUserData, const SizeAlign &gasUserDataSizeAlign,
             const void* gasChildUserData, const SizeAlign &gasChildUserDataSizeAlign,
             uint32_t numRayTypes, uint8_t* records) const;
+        void accumulateSBTLayoutStats(
+            _GeometryAccelerationStructure* gas, uint32_t gasMatSetIdx,
+            const SizeAlign &gasUserDataSizeAlign,
+            const SizeAlign &gasChildUserDataSizeAlign,
+            uint32_t numRayTypes,
+            ShaderBindingTableLayoutStats::MaterialSetEntry* entry,
+            ShaderBindingTableLayoutStats* stats);
     };
 
 
@@ -836,11 +1942,17 @@ namespace optixu {
         CUdeviceptr compactedSizeOnDevice;
         size_t compactedSize;
         OptixAccelEmitDesc propertyCompactedSize;
+        // JP: 非同期の読み戻し用のピン留めされたホストメモリとイベント。初回使用時に確保する。
+        // EN: Pinned host memory and an event for asynchronous readback. Allocated at the first use.
+        size_t* compactedSizeOnHost;
+        CUevent compactedSizeReadbackEvent;
 
         OptixTraversableHandle handle;
         OptixTraversableHandle compactedHandle;
         BufferView accelBuffer;
         BufferView compactedAccelBuffer;
+        ManagedASMemory managedMemory;
+        AccelerationStructureUpdatePolicy::Priv* updatePolicy;
         ASTradeoff tradeoff;
         struct {
             unsigned int allowUpdate : 1;
@@ -850,6 +1962,7 @@ namespace optixu {
             unsigned int allowDisableOpacityMicroMaps : 1;
             unsigned int readyToBuild : 1;
             unsigned int available : 1;
+            unsigned int compactedSizeReadbackPending : 1;
             unsigned int readyToCompact : 1;
             unsigned int compactedAvailable : 1;
         };
@@ -857,18 +1970,19 @@ namespace optixu {
     public:
         OPTIXU_OPAQUE_BRIDGE(GeometryAccelerationStructure);
 
-        Priv(_Scene* _scene, uint32_t _serialID, GeometryType _geomType) :
+        Priv(_Scene* _scene, GeometryType _geomType) :
             scene(_scene),
-            serialID(_serialID),
             geomType(_geomType),
             userData(sizeof(uint32_t)),
+            compactedSizeOnHost(nullptr), compactedSizeReadbackEvent(nullptr),
             handle(0), compactedHandle(0),
+            updatePolicy(nullptr),
             tradeoff(ASTradeoff::Default),
             allowUpdate(false), allowCompaction(false), allowRandomVertexAccess(false),
             allowOpacityMicroMapUpdate(false), allowDisableOpacityMicroMaps(false),
-            readyToBuild(false), available(false),
+            readyToBuild(false), available(false), compactedSizeReadbackPending(false),
             readyToCompact(false), compactedAvailable(false) {
-            scene->addGAS(this);
+            serialID = scene->addGAS(this);
 
             numRayTypesPerMaterialSet.resize(1, 0);
 
@@ -883,9 +1997,20 @@ namespace optixu {
             propertyCompactedSize.result = compactedSizeOnDevice;
         }
         ~Priv() {
+            detachUpdatePolicy();
+            managedMemory.releaseAll();
+            if (compactedSizeReadbackEvent) {
+                cuEventSynchronize(compactedSizeReadbackEvent);
+                cuEventDestroy(compactedSizeReadbackEvent);
+                cuMemFreeHost(compactedSizeOnHost);
+            }
             cuMemFree(compactedSizeOnDevice);
             cuEventDestroy(finishEvent);
 
+            for (const Child &child : children) {
+                if (child.geomInst)
+                    child.geomInst->removeParentGAS(this);
+            }
             scene->removeGAS(this);
             getContext()->unregisterName(this);
         }
@@ -898,6 +2023,14 @@ namespace optixu {
         }
         OPTIXU_DEFINE_THROW_RUNTIME_ERROR("GAS");
 
+        // JP: 設定されているアップデートポリシーとの関連を解除する。
+        // EN: Detach the attached update policy.
+        void detachUpdatePolicy() {
+            if (updatePolicy)
+                updatePolicy->clearOwner();
+            updatePolicy = nullptr;
+        }
+
 
 
         uint32_t getSerialID() const {
@@ -914,10 +2047,69 @@ namespace optixu {
         void calcSBTRequirements(
             uint32_t matSetIdx, SizeAlign* maxRecordSizeAlign, uint32_t* numSBTRecords) const;
         uint32_t fillSBTRecords(const _Pipeline* pipeline, uint32_t matSetIdx, uint8_t* records) const;
+        uint32_t getNumChildren() const {
+            return static_cast<uint32_t>(children.size());
+        }
+        uint32_t getNumPrimitives() const;
+        bool hasChild(const _GeometryInstance* geomInst, uint32_t childIdx) const {
+            return children[childIdx].geomInst == geomInst;
+        }
+        void releaseChild(const _GeometryInstance* geomInst) {
+            for (Child &child : children) {
+                if (child.geomInst == geomInst)
+                    child.geomInst = nullptr;
+            }
+        }
+        uint32_t getNumSBTRecords(uint32_t matSetIdx) const;
+        SBTRecordRange getChildSBTRecordRange(uint32_t matSetIdx, uint32_t childIdx) const;
+        uint32_t fillChildSBTRecords(
+            const _Pipeline* pipeline, uint32_t matSetIdx, uint32_t childIdx, uint8_t* records) const;
+        void accumulateSBTLayoutStats(uint32_t matSetIdx, ShaderBindingTableLayoutStats* stats);
         bool hasMotion() const {
             return buildOptions.motionOptions.numKeys >= 2;
         }
 
+        const OptixAccelBufferSizes &getMemoryRequirement() const {
+            return memoryRequirement;
+        }
+        bool compactionIsEnabled() const {
+            return (buildOptions.buildFlags & OPTIX_BUILD_FLAG_ALLOW_COMPACTION) != 0;
+        }
+        // JP: 次のビルドでコンパクション後のサイズを書き込む先を変更する。0で自身のバッファーに戻す。
+        // EN: Change where the next build writes the compacted size. 0 restores the own buffer.
+        void setCompactedSizeEmitTarget(CUdeviceptr target) {
+            propertyCompactedSize.result = target ? target : compactedSizeOnDevice;
+        }
+        void setCompactedSize(size_t size) {
+            compactedSize = size;
+            readyToCompact = true;
+        }
+        ManagedASMemory &getManagedMemory() {
+            return managedMemory;
+        }
+        // JP: 現在のASがアロケーターから確保したメモリ上にあればそのアドレスを、無ければ0を返す。
+        // EN: Returns the address of the current AS if it lives in memory from an allocator, otherwise 0.
+        CUdeviceptr getRelocatableAddress() const;
+        bool relocate(CUstream stream);
+        void fillRelocateInputs(std::vector<OptixRelocateInput>* relocInputs) const;
+
+        // JP: prepareForBuild()の後に呼ぶ。キャッシュできない場合はfalseを返す。
+        // EN: Call this after prepareForBuild(). Returns false if not cacheable.
+        bool computeContentHash(uint64_t* hash) const;
+        // JP: 現在のAS(コンパクション後があればそちら)のデータのサイズ。
+        // EN: The data size of the current AS (the compacted one if exists).
+        size_t getCurrentDataSize() const {
+            return compactedAvailable ? compactedSize : memoryRequirement.outputSizeInBytes;
+        }
+        CUdeviceptr getCurrentAddress() const {
+            return (compactedAvailable ? compactedAccelBuffer : accelBuffer).getCUdeviceptr();
+        }
+        // JP: 外部で配置したASを現在のASとして採用する。
+        //     コンパクションが有効な場合はコンパクション済みのASとして扱う。
+        // EN: Adopt an AS placed externally as the current AS.
+        //     It is treated as a compacted AS when compaction is enabled.
+        void adoptAS(const BufferView &buffer, OptixTraversableHandle asHandle, CUstream stream);
+
         void markDirty();
         bool isReady() const {
             return available || compactedAvailable;
@@ -949,8 +2141,10 @@ namespace optixu {
         size_t dataSize;
         TransformType type;
         OptixMotionOptions options;
+        uint32_t slotInScene;
 
         OptixTraversableHandle handle;
+        ManagedASMemory managedMemory;
         struct {
             unsigned int available : 1;
         };
@@ -963,7 +2157,7 @@ namespace optixu {
             data(nullptr), dataSize(0),
             handle(0),
             available(false) {
-            scene->addTransform(this);
+            slotInScene = scene->addTransform(this);
 
             options.numKeys = 2;
             options.timeBegin = 0.0f;
@@ -971,6 +2165,7 @@ namespace optixu {
             options.flags = OPTIX_MOTION_FLAG_NONE;
         }
         ~Priv() {
+            managedMemory.releaseAll();
             if (data)
                 delete data;
             data = nullptr;
@@ -988,7 +2183,18 @@ namespace optixu {
 
 
 
+        uint32_t getSlotInScene() const {
+            return slotInScene;
+        }
         _GeometryAccelerationStructure* getDescendantGAS() const;
+        size_t getDataSize() const {
+            return dataSize;
+        }
+        bool childIsReady() const;
+        bool childIsInvalidated(const std::unordered_set<const _GeometryAccelerationStructure*> &relocatedGASes) const;
+        ManagedASMemory &getManagedMemory() {
+            return managedMemory;
+        }
 
         void markDirty();
         bool isReady() const {
@@ -1017,12 +2223,16 @@ namespace optixu {
         uint32_t visibilityMask;
         OptixInstanceFlags flags;
         float instTransform[12];
+        // JP: OptixInstanceの内容に影響する変更の度に増加する。IASは再アップロードの要否の判定に使う。
+        // EN: Incremented on every change affecting the OptixInstance contents.
+        //     IASs use this to determine whether re-upload is needed.
+        uint32_t revision;
 
     public:
         OPTIXU_OPAQUE_BRIDGE(Instance);
 
         Priv(_Scene* _scene) :
-            scene(_scene) {
+            scene(_scene), revision(0) {
             matSetIndex = 0xFFFFFFFF;
             id = 0;
             visibilityMask = 0xFF;
@@ -1050,19 +2260,53 @@ namespace optixu {
 
         void fillInstance(OptixInstance* instance) const;
         void updateInstance(OptixInstance* instance) const;
+        OptixTraversableHandle getChildHandle() const;
+        uint32_t getRevision() const {
+            return revision;
+        }
+        void markDirty() {
+            ++revision;
+        }
+        void setTransform(const float row0[4], const float row1[4], const float row2[4]) {
+            packTransform(row0, row1, row2, instTransform);
+            markDirty();
+        }
         bool isMotionAS() const;
         bool isTransform() const;
+        bool childIsReady() const;
+        bool childIsInvalidated(const std::unordered_set<const _GeometryAccelerationStructure*> &relocatedGASes) const;
     };
 
 
 
     template <>
     class Object<InstanceAccelerationStructure>::Priv : public PrivateObject {
+    public:
+        // JP: アップデート時に、この数以下のインスタンスの隙間を挟む変更範囲は一回のコピーにまとめる。
+        // EN: In update, changed ranges separated by a gap up to this number of instances
+        //     are merged into a single copy.
+        static constexpr uint32_t s_maxInstanceUploadGap = 32;
+        // JP: インスタンスごとの処理の並列化におけるタスクあたりの最小のインスタンス数。
+        // EN: The minimum number of instances per task in parallel per-instance processing.
+        static constexpr uint32_t s_minNumInstancesPerTask = 4096;
+
+    private:
         _Scene* scene;
 
         std::vector<_Instance*> children;
         OptixBuildInput buildInput;
-        std::vector<OptixInstance> instances;
+        // JP: インスタンスを詰めるピン留めされたホストメモリ。アップロードの完了はイベントで追跡する。
+        //     アップデートは変更されたインスタンスのみを詰め直すので内容はビルド間で保持される。
+        // EN: Pinned host memory to fill instances in. Completion of the upload is tracked by an event.
+        //     Update refills only changed instances, so the contents persist across builds.
+        OptixInstance* stagingInstances;
+        uint32_t stagingCapacity;
+        CUevent stagingUploadEvent;
+        // JP: インスタンスバッファーにアップロード済みの各子のリビジョン。
+        //     SBTのレイアウトの変更はIASをdirty状態にするので、ここではSBTオフセットの変化を考えなくてよい。
+        // EN: The revision of each child uploaded to the instance buffer.
+        //     Changing the SBT layout marks IASs dirty, so changes of SBT offsets needn't be considered here.
+        std::vector<uint32_t> uploadedInstanceRevisions;
 
         OptixAccelBuildOptions buildOptions;
         OptixAccelBufferSizes memoryRequirement;
@@ -1071,21 +2315,31 @@ namespace optixu {
         CUdeviceptr compactedSizeOnDevice;
         size_t compactedSize;
         OptixAccelEmitDesc propertyCompactedSize;
+        // JP: 非同期の読み戻し用のピン留めされたホストメモリとイベント。初回使用時に確保する。
+        // EN: Pinned host memory and an event for asynchronous readback. Allocated at the first use.
+        size_t* compactedSizeOnHost;
+        CUevent compactedSizeReadbackEvent;
 
         OptixTraversableHandle handle;
         OptixTraversableHandle compactedHandle;
         BufferView instanceBuffer;
         BufferView accelBuffer;
         BufferView compactedAccelBuffer;
+        ManagedASMemory managedMemory;
+        AccelerationStructureUpdatePolicy::Priv* updatePolicy;
         ASTradeoff tradeoff;
+        uint32_t slotInScene;
         struct {
             unsigned int allowUpdate : 1;
             unsigned int allowCompaction : 1;
             unsigned int allowRandomInstanceAccess : 1;
             unsigned int readyToBuild : 1;
             unsigned int available : 1;
+            unsigned int compactedSizeReadbackPending : 1;
             unsigned int readyToCompact : 1;
             unsigned int compactedAvailable : 1;
+            unsigned int stagingIsPreparedForCapture : 1;
+            unsigned int stagingIsCopiedByCapture : 1;
         };
 
     public:
@@ -1093,12 +2347,16 @@ namespace optixu {
 
         Priv(_Scene* _scene) :
             scene(_scene),
+            stagingInstances(nullptr), stagingCapacity(0), stagingUploadEvent(nullptr),
+            compactedSizeOnHost(nullptr), compactedSizeReadbackEvent(nullptr),
             handle(0), compactedHandle(0),
+            updatePolicy(nullptr),
             tradeoff(ASTradeoff::Default),
             allowUpdate(false), allowCompaction(false), allowRandomInstanceAccess(false),
-            readyToBuild(false), available(false),
-            readyToCompact(false), compactedAvailable(false) {
-            scene->addIAS(this);
+            readyToBuild(false), available(false), compactedSizeReadbackPending(false),
+            readyToCompact(false), compactedAvailable(false),
+            stagingIsPreparedForCapture(false), stagingIsCopiedByCapture(false) {
+            slotInScene = scene->addIAS(this);
 
             buildOptions = {};
 
@@ -1111,6 +2369,18 @@ namespace optixu {
             propertyCompactedSize.result = compactedSizeOnDevice;
         }
         ~Priv() {
+            detachUpdatePolicy();
+            managedMemory.releaseAll();
+            if (compactedSizeReadbackEvent) {
+                cuEventSynchronize(compactedSizeReadbackEvent);
+                cuEventDestroy(compactedSizeReadbackEvent);
+                cuMemFreeHost(compactedSizeOnHost);
+            }
+            if (stagingUploadEvent) {
+                cuEventSynchronize(stagingUploadEvent);
+                cuEventDestroy(stagingUploadEvent);
+                cuMemFreeHost(stagingInstances);
+            }
             cuMemFree(compactedSizeOnDevice);
             cuEventDestroy(finishEvent);
 
@@ -1124,13 +2394,89 @@ namespace optixu {
         _Context* getContext() const override {
             return scene->getContext();
         }
+
+        // JP: 設定されているアップデートポリシーとの関連を解除する。
+        // EN: Detach the attached update policy.
+        void detachUpdatePolicy() {
+            if (updatePolicy)
+                updatePolicy->clearOwner();
+            updatePolicy = nullptr;
+        }
         OPTIXU_DEFINE_THROW_RUNTIME_ERROR("IAS");
 
 
 
+        uint32_t getSlotInScene() const {
+            return slotInScene;
+        }
         bool hasMotion() const {
             return buildOptions.motionOptions.numKeys >= 2;
         }
+        uint32_t getNumChildren() const {
+            return static_cast<uint32_t>(children.size());
+        }
+        bool childrenAreReady() const;
+        bool hasInvalidatedChild(const std::unordered_set<const _GeometryAccelerationStructure*> &relocatedGASes) const;
+        // JP: 前回のアップロード以降に変更された子のみを詰め直し、変更範囲のみをアップロードする。
+        // EN: Refill only children changed since the last upload and upload only the changed ranges.
+        void uploadDirtyInstances(CUstream stream);
+        // JP: 前回のアップロードの完了を待ってから、少なくとも指定数の容量を持つステージングメモリを返す。
+        //     ストリームキャプチャー中は同期と確保が禁止されているので、事前に準備されたメモリをそのまま返す。
+        // EN: Wait for the completion of the previous upload, then return staging memory
+        //     with at least the given capacity.
+        //     Synchronization and allocation are prohibited during stream capture,
+        //     so return the memory prepared in advance as is.
+        OptixInstance* acquireStagingInstances(CUstream stream, uint32_t numInstances);
+        void recordStagingUse(CUstream stream);
+        // JP: LaunchGraphがキャプチャーの前後に呼ぶ。
+        //     キャプチャー中のアップロードはステージングメモリ全体を一度にコピーする。
+        //     finishStagingCapture()はグラフがステージングメモリをコピーするかを返す。
+        // EN: LaunchGraph calls these before and after a capture.
+        //     Upload during a capture copies the whole staging memory at once.
+        //     finishStagingCapture() returns whether the graph copies the staging memory.
+        void prepareStagingForCapture(CUstream stream) {
+            acquireStagingInstances(stream, static_cast<uint32_t>(children.size()));
+            stagingIsPreparedForCapture = true;
+            stagingIsCopiedByCapture = false;
+        }
+        bool finishStagingCapture() {
+            bool copied = stagingIsCopiedByCapture;
+            stagingIsPreparedForCapture = false;
+            stagingIsCopiedByCapture = false;
+            return copied;
+        }
+        // JP: LaunchGraphがグラフの実行前に呼ぶ。前回の詰め込み以降に変更された子をホスト側で詰め直す。
+        //     グラフの再実行がステージングメモリ全体をコピーするので、再キャプチャーせずに変更が反映される。
+        // EN: LaunchGraph calls this before launching the graph.
+        //     Refill children changed since the last fill on the host.
+        //     Replaying the graph copies the whole staging memory, so the changes are reflected without recapture.
+        void refillStagingForGraph(CUstream stream);
+        // JP: グラフに焼き込まれる状態(ハンドル、インスタンスバッファー、コピーするインスタンス数)のハッシュ。
+        // EN: Hash of the states baked into a graph (handle, instance buffer and the number of instances to copy).
+        void hashLaunchState(ContentHasher* hasher) const {
+            hasher->add(isReady() ? getHandle() : 0);
+            hasher->add(instanceBuffer.getCUdeviceptr());
+            hasher->add(static_cast<uint32_t>(children.size()));
+        }
+
+        const OptixAccelBufferSizes &getMemoryRequirement() const {
+            return memoryRequirement;
+        }
+        bool compactionIsEnabled() const {
+            return (buildOptions.buildFlags & OPTIX_BUILD_FLAG_ALLOW_COMPACTION) != 0;
+        }
+        // JP: 次のビルドでコンパクション後のサイズを書き込む先を変更する。0で自身のバッファーに戻す。
+        // EN: Change where the next build writes the compacted size. 0 restores the own buffer.
+        void setCompactedSizeEmitTarget(CUdeviceptr target) {
+            propertyCompactedSize.result = target ? target : compactedSizeOnDevice;
+        }
+        void setCompactedSize(size_t size) {
+            compactedSize = size;
+            readyToCompact = true;
+        }
+        ManagedASMemory &getManagedMemory() {
+            return managedMemory;
+        }
 
 
 
@@ -1152,6 +2498,96 @@ namespace optixu {
 
 
 
+    class PartitionedInstanceAccelerationStructure::Priv {
+        enum class CompactionState {
+            None = 0,
+            WaitingForSize,
+            WaitingForRemoval,
+        };
+
+        struct Member {
+            _Instance* instance;
+            uint32_t revision;
+            // JP: 最後に確認した子のハンドル。アップデートはハンドルを書き換えないので、変化時はリビルドする。
+            // EN: The handle of the child as of the last check.
+            //     Update doesn't rewrite handles, so rebuild when it changes.
+            OptixTraversableHandle childHandle;
+            uint32_t numStableFrames;
+        };
+
+        struct Partition {
+            _InstanceAccelerationStructure* ias;
+            _Instance* instance;
+            std::vector<Member> members;
+            bool membershipChanged;
+        };
+
+        static constexpr uint32_t s_static = 0;
+        static constexpr uint32_t s_dynamic = 1;
+
+        _Scene* scene;
+        AccelerationStructureMemoryAllocator* allocator;
+        uint32_t numStableFramesToBecomeStatic;
+        uint32_t minNumInstancesToMigrate;
+        uint32_t deviceMaxTraversableGraphDepth;
+        uint32_t traversableGraphDepthLimit;
+        uint32_t maxTraversableGraphDepth;
+
+        Partition partitions[2];
+        _InstanceAccelerationStructure* topLevelIAS;
+        // JP: 各子が属する分割と分割内のインデックス。
+        // EN: The partition each child belongs to and the index in the partition.
+        std::unordered_map<const _Instance*, std::pair<uint32_t, uint32_t>> locations;
+        BufferView scratchBuffer;
+        CompactionState staticCompactionState;
+
+        void moveMember(uint32_t srcPartIdx, uint32_t index);
+        const BufferView &acquireScratchBuffer(size_t size);
+        void rebuild(CUstream stream, _InstanceAccelerationStructure* ias);
+        uint32_t computeMaxTraversableGraphDepth() const;
+
+    public:
+        OPTIXU_OPAQUE_BRIDGE(PartitionedInstanceAccelerationStructure);
+
+        Priv(_Scene* _scene, AccelerationStructureMemoryAllocator* _allocator);
+        ~Priv();
+
+        void setMigrationOptions(uint32_t _numStableFramesToBecomeStatic, uint32_t _minNumInstancesToMigrate) {
+            numStableFramesToBecomeStatic = _numStableFramesToBecomeStatic;
+            minNumInstancesToMigrate = _minNumInstancesToMigrate;
+        }
+        void setTraversableGraphDepthLimit(uint32_t limit) {
+            traversableGraphDepthLimit = limit;
+        }
+        void addChild(_Instance* instance);
+        void removeChild(const _Instance* instance);
+        void markDirty() {
+            partitions[s_static].membershipChanged = true;
+            partitions[s_dynamic].membershipChanged = true;
+        }
+
+        OptixTraversableHandle build(CUstream stream);
+
+        OptixTraversableHandle getHandle() const {
+            return topLevelIAS->getHandle();
+        }
+        uint32_t getMaxTraversableGraphDepth() const {
+            return maxTraversableGraphDepth;
+        }
+        uint32_t getNumChildren() const {
+            return static_cast<uint32_t>(locations.size());
+        }
+        uint32_t getNumDynamicChildren() const {
+            return static_cast<uint32_t>(partitions[s_dynamic].members.size());
+        }
+        bool isDynamicChild(const _Instance* instance) const {
+            auto it = locations.find(instance);
+            return it != locations.cend() && it->second.first == s_dynamic;
+        }
+    };
+
+
+
     template <>
     class Object<Pipeline>::Priv : public PrivateObject {
         struct KeyForBuiltinISModule {
@@ -1196,12 +2632,45 @@ namespace optixu {
             }
         };
 
+        // JP: パイプラインが所有するSBTリングの1スロット。
+        //     スロットを読むローンチの完了はイベントで追跡する。
+        // EN: A slot of the SBT ring owned by the pipeline.
+        //     Completion of launches reading the slot is tracked by the event.
+        struct SBTRingSlot {
+            CUdeviceptr sbtMem;
+            void* sbtHostMem;
+            size_t sbtCapacity;
+            CUdeviceptr hitGroupSbtMem;
+            void* hitGroupSbtHostMem;
+            size_t hitGroupSbtCapacity;
+            HitGroupSBTSyncState hitGroupSbtSyncState;
+            CUevent launchEvent;
+        };
+
+        // JP: バッチの終了時にまとめて生成するプログラムグループ。
+        //     記述子の文字列とペイロードタイプは生成時にポインターを設定し直すためにコピーとして保持する。
+        // EN: A program group created together at the end of a batch.
+        //     Strings and payload type in the desc are kept as copies to set pointers again on creation.
+        struct PendingProgramGroup {
+            OptixProgramGroupDesc desc;
+            std::string entryFunctionNames[3];
+            PayloadType payloadType;
+            std::variant<
+                _Program*,
+                _HitProgramGroup*,
+                _CallableProgramGroup*
+            > target;
+        };
+
         _Context* context;
         OptixPipeline rawPipeline;
 
         OptixPipelineCompileOptions pipelineCompileOptions;
         size_t sizeOfPipelineLaunchParams;
-        std::unordered_set<OptixProgramGroup> programGroups;
+        // JP: キャッシュにより同じプログラムグループが複数のオブジェクトから共有され得るので参照数を数える。
+        // EN: Count references since the same program group can be shared by multiple objects via the cache.
+        std::unordered_map<OptixProgramGroup, uint32_t> programGroups;
+        std::vector<PendingProgramGroup> pendingProgramGroups;
 
         _Scene* scene;
         uint32_t numMissRayTypes;
@@ -1217,6 +2686,9 @@ namespace optixu {
         void* sbtHostMem;
         BufferView hitGroupSbt;
         void* hitGroupSbtHostMem;
+        HitGroupSBTSyncState hitGroupSbtSyncState;
+        std::vector<SBTRingSlot> sbtRing;
+        uint32_t sbtRingIndex;
         OptixShaderBindingTable sbtParams;
 
         struct {
@@ -1224,6 +2696,7 @@ namespace optixu {
             unsigned int sbtLayoutIsUpToDate : 1;
             unsigned int sbtIsUpToDate : 1;
             unsigned int hitGroupSbtIsUpToDate : 1;
+            unsigned int programGroupBatchIsOpen : 1;
         };
 
         Module createModule(
@@ -1231,11 +2704,14 @@ namespace optixu {
             int32_t maxRegisterCount,
             OptixCompileOptimizationLevel optLevel, OptixCompileDebugLevel debugLevel,
             OptixModuleCompileBoundValueEntry* boundValues, uint32_t numBoundValues,
-            const PayloadType* payloadTypes, uint32_t numPayloadTypes);
+            const PayloadType* payloadTypes, uint32_t numPayloadTypes,
+            bool async);
         OptixModule getModuleForBuiltin(
             OptixPrimitiveType primType, OptixCurveEndcapFlags endcapFlags,
             ASTradeoff tradeoff, bool allowUpdate, bool allowCompaction, bool allowRandomVertexAccess);
 
+        void releaseSBTRing();
+        void acquireSBTRingSlot();
         void setupShaderBindingTable(CUstream stream);
 
     public:
@@ -1246,8 +2722,10 @@ namespace optixu {
             sizeOfPipelineLaunchParams(0),
             scene(nullptr), numMissRayTypes(0), numCallablePrograms(0),
             rayGenProgram(nullptr), exceptionProgram(nullptr),
+            sbtRingIndex(0),
             pipelineLinked(false), sbtLayoutIsUpToDate(false),
-            sbtIsUpToDate(false), hitGroupSbtIsUpToDate(false) {
+            sbtIsUpToDate(false), hitGroupSbtIsUpToDate(false),
+            programGroupBatchIsOpen(false) {
             sbtParams = {};
         }
         ~Priv();
@@ -1264,24 +2742,64 @@ namespace optixu {
 
 
         void markDirty();
-        void createProgram(
+        // JP: バッチ中は生成を保留し、プログラムグループを持たないオブジェクトを返す。
+        // EN: Defer the creation during a batch, returning an object without a program group.
+        template <typename PrivType, typename... ArgTypes>
+        PrivType* createProgram(
             const OptixProgramGroupDesc &desc, const OptixProgramGroupOptions &options,
-            OptixProgramGroup* group);
+            const ArgTypes &... args);
         void destroyProgram(OptixProgramGroup group);
+        void beginProgramGroupBatch();
+        void endProgramGroupBatch();
+        bool usesSBTRing() const {
+            return !sbtRing.empty();
+        }
+        const OptixShaderBindingTable &getSBTParams() const {
+            return sbtParams;
+        }
+        void hashLaunchState(ContentHasher* hasher) const {
+            hasher->add(rawPipeline);
+            hasher->add(pipelineLinked);
+            hasher->add(sbtIsUpToDate);
+            hasher->add(hitGroupSbtIsUpToDate);
+            hasher->add(sbtParams);
+        }
+        void cancelPendingProgramGroup(
+            const std::variant<_Program*, _HitProgramGroup*, _CallableProgramGroup*> &target);
     };
 
 
 
     template <>
     class Object<Module>::Priv : public PrivateObject {
+    public:
+        // JP: タスクによるコンパイル中に参照され得るため、完了まで保持する入力のコピー。
+        // EN: Copies of inputs kept until completion since they may be referenced during compilation by tasks.
+        struct CompileInputs {
+            std::vector<char> data;
+            std::vector<OptixModuleCompileBoundValueEntry> boundValues;
+            std::vector<std::vector<uint8_t>> boundValueData;
+            std::vector<PayloadType> payloadTypes;
+            std::vector<OptixPayloadType> rawPayloadTypes;
+            OptixModuleCompileOptions compileOptions;
+        };
+
+    private:
         const _Pipeline* pipeline;
         OptixModule rawModule;
+        std::shared_ptr<ModuleCompileJob> compileJob;
+        std::unique_ptr<CompileInputs> compileInputs;
 
     public:
         OPTIXU_OPAQUE_BRIDGE(Module);
 
         Priv(const _Pipeline* pl, OptixModule _rawModule) :
             pipeline(pl), rawModule(_rawModule) {}
+        Priv(
+            const _Pipeline* pl, OptixModule _rawModule,
+            const std::shared_ptr<ModuleCompileJob> &_compileJob, std::unique_ptr<CompileInputs> &&_compileInputs) :
+            pipeline(pl), rawModule(_rawModule),
+            compileJob(_compileJob), compileInputs(std::move(_compileInputs)) {}
         ~Priv() {
             getContext()->unregisterName(this);
         }
@@ -1293,7 +2811,14 @@ namespace optixu {
             return pipeline;
         }
 
-        OptixModule getRawModule() const {
+        bool isReady() const {
+            return !compileJob || compileJob->isFinished();
+        }
+        // JP: 非同期のコンパイルの完了を待ち、失敗していれば例外を送出する。
+        // EN: Wait for the completion of the asynchronous compilation, and throw if it failed.
+        void waitForCompilation();
+        OptixModule getRawModule() {
+            waitForCompilation();
             return rawModule;
         }
     };
@@ -1304,23 +2829,16 @@ namespace optixu {
     class Object<Program>::Priv : public PrivateObject {
         _Pipeline* pipeline;
         OptixProgramGroup rawGroup;
+        OptixProgramGroupKind kind;
         uint32_t stackSize;
 
     public:
         OPTIXU_OPAQUE_BRIDGE(Program);
 
-        Priv(_Pipeline* pl, OptixProgramGroup _rawGroup, OptixProgramGroupKind kind) :
-            pipeline(pl), rawGroup(_rawGroup) {
-            OptixStackSizes stackSizes;
-            OPTIX_CHECK(optixProgramGroupGetStackSize(rawGroup, &stackSizes, pipeline->getRawPipeline()));
-            if (kind == OPTIX_PROGRAM_GROUP_KIND_RAYGEN)
-                stackSize = stackSizes.cssRG;
-            else if (kind == OPTIX_PROGRAM_GROUP_KIND_MISS)
-                stackSize = stackSizes.cssMS;
-            else if (kind == OPTIX_PROGRAM_GROUP_KIND_EXCEPTION)
-                stackSize = 0;
-            else
-                optixuAssert_ShouldNotBeCalled();
+        Priv(_Pipeline* pl, OptixProgramGroup _rawGroup, OptixProgramGroupKind _kind) :
+            pipeline(pl), rawGroup(nullptr), kind(_kind), stackSize(0) {
+            if (_rawGroup)
+                setRawProgramGroup(_rawGroup);
         }
         ~Priv() {
             getContext()->unregisterName(this);
@@ -1329,15 +2847,38 @@ namespace optixu {
         _Context* getContext() const override {
             return pipeline->getContext();
         }
+        OPTIXU_DEFINE_THROW_RUNTIME_ERROR("Program");
         const _Pipeline* getPipeline() const {
             return pipeline;
         }
 
+        // JP: nullptrはバッチの失敗時に生成待ちの状態へ戻すために使う。
+        // EN: nullptr is used to revert to the pending state on a batch failure.
+        void setRawProgramGroup(OptixProgramGroup _rawGroup) {
+            rawGroup = _rawGroup;
+            stackSize = 0;
+            if (!rawGroup)
+                return;
+            OptixStackSizes stackSizes;
+            OPTIX_CHECK(optixProgramGroupGetStackSize(rawGroup, &stackSizes, pipeline->getRawPipeline()));
+            if (kind == OPTIX_PROGRAM_GROUP_KIND_RAYGEN)
+                stackSize = stackSizes.cssRG;
+            else if (kind == OPTIX_PROGRAM_GROUP_KIND_MISS)
+                stackSize = stackSizes.cssMS;
+            else if (kind == OPTIX_PROGRAM_GROUP_KIND_EXCEPTION)
+                stackSize = 0;
+            else
+                optixuAssert_ShouldNotBeCalled();
+        }
         OptixProgramGroup getRawProgramGroup() const {
             return rawGroup;
         }
+        bool isPending() const {
+            return rawGroup == nullptr;
+        }
 
         void packHeader(uint8_t* record) const {
+            throwRuntimeError(rawGroup, "Program group is still pending in a batch.");
             OPTIX_CHECK(optixSbtRecordPackHeader(rawGroup, record));
         }
     };
@@ -1356,12 +2897,10 @@ namespace optixu {
         OPTIXU_OPAQUE_BRIDGE(HitProgramGroup);
 
         Priv(_Pipeline* pl, OptixProgramGroup _rawGroup) :
-            pipeline(pl), rawGroup(_rawGroup) {
-            OptixStackSizes stackSizes;
-            OPTIX_CHECK(optixProgramGroupGetStackSize(rawGroup, &stackSizes, pipeline->getRawPipeline()));
-            stackSizeCH = stackSizes.cssCH;
-            stackSizeAH = stackSizes.cssAH;
-            stackSizeIS = stackSizes.cssIS;
+            pipeline(pl), rawGroup(nullptr),
+            stackSizeCH(0), stackSizeAH(0), stackSizeIS(0) {
+            if (_rawGroup)
+                setRawProgramGroup(_rawGroup);
         }
         ~Priv() {
             getContext()->unregisterName(this);
@@ -1370,15 +2909,33 @@ namespace optixu {
         _Context* getContext() const override {
             return pipeline->getContext();
         }
+        OPTIXU_DEFINE_THROW_RUNTIME_ERROR("HitGroup");
         const _Pipeline* getPipeline() const {
             return pipeline;
         }
 
+        void setRawProgramGroup(OptixProgramGroup _rawGroup) {
+            rawGroup = _rawGroup;
+            stackSizeCH = 0;
+            stackSizeAH = 0;
+            stackSizeIS = 0;
+            if (!rawGroup)
+                return;
+            OptixStackSizes stackSizes;
+            OPTIX_CHECK(optixProgramGroupGetStackSize(rawGroup, &stackSizes, pipeline->getRawPipeline()));
+            stackSizeCH = stackSizes.cssCH;
+            stackSizeAH = stackSizes.cssAH;
+            stackSizeIS = stackSizes.cssIS;
+        }
         OptixProgramGroup getRawProgramGroup() const {
             return rawGroup;
         }
+        bool isPending() const {
+            return rawGroup == nullptr;
+        }
 
         void packHeader(uint8_t* record) const {
+            throwRuntimeError(rawGroup, "Program group is still pending in a batch.");
             OPTIX_CHECK(optixSbtRecordPackHeader(rawGroup, record));
         }
     };
@@ -1396,11 +2953,10 @@ namespace optixu {
         OPTIXU_OPAQUE_BRIDGE(CallableProgramGroup);
 
         Priv(_Pipeline* pl, OptixProgramGroup _rawGroup) :
-            pipeline(pl), rawGroup(_rawGroup) {
-            OptixStackSizes stackSizes;
-            OPTIX_CHECK(optixProgramGroupGetStackSize(rawGroup, &stackSizes, pipeline->getRawPipeline()));
-            stackSizeDC = stackSizes.dssDC;
-            stackSizeCC = stackSizes.cssCC;
+            pipeline(pl), rawGroup(nullptr),
+            stackSizeDC(0), stackSizeCC(0) {
+            if (_rawGroup)
+                setRawProgramGroup(_rawGroup);
         }
         ~Priv() {
             getContext()->unregisterName(this);
@@ -1409,15 +2965,31 @@ namespace optixu {
         _Context* getContext() const override {
             return pipeline->getContext();
         }
+        OPTIXU_DEFINE_THROW_RUNTIME_ERROR("CallableGroup");
         const _Pipeline* getPipeline() const {
             return pipeline;
         }
 
+        void setRawProgramGroup(OptixProgramGroup _rawGroup) {
+            rawGroup = _rawGroup;
+            stackSizeDC = 0;
+            stackSizeCC = 0;
+            if (!rawGroup)
+                return;
+            OptixStackSizes stackSizes;
+            OPTIX_CHECK(optixProgramGroupGetStackSize(rawGroup, &stackSizes, pipeline->getRawPipeline()));
+            stackSizeDC = stackSizes.dssDC;
+            stackSizeCC = stackSizes.cssCC;
+        }
         OptixProgramGroup getRawProgramGroup() const {
             return rawGroup;
         }
+        bool isPending() const {
+            return rawGroup == nullptr;
+        }
 
         void packHeader(uint8_t* record) const {
+            throwRuntimeError(rawGroup, "Program group is still pending in a batch.");
             OPTIX_CHECK(optixSbtRecordPackHeader(rawGroup, record));
         }
     };
@@ -1527,4 +3099,36 @@ namespace optixu {
         }
         OPTIXU_DEFINE_THROW_RUNTIME_ERROR("Denoiser");
     };
+
+
+
+    class LaunchGraph::Priv {
+        std::vector<_Pipeline*> pipelines;
+        std::vector<_GeometryAccelerationStructure*> gases;
+        std::vector<_InstanceAccelerationStructure*> iases;
+        // JP: グラフがステージングメモリ全体をコピーするIAS。
+        // EN: IASs whose whole staging memory the graph copies.
+        std::vector<_InstanceAccelerationStructure*> stagingIASes;
+        CUgraph graph;
+        CUgraphExec graphExec;
+        uint64_t capturedStateHash;
+        uint32_t numInstantiations;
+
+        void releaseGraph();
+
+    public:
+        OPTIXU_OPAQUE_BRIDGE(LaunchGraph);
+
+        Priv() :
+            graph(nullptr), graphExec(nullptr),
+            capturedStateHash(0), numInstantiations(0) {}
+        ~Priv() {
+            releaseGraph();
+        }
+
+        // JP: グラフに焼き込まれる状態(パイプライン、SBT、ASのハンドル)のハッシュ。
+        // EN: Hash of the states baked into the graph (pipelines, SBTs and AS handles).
+        uint64_t computeStateHash() const;
+        void launch(CUstream stream, const std::function<void(CUstream)> &recordFunc);
+    };
 }
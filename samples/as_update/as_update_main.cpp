@@ -423,6 +423,15 @@ int32_t main(int32_t argc, const char* argv[]) try {
         std::max(maxSizeOfScratchBuffer,
                  std::max(asMemReqs.tempSizeInBytes, asMemReqs.tempUpdateSizeInBytes));
 
+    // JP: アップデートを続けるとASの品質が低下するため、ポリシーに従ってときどきリビルドする。
+    //     境界の表面積が1.5倍を超えて増えた場合か、60回アップデートした場合にリビルドする。
+    // EN: AS quality degrades as updates continue, so occasionally rebuild according to a policy.
+    //     Rebuild when the surface area of the bounds grows by more than 1.5x or after 60 updates.
+    optixu::AccelerationStructureUpdatePolicy iasUpdatePolicy =
+        optixu::AccelerationStructureUpdatePolicy::create();
+    iasUpdatePolicy.setThresholds(1.5f, 0.25f, 60);
+    ias.setUpdatePolicy(iasUpdatePolicy);
+
 
 
     // JP: ASビルド用のスクラッチメモリを確保する。
@@ -600,19 +609,16 @@ int32_t main(int32_t argc, const char* argv[]) try {
 
         /*
         JP: IASのアップデートを行う。
-            品質を維持するためにたまにはリビルドする。
+            品質を維持するためにポリシーが必要と判断した場合はリビルドする。
             アップデートの代用としてのリビルドでは、インスタンスの追加・削除や
             ASビルド設定の変更を行っていないのでmarkDirty()やprepareForBuild()は必要無い。
         EN: Update the IAS.
-            Sometimes perform rebuild to maintain AS quality.
+            Perform rebuild when the policy decides it is necessary to maintain AS quality.
             Rebuild as the alternative for update doesn't involves
             add/remove of instances and changes of AS build settings
             so neither of markDirty() nor prepareForBuild() is required.
         */
-        if (frameIndex % 10 == 0)
-            plp.travHandle = ias.rebuild(curStream, instanceBuffer, iasMem, asBuildScratchMem);
-        else
-            ias.update(curStream, asBuildScratchMem);
+        plp.travHandle = ias.buildOrUpdate(curStream, asBuildScratchMem);
 
         // Render
         outputBufferSurfaceHolder.beginCUDAAccess(curStream);
@@ -687,6 +693,7 @@ int32_t main(int32_t argc, const char* argv[]) try {
     instanceBuffer.finalize();
     iasMem.finalize();
     ias.destroy();
+    iasUpdatePolicy.destroy();
 
     for (int i = bunnies.size() - 1; i >= 0; --i)
         bunnies[i].inst.destroy();
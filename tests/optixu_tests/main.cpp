@@ -30,6 +30,8 @@
 #include <cstdio>
 #include <cstdint>
 #include <cstdlib>
+#include <chrono>
+#include <atomic>
 #include <fstream>
 #include <filesystem>
 
@@ -995,6 +997,3081 @@ TEST(GeometryInstanceTest, GeometryInstanceBasic) {
 
 
 
+TEST(SceneTest, SceneIncrementalHitGroupSBT) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        uint32_t value = 0;
+
+        optixu::Material mat0 = context.createMaterial();
+        mat0.setUserData(value);
+        optixu::Material mat1 = context.createMaterial();
+        mat1.setUserData(value);
+
+        optixu::GeometryInstance geomInst0 = scene.createGeometryInstance();
+        geomInst0.setMaterial(0, 0, mat0);
+        geomInst0.setUserData(value);
+        optixu::GeometryInstance geomInst1 = scene.createGeometryInstance();
+        geomInst1.setMaterial(0, 0, mat1);
+        geomInst1.setUserData(value);
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        gas.setNumMaterialSets(1);
+        gas.setNumRayTypes(0, 2);
+        gas.addChild(geomInst0);
+        gas.addChild(geomInst1);
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+
+        optixu::_Scene* _scene = optixu::extract(scene);
+        optixu::HitGroupSBTSyncState syncState;
+        syncState.epoch = _scene->getSBTEpoch();
+        syncState.numSyncedEdits = _scene->getNumSBTRecordEdits();
+        syncState.valid = true;
+
+        std::vector<optixu::_Scene::SBTRecordEdit> edits;
+        std::vector<optixu::SBTRecordRange> ranges;
+
+        // JP: 変更が無い場合は転送範囲も無い。
+        EXPECT_EQ(_scene->collectSBTRecordEdits(syncState, &edits, &ranges), true);
+        EXPECT_EQ(ranges.size(), 0);
+
+        // JP: サイズの変わらないユーザーデータの変更は該当するGeometryInstanceのレコードのみに影響する。
+        value = 1;
+        geomInst1.setUserData(value);
+        EXPECT_EQ(scene.shaderBindingTableLayoutIsReady(), true);
+        EXPECT_EQ(_scene->collectSBTRecordEdits(syncState, &edits, &ranges), true);
+        EXPECT_EQ(ranges.size(), 1);
+        EXPECT_EQ(ranges[0].offset, 2);
+        EXPECT_EQ(ranges[0].count, 2);
+
+        // JP: 隣接する範囲はひとつにまとめられる。
+        mat0.setUserData(value);
+        EXPECT_EQ(_scene->collectSBTRecordEdits(syncState, &edits, &ranges), true);
+        EXPECT_EQ(ranges.size(), 1);
+        EXPECT_EQ(ranges[0].offset, 0);
+        EXPECT_EQ(ranges[0].count, 4);
+
+        // JP: レイアウトが再生成された場合は全体のセットアップが必要。
+        uint64_t largeValue = 1;
+        geomInst1.setUserData(largeValue);
+        EXPECT_EQ(scene.shaderBindingTableLayoutIsReady(), false);
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        EXPECT_EQ(_scene->collectSBTRecordEdits(syncState, &edits, &ranges), false);
+
+        gas.destroy();
+        geomInst1.destroy();
+        geomInst0.destroy();
+        mat1.destroy();
+        mat0.destroy();
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, SceneReadinessCounters) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+        optixu::_Scene* _scene = optixu::extract(scene);
+
+        bool hasMotionAS;
+        bool hasMotionASByWalk;
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        optixu::InstanceAccelerationStructure ias = scene.createInstanceAccelerationStructure();
+        optixu::Transform xfm = scene.createTransform();
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+
+        // JP: 未ビルドのトラバーサブルがある間はレディではない。
+        EXPECT_EQ(_scene->isReady(&hasMotionAS), false);
+        EXPECT_EQ(_scene->isReadyByFullWalk(&hasMotionASByWalk), false);
+        EXPECT_EQ(hasMotionAS, false);
+        EXPECT_EQ(hasMotionASByWalk, false);
+
+        // JP: モーションASの数はモーション設定の変化に追従する。
+        gas.setMotionOptions(3, 0.0f, 1.0f, OPTIX_MOTION_FLAG_NONE);
+        ias.setMotionOptions(2, 0.0f, 1.0f, OPTIX_MOTION_FLAG_NONE);
+        _scene->isReady(&hasMotionAS);
+        _scene->isReadyByFullWalk(&hasMotionASByWalk);
+        EXPECT_EQ(hasMotionAS, true);
+        EXPECT_EQ(hasMotionASByWalk, true);
+
+        gas.setMotionOptions(1, 0.0f, 0.0f, OPTIX_MOTION_FLAG_NONE);
+        _scene->isReady(&hasMotionAS);
+        EXPECT_EQ(hasMotionAS, true);
+
+        // JP: 破棄されたオブジェクトはカウンターから取り除かれる。
+        ias.destroy();
+        _scene->isReady(&hasMotionAS);
+        _scene->isReadyByFullWalk(&hasMotionASByWalk);
+        EXPECT_EQ(hasMotionAS, false);
+        EXPECT_EQ(hasMotionASByWalk, false);
+
+        gas.destroy();
+        xfm.destroy();
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        EXPECT_EQ(_scene->isReady(&hasMotionAS), true);
+        EXPECT_EQ(_scene->isReadyByFullWalk(&hasMotionASByWalk), true);
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, SceneGASSlotReuse) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+        optixu::_Scene* _scene = optixu::extract(scene);
+
+        optixu::GeometryAccelerationStructure gas0 = scene.createGeometryAccelerationStructure();
+        gas0.setNumRayTypes(0, 1);
+        optixu::GeometryAccelerationStructure gas1 = scene.createGeometryAccelerationStructure();
+        gas1.setNumMaterialSets(2);
+        gas1.setNumRayTypes(0, 1);
+        gas1.setNumRayTypes(1, 1);
+        uint32_t serialID0 = optixu::extract(gas0)->getSerialID();
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        EXPECT_EQ(_scene->hasSBTOffset(serialID0, 0), true);
+
+        // JP: 破棄されたGASのシリアルIDは古いレイアウトを参照せず、次に作られるGASで再利用される。
+        gas0.destroy();
+        EXPECT_EQ(_scene->hasSBTOffset(serialID0, 0), false);
+        optixu::GeometryAccelerationStructure gas2 = scene.createGeometryAccelerationStructure();
+        gas2.setNumRayTypes(0, 1);
+        EXPECT_EQ(optixu::extract(gas2)->getSerialID(), serialID0);
+        EXPECT_EQ(_scene->hasSBTOffset(serialID0, 0), false);
+
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        EXPECT_EQ(_scene->hasSBTOffset(serialID0, 0), true);
+        EXPECT_EQ(_scene->hasSBTOffset(serialID0, 1), false);
+        // JP: 子を持たないGASはレコードを持たない。
+        EXPECT_EQ(_scene->getSBTOffset(optixu::extract(gas2), 0), 0);
+        EXPECT_EQ(_scene->getSBTOffset(optixu::extract(gas1), 1), 0);
+
+        gas2.destroy();
+        gas1.destroy();
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, SceneIndirectMaterialUserData) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+        optixu::_Scene* _scene = optixu::extract(scene);
+
+        struct LargeData {
+            float values[32];
+        };
+        LargeData largeData = {};
+        for (uint32_t i = 0; i < 32; ++i)
+            largeData.values[i] = static_cast<float>(i);
+        uint32_t smallData = 0x12345678;
+
+        optixu::Material mat0 = context.createMaterial();
+        mat0.setUserData(largeData);
+        optixu::Material mat1 = context.createMaterial();
+        mat1.setUserData(smallData);
+
+        optixu::GeometryInstance geomInst0 = scene.createGeometryInstance();
+        geomInst0.setMaterial(0, 0, mat0);
+        optixu::GeometryInstance geomInst1 = scene.createGeometryInstance();
+        geomInst1.setMaterial(0, 0, mat1);
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        gas.setNumRayTypes(0, 1);
+        gas.addChild(geomInst0);
+        gas.addChild(geomInst1);
+
+        // JP: 通常モードでは大きなマテリアルのデータがストライドを決める。
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        EXPECT_EQ(_scene->getSingleRecordSize(), OPTIX_SBT_RECORD_HEADER_SIZE + sizeof(LargeData));
+
+        optixu::IndirectMaterialUserData indirect = optixu::IndirectMaterialUserData::Yes;
+        scene.getConfiguration(&indirect);
+        EXPECT_EQ(indirect, false);
+
+        // JP: 間接参照モードではレコードにはアドレスのみが置かれる。
+        scene.setConfiguration(optixu::IndirectMaterialUserData::Yes);
+        EXPECT_EQ(scene.shaderBindingTableLayoutIsReady(), false);
+        scene.getConfiguration(&indirect);
+        EXPECT_EQ(indirect, true);
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        EXPECT_EQ(_scene->getSingleRecordSize(), OPTIX_SBT_RECORD_HEADER_SIZE + OPTIX_SBT_RECORD_ALIGNMENT);
+        EXPECT_EQ(scene.getMaterialUserDataBufferSize(), sizeof(LargeData) + sizeof(smallData));
+
+        // JP: バッファー未設定ではセットアップできない。
+        EXPECT_EXCEPTION(_scene->setupMaterialUserData(0));
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        const auto matchesDeviceData = [stream](CUdeviceptr address, const void* data, size_t size) {
+            CUDADRV_CHECK(cuStreamSynchronize(stream));
+            std::vector<uint8_t> dataOnDevice(size);
+            CUDADRV_CHECK(cuMemcpyDtoH(dataOnDevice.data(), address, size));
+            return std::memcmp(dataOnDevice.data(), data, size) == 0;
+        };
+
+        CUdeviceptr deviceMem;
+        CUDADRV_CHECK(cuMemAlloc(&deviceMem, scene.getMaterialUserDataBufferSize()));
+        std::vector<uint8_t> hostMem(scene.getMaterialUserDataBufferSize());
+        optixu::BufferView matUserDataBuffer(deviceMem, hostMem.size(), 1);
+        scene.setMaterialUserDataBuffer(matUserDataBuffer, hostMem.data());
+        _scene->setupMaterialUserData(stream);
+
+        CUdeviceptr address0 = _scene->getMaterialUserDataAddress(optixu::extract(mat0));
+        CUdeviceptr address1 = _scene->getMaterialUserDataAddress(optixu::extract(mat1));
+        EXPECT_EQ(matchesDeviceData(address0, &largeData, sizeof(largeData)), true);
+        EXPECT_EQ(matchesDeviceData(address1, &smallData, sizeof(smallData)), true);
+
+        // JP: マテリアルのデータの変更は次のセットアップで転送される。
+        smallData = 0xDEADBEEF;
+        mat1.setUserData(smallData);
+        _scene->setupMaterialUserData(stream);
+        EXPECT_EQ(matchesDeviceData(address1, &smallData, sizeof(smallData)), true);
+
+        // JP: サイズの変更はレイアウトを無効化し、再生成するまでセットアップできない。
+        mat1.setUserData(largeData);
+        EXPECT_EQ(scene.shaderBindingTableLayoutIsReady(), false);
+        EXPECT_EXCEPTION(_scene->setupMaterialUserData(stream));
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        EXPECT_EQ(scene.getMaterialUserDataBufferSize(), 2 * sizeof(LargeData));
+        CUDADRV_CHECK(cuMemFree(deviceMem));
+        CUDADRV_CHECK(cuMemAlloc(&deviceMem, scene.getMaterialUserDataBufferSize()));
+        hostMem.resize(scene.getMaterialUserDataBufferSize());
+        matUserDataBuffer = optixu::BufferView(deviceMem, hostMem.size(), 1);
+        scene.setMaterialUserDataBuffer(matUserDataBuffer, hostMem.data());
+        _scene->setupMaterialUserData(stream);
+        address1 = _scene->getMaterialUserDataAddress(optixu::extract(mat1));
+        EXPECT_EQ(matchesDeviceData(address1, &largeData, sizeof(largeData)), true);
+
+        // JP: 破棄したマテリアルはシーンの配置から取り除かれ、レイアウトが無効化される。
+        geomInst1.setMaterial(0, 0, mat0);
+        mat1.destroy();
+        EXPECT_EQ(scene.shaderBindingTableLayoutIsReady(), false);
+        EXPECT_EXCEPTION(_scene->setupMaterialUserData(stream));
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        EXPECT_EQ(scene.getMaterialUserDataBufferSize(), sizeof(LargeData));
+        _scene->setupMaterialUserData(stream);
+        address0 = _scene->getMaterialUserDataAddress(optixu::extract(mat0));
+        EXPECT_EQ(matchesDeviceData(address0, &largeData, sizeof(largeData)), true);
+
+        gas.destroy();
+        geomInst1.destroy();
+        geomInst0.destroy();
+        mat0.destroy();
+
+        scene.destroy();
+
+        CUDADRV_CHECK(cuMemFree(deviceMem));
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, SceneSBTLayoutStats) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        struct LargeData {
+            float values[16];
+        };
+        LargeData largeData = {};
+        uint32_t smallData = 0;
+
+        optixu::Material mat0 = context.createMaterial();
+        mat0.setUserData(largeData);
+        optixu::Material mat1 = context.createMaterial();
+        mat1.setUserData(smallData);
+
+        optixu::GeometryInstance geomInst0 = scene.createGeometryInstance();
+        geomInst0.setMaterial(0, 0, mat0);
+        optixu::GeometryInstance geomInst1 = scene.createGeometryInstance();
+        geomInst1.setMaterial(0, 0, mat1);
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        gas.setNumRayTypes(0, 2);
+        gas.addChild(geomInst0);
+        gas.addChild(geomInst1);
+
+        optixu::ShaderBindingTableLayoutStats stats;
+        // JP: レイアウト生成前には統計情報は取得できない。
+        EXPECT_EXCEPTION(scene.getShaderBindingTableLayoutStats(&stats));
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        scene.getShaderBindingTableLayoutStats(&stats);
+
+        const uint32_t largeRecordSize = OPTIX_SBT_RECORD_HEADER_SIZE + sizeof(LargeData);
+        const uint32_t smallRecordSize = OPTIX_SBT_RECORD_HEADER_SIZE + sizeof(smallData);
+        EXPECT_EQ(stats.numRecords, 4);
+        EXPECT_EQ(stats.recordStride, largeRecordSize);
+        EXPECT_EQ(stats.materialSetEntries.size(), 1);
+        EXPECT_EQ(stats.materialSetEntries[0].gas, gas);
+        EXPECT_EQ(stats.materialSetEntries[0].materialSetIndex, 0);
+        EXPECT_EQ(stats.materialSetEntries[0].numRecords, 4);
+
+        // JP: 最大のレコードはgeomInst0とmat0から構成される。
+        EXPECT_EQ(stats.maxRecordSize, largeRecordSize);
+        EXPECT_EQ(stats.maxRecordGAS, gas);
+        EXPECT_EQ(stats.maxRecordMaterialSetIndex, 0);
+        EXPECT_EQ(stats.maxRecordGeometryInstance, geomInst0);
+        EXPECT_EQ(stats.maxRecordMaterial, mat0);
+
+        // JP: 小さなレコード(2レイタイプ分)がパディングを生む。
+        EXPECT_EQ(stats.totalPaddingBytes, 2 * (largeRecordSize - smallRecordSize));
+        EXPECT_EQ(stats.materialSetEntries[0].paddingBytes, stats.totalPaddingBytes);
+
+        gas.destroy();
+        geomInst1.destroy();
+        geomInst0.destroy();
+        mat1.destroy();
+        mat0.destroy();
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+// JP: ASのメモリをcuMemAllocで確保し、生存中の確保数を数えるアロケーター。
+class CountingASMemoryAllocator : public optixu::AccelerationStructureMemoryAllocator {
+public:
+    uint32_t numLiveAllocations = 0;
+
+    optixu::BufferView allocate(size_t size, size_t alignment) override {
+        CUdeviceptr ptr;
+        CUDADRV_CHECK(cuMemAlloc(&ptr, size));
+        EXPECT_EQ(ptr % alignment, 0);
+        ++numLiveAllocations;
+        return optixu::BufferView(ptr, size, 1);
+    }
+    void release(const optixu::BufferView &buffer) override {
+        CUDADRV_CHECK(cuMemFree(buffer.getCUdeviceptr()));
+        --numLiveAllocations;
+    }
+};
+
+TEST(SceneTest, SceneBuildDirty) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+        optixu::_Scene* _scene = optixu::extract(scene);
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        CountingASMemoryAllocator allocator;
+
+        optixu::GeometryAccelerationStructure gas0 = scene.createGeometryAccelerationStructure();
+        optixu::GeometryAccelerationStructure gas1 = scene.createGeometryAccelerationStructure();
+
+        optixu::Transform xfm = scene.createTransform();
+        size_t xfmSize;
+        xfm.setConfiguration(optixu::TransformType::Static, 0, &xfmSize);
+        xfm.setChild(gas1);
+
+        optixu::Instance inst0 = scene.createInstance();
+        inst0.setChild(gas0);
+        optixu::Instance inst1 = scene.createInstance();
+        inst1.setChild(xfm);
+
+        // JP: IASを子に持つIASも下から順にビルドされる。
+        optixu::InstanceAccelerationStructure lowerIas = scene.createInstanceAccelerationStructure();
+        lowerIas.setConfiguration(
+            optixu::ASTradeoff::Default,
+            optixu::AllowUpdate::No,
+            optixu::AllowCompaction::Yes);
+        lowerIas.addChild(inst0);
+        lowerIas.addChild(inst1);
+
+        optixu::Instance inst2 = scene.createInstance();
+        inst2.setChild(lowerIas);
+        optixu::InstanceAccelerationStructure upperIas = scene.createInstanceAccelerationStructure();
+        upperIas.addChild(inst2);
+
+        bool hasMotionAS;
+        EXPECT_EQ(scene.shaderBindingTableLayoutIsReady(), false);
+        EXPECT_EXCEPTION(scene.buildDirty(stream, &allocator));
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        scene.buildDirty(stream, &allocator);
+        EXPECT_EQ(_scene->isReady(&hasMotionAS), true);
+        // JP: スクラッチとサイズの読み戻し用のバッファーは返却され、
+        //     コンパクションされたIASはコンパクション前のバッファーを保持しない。
+        uint32_t numAllocationsAfterBuild = allocator.numLiveAllocations;
+        EXPECT_EQ(numAllocationsAfterBuild, 1 + 2 + 2);
+
+        // JP: 準備完了のASは再ビルドされない。
+        scene.buildDirty(stream, &allocator);
+        EXPECT_EQ(allocator.numLiveAllocations, numAllocationsAfterBuild);
+
+        // JP: dirty状態のASのみが再ビルドされ、バッファーは再利用される。
+        upperIas.markDirty();
+        EXPECT_EQ(_scene->isReady(&hasMotionAS), false);
+        scene.buildDirty(stream, &allocator);
+        EXPECT_EQ(_scene->isReady(&hasMotionAS), true);
+        EXPECT_EQ(allocator.numLiveAllocations, numAllocationsAfterBuild);
+
+        // JP: ASが破棄されるとバッファーはアロケーターに返却される。
+        upperIas.destroy();
+        inst2.destroy();
+        lowerIas.destroy();
+        inst1.destroy();
+        inst0.destroy();
+        xfm.destroy();
+        gas1.destroy();
+        gas0.destroy();
+        EXPECT_EQ(allocator.numLiveAllocations, 0);
+
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, SceneAsyncCompaction) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        optixu::Instance inst = scene.createInstance();
+        inst.setChild(gas);
+
+        optixu::InstanceAccelerationStructure ias = scene.createInstanceAccelerationStructure();
+        ias.setConfiguration(
+            optixu::ASTradeoff::Default,
+            optixu::AllowUpdate::No,
+            optixu::AllowCompaction::Yes);
+        ias.addChild(inst);
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+
+        OptixAccelBufferSizes memReq;
+        gas.prepareForBuild(&memReq);
+        gas.rebuild(stream, optixu::BufferView(), optixu::BufferView());
+
+        ias.prepareForBuild(&memReq);
+        CUdeviceptr instanceMem;
+        CUdeviceptr accelMem;
+        CUdeviceptr scratchMem;
+        CUDADRV_CHECK(cuMemAlloc(&instanceMem, sizeof(OptixInstance)));
+        CUDADRV_CHECK(cuMemAlloc(&accelMem, memReq.outputSizeInBytes));
+        CUDADRV_CHECK(cuMemAlloc(&scratchMem, memReq.tempSizeInBytes));
+        ias.rebuild(
+            stream,
+            optixu::BufferView(instanceMem, 1, sizeof(OptixInstance)),
+            optixu::BufferView(accelMem, memReq.outputSizeInBytes, 1),
+            optixu::BufferView(scratchMem, memReq.tempSizeInBytes, 1));
+
+        // JP: 読み戻しを要求する前にサイズを問い合わせることはできない。
+        size_t compactedSize;
+        EXPECT_EXCEPTION(ias.compactedSizeIsReady(&compactedSize));
+
+        // JP: ホスト側で待たずにサイズが届くのをポーリングする。
+        ias.prepareForCompactAsync(stream);
+        while (!ias.compactedSizeIsReady(&compactedSize));
+        EXPECT_GT(compactedSize, 0);
+        // JP: 既知のサイズは同期版の呼び出しでも再利用される。
+        size_t compactedSizeSync;
+        ias.prepareForCompact(&compactedSizeSync);
+        EXPECT_EQ(compactedSizeSync, compactedSize);
+
+        CUdeviceptr compactedAccelMem;
+        CUDADRV_CHECK(cuMemAlloc(&compactedAccelMem, compactedSize));
+        ias.compact(stream, optixu::BufferView(compactedAccelMem, compactedSize, 1));
+        // JP: デバイス上でコンパクションが完了した後にコンパクション前のバッファーを解放できる。
+        while (!ias.tryRemoveUncompacted());
+        CUDADRV_CHECK(cuMemFree(accelMem));
+
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        CUDADRV_CHECK(cuMemFree(compactedAccelMem));
+        CUDADRV_CHECK(cuMemFree(scratchMem));
+        CUDADRV_CHECK(cuMemFree(instanceMem));
+
+        ias.destroy();
+        inst.destroy();
+        gas.destroy();
+
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+// JP: デバイスに触れずにアドレス範囲だけを払い出す偽のヒープ。
+//     ブロックの先頭はわざとOptiXのアラインメントからずらしてある。
+class FakeDeviceHeap : public optixu::MemoryArenaCore::Heap {
+    CUdeviceptr nextAddress = 0x10000040;
+
+public:
+    std::map<CUdeviceptr, size_t> liveBlocks;
+
+    CUdeviceptr allocate(size_t size) override {
+        CUdeviceptr ptr = nextAddress;
+        nextAddress += (size + 0xFFFF) & ~static_cast<size_t>(0xFFFF);
+        liveBlocks[ptr] = size;
+        return ptr;
+    }
+    void release(CUdeviceptr ptr) override {
+        EXPECT_EQ(liveBlocks.count(ptr), 1);
+        liveBlocks.erase(ptr);
+    }
+};
+
+TEST(AccelerationStructureMemoryArenaTest, ArenaSuballocation) {
+    try {
+        FakeDeviceHeap heap;
+        constexpr size_t blockSize = 4096;
+        optixu::AccelerationStructureMemoryArenaStats stats;
+        {
+            optixu::MemoryArenaCore arena(&heap, blockSize);
+
+            // JP: 要求されたアラインメントを満たし、サイズはアラインメントの倍数に切り上げられる。
+            CUdeviceptr a = arena.allocate(100, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+            CUdeviceptr b = arena.allocate(200, OPTIX_INSTANCE_BYTE_ALIGNMENT);
+            CUdeviceptr c = arena.allocate(300, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+            EXPECT_EQ(a % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT, 0);
+            EXPECT_EQ(b % OPTIX_INSTANCE_BYTE_ALIGNMENT, 0);
+            EXPECT_EQ(c % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT, 0);
+            EXPECT_EQ(b, a + 128);
+            EXPECT_EQ(c, b + 256);
+            EXPECT_EQ(heap.liveBlocks.size(), 1);
+
+            arena.getStats(&stats);
+            EXPECT_EQ(stats.numBlocks, 1);
+            EXPECT_EQ(stats.numAllocations, 3);
+            EXPECT_EQ(stats.reservedSize, blockSize);
+            EXPECT_EQ(stats.usedSize, 128 + 208 + 384);
+
+            // JP: 間に空いた穴は断片化として報告される。
+            arena.release(b);
+            arena.getStats(&stats);
+            EXPECT_EQ(stats.numFreeRanges, 3);
+            EXPECT_GT(stats.fragmentation, 0.0f);
+
+            // JP: 穴は収まる要求に再利用される。
+            CUdeviceptr d = arena.allocate(256, OPTIX_INSTANCE_BYTE_ALIGNMENT);
+            EXPECT_EQ(d, b);
+            arena.release(d);
+
+            // JP: 隣接する空き範囲は結合される。
+            arena.release(a);
+            arena.release(c);
+            arena.getStats(&stats);
+            EXPECT_EQ(stats.numAllocations, 0);
+            EXPECT_EQ(stats.numFreeRanges, 1);
+            EXPECT_EQ(stats.usedSize, 0);
+            EXPECT_EQ(stats.fragmentation, 0.0f);
+
+            // JP: ブロックより大きな要求は専用のブロックに置かれ、空になると即座に解放される。
+            CUdeviceptr big = arena.allocate(3 * blockSize, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+            EXPECT_EQ(big % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT, 0);
+            EXPECT_EQ(heap.liveBlocks.size(), 2);
+            arena.release(big);
+            EXPECT_EQ(heap.liveBlocks.size(), 1);
+
+            // JP: 確保していないアドレスの解放はエラー。
+            EXPECT_EXCEPTION(arena.release(0x1234));
+
+            // JP: 通常のブロックはtrim()で解放される。
+            arena.trim();
+            EXPECT_EQ(heap.liveBlocks.size(), 0);
+
+            arena.allocate(16, OPTIX_INSTANCE_BYTE_ALIGNMENT);
+            arena.allocate(blockSize, OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT);
+            EXPECT_EQ(heap.liveBlocks.size(), 2);
+        }
+        // JP: 破棄時に全てのブロックが解放される。
+        EXPECT_EQ(heap.liveBlocks.size(), 0);
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, SceneDefragmentAccelerationStructures) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+        optixu::_Scene* _scene = optixu::extract(scene);
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        optixu::AccelerationStructureMemoryArena arena =
+            optixu::AccelerationStructureMemoryArena::create(1024 * 1024);
+
+        CUdeviceptr vertexMem;
+        CUDADRV_CHECK(cuMemAlloc(&vertexMem, 3 * sizeof(float) * 3));
+        optixu::Material mat = context.createMaterial();
+        optixu::GeometryInstance geomInst = scene.createGeometryInstance();
+        geomInst.setVertexBuffer(optixu::BufferView(vertexMem, 3, sizeof(float) * 3));
+        geomInst.setMaterial(0, 0, mat);
+
+        constexpr uint32_t numGASes = 4;
+        optixu::GeometryAccelerationStructure gases[numGASes];
+        for (uint32_t i = 0; i < numGASes; ++i) {
+            gases[i] = scene.createGeometryAccelerationStructure();
+            gases[i].addChild(geomInst);
+        }
+
+        optixu::Instance inst = scene.createInstance();
+        inst.setChild(gases[numGASes - 1]);
+        optixu::InstanceAccelerationStructure ias = scene.createInstanceAccelerationStructure();
+        ias.addChild(inst);
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        scene.buildDirty(stream, &arena);
+
+        bool hasMotionAS;
+        EXPECT_EQ(_scene->isReady(&hasMotionAS), true);
+        CUdeviceptr addresses[numGASes];
+        for (uint32_t i = 0; i < numGASes; ++i)
+            addresses[i] = optixu::extract(gases[i])->getRelocatableAddress();
+
+        // JP: 隙間が無ければ何も移動しない。
+        EXPECT_EQ(scene.defragmentAccelerationStructures(stream), 0);
+        EXPECT_EQ(_scene->isReady(&hasMotionAS), true);
+
+        // JP: 先頭のGASを破棄して隙間を作ると、後ろのGASが前に詰められる。
+        gases[0].destroy();
+        gases[1].destroy();
+        EXPECT_EQ(scene.defragmentAccelerationStructures(stream), 2);
+        CUdeviceptr newAddress2 = optixu::extract(gases[2])->getRelocatableAddress();
+        CUdeviceptr newAddress3 = optixu::extract(gases[3])->getRelocatableAddress();
+        EXPECT_LE(newAddress2, addresses[0]);
+        EXPECT_EQ(newAddress3, newAddress2 + (addresses[3] - addresses[2]));
+        EXPECT_EQ(gases[2].isReady(), true);
+
+        // JP: 移動したGASを参照するIASはdirty状態になり、再ビルドで新しいハンドルを拾う。
+        EXPECT_EQ(ias.isReady(), false);
+        EXPECT_EQ(_scene->isReady(&hasMotionAS), false);
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        scene.buildDirty(stream, &arena);
+        EXPECT_EQ(_scene->isReady(&hasMotionAS), true);
+
+        ias.destroy();
+        inst.destroy();
+        gases[3].destroy();
+        gases[2].destroy();
+        geomInst.destroy();
+        mat.destroy();
+
+        optixu::AccelerationStructureMemoryArenaStats stats;
+        arena.getStats(&stats);
+        EXPECT_EQ(stats.numAllocations, 0);
+        arena.destroy();
+
+        CUDADRV_CHECK(cuMemFree(vertexMem));
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(AccelerationStructureCacheTest, ContentHashAndFileFormat) {
+    try {
+        const uint8_t bytes[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+
+        // JP: 同じ入力には同じハッシュ値、順序や区切り方が異なればそれぞれ異なるハッシュ値になる。
+        optixu::ContentHasher hasherA;
+        hasherA.add(bytes, sizeof(bytes));
+        hasherA.add(1.0f);
+        optixu::ContentHasher hasherB;
+        hasherB.add(bytes, sizeof(bytes));
+        hasherB.add(1.0f);
+        EXPECT_EQ(hasherA.getValue(), hasherB.getValue());
+
+        optixu::ContentHasher hasherC;
+        hasherC.add(1.0f);
+        hasherC.add(bytes, sizeof(bytes));
+        EXPECT_NE(hasherA.getValue(), hasherC.getValue());
+
+        optixu::ContentHasher hasherD;
+        hasherD.add(bytes, 5);
+        hasherD.add(bytes + 5, sizeof(bytes) - 5);
+        hasherD.add(1.0f);
+        EXPECT_NE(hasherA.getValue(), hasherD.getValue());
+
+        optixu::ContentHasher hasherE;
+        hasherE.add(bytes, sizeof(bytes) - 1);
+        hasherE.add(1.0f);
+        EXPECT_NE(hasherA.getValue(), hasherE.getValue());
+
+        EXPECT_EQ(optixu::getASCacheFileName(0x0123456789abcdefull), "0123456789abcdef.optixuas");
+
+        const uint64_t contentHash = hasherA.getValue();
+        OptixRelocationInfo relocInfo = {};
+        for (uint32_t i = 0; i < sizeof(relocInfo.info) / sizeof(relocInfo.info[0]); ++i)
+            relocInfo.info[i] = 0x1000 + i;
+        std::vector<uint8_t> asData(1000);
+        for (uint32_t i = 0; i < asData.size(); ++i)
+            asData[i] = static_cast<uint8_t>(i * 7);
+
+        std::stringstream file;
+        optixu::writeASCacheFile(file, contentHash, relocInfo, asData.data(), asData.size());
+        const std::string fileContents = file.str();
+        EXPECT_EQ(fileContents.size(), sizeof(optixu::ASCacheFileHeader) + asData.size());
+
+        // JP: 書き込んだ内容がそのまま読み戻せる。
+        {
+            std::istringstream in(fileContents);
+            OptixRelocationInfo readRelocInfo;
+            std::vector<uint8_t> readData;
+            EXPECT_EQ(optixu::readASCacheFile(in, contentHash, &readRelocInfo, &readData), true);
+            EXPECT_EQ(readData, asData);
+            EXPECT_EQ(std::memcmp(&readRelocInfo, &relocInfo, sizeof(relocInfo)), 0);
+        }
+
+        // JP: 別のハッシュに対するエントリー、破損・途中で切れたファイル、別のバージョンは読み込まれない。
+        auto tryRead = [&](const std::string &contents, uint64_t hash) {
+            std::istringstream in(contents);
+            OptixRelocationInfo readRelocInfo;
+            std::vector<uint8_t> readData;
+            return optixu::readASCacheFile(in, hash, &readRelocInfo, &readData);
+        };
+        EXPECT_EQ(tryRead(fileContents, contentHash + 1), false);
+
+        std::string corrupted = fileContents;
+        corrupted[sizeof(optixu::ASCacheFileHeader) + 10] ^= 0x01;
+        EXPECT_EQ(tryRead(corrupted, contentHash), false);
+
+        EXPECT_EQ(tryRead(fileContents.substr(0, fileContents.size() - 1), contentHash), false);
+        EXPECT_EQ(tryRead(fileContents.substr(0, sizeof(optixu::ASCacheFileHeader) / 2), contentHash), false);
+
+        // JP: 実際の長さを超えるデータサイズを持つファイルは確保を行わずに読み込まれない。
+        std::string hugeSize = fileContents;
+        uint64_t dataSize = ~0ull;
+        std::memcpy(&hugeSize[offsetof(optixu::ASCacheFileHeader, dataSize)], &dataSize, sizeof(dataSize));
+        EXPECT_EQ(tryRead(hugeSize, contentHash), false);
+
+        std::string otherVersion = fileContents;
+        uint32_t version = optixu::s_asCacheFileVersion + 1;
+        std::memcpy(&otherVersion[offsetof(optixu::ASCacheFileHeader, version)], &version, sizeof(version));
+        EXPECT_EQ(tryRead(otherVersion, contentHash), false);
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+TEST(AccelerationStructureCacheTest, BuildOrLoad) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        std::filesystem::path cacheDir =
+            std::filesystem::temp_directory_path() / "optixu_tests_as_cache";
+        std::filesystem::remove_all(cacheDir);
+        std::filesystem::create_directories(cacheDir);
+        optixu::AccelerationStructureCache cache =
+            optixu::AccelerationStructureCache::create(cacheDir.string());
+
+        optixu::AccelerationStructureMemoryArena arena =
+            optixu::AccelerationStructureMemoryArena::create(1024 * 1024);
+
+        const float vertices[] = {
+            0.0f, 0.0f, 0.0f,
+            1.0f, 0.0f, 0.0f,
+            0.0f, 1.0f, 0.0f,
+        };
+        CUdeviceptr vertexMem;
+        CUDADRV_CHECK(cuMemAlloc(&vertexMem, sizeof(vertices)));
+        CUDADRV_CHECK(cuMemcpyHtoD(vertexMem, vertices, sizeof(vertices)));
+        optixu::Material mat = context.createMaterial();
+        optixu::GeometryInstance geomInst = scene.createGeometryInstance();
+        geomInst.setVertexBuffer(optixu::BufferView(vertexMem, 3, sizeof(float) * 3));
+        geomInst.setMaterial(0, 0, mat);
+
+        auto countCacheFiles = [&]() {
+            uint32_t count = 0;
+            for (const auto &entry : std::filesystem::directory_iterator(cacheDir)) {
+                if (entry.path().extension() == ".optixuas")
+                    ++count;
+            }
+            return count;
+        };
+
+        optixu::GeometryAccelerationStructure gasA = scene.createGeometryAccelerationStructure();
+        gasA.setConfiguration(
+            optixu::ASTradeoff::PreferFastTrace,
+            optixu::AllowUpdate::No,
+            optixu::AllowCompaction::Yes);
+        gasA.addChild(geomInst);
+
+        // JP: 初回はミスしてビルド・コンパクションの結果が保存される。
+        EXPECT_EQ(cache.buildOrLoad(gasA, stream, &arena), false);
+        EXPECT_EQ(gasA.isReady(), true);
+        EXPECT_EQ(countCacheFiles(), 1);
+
+        // JP: 同じ内容のGASはディスクから読み込まれる。
+        optixu::GeometryAccelerationStructure gasB = scene.createGeometryAccelerationStructure();
+        gasB.setConfiguration(
+            optixu::ASTradeoff::PreferFastTrace,
+            optixu::AllowUpdate::No,
+            optixu::AllowCompaction::Yes);
+        gasB.addChild(geomInst);
+        EXPECT_EQ(cache.buildOrLoad(gasB, stream, &arena), true);
+        EXPECT_EQ(gasB.isReady(), true);
+        EXPECT_NE(optixu::extract(gasB)->getRelocatableAddress(), 0);
+
+        // JP: ビルドフラグや頂点の内容が変わるとミスする。
+        gasB.setConfiguration(
+            optixu::ASTradeoff::PreferFastBuild,
+            optixu::AllowUpdate::No,
+            optixu::AllowCompaction::Yes);
+        EXPECT_EQ(cache.buildOrLoad(gasB, stream, &arena), false);
+        EXPECT_EQ(countCacheFiles(), 2);
+
+        const float movedVertex[] = { 0.0f, 2.0f, 0.0f };
+        CUDADRV_CHECK(cuMemcpyHtoD(vertexMem + sizeof(float) * 6, movedVertex, sizeof(movedVertex)));
+        EXPECT_EQ(cache.buildOrLoad(gasA, stream, &arena), false);
+        EXPECT_EQ(countCacheFiles(), 3);
+        EXPECT_EQ(cache.buildOrLoad(gasA, stream, &arena), true);
+
+        gasB.destroy();
+        gasA.destroy();
+        geomInst.destroy();
+        mat.destroy();
+
+        optixu::AccelerationStructureMemoryArenaStats stats;
+        arena.getStats(&stats);
+        EXPECT_EQ(stats.numAllocations, 0);
+        arena.destroy();
+
+        cache.destroy();
+        std::filesystem::remove_all(cacheDir);
+
+        CUDADRV_CHECK(cuMemFree(vertexMem));
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, IASPartialInstanceUpload) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        CUdeviceptr vertexMem;
+        CUDADRV_CHECK(cuMemAlloc(&vertexMem, 3 * sizeof(float) * 3));
+        optixu::Material mat = context.createMaterial();
+        optixu::GeometryInstance geomInst = scene.createGeometryInstance();
+        geomInst.setVertexBuffer(optixu::BufferView(vertexMem, 3, sizeof(float) * 3));
+        geomInst.setMaterial(0, 0, mat);
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        gas.addChild(geomInst);
+
+        constexpr uint32_t numInsts = 200;
+        optixu::Instance insts[numInsts];
+        optixu::InstanceAccelerationStructure ias = scene.createInstanceAccelerationStructure();
+        ias.setConfiguration(
+            optixu::ASTradeoff::PreferFastBuild,
+            optixu::AllowUpdate::Yes,
+            optixu::AllowCompaction::No);
+        for (uint32_t i = 0; i < numInsts; ++i) {
+            insts[i] = scene.createInstance();
+            insts[i].setChild(gas);
+            ias.addChild(insts[i]);
+        }
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+
+        OptixAccelBufferSizes gasMemReq;
+        gas.prepareForBuild(&gasMemReq);
+        OptixAccelBufferSizes iasMemReq;
+        ias.prepareForBuild(&iasMemReq);
+        size_t scratchSize = std::max({
+            gasMemReq.tempSizeInBytes, iasMemReq.tempSizeInBytes, iasMemReq.tempUpdateSizeInBytes });
+        CUdeviceptr gasMem, iasMem, instMem, scratchMem;
+        CUDADRV_CHECK(cuMemAlloc(&gasMem, gasMemReq.outputSizeInBytes));
+        CUDADRV_CHECK(cuMemAlloc(&iasMem, iasMemReq.outputSizeInBytes));
+        CUDADRV_CHECK(cuMemAlloc(&instMem, sizeof(OptixInstance) * numInsts));
+        CUDADRV_CHECK(cuMemAlloc(&scratchMem, scratchSize));
+        optixu::BufferView scratchBuffer(scratchMem, scratchSize, 1);
+
+        gas.rebuild(stream, optixu::BufferView(gasMem, gasMemReq.outputSizeInBytes, 1), scratchBuffer);
+        ias.rebuild(
+            stream,
+            optixu::BufferView(instMem, numInsts, sizeof(OptixInstance)),
+            optixu::BufferView(iasMem, iasMemReq.outputSizeInBytes, 1),
+            scratchBuffer);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+
+        // JP: アップロードされたかを判別するため、デバイス側のインスタンスIDを書き換えておく。
+        auto writeSentinelID = [&](uint32_t instIdx) {
+            const uint32_t sentinelID = 0xDEAD;
+            CUDADRV_CHECK(cuMemcpyHtoD(
+                instMem + sizeof(OptixInstance) * instIdx + offsetof(OptixInstance, instanceId),
+                &sentinelID, sizeof(sentinelID)));
+        };
+        auto readInstance = [&](uint32_t instIdx) {
+            OptixInstance instance;
+            CUDADRV_CHECK(cuMemcpyDtoH(
+                &instance, instMem + sizeof(OptixInstance) * instIdx, sizeof(instance)));
+            return instance;
+        };
+        for (uint32_t i = 0; i < numInsts; ++i)
+            writeSentinelID(i);
+
+        // JP: 変更されたインスタンスを含む範囲のみがアップロードされる。
+        const float movedTransform[] = {
+            1, 0, 0, 5,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+        };
+        insts[10].setTransform(movedTransform);
+        insts[150].setFlags(OPTIX_INSTANCE_FLAG_DISABLE_TRIANGLE_FACE_CULLING);
+        ias.update(stream, scratchBuffer);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+
+        OptixInstance instance10 = readInstance(10);
+        EXPECT_EQ(instance10.transform[3], 5.0f);
+        EXPECT_EQ(instance10.instanceId, 0);
+        OptixInstance instance150 = readInstance(150);
+        EXPECT_EQ(instance150.flags, OPTIX_INSTANCE_FLAG_DISABLE_TRIANGLE_FACE_CULLING);
+        EXPECT_EQ(instance150.instanceId, 0);
+        EXPECT_EQ(readInstance(0).instanceId, 0xDEAD);
+        EXPECT_EQ(readInstance(100).instanceId, 0xDEAD);
+        EXPECT_EQ(readInstance(numInsts - 1).instanceId, 0xDEAD);
+
+        // JP: 近接する変更範囲は一回のコピーにまとめられる。
+        insts[20].setVisibilityMask(0x0F);
+        insts[25].setID(7);
+        ias.update(stream, scratchBuffer);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        EXPECT_EQ(readInstance(20).visibilityMask, 0x0F);
+        EXPECT_EQ(readInstance(22).instanceId, 0);
+        EXPECT_EQ(readInstance(25).instanceId, 7);
+        EXPECT_EQ(readInstance(100).instanceId, 0xDEAD);
+
+        // JP: 変更が無ければ何もアップロードされない。
+        writeSentinelID(10);
+        ias.update(stream, scratchBuffer);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        EXPECT_EQ(readInstance(10).instanceId, 0xDEAD);
+
+        // JP: リビルドでは全体がアップロードされる。
+        ias.rebuild(
+            stream,
+            optixu::BufferView(instMem, numInsts, sizeof(OptixInstance)),
+            optixu::BufferView(iasMem, iasMemReq.outputSizeInBytes, 1),
+            scratchBuffer);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        EXPECT_EQ(readInstance(10).instanceId, 0);
+        EXPECT_EQ(readInstance(100).instanceId, 0);
+
+        ias.destroy();
+        for (uint32_t i = 0; i < numInsts; ++i)
+            insts[i].destroy();
+        gas.destroy();
+        geomInst.destroy();
+        mat.destroy();
+
+        CUDADRV_CHECK(cuMemFree(scratchMem));
+        CUDADRV_CHECK(cuMemFree(instMem));
+        CUDADRV_CHECK(cuMemFree(iasMem));
+        CUDADRV_CHECK(cuMemFree(gasMem));
+        CUDADRV_CHECK(cuMemFree(vertexMem));
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, IASSetChildTransforms) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        constexpr uint32_t numInsts = 3;
+        optixu::Instance insts[numInsts];
+        optixu::InstanceAccelerationStructure ias = scene.createInstanceAccelerationStructure();
+        for (uint32_t i = 0; i < numInsts; ++i) {
+            insts[i] = scene.createInstance();
+            ias.addChild(insts[i]);
+        }
+
+        // JP: 範囲を指定して変換を設定できる。
+        const float transforms[][12] = {
+            { 1, 0, 0, 1, 0, 1, 0, 2, 0, 0, 1, 3 },
+            { 2, 0, 0, 4, 0, 2, 0, 5, 0, 0, 2, 6 },
+        };
+        ias.setChildTransforms(transforms, 2, 1);
+        float transform[12];
+        insts[0].getTransform(transform);
+        EXPECT_EQ(transform[0], 1.0f);
+        EXPECT_EQ(transform[3], 0.0f);
+        for (uint32_t i = 1; i < numInsts; ++i) {
+            insts[i].getTransform(transform);
+            for (uint32_t j = 0; j < 12; ++j)
+                EXPECT_EQ(transform[j], transforms[i - 1][j]);
+        }
+
+        // JP: 行ごとに分かれた配列からも設定できる。
+        float rows[3][numInsts][4];
+        for (uint32_t r = 0; r < 3; ++r) {
+            for (uint32_t i = 0; i < numInsts; ++i) {
+                for (uint32_t c = 0; c < 4; ++c)
+                    rows[r][i][c] = static_cast<float>(100 * i + 10 * r + c);
+            }
+        }
+        ias.setChildTransforms(rows[0], rows[1], rows[2], numInsts);
+        for (uint32_t i = 0; i < numInsts; ++i) {
+            insts[i].getTransform(transform);
+            for (uint32_t r = 0; r < 3; ++r) {
+                for (uint32_t c = 0; c < 4; ++c)
+                    EXPECT_EQ(transform[4 * r + c], rows[r][i][c]);
+            }
+        }
+
+        EXPECT_EXCEPTION(ias.setChildTransforms(transforms, 2, 2));
+        EXPECT_EXCEPTION(ias.setChildTransforms(rows[0], rows[1], rows[2], numInsts + 1));
+
+        ias.destroy();
+        for (uint32_t i = 0; i < numInsts; ++i)
+            insts[i].destroy();
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, IASParallelInstanceFill) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+        context.setNumWorkerThreads(3);
+
+        optixu::Scene scene = context.createScene();
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        CUdeviceptr vertexMem;
+        CUDADRV_CHECK(cuMemAlloc(&vertexMem, 3 * sizeof(float) * 3));
+        optixu::Material mat = context.createMaterial();
+        optixu::GeometryInstance geomInst = scene.createGeometryInstance();
+        geomInst.setVertexBuffer(optixu::BufferView(vertexMem, 3, sizeof(float) * 3));
+        geomInst.setMaterial(0, 0, mat);
+
+        constexpr uint32_t numGASes = 3;
+        optixu::GeometryAccelerationStructure gases[numGASes];
+        for (uint32_t i = 0; i < numGASes; ++i) {
+            gases[i] = scene.createGeometryAccelerationStructure();
+            gases[i].setNumRayTypes(0, 1 + i);
+            gases[i].addChild(geomInst);
+        }
+
+        // JP: タスクあたりの最小数を超えるインスタンスは複数のスレッドで詰められる。
+        constexpr uint32_t numInsts = 3 * optixu::_InstanceAccelerationStructure::s_minNumInstancesPerTask + 5;
+        std::vector<optixu::Instance> insts(numInsts);
+        optixu::InstanceAccelerationStructure ias = scene.createInstanceAccelerationStructure();
+        for (uint32_t i = 0; i < numInsts; ++i) {
+            insts[i] = scene.createInstance();
+            insts[i].setChild(gases[i % numGASes]);
+            insts[i].setID(i % 1000);
+            ias.addChild(insts[i]);
+        }
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+
+        CountingASMemoryAllocator allocator;
+        scene.buildDirty(stream, &allocator);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        EXPECT_EQ(ias.isReady(), true);
+
+        optixu::_Scene* _scene = optixu::extract(scene);
+        optixu::_InstanceAccelerationStructure* _ias = optixu::extract(ias);
+        std::vector<OptixInstance> instances(numInsts);
+        CUDADRV_CHECK(cuMemcpyDtoH(
+            instances.data(), _ias->getManagedMemory().auxBuffer.getCUdeviceptr(),
+            sizeof(OptixInstance) * numInsts));
+        for (uint32_t i = 0; i < numInsts; ++i) {
+            optixu::_GeometryAccelerationStructure* gas = optixu::extract(gases[i % numGASes]);
+            EXPECT_EQ(instances[i].instanceId, i % 1000);
+            EXPECT_EQ(instances[i].traversableHandle, gas->getHandle());
+            EXPECT_EQ(instances[i].sbtOffset, _scene->getSBTOffset(gas, 0));
+        }
+
+        // JP: 準備ができていない子があれば、いずれかのスレッドで送出された例外が呼び出し元に届く。
+        gases[1].markDirty();
+        OptixAccelBufferSizes iasMemReq;
+        ias.prepareForBuild(&iasMemReq);
+        const optixu::ManagedASMemory &iasMemory = _ias->getManagedMemory();
+        EXPECT_EXCEPTION(ias.rebuild(stream, iasMemory.auxBuffer, iasMemory.accelBuffer, iasMemory.auxBuffer));
+
+        ias.destroy();
+        for (optixu::Instance &inst : insts)
+            inst.destroy();
+        for (uint32_t i = 0; i < numGASes; ++i)
+            gases[i].destroy();
+        geomInst.destroy();
+        mat.destroy();
+
+        CUDADRV_CHECK(cuMemFree(vertexMem));
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, BulkCreateAndAddChildren) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        // JP: インスタンスをまとめて生成して追加できる。
+        constexpr uint32_t numInsts = 300;
+        std::vector<optixu::Instance> insts(numInsts);
+        scene.createInstances(numInsts, insts.data());
+        optixu::Instance singleInst = scene.createInstance();
+        optixu::InstanceAccelerationStructure ias = scene.createInstanceAccelerationStructure();
+        ias.addChild(singleInst);
+        ias.addChildren(insts.data(), numInsts);
+        EXPECT_EQ(ias.getNumChildren(), numInsts + 1);
+        EXPECT_EQ(ias.getChild(0), singleInst);
+        for (uint32_t i = 0; i < numInsts; ++i)
+            EXPECT_EQ(ias.getChild(1 + i), insts[i]);
+
+        // JP: 既存の子やバッチ内の重複があれば何も追加されない。
+        optixu::Instance extraInsts[2];
+        scene.createInstances(2, extraInsts);
+        optixu::Instance dupInsts[] = { extraInsts[0], insts[5] };
+        EXPECT_EXCEPTION(ias.addChildren(dupInsts, 2));
+        optixu::Instance dupInsts2[] = { extraInsts[0], extraInsts[1], extraInsts[0] };
+        EXPECT_EXCEPTION(ias.addChildren(dupInsts2, 3));
+        EXPECT_EQ(ias.getNumChildren(), numInsts + 1);
+        ias.addChildren(extraInsts, 2);
+        EXPECT_EQ(ias.getNumChildren(), numInsts + 3);
+
+        // JP: 破棄したインスタンスの領域は再利用される。
+        insts[10].destroy();
+        optixu::Instance reusedInst = scene.createInstance();
+        reusedInst.setID(123);
+        EXPECT_EQ(reusedInst.getID(), 123u);
+        reusedInst.destroy();
+
+        // JP: ジオメトリーインスタンスをまとめて追加できる。
+        constexpr uint32_t numGeomInsts = 4;
+        optixu::GeometryInstance geomInsts[numGeomInsts];
+        for (uint32_t i = 0; i < numGeomInsts; ++i)
+            geomInsts[i] = scene.createGeometryInstance();
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        gas.addChild(geomInsts[0]);
+        const CUdeviceptr preTransforms[] = { 0x100, 0, 0 };
+        gas.addChildren(geomInsts + 1, preTransforms, 3);
+        EXPECT_EQ(gas.getNumChildren(), 4u);
+        EXPECT_EQ(gas.findChildIndex(geomInsts[1], 0x100), 1u);
+        EXPECT_EQ(gas.findChildIndex(geomInsts[3], 0), 3u);
+        // JP: 変換が異なれば同じジオメトリーインスタンスを追加できる。
+        const CUdeviceptr preTransforms2[] = { 0x200 };
+        gas.addChildren(geomInsts, preTransforms2, 1);
+        EXPECT_EQ(gas.getNumChildren(), 5u);
+        EXPECT_EXCEPTION(gas.addChildren(geomInsts + 2, nullptr, 1));
+        EXPECT_EQ(gas.getNumChildren(), 5u);
+
+        optixu::GeometryInstance curveGeomInst =
+            scene.createGeometryInstance(optixu::GeometryType::CubicBSplines);
+        EXPECT_EXCEPTION(gas.addChildren(&curveGeomInst, nullptr, 1));
+        optixu::GeometryAccelerationStructure curveGas =
+            scene.createGeometryAccelerationStructure(optixu::GeometryType::CubicBSplines);
+        EXPECT_EXCEPTION(curveGas.addChildren(&curveGeomInst, preTransforms, 1));
+        curveGas.addChildren(&curveGeomInst, nullptr, 1);
+        EXPECT_EQ(curveGas.getNumChildren(), 1u);
+
+        curveGas.destroy();
+        curveGeomInst.destroy();
+        gas.destroy();
+        for (uint32_t i = 0; i < numGeomInsts; ++i)
+            geomInsts[i].destroy();
+        ias.destroy();
+        for (uint32_t i = 0; i < 2; ++i)
+            extraInsts[i].destroy();
+        for (uint32_t i = 0; i < numInsts; ++i) {
+            if (i != 10)
+                insts[i].destroy();
+        }
+        singleInst.destroy();
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, ObjectPool) {
+    try {
+        struct Item {
+            uint64_t values[3];
+            uint32_t* numLiveItems;
+
+            Item(uint32_t* _numLiveItems, uint64_t v) : numLiveItems(_numLiveItems) {
+                values[0] = values[1] = values[2] = v;
+                ++*numLiveItems;
+            }
+            ~Item() {
+                --*numLiveItems;
+            }
+        };
+
+        uint32_t numLiveItems = 0;
+        {
+            optixu::ObjectPool<Item> pool;
+            Item* a = pool.create(&numLiveItems, 1);
+            Item* b = pool.create(&numLiveItems, 2);
+            EXPECT_EQ(numLiveItems, 2u);
+            EXPECT_EQ(pool.getNumObjects(), 2u);
+            EXPECT_EQ(pool.getNumPages(), 1u);
+
+            // JP: 解放した領域は再利用される。
+            pool.destroy(a);
+            EXPECT_EQ(numLiveItems, 1u);
+            Item* c = pool.create(&numLiveItems, 3);
+            EXPECT_EQ(c, a);
+            EXPECT_EQ(c->values[2], 3u);
+
+            // JP: まとめて確保したオブジェクトは連続した領域に置かれる。
+            constexpr uint32_t numBulkItems = 1000;
+            std::vector<Item*> items(numBulkItems);
+            pool.createContiguous(numBulkItems, items.data(), &numLiveItems, static_cast<uint64_t>(4));
+            EXPECT_EQ(numLiveItems, 2 + numBulkItems);
+            EXPECT_EQ(pool.getNumPages(), 2u);
+            for (uint32_t i = 1; i < numBulkItems; ++i)
+                EXPECT_EQ(items[i], items[0] + i);
+
+            // JP: 前のページの残りはフリーリスト経由で使われる。
+            Item* d = pool.create(&numLiveItems, 5);
+            EXPECT_EQ(pool.getNumPages(), 2u);
+            EXPECT_TRUE(d != b && d != c);
+
+            for (Item* item : items)
+                pool.destroy(item);
+            pool.destroy(b);
+            pool.destroy(c);
+            pool.destroy(d);
+            EXPECT_EQ(numLiveItems, 0u);
+            EXPECT_EQ(pool.getNumObjects(), 0u);
+        }
+
+        // JP: シーンに属するオブジェクトは型ごとのプールから確保される。
+        optixu::Context context = optixu::Context::create(cuContext);
+        optixu::Scene scene = context.createScene();
+        optixu::GeometryInstance geomInst = scene.createGeometryInstance();
+        optixu::Transform xfm = scene.createTransform();
+        optixu::Instance inst = scene.createInstance();
+        const optixu::_Scene* _scene = optixu::extract(scene);
+        EXPECT_EQ(_scene->getObjectPool<optixu::_GeometryInstance>().getNumObjects(), 1u);
+        EXPECT_EQ(_scene->getObjectPool<optixu::_Transform>().getNumObjects(), 1u);
+        EXPECT_EQ(_scene->getObjectPool<optixu::_Instance>().getNumObjects(), 1u);
+        inst.destroy();
+        xfm.destroy();
+        geomInst.destroy();
+        EXPECT_EQ(_scene->getObjectPool<optixu::_GeometryInstance>().getNumObjects(), 0u);
+        EXPECT_EQ(_scene->getObjectPool<optixu::_Transform>().getNumObjects(), 0u);
+        EXPECT_EQ(_scene->getObjectPool<optixu::_Instance>().getNumObjects(), 0u);
+        scene.destroy();
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(AccelerationStructureUpdatePolicyTest, Decision) {
+    try {
+        // JP: 判定処理はデバイスに依存せず、報告された境界だけで決まる。
+        optixu::AccelerationStructureUpdatePolicy policy = optixu::AccelerationStructureUpdatePolicy::create();
+        policy.setThresholds(1.5f, 0.25f, 100);
+        optixu::AccelerationStructureUpdatePolicy::Priv* _policy = optixu::extract(policy);
+
+        const OptixAabb unitBox = { 0, 0, 0, 1, 1, 1 };
+        _policy->onRebuilt();
+        _policy->reportBounds(&unitBox, 1);
+        EXPECT_EQ(policy.getSurfaceAreaGrowth(), 1.0f);
+        EXPECT_FALSE(_policy->shouldRebuild());
+
+        // JP: 表面積の増加率が閾値を超えるとリビルドを選ぶ。
+        const OptixAabb slightlyGrownBox = { 0, 0, 0, 1.1f, 1, 1 };
+        _policy->onUpdated();
+        _policy->reportBounds(&slightlyGrownBox, 1);
+        EXPECT_GT(policy.getSurfaceAreaGrowth(), 1.0f);
+        EXPECT_FALSE(_policy->shouldRebuild());
+        const OptixAabb grownBox = { 0, 0, 0, 2, 1, 1 };
+        _policy->onUpdated();
+        _policy->reportBounds(&grownBox, 1);
+        EXPECT_NEAR(policy.getSurfaceAreaGrowth(), 10.0f / 6.0f, 1e-5f);
+        EXPECT_TRUE(_policy->shouldRebuild());
+        EXPECT_EQ(policy.getNumUpdatesSinceRebuild(), 2u);
+
+        // JP: リビルド後は最初に得た境界が新たな基準になる。
+        _policy->onRebuilt();
+        EXPECT_EQ(policy.getNumUpdatesSinceRebuild(), 0u);
+        _policy->reportBounds(&grownBox, 1);
+        EXPECT_EQ(policy.getSurfaceAreaGrowth(), 1.0f);
+        EXPECT_FALSE(_policy->shouldRebuild());
+
+        // JP: モーションキーごとの境界はその和として扱う。
+        const OptixAabb motionBoxes[] = {
+            { 0, 0, 0, 2, 1, 1 },
+            { 0, 0, 0, 1, 1, 2 },
+        };
+        _policy->onUpdated();
+        _policy->reportBounds(motionBoxes, 2);
+        EXPECT_NEAR(policy.getSurfaceAreaGrowth(), 16.0f / 10.0f, 1e-5f);
+        EXPECT_TRUE(_policy->shouldRebuild());
+
+        // JP: 累積変位と境界の対角線の長さの比が閾値を超えるとリビルドを選ぶ。
+        _policy->onRebuilt();
+        _policy->reportBounds(&unitBox, 1);
+        policy.addDisplacementBound(0.2f);
+        EXPECT_NEAR(policy.getRelativeDisplacement(), 0.2f / std::sqrt(3.0f), 1e-5f);
+        EXPECT_FALSE(_policy->shouldRebuild());
+        policy.addDisplacementBound(0.3f);
+        EXPECT_TRUE(_policy->shouldRebuild());
+
+        // JP: アップデート回数の上限に達するとリビルドを選ぶ。
+        policy.setThresholds(1.5f, 0.25f, 3);
+        _policy->onRebuilt();
+        _policy->reportBounds(&unitBox, 1);
+        for (uint32_t i = 0; i < 3; ++i) {
+            EXPECT_FALSE(_policy->shouldRebuild());
+            _policy->onUpdated();
+        }
+        EXPECT_TRUE(_policy->shouldRebuild());
+
+        policy.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+TEST(AccelerationStructureUpdatePolicyTest, BuildOrUpdate) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        CUdeviceptr vertexMem;
+        CUDADRV_CHECK(cuMemAlloc(&vertexMem, 3 * sizeof(float) * 3));
+        optixu::Material mat = context.createMaterial();
+        optixu::GeometryInstance geomInst = scene.createGeometryInstance();
+        geomInst.setVertexBuffer(optixu::BufferView(vertexMem, 3, sizeof(float) * 3));
+        geomInst.setMaterial(0, 0, mat);
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        gas.setConfiguration(optixu::ASTradeoff::PreferFastBuild, optixu::AllowUpdate::Yes);
+        gas.addChild(geomInst);
+
+        OptixAccelBufferSizes memReq;
+        gas.prepareForBuild(&memReq);
+        CUdeviceptr gasMem, scratchMem;
+        CUDADRV_CHECK(cuMemAlloc(&gasMem, memReq.outputSizeInBytes));
+        CUDADRV_CHECK(cuMemAlloc(&scratchMem, memReq.tempSizeInBytes));
+        optixu::BufferView scratchBuffer(scratchMem, memReq.tempSizeInBytes, 1);
+
+        optixu::AccelerationStructureUpdatePolicy policy = optixu::AccelerationStructureUpdatePolicy::create();
+        policy.setThresholds(1.5f, 0.25f, 2);
+
+        // JP: ポリシー無しやビルド前の呼び出しはエラーになる。
+        EXPECT_EXCEPTION(gas.buildOrUpdate(stream, scratchBuffer));
+        gas.setUpdatePolicy(policy);
+        EXPECT_EXCEPTION(gas.buildOrUpdate(stream, scratchBuffer));
+
+        gas.rebuild(stream, optixu::BufferView(gasMem, memReq.outputSizeInBytes, 1), scratchBuffer);
+
+        // JP: ポリシーの判定に従ってアップデートとリビルドが選ばれる。
+        bool rebuilt;
+        gas.buildOrUpdate(stream, scratchBuffer, &rebuilt);
+        EXPECT_FALSE(rebuilt);
+        gas.buildOrUpdate(stream, scratchBuffer, &rebuilt);
+        EXPECT_FALSE(rebuilt);
+        EXPECT_EQ(policy.getNumUpdatesSinceRebuild(), 2u);
+        gas.buildOrUpdate(stream, scratchBuffer, &rebuilt);
+        EXPECT_TRUE(rebuilt);
+        EXPECT_EQ(policy.getNumUpdatesSinceRebuild(), 0u);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+
+        // JP: ビルド時に出力された境界が読み戻されて基準になる。
+        gas.buildOrUpdate(stream, scratchBuffer, &rebuilt);
+        EXPECT_FALSE(rebuilt);
+        EXPECT_EQ(policy.getSurfaceAreaGrowth(), 1.0f);
+        EXPECT_FALSE(optixu::extract(policy)->shouldRebuild());
+
+        // JP: アップデートを許可していないASには設定できず、設定中はアップデートを禁止できない。
+        optixu::GeometryAccelerationStructure otherGas = scene.createGeometryAccelerationStructure();
+        optixu::AccelerationStructureUpdatePolicy otherPolicy = optixu::AccelerationStructureUpdatePolicy::create();
+        EXPECT_EXCEPTION(otherGas.setUpdatePolicy(otherPolicy));
+        EXPECT_EXCEPTION(gas.setConfiguration(optixu::ASTradeoff::PreferFastBuild, optixu::AllowUpdate::No));
+
+        // JP: ポリシーは一つのASにのみ設定できる。
+        otherGas.setConfiguration(optixu::ASTradeoff::PreferFastBuild, optixu::AllowUpdate::Yes);
+        EXPECT_EXCEPTION(otherGas.setUpdatePolicy(policy));
+        gas.setUpdatePolicy(optixu::AccelerationStructureUpdatePolicy());
+        otherGas.setUpdatePolicy(policy);
+        otherGas.destroy();
+        EXPECT_EQ(optixu::extract(policy)->hasOwner(), false);
+
+        // JP: 設定中のポリシーを破棄するとASから外れる。
+        gas.setUpdatePolicy(otherPolicy);
+        EXPECT_EQ(optixu::extract(otherPolicy)->hasOwner(), true);
+        otherPolicy.destroy();
+        EXPECT_EXCEPTION(gas.buildOrUpdate(stream, scratchBuffer));
+        gas.setUpdatePolicy(policy);
+
+        // JP: シーンの破棄で個別に破棄されずに解放されるASからもポリシーは外れる。
+        {
+            optixu::Scene tempScene = context.createScene();
+            optixu::GeometryAccelerationStructure tempGas = tempScene.createGeometryAccelerationStructure();
+            tempGas.setConfiguration(optixu::ASTradeoff::PreferFastBuild, optixu::AllowUpdate::Yes);
+            optixu::AccelerationStructureUpdatePolicy tempPolicy = optixu::AccelerationStructureUpdatePolicy::create();
+            tempGas.setUpdatePolicy(tempPolicy);
+            tempScene.destroy();
+            EXPECT_EQ(optixu::extract(tempPolicy)->hasOwner(), false);
+            tempPolicy.destroy();
+        }
+
+        policy.destroy();
+        gas.destroy();
+        geomInst.destroy();
+        mat.destroy();
+        CUDADRV_CHECK(cuMemFree(scratchMem));
+        CUDADRV_CHECK(cuMemFree(gasMem));
+        CUDADRV_CHECK(cuMemFree(vertexMem));
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(AccelerationStructureBuildQueueTest, Scheduler) {
+    try {
+        // JP: 真のコストが固定コスト + 1プリミティブあたりのコストで表される仮想のビルドで
+        //     スケジューラーの挙動を確認する。
+        const float fixedCost = 0.01f;
+        const float trueCostPerPrim = 2e-4f;
+        const auto trueCost = [&](uint32_t numPrims) {
+            return fixedCost + trueCostPerPrim * numPrims;
+        };
+
+        optixu::ASBuildScheduler<uint32_t> scheduler;
+        scheduler.setCostModel(fixedCost, 1e-5f);
+        const uint32_t numBuilds = 64;
+        for (uint32_t i = 0; i < numBuilds; ++i)
+            scheduler.enqueue(i, 1000 + 500 * (i % 7));
+        EXPECT_EQ(scheduler.getNumQueued(), numBuilds);
+
+        // JP: 予算が非常に小さくても毎フレーム少なくとも一つのビルドが発行される。
+        std::vector<uint32_t> issued;
+        float estimated = scheduler.dequeueWithinBudget(
+            0.0f,
+            [&](uint32_t item, uint32_t numPrims) {
+                issued.push_back(item);
+                scheduler.addMeasurement(numPrims, trueCost(numPrims));
+            });
+        EXPECT_EQ(issued.size(), 1u);
+        EXPECT_EQ(issued[0], 0u);
+        EXPECT_GT(estimated, 0.0f);
+        // JP: 最初の計測結果は初期値を置き換える。
+        EXPECT_NEAR(scheduler.getCostPerPrimitive(), trueCostPerPrim, 1e-7f);
+
+        // JP: 以降のフレームでは真のコストの合計が予算を超えず、発行順はキューの順序に従う。
+        const float budget = 1.0f;
+        uint32_t numFrames = 0;
+        while (scheduler.getNumQueued() > 0) {
+            float sumTrueCost = 0.0f;
+            uint32_t numIssuedInFrame = 0;
+            scheduler.dequeueWithinBudget(
+                budget,
+                [&](uint32_t item, uint32_t numPrims) {
+                    EXPECT_EQ(item, static_cast<uint32_t>(issued.size()));
+                    issued.push_back(item);
+                    sumTrueCost += trueCost(numPrims);
+                    ++numIssuedInFrame;
+                    scheduler.addMeasurement(numPrims, trueCost(numPrims));
+                });
+            EXPECT_GE(numIssuedInFrame, 1u);
+            EXPECT_LE(sumTrueCost, budget * 1.0001f);
+            ++numFrames;
+        }
+        EXPECT_EQ(issued.size(), numBuilds);
+        EXPECT_GT(numFrames, 1u);
+        EXPECT_NEAR(scheduler.estimateCost(2000), trueCost(2000), 1e-5f);
+
+        // JP: 計測値は指数移動平均で取り込まれ、コストの変化に追従する。
+        for (uint32_t i = 0; i < 64; ++i)
+            scheduler.addMeasurement(1000, fixedCost + 2 * trueCostPerPrim * 1000);
+        EXPECT_NEAR(scheduler.getCostPerPrimitive(), 2 * trueCostPerPrim, 1e-6f);
+
+        // JP: プリミティブが無いビルドの計測値は無視される。
+        scheduler.addMeasurement(0, 100.0f);
+        EXPECT_NEAR(scheduler.getCostPerPrimitive(), 2 * trueCostPerPrim, 1e-6f);
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+TEST(AccelerationStructureBuildQueueTest, ProcessFrame) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        CountingASMemoryAllocator allocator;
+
+        // JP: GAS iは(i + 1) * numTriangles個の三角形を持つ。
+        constexpr uint32_t numTriangles = 100;
+        constexpr uint32_t numGASes = 4;
+        CUdeviceptr vertexMem;
+        CUDADRV_CHECK(cuMemAlloc(&vertexMem, 3 * numGASes * numTriangles * sizeof(float) * 3));
+        optixu::Material mat = context.createMaterial();
+        optixu::GeometryInstance geomInsts[numGASes];
+        optixu::GeometryAccelerationStructure gases[numGASes];
+        for (uint32_t i = 0; i < numGASes; ++i) {
+            geomInsts[i] = scene.createGeometryInstance();
+            geomInsts[i].setVertexBuffer(
+                optixu::BufferView(vertexMem, 3 * (i + 1) * numTriangles, sizeof(float) * 3));
+            geomInsts[i].setMaterial(0, 0, mat);
+
+            gases[i] = scene.createGeometryAccelerationStructure();
+            gases[i].setConfiguration(
+                optixu::ASTradeoff::PreferFastTrace, optixu::AllowUpdate::No,
+                i % 2 == 0 ? optixu::AllowCompaction::Yes : optixu::AllowCompaction::No);
+            gases[i].addChild(geomInsts[i]);
+        }
+        EXPECT_EQ(optixu::extract(gases[2])->getNumPrimitives(), 3 * numTriangles);
+
+        optixu::AccelerationStructureBuildQueue queue =
+            optixu::AccelerationStructureBuildQueue::create(&allocator);
+        queue.setCostModel(0.0f, 1.0f);
+        queue.setFrameBudget(3.0f * numTriangles);
+        EXPECT_EQ(queue.estimateBuildCost(numTriangles), numTriangles);
+        for (uint32_t i = 0; i < numGASes; ++i)
+            queue.enqueue(gases[i]);
+        EXPECT_EQ(queue.getNumQueuedBuilds(), numGASes);
+
+        // JP: 最初のフレームでは予算内のGAS 0, 1のビルドが発行される。
+        std::vector<optixu::GeometryAccelerationStructure> readyGASes;
+        queue.processFrame(stream, &readyGASes);
+        ASSERT_EQ(readyGASes.size(), 2u);
+        EXPECT_EQ(readyGASes[0], gases[0]);
+        EXPECT_EQ(readyGASes[1], gases[1]);
+        EXPECT_EQ(queue.getNumQueuedBuilds(), 2u);
+        EXPECT_NE(gases[0].getHandle(), 0u);
+
+        // JP: 計測によってコストモデルが更新され、コンパクションされたGAS 0も報告される。
+        uint32_t numFrames = 1;
+        std::vector<optixu::GeometryAccelerationStructure> allReadyGASes = readyGASes;
+        while (!queue.isIdle()) {
+            queue.processFrame(stream, &readyGASes);
+            allReadyGASes.insert(allReadyGASes.end(), readyGASes.begin(), readyGASes.end());
+            ++numFrames;
+            ASSERT_LT(numFrames, 16u);
+        }
+        EXPECT_LT(queue.estimateBuildCost(numTriangles), numTriangles);
+        EXPECT_EQ(allReadyGASes.size(), numGASes + 2);
+        for (uint32_t i = 0; i < numGASes; ++i)
+            EXPECT_NE(gases[i].getHandle(), 0u);
+
+        // JP: スクラッチと非コンパクションASのメモリはアロケーターに返却されている。
+        EXPECT_EQ(allocator.numLiveAllocations, numGASes);
+
+        queue.destroy();
+        for (uint32_t i = 0; i < numGASes; ++i) {
+            gases[i].destroy();
+            geomInsts[i].destroy();
+        }
+        EXPECT_EQ(allocator.numLiveAllocations, 0u);
+        mat.destroy();
+        CUDADRV_CHECK(cuMemFree(vertexMem));
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+        scene.destroy();
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(SceneTest, PartitionedIAS) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        CountingASMemoryAllocator allocator;
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+
+        constexpr uint32_t numInstances = 8;
+        optixu::Instance insts[numInstances];
+        scene.createInstances(numInstances, insts);
+        for (uint32_t i = 0; i < numInstances; ++i)
+            insts[i].setChild(gas);
+
+        optixu::Transform xfm = scene.createTransform();
+        size_t xfmSize;
+        xfm.setConfiguration(optixu::TransformType::Static, 0, &xfmSize);
+        xfm.setChild(gas);
+        optixu::Instance xfmInst = scene.createInstance();
+        xfmInst.setChild(xfm);
+
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        scene.buildDirty(stream, &allocator);
+        uint32_t numAllocationsBeforePartitioning = allocator.numLiveAllocations;
+
+        optixu::PartitionedInstanceAccelerationStructure partitionedIas =
+            optixu::PartitionedInstanceAccelerationStructure::create(scene, &allocator);
+        partitionedIas.setMigrationOptions(2, 1);
+
+        // JP: 追加されたインスタンスは静的な側から始まる。
+        partitionedIas.addChildren(insts, numInstances);
+        EXPECT_EXCEPTION(partitionedIas.addChild(insts[0]));
+        EXPECT_NE(partitionedIas.build(stream), 0u);
+        EXPECT_EQ(partitionedIas.getNumChildren(), numInstances);
+        EXPECT_EQ(partitionedIas.getNumDynamicChildren(), 0u);
+        EXPECT_EQ(partitionedIas.getMaxTraversableGraphDepth(), 3u);
+
+        // JP: 変更されたインスタンスは動的な側へ移る。
+        const float transform[] = {
+            1, 0, 0, 1,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+        };
+        insts[1].setTransform(transform);
+        insts[5].setTransform(transform);
+        partitionedIas.build(stream);
+        EXPECT_EQ(partitionedIas.getNumDynamicChildren(), 2u);
+        EXPECT_TRUE(partitionedIas.isDynamicChild(insts[1]));
+        EXPECT_TRUE(partitionedIas.isDynamicChild(insts[5]));
+        EXPECT_FALSE(partitionedIas.isDynamicChild(insts[0]));
+
+        // JP: 変更され続けるインスタンスは動的な側に留まり、
+        //     指定フレーム数変更されなかったインスタンスは静的な側へ戻る。
+        for (uint32_t frame = 0; frame < 2; ++frame) {
+            insts[5].setTransform(transform);
+            partitionedIas.build(stream);
+        }
+        EXPECT_FALSE(partitionedIas.isDynamicChild(insts[1]));
+        EXPECT_TRUE(partitionedIas.isDynamicChild(insts[5]));
+        EXPECT_EQ(partitionedIas.getNumDynamicChildren(), 1u);
+
+        // JP: Transformを経由する子があると最大の階層数が増える。
+        partitionedIas.addChild(xfmInst);
+        partitionedIas.build(stream);
+        EXPECT_EQ(partitionedIas.getMaxTraversableGraphDepth(), 4u);
+        partitionedIas.removeChild(xfmInst);
+        EXPECT_EXCEPTION(partitionedIas.removeChild(xfmInst));
+        partitionedIas.build(stream);
+        EXPECT_EQ(partitionedIas.getMaxTraversableGraphDepth(), 3u);
+        EXPECT_EQ(partitionedIas.getNumChildren(), numInstances);
+
+        // JP: 動的なインスタンスの子の差し替えは動的なIASのリビルドを伴い、階層数が再計算される。
+        //     設定した上限を超える場合はビルドが失敗し、上限を上げれば次のビルドで反映される。
+        partitionedIas.setTraversableGraphDepthLimit(3);
+        insts[5].setChild(xfm);
+        EXPECT_EXCEPTION(partitionedIas.build(stream));
+        EXPECT_TRUE(partitionedIas.isDynamicChild(insts[5]));
+        partitionedIas.setTraversableGraphDepthLimit(4);
+        partitionedIas.build(stream);
+        EXPECT_EQ(partitionedIas.getMaxTraversableGraphDepth(), 4u);
+        insts[5].setChild(gas);
+        partitionedIas.build(stream);
+        EXPECT_TRUE(partitionedIas.isDynamicChild(insts[5]));
+        EXPECT_EQ(partitionedIas.getMaxTraversableGraphDepth(), 3u);
+
+        // JP: 子が全て静的になっても辿れる状態を保つ。
+        for (uint32_t frame = 0; frame < 3; ++frame)
+            EXPECT_NE(partitionedIas.build(stream), 0u);
+        EXPECT_EQ(partitionedIas.getNumDynamicChildren(), 0u);
+        EXPECT_EQ(partitionedIas.getHandle(), partitionedIas.build(stream));
+
+        // JP: 破棄時に全てのメモリがアロケーターに返却される。
+        partitionedIas.destroy();
+        EXPECT_EQ(allocator.numLiveAllocations, numAllocationsBeforePartitioning);
+
+        xfmInst.destroy();
+        xfm.destroy();
+        for (uint32_t i = 0; i < numInstances; ++i)
+            insts[i].destroy();
+        gas.destroy();
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+        scene.destroy();
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+// JP: タスクの値を残りの深さとして、各タスクが一つ浅いタスクを最大3つ生成する偽のタスクソース。
+class FakeModuleCompileTaskSource : public optixu::ModuleCompileTaskSource {
+public:
+    std::atomic<uint32_t> numExecutedTasks{ 0 };
+    std::atomic<uint32_t> numConcurrentTasks{ 0 };
+    std::atomic<uint32_t> maxNumConcurrentTasks{ 0 };
+    uintptr_t failingDepth = 0;
+
+    void execute(
+        OptixTask task, OptixTask* newTasks, uint32_t maxNumNewTasks, uint32_t* numNewTasks) override {
+        uint32_t numConcurrent = ++numConcurrentTasks;
+        uint32_t prevMax = maxNumConcurrentTasks;
+        while (numConcurrent > prevMax && !maxNumConcurrentTasks.compare_exchange_weak(prevMax, numConcurrent));
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        ++numExecutedTasks;
+        --numConcurrentTasks;
+
+        uintptr_t depth = reinterpret_cast<uintptr_t>(task);
+        if (depth == failingDepth)
+            throw std::runtime_error("Compile task failed.");
+        *numNewTasks = 0;
+        if (depth <= 1)
+            return;
+        for (uint32_t i = 0; i < std::min(maxNumNewTasks, 3u); ++i)
+            newTasks[(*numNewTasks)++] = reinterpret_cast<OptixTask>(depth - 1);
+    }
+};
+
+TEST(PipelineTest, ModuleCompileJob) {
+    try {
+        // JP: 深さ4の木のタスクは1 + 3 + 9 + 27個。
+        constexpr uintptr_t depth = 4;
+        constexpr uint32_t numTasksPerModule = 1 + 3 + 9 + 27;
+
+        // JP: スレッドプールが無い場合は待機時に呼び出し元スレッドで全てのタスクが実行される。
+        //     実行ごとに生成されるタスクは1つに制限される。
+        {
+            FakeModuleCompileTaskSource taskSource;
+            auto job = std::make_shared<optixu::ModuleCompileJob>(nullptr, &taskSource);
+            job->start(reinterpret_cast<OptixTask>(depth));
+            EXPECT_FALSE(job->isFinished());
+            EXPECT_EQ(taskSource.numExecutedTasks, 0u);
+            job->wait();
+            EXPECT_TRUE(job->isFinished());
+            EXPECT_EQ(taskSource.numExecutedTasks, static_cast<uint32_t>(depth));
+            EXPECT_EQ(taskSource.maxNumConcurrentTasks, 1u);
+        }
+
+        optixu::WorkerThreadPool threadPool(4);
+
+        // JP: 複数のモジュールのタスク、およびモジュール内のタスクが並行に実行される。
+        {
+            FakeModuleCompileTaskSource taskSource;
+            constexpr uint32_t numModules = 3;
+            std::shared_ptr<optixu::ModuleCompileJob> jobs[numModules];
+            for (uint32_t i = 0; i < numModules; ++i) {
+                jobs[i] = std::make_shared<optixu::ModuleCompileJob>(&threadPool, &taskSource);
+                jobs[i]->start(reinterpret_cast<OptixTask>(depth));
+            }
+            for (uint32_t i = 0; i < numModules; ++i) {
+                jobs[i]->wait();
+                EXPECT_TRUE(jobs[i]->isFinished());
+            }
+            EXPECT_EQ(taskSource.numExecutedTasks, numModules * numTasksPerModule);
+            EXPECT_GT(taskSource.maxNumConcurrentTasks, 1u);
+            EXPECT_LE(taskSource.maxNumConcurrentTasks, threadPool.getNumThreads() + 1);
+        }
+
+        // JP: タスクの失敗は残りのタスクを破棄し、待機時に再送出される。
+        {
+            FakeModuleCompileTaskSource taskSource;
+            taskSource.failingDepth = 2;
+            auto job = std::make_shared<optixu::ModuleCompileJob>(&threadPool, &taskSource);
+            job->start(reinterpret_cast<OptixTask>(depth));
+            EXPECT_EXCEPTION(job->wait());
+            EXPECT_TRUE(job->isFinished());
+            EXPECT_LT(taskSource.numExecutedTasks, numTasksPerModule);
+            // JP: 失敗後の待機も同じ例外を送出する。
+            EXPECT_EXCEPTION(job->wait());
+        }
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(PipelineTest, AsyncModuleCreation) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+        context.setNumWorkerThreads(2);
+
+        optixu::Pipeline pipeline = context.createPipeline();
+        pipeline.setPipelineOptions(
+            shared::Pipeline0Payload0Signature::numDwords,
+            optixu::calcSumDwords<float2>(),
+            "plp", sizeof(shared::PipelineLaunchParameters0),
+            OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_ANY,
+            OPTIX_EXCEPTION_FLAG_DEBUG,
+            OPTIX_PRIMITIVE_TYPE_FLAGS_TRIANGLE);
+
+        const std::vector<char> optixIr = readBinaryFile(getExecutableDirectory() / "optixu_tests/ptxes/kernels_0.optixir");
+        // JP: 非同期に生成したモジュールからもプログラムを生成できる。プログラムの生成時に完了を待つ。
+        optixu::Module modules[2];
+        for (uint32_t i = 0; i < 2; ++i) {
+            modules[i] = pipeline.createModuleFromOptixIRAsync(
+                optixIr, OPTIX_COMPILE_DEFAULT_MAX_REGISTER_COUNT,
+                DEBUG_SELECT(OPTIX_COMPILE_OPTIMIZATION_LEVEL_0, OPTIX_COMPILE_OPTIMIZATION_DEFAULT),
+                DEBUG_SELECT(OPTIX_COMPILE_DEBUG_LEVEL_FULL, OPTIX_COMPILE_DEBUG_LEVEL_NONE));
+        }
+        optixu::Program rayGenProgram = pipeline.createRayGenProgram(modules[0], RT_RG_NAME_STR("rg0"));
+        EXPECT_TRUE(modules[0].isReady());
+        modules[1].wait();
+        EXPECT_TRUE(modules[1].isReady());
+
+        rayGenProgram.destroy();
+        modules[1].destroy();
+        modules[0].destroy();
+        pipeline.destroy();
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(PipelineTest, ProgramCacheKey) {
+    try {
+        const char* ptx0 = "ptx0";
+        const char* ptx1 = "ptx1";
+        int32_t boundValue0 = 1;
+        int32_t boundValue1 = 2;
+
+        OptixPipelineCompileOptions pipelineOptions = {};
+        pipelineOptions.numPayloadValues = 2;
+        pipelineOptions.pipelineLaunchParamsVariableName = "plp";
+
+        OptixModuleCompileBoundValueEntry boundValueEntry = {};
+        boundValueEntry.pipelineParamOffsetInBytes = 4;
+        boundValueEntry.sizeInBytes = sizeof(boundValue0);
+        boundValueEntry.boundValuePtr = &boundValue0;
+
+        OptixModuleCompileOptions moduleOptions = {};
+        moduleOptions.optLevel = OPTIX_COMPILE_OPTIMIZATION_DEFAULT;
+        moduleOptions.boundValues = &boundValueEntry;
+        moduleOptions.numBoundValues = 1;
+
+        const uint64_t key = optixu::computeModuleCacheKey(ptx0, 4, moduleOptions, pipelineOptions);
+        EXPECT_EQ(optixu::computeModuleCacheKey(ptx0, 4, moduleOptions, pipelineOptions), key);
+
+        // JP: 入力のバイト列、コンパイルオプション、バインドする値の中身、パイプラインのオプションが
+        //     異なる場合はキーも異なる。
+        EXPECT_NE(optixu::computeModuleCacheKey(ptx1, 4, moduleOptions, pipelineOptions), key);
+        {
+            OptixModuleCompileOptions options = moduleOptions;
+            options.optLevel = OPTIX_COMPILE_OPTIMIZATION_LEVEL_0;
+            EXPECT_NE(optixu::computeModuleCacheKey(ptx0, 4, options, pipelineOptions), key);
+        }
+        {
+            boundValueEntry.boundValuePtr = &boundValue1;
+            EXPECT_NE(optixu::computeModuleCacheKey(ptx0, 4, moduleOptions, pipelineOptions), key);
+            boundValueEntry.boundValuePtr = &boundValue0;
+        }
+        {
+            // JP: 起動パラメーター名はポインターではなく中身で比較される。
+            std::string name = "plp";
+            OptixPipelineCompileOptions options = pipelineOptions;
+            options.pipelineLaunchParamsVariableName = name.c_str();
+            EXPECT_EQ(optixu::computeModuleCacheKey(ptx0, 4, moduleOptions, options), key);
+            options.pipelineLaunchParamsVariableName = "plp1";
+            EXPECT_NE(optixu::computeModuleCacheKey(ptx0, 4, moduleOptions, options), key);
+        }
+
+        const OptixModule module = reinterpret_cast<OptixModule>(0x10);
+        const OptixModule unknownModule = reinterpret_cast<OptixModule>(0x20);
+        std::unordered_map<OptixModule, uint64_t> moduleKeys;
+        moduleKeys[module] = key;
+
+        OptixProgramGroupDesc desc = {};
+        desc.kind = OPTIX_PROGRAM_GROUP_KIND_RAYGEN;
+        desc.raygen.module = module;
+        desc.raygen.entryFunctionName = "__raygen__rg0";
+        OptixProgramGroupOptions groupOptions = {};
+
+        uint64_t groupKey;
+        EXPECT_TRUE(optixu::computeProgramGroupCacheKey(
+            desc, groupOptions, pipelineOptions, moduleKeys, &groupKey));
+
+        uint64_t otherGroupKey;
+        std::string entryName = "__raygen__rg0";
+        desc.raygen.entryFunctionName = entryName.c_str();
+        EXPECT_TRUE(optixu::computeProgramGroupCacheKey(
+            desc, groupOptions, pipelineOptions, moduleKeys, &otherGroupKey));
+        EXPECT_EQ(otherGroupKey, groupKey);
+
+        desc.raygen.entryFunctionName = "__raygen__rg1";
+        EXPECT_TRUE(optixu::computeProgramGroupCacheKey(
+            desc, groupOptions, pipelineOptions, moduleKeys, &otherGroupKey));
+        EXPECT_NE(otherGroupKey, groupKey);
+
+        // JP: キャッシュに無いモジュールを参照するプログラムグループはキャッシュできない。
+        desc.raygen.module = unknownModule;
+        EXPECT_FALSE(optixu::computeProgramGroupCacheKey(
+            desc, groupOptions, pipelineOptions, moduleKeys, &otherGroupKey));
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(PipelineTest, ProgramCache) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+        context.setProgramCacheEnabled(true);
+
+        const std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / "optixu_tests_cache";
+        context.setDiskCache(true, cacheDir.string().c_str());
+        EXPECT_TRUE(context.getDiskCache());
+
+        const std::vector<char> optixIr = readBinaryFile(getExecutableDirectory() / "optixu_tests/ptxes/kernels_0.optixir");
+
+        // JP: 同じオプションを持つパイプライン間ではモジュールとプログラムが共有される。
+        optixu::Pipeline pipelines[3];
+        optixu::Module modules[3];
+        optixu::Program rayGenPrograms[3];
+        for (uint32_t i = 0; i < 3; ++i) {
+            pipelines[i] = context.createPipeline();
+            pipelines[i].setPipelineOptions(
+                shared::Pipeline0Payload0Signature::numDwords,
+                optixu::calcSumDwords<float2>(),
+                "plp", sizeof(shared::PipelineLaunchParameters0),
+                OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_ANY,
+                i < 2 ? OPTIX_EXCEPTION_FLAG_DEBUG : OPTIX_EXCEPTION_FLAG_NONE,
+                OPTIX_PRIMITIVE_TYPE_FLAGS_TRIANGLE);
+            modules[i] = pipelines[i].createModuleFromOptixIR(
+                optixIr, OPTIX_COMPILE_DEFAULT_MAX_REGISTER_COUNT,
+                DEBUG_SELECT(OPTIX_COMPILE_OPTIMIZATION_LEVEL_0, OPTIX_COMPILE_OPTIMIZATION_DEFAULT),
+                DEBUG_SELECT(OPTIX_COMPILE_DEBUG_LEVEL_FULL, OPTIX_COMPILE_DEBUG_LEVEL_NONE));
+            rayGenPrograms[i] = pipelines[i].createRayGenProgram(modules[i], RT_RG_NAME_STR("rg0"));
+        }
+
+        EXPECT_EQ(optixu::extract(modules[0])->getRawModule(), optixu::extract(modules[1])->getRawModule());
+        EXPECT_NE(optixu::extract(modules[0])->getRawModule(), optixu::extract(modules[2])->getRawModule());
+        EXPECT_EQ(
+            optixu::extract(rayGenPrograms[0])->getRawProgramGroup(),
+            optixu::extract(rayGenPrograms[1])->getRawProgramGroup());
+        EXPECT_NE(
+            optixu::extract(rayGenPrograms[0])->getRawProgramGroup(),
+            optixu::extract(rayGenPrograms[2])->getRawProgramGroup());
+
+        uint32_t numModules, numProgramGroups;
+        context.getProgramCacheStats(&numModules, &numProgramGroups);
+        EXPECT_EQ(numModules, 2);
+        EXPECT_EQ(numProgramGroups, 2);
+
+        // JP: 共有されたオブジェクトは最後の参照が破棄されるまで残る。
+        rayGenPrograms[0].destroy();
+        modules[0].destroy();
+        context.getProgramCacheStats(&numModules, &numProgramGroups);
+        EXPECT_EQ(numModules, 2);
+        EXPECT_EQ(numProgramGroups, 2);
+
+        for (uint32_t i = 1; i < 3; ++i) {
+            rayGenPrograms[i].destroy();
+            modules[i].destroy();
+            pipelines[i].destroy();
+        }
+        pipelines[0].destroy();
+        context.getProgramCacheStats(&numModules, &numProgramGroups);
+        EXPECT_EQ(numModules, 0);
+        EXPECT_EQ(numProgramGroups, 0);
+
+        context.setDiskCache(false);
+        EXPECT_FALSE(context.getDiskCache());
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(PipelineTest, ProgramGroupBatch) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Pipeline pipeline = context.createPipeline();
+        pipeline.setPipelineOptions(
+            shared::Pipeline0Payload0Signature::numDwords,
+            optixu::calcSumDwords<float2>(),
+            "plp", sizeof(shared::PipelineLaunchParameters0),
+            OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_ANY,
+            OPTIX_EXCEPTION_FLAG_DEBUG,
+            OPTIX_PRIMITIVE_TYPE_FLAGS_TRIANGLE);
+
+        const std::vector<char> optixIr = readBinaryFile(getExecutableDirectory() / "optixu_tests/ptxes/kernels_0.optixir");
+        optixu::Module module = pipeline.createModuleFromOptixIR(
+            optixIr, OPTIX_COMPILE_DEFAULT_MAX_REGISTER_COUNT,
+            DEBUG_SELECT(OPTIX_COMPILE_OPTIMIZATION_LEVEL_0, OPTIX_COMPILE_OPTIMIZATION_DEFAULT),
+            DEBUG_SELECT(OPTIX_COMPILE_DEBUG_LEVEL_FULL, OPTIX_COMPILE_DEBUG_LEVEL_NONE));
+        optixu::Module emptyModule;
+
+        pipeline.beginProgramGroupBatch();
+
+        optixu::Program rayGenProgram = pipeline.createRayGenProgram(module, RT_RG_NAME_STR("rg0"));
+        optixu::Program missProgram = pipeline.createMissProgram(module, RT_MS_NAME_STR("ms0"));
+        optixu::HitProgramGroup hitProgramGroups[2];
+        for (uint32_t i = 0; i < 2; ++i) {
+            // JP: エントリー関数名はバッチ内でコピーされるので一時的な文字列でも良い。
+            std::string entryName = i == 0 ? RT_CH_NAME_STR("ch0") : RT_CH_NAME_STR("ch1");
+            hitProgramGroups[i] = pipeline.createHitProgramGroupForTriangleIS(
+                module, entryName.c_str(),
+                emptyModule, nullptr);
+        }
+        optixu::CallableProgramGroup callableProgramGroup = pipeline.createCallableProgramGroup(
+            module, RT_DC_NAME_STR("dc0"),
+            emptyModule, nullptr);
+        // JP: バッチ中に破棄したプログラムグループは生成されない。
+        optixu::HitProgramGroup discardedHitProgramGroup = pipeline.createHitProgramGroupForTriangleIS(
+            module, RT_CH_NAME_STR("ch0"),
+            module, RT_AH_NAME_STR("ah0"));
+        discardedHitProgramGroup.destroy();
+
+        // JP: バッチの終了まではプログラムグループが生成されない。
+        EXPECT_EQ(optixu::extract(rayGenProgram)->getRawProgramGroup(), nullptr);
+        EXPECT_EQ(optixu::extract(hitProgramGroups[1])->getRawProgramGroup(), nullptr);
+
+        // JP: 生成待ちのプログラム(グループ)は使用できない。
+        optixu::Material material = context.createMaterial();
+        EXPECT_EXCEPTION(pipeline.setRayGenerationProgram(rayGenProgram));
+        EXPECT_EXCEPTION(material.setHitGroup(0, hitProgramGroups[0]));
+        uint8_t record[OPTIX_SBT_RECORD_HEADER_SIZE];
+        EXPECT_EXCEPTION(optixu::extract(hitProgramGroups[0])->packHeader(record));
+
+        // JP: 生成に失敗したバッチはいずれのプログラムグループも生成せずに継続し、
+        //     原因を破棄すれば再度終了できる。
+        //     失敗したものとは別のペイロードタイプとして先に生成されたものは解放される。
+        uint32_t numCachedModules;
+        uint32_t numCachedProgramGroups;
+        context.getProgramCacheStats(&numCachedModules, &numCachedProgramGroups);
+        optixu::PayloadType failingPayloadType;
+        failingPayloadType.numDwords = 1;
+        failingPayloadType.semantics[0] = static_cast<OptixPayloadSemantics>(
+            OPTIX_PAYLOAD_SEMANTICS_TRACE_CALLER_READ_WRITE | OPTIX_PAYLOAD_SEMANTICS_CH_READ_WRITE);
+        optixu::HitProgramGroup failingHitProgramGroup = pipeline.createHitProgramGroupForTriangleIS(
+            module, RT_CH_NAME_STR("missing"),
+            emptyModule, nullptr,
+            failingPayloadType);
+        EXPECT_EXCEPTION(pipeline.endProgramGroupBatch());
+        EXPECT_EQ(optixu::extract(rayGenProgram)->getRawProgramGroup(), nullptr);
+        EXPECT_EQ(optixu::extract(hitProgramGroups[0])->getRawProgramGroup(), nullptr);
+        uint32_t numCachedProgramGroupsAfterFailure;
+        context.getProgramCacheStats(&numCachedModules, &numCachedProgramGroupsAfterFailure);
+        EXPECT_EQ(numCachedProgramGroupsAfterFailure, numCachedProgramGroups);
+        failingHitProgramGroup.destroy();
+
+        pipeline.endProgramGroupBatch();
+
+        std::unordered_set<OptixProgramGroup> rawGroups;
+        rawGroups.insert(optixu::extract(rayGenProgram)->getRawProgramGroup());
+        rawGroups.insert(optixu::extract(missProgram)->getRawProgramGroup());
+        rawGroups.insert(optixu::extract(hitProgramGroups[0])->getRawProgramGroup());
+        rawGroups.insert(optixu::extract(hitProgramGroups[1])->getRawProgramGroup());
+        rawGroups.insert(optixu::extract(callableProgramGroup)->getRawProgramGroup());
+        EXPECT_EQ(rawGroups.size(), 5);
+        EXPECT_EQ(rawGroups.count(nullptr), 0);
+
+        pipeline.link(1);
+        pipeline.computeStackSizes(1, 0, 1);
+
+        pipeline.setRayGenerationProgram(rayGenProgram);
+        material.setHitGroup(0, hitProgramGroups[0]);
+
+        material.destroy();
+        callableProgramGroup.destroy();
+        hitProgramGroups[1].destroy();
+        hitProgramGroups[0].destroy();
+        missProgram.destroy();
+        rayGenProgram.destroy();
+        module.destroy();
+        pipeline.destroy();
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(PipelineTest, StackSizeComputation) {
+    try {
+        // JP: 各フィールドごとに最大値が集計される。
+        OptixStackSizes accumulated = {};
+        OptixStackSizes rgStackSizes = {};
+        rgStackSizes.cssRG = 64;
+        OptixStackSizes msStackSizes = {};
+        msStackSizes.cssMS = 16;
+        OptixStackSizes hgStackSizes0 = {};
+        hgStackSizes0.cssCH = 96;
+        hgStackSizes0.cssAH = 8;
+        OptixStackSizes hgStackSizes1 = {};
+        hgStackSizes1.cssCH = 32;
+        hgStackSizes1.cssAH = 40;
+        hgStackSizes1.cssIS = 72;
+        OptixStackSizes cpStackSizes = {};
+        cpStackSizes.cssCC = 24;
+        cpStackSizes.dssDC = 48;
+        optixu::accumulateStackSizes(rgStackSizes, &accumulated);
+        optixu::accumulateStackSizes(msStackSizes, &accumulated);
+        optixu::accumulateStackSizes(hgStackSizes0, &accumulated);
+        optixu::accumulateStackSizes(hgStackSizes1, &accumulated);
+        optixu::accumulateStackSizes(cpStackSizes, &accumulated);
+        EXPECT_EQ(accumulated.cssRG, 64);
+        EXPECT_EQ(accumulated.cssMS, 16);
+        EXPECT_EQ(accumulated.cssCH, 96);
+        EXPECT_EQ(accumulated.cssAH, 40);
+        EXPECT_EQ(accumulated.cssIS, 72);
+        EXPECT_EQ(accumulated.cssCC, 24);
+        EXPECT_EQ(accumulated.dssDC, 48);
+
+        uint32_t dcStackSizeFromTraversal;
+        uint32_t dcStackSizeFromState;
+        uint32_t continuationStackSize;
+
+        // JP: トレースもcallableも呼ばない場合はRGのみ。
+        optixu::calcPipelineStackSizes(
+            accumulated, 0, 0, 0,
+            &dcStackSizeFromTraversal, &dcStackSizeFromState, &continuationStackSize);
+        EXPECT_EQ(dcStackSizeFromTraversal, 0);
+        EXPECT_EQ(dcStackSizeFromState, 0);
+        EXPECT_EQ(continuationStackSize, 64);
+
+        // JP: 深さ1のトレースでは max(CH, MS) と IS + AH の大きい方を使う。
+        //     64 + max(96, 72 + 40)
+        optixu::calcPipelineStackSizes(
+            accumulated, 1, 0, 0,
+            &dcStackSizeFromTraversal, &dcStackSizeFromState, &continuationStackSize);
+        EXPECT_EQ(continuationStackSize, 64 + 112);
+
+        // JP: CCの木はRGとトレースの各段に積まれる。DCは深さに比例する。
+        //     cssCCTree = 2 * 24 = 48, cssCHOrMSPlusCCTree = 96 + 48 = 144
+        //     64 + 48 + (3 - 1) * 144 + max(144, 112)
+        optixu::calcPipelineStackSizes(
+            accumulated, 3, 2, 2,
+            &dcStackSizeFromTraversal, &dcStackSizeFromState, &continuationStackSize);
+        EXPECT_EQ(dcStackSizeFromTraversal, 2 * 48);
+        EXPECT_EQ(dcStackSizeFromState, 2 * 48);
+        EXPECT_EQ(continuationStackSize, 64 + 48 + 2 * 144 + 144);
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(PipelineTest, LaunchGraph) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        CountingASMemoryAllocator allocator;
+
+        constexpr uint32_t numTriangles = 100;
+        CUdeviceptr vertexMem;
+        CUDADRV_CHECK(cuMemAlloc(&vertexMem, 3 * numTriangles * sizeof(float) * 3));
+        optixu::Material mat = context.createMaterial();
+        optixu::GeometryInstance geomInst = scene.createGeometryInstance();
+        geomInst.setVertexBuffer(optixu::BufferView(vertexMem, 3 * numTriangles, sizeof(float) * 3));
+        geomInst.setMaterial(0, 0, mat);
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        gas.setConfiguration(
+            optixu::ASTradeoff::PreferFastTrace, optixu::AllowUpdate::No, optixu::AllowCompaction::No);
+        gas.addChild(geomInst);
+
+        CUdeviceptr plpOnDevice;
+        CUDADRV_CHECK(cuMemAlloc(&plpOnDevice, sizeof(shared::PipelineLaunchParameters0)));
+
+        optixu::LaunchGraph launchGraph = optixu::LaunchGraph::create();
+        launchGraph.addAccelerationStructure(gas);
+
+        uint32_t numRecords = 0;
+        const auto record = [&numRecords, plpOnDevice](CUstream stream) {
+            CUDADRV_CHECK(cuMemsetD8Async(plpOnDevice, 0, sizeof(shared::PipelineLaunchParameters0), stream));
+            ++numRecords;
+        };
+
+        // JP: 初回のみキャプチャーし、以降はグラフを再実行する。
+        for (uint32_t frame = 0; frame < 3; ++frame)
+            launchGraph.launch(stream, record);
+        EXPECT_EQ(numRecords, 1);
+        EXPECT_EQ(launchGraph.getNumInstantiations(), 1);
+
+        // JP: ASのハンドルが変わると再キャプチャーする。
+        size_t sbtSize;
+        scene.generateShaderBindingTableLayout(&sbtSize);
+        scene.buildDirty(stream, &allocator);
+        EXPECT_NE(gas.getHandle(), 0u);
+        for (uint32_t frame = 0; frame < 2; ++frame)
+            launchGraph.launch(stream, record);
+        EXPECT_EQ(numRecords, 2);
+        EXPECT_EQ(launchGraph.getNumInstantiations(), 2);
+
+        // JP: 明示的に無効化した場合も再キャプチャーする。
+        launchGraph.invalidate();
+        launchGraph.launch(stream, record);
+        EXPECT_EQ(numRecords, 3);
+        EXPECT_EQ(launchGraph.getNumInstantiations(), 3);
+
+        // JP: 記録中の例外は呼び出し側に伝わり、次回に再キャプチャーする。
+        launchGraph.invalidate();
+        EXPECT_EXCEPTION(launchGraph.launch(stream, [](CUstream) {
+            throw std::runtime_error("Record failure.");
+        }));
+        launchGraph.launch(stream, record);
+        EXPECT_EQ(numRecords, 4);
+        EXPECT_EQ(launchGraph.getNumInstantiations(), 4);
+
+        launchGraph.destroy();
+
+        CUDADRV_CHECK(cuMemFree(plpOnDevice));
+        gas.destroy();
+        geomInst.destroy();
+        mat.destroy();
+        CUDADRV_CHECK(cuMemFree(vertexMem));
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+        scene.destroy();
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(PipelineTest, LaunchGraphWithPipeline) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        optixu::Pipeline pipeline = context.createPipeline();
+        pipeline.setPipelineOptions(
+            shared::Pipeline0Payload0Signature::numDwords,
+            optixu::calcSumDwords<float2>(),
+            "plp", sizeof(shared::PipelineLaunchParameters0),
+            OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_ANY,
+            OPTIX_EXCEPTION_FLAG_DEBUG,
+            OPTIX_PRIMITIVE_TYPE_FLAGS_TRIANGLE);
+
+        const std::vector<char> optixIr = readBinaryFile(getExecutableDirectory() / "optixu_tests/ptxes/kernels_0.optixir");
+        optixu::Module module = pipeline.createModuleFromOptixIR(
+            optixIr, OPTIX_COMPILE_DEFAULT_MAX_REGISTER_COUNT,
+            DEBUG_SELECT(OPTIX_COMPILE_OPTIMIZATION_LEVEL_0, OPTIX_COMPILE_OPTIMIZATION_DEFAULT),
+            DEBUG_SELECT(OPTIX_COMPILE_DEBUG_LEVEL_FULL, OPTIX_COMPILE_DEBUG_LEVEL_NONE));
+        optixu::Module emptyModule;
+
+        optixu::Program rayGenProgram = pipeline.createRayGenProgram(module, RT_RG_NAME_STR("rg0"));
+        optixu::Program missProgram = pipeline.createMissProgram(module, RT_MS_NAME_STR("ms0"));
+        optixu::HitProgramGroup hitProgramGroup = pipeline.createHitProgramGroupForTriangleIS(
+            module, RT_CH_NAME_STR("ch0"),
+            emptyModule, nullptr);
+        pipeline.link(1);
+        pipeline.setRayGenerationProgram(rayGenProgram);
+        pipeline.setNumMissRayTypes(1);
+        pipeline.setMissProgram(0, missProgram);
+
+        optixu::Scene scene = context.createScene();
+
+        CUdeviceptr vertexMem;
+        CUDADRV_CHECK(cuMemAlloc(&vertexMem, 3 * sizeof(float) * 3));
+        optixu::Material mat = context.createMaterial();
+        mat.setHitGroup(0, hitProgramGroup);
+        optixu::GeometryInstance geomInst = scene.createGeometryInstance();
+        geomInst.setVertexBuffer(optixu::BufferView(vertexMem, 3, sizeof(float) * 3));
+        geomInst.setMaterial(0, 0, mat);
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        gas.setNumRayTypes(0, 1);
+        gas.addChild(geomInst);
+
+        constexpr uint32_t numInsts = 4;
+        optixu::Instance insts[numInsts];
+        optixu::InstanceAccelerationStructure ias = scene.createInstanceAccelerationStructure();
+        ias.setConfiguration(
+            optixu::ASTradeoff::PreferFastBuild,
+            optixu::AllowUpdate::Yes,
+            optixu::AllowCompaction::No);
+        for (uint32_t i = 0; i < numInsts; ++i) {
+            insts[i] = scene.createInstance();
+            insts[i].setChild(gas);
+            ias.addChild(insts[i]);
+        }
+
+        size_t hitGroupSbtSize;
+        scene.generateShaderBindingTableLayout(&hitGroupSbtSize);
+
+        OptixAccelBufferSizes gasMemReq;
+        gas.prepareForBuild(&gasMemReq);
+        OptixAccelBufferSizes iasMemReq;
+        ias.prepareForBuild(&iasMemReq);
+        size_t scratchSize = std::max({
+            gasMemReq.tempSizeInBytes, iasMemReq.tempSizeInBytes, iasMemReq.tempUpdateSizeInBytes });
+        CUdeviceptr gasMem, iasMem, instMem, scratchMem;
+        CUDADRV_CHECK(cuMemAlloc(&gasMem, gasMemReq.outputSizeInBytes));
+        CUDADRV_CHECK(cuMemAlloc(&iasMem, iasMemReq.outputSizeInBytes));
+        CUDADRV_CHECK(cuMemAlloc(&instMem, sizeof(OptixInstance) * numInsts));
+        CUDADRV_CHECK(cuMemAlloc(&scratchMem, scratchSize));
+        optixu::BufferView scratchBuffer(scratchMem, scratchSize, 1);
+
+        gas.rebuild(stream, optixu::BufferView(gasMem, gasMemReq.outputSizeInBytes, 1), scratchBuffer);
+        ias.rebuild(
+            stream,
+            optixu::BufferView(instMem, numInsts, sizeof(OptixInstance)),
+            optixu::BufferView(iasMem, iasMemReq.outputSizeInBytes, 1),
+            scratchBuffer);
+
+        pipeline.setScene(scene);
+        size_t sbtSize;
+        pipeline.generateShaderBindingTableLayout(&sbtSize);
+        CUdeviceptr sbtMem, hitGroupSbtMem, plpOnDevice;
+        CUDADRV_CHECK(cuMemAlloc(&sbtMem, sbtSize));
+        CUDADRV_CHECK(cuMemAlloc(&hitGroupSbtMem, hitGroupSbtSize));
+        CUDADRV_CHECK(cuMemAlloc(&plpOnDevice, sizeof(shared::PipelineLaunchParameters0)));
+        std::vector<uint8_t> sbtHostMem(sbtSize);
+        std::vector<uint8_t> hitGroupSbtHostMem(hitGroupSbtSize);
+        pipeline.setShaderBindingTable(optixu::BufferView(sbtMem, sbtSize, 1), sbtHostMem.data());
+        pipeline.setHitGroupShaderBindingTable(
+            optixu::BufferView(hitGroupSbtMem, hitGroupSbtSize, 1), hitGroupSbtHostMem.data());
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+
+        auto readInstance = [&](uint32_t instIdx) {
+            OptixInstance instance;
+            CUDADRV_CHECK(cuMemcpyDtoH(
+                &instance, instMem + sizeof(OptixInstance) * instIdx, sizeof(instance)));
+            return instance;
+        };
+
+        uint32_t numRecords = 0;
+        const auto record = [&](CUstream stream) {
+            ias.update(stream, scratchBuffer);
+            pipeline.launch(stream, plpOnDevice, 16, 16, 1);
+            ++numRecords;
+        };
+
+        optixu::LaunchGraph launchGraph = optixu::LaunchGraph::create();
+        launchGraph.addPipeline(pipeline);
+        launchGraph.addAccelerationStructure(gas);
+        launchGraph.addAccelerationStructure(ias);
+
+        // JP: IASのアップデートとローンチをキャプチャーし、変更が無ければグラフを再実行する。
+        for (uint32_t frame = 0; frame < 3; ++frame)
+            launchGraph.launch(stream, record);
+        EXPECT_EQ(numRecords, 1);
+        EXPECT_EQ(launchGraph.getNumInstantiations(), 1);
+
+        // JP: インスタンスの変更は再キャプチャーを引き起こさず、グラフの実行後のインスタンスバッファーに反映される。
+        float movedTransform[] = {
+            1, 0, 0, 5,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+        };
+        for (uint32_t frame = 0; frame < 3; ++frame) {
+            movedTransform[3] = static_cast<float>(5 + frame);
+            insts[1].setTransform(movedTransform);
+            launchGraph.launch(stream, record);
+            CUDADRV_CHECK(cuStreamSynchronize(stream));
+            EXPECT_EQ(readInstance(1).transform[3], static_cast<float>(5 + frame));
+            EXPECT_EQ(readInstance(0).transform[3], 0.0f);
+        }
+        EXPECT_EQ(numRecords, 1);
+        EXPECT_EQ(launchGraph.getNumInstantiations(), 1);
+
+        // JP: グラフの外でのアップデートとグラフの実行を混在させても変更は失われない。
+        movedTransform[3] = 9.0f;
+        insts[3].setTransform(movedTransform);
+        ias.update(stream, scratchBuffer);
+        movedTransform[3] = 10.0f;
+        insts[0].setTransform(movedTransform);
+        launchGraph.launch(stream, record);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        EXPECT_EQ(readInstance(3).transform[3], 9.0f);
+        EXPECT_EQ(readInstance(0).transform[3], 10.0f);
+        EXPECT_EQ(launchGraph.getNumInstantiations(), 1);
+
+        // JP: ASのハンドルの変化は再キャプチャーを引き起こす。
+        CUdeviceptr otherIasMem;
+        CUDADRV_CHECK(cuMemAlloc(&otherIasMem, iasMemReq.outputSizeInBytes));
+        ias.rebuild(
+            stream,
+            optixu::BufferView(instMem, numInsts, sizeof(OptixInstance)),
+            optixu::BufferView(otherIasMem, iasMemReq.outputSizeInBytes, 1),
+            scratchBuffer);
+        launchGraph.launch(stream, record);
+        EXPECT_EQ(numRecords, 2);
+        EXPECT_EQ(launchGraph.getNumInstantiations(), 2);
+
+        // JP: 登録していないIASはステージングメモリが準備されないのでキャプチャー中にアップデートできない。
+        {
+            optixu::LaunchGraph unregisteredGraph = optixu::LaunchGraph::create();
+            unregisteredGraph.addPipeline(pipeline);
+            insts[2].setTransform(movedTransform);
+            EXPECT_EXCEPTION(unregisteredGraph.launch(stream, record));
+            unregisteredGraph.destroy();
+        }
+
+        // JP: SBTリングを使うパイプラインは記録できない。
+        pipeline.setShaderBindingTableRingDepth(2);
+        EXPECT_EXCEPTION(launchGraph.launch(stream, record));
+        pipeline.setShaderBindingTableRingDepth(0);
+
+        launchGraph.destroy();
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+
+        ias.destroy();
+        for (uint32_t i = 0; i < numInsts; ++i)
+            insts[i].destroy();
+        gas.destroy();
+        geomInst.destroy();
+        mat.destroy();
+        scene.destroy();
+
+        CUDADRV_CHECK(cuMemFree(plpOnDevice));
+        CUDADRV_CHECK(cuMemFree(hitGroupSbtMem));
+        CUDADRV_CHECK(cuMemFree(sbtMem));
+        CUDADRV_CHECK(cuMemFree(scratchMem));
+        CUDADRV_CHECK(cuMemFree(instMem));
+        CUDADRV_CHECK(cuMemFree(otherIasMem));
+        CUDADRV_CHECK(cuMemFree(iasMem));
+        CUDADRV_CHECK(cuMemFree(gasMem));
+        CUDADRV_CHECK(cuMemFree(vertexMem));
+
+        hitProgramGroup.destroy();
+        missProgram.destroy();
+        rayGenProgram.destroy();
+        module.destroy();
+        pipeline.destroy();
+
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(PipelineTest, ShaderBindingTableRing) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        optixu::Pipeline pipeline = context.createPipeline();
+        pipeline.setPipelineOptions(
+            shared::Pipeline0Payload0Signature::numDwords,
+            optixu::calcSumDwords<float2>(),
+            "plp", sizeof(shared::PipelineLaunchParameters0),
+            OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_ANY,
+            OPTIX_EXCEPTION_FLAG_DEBUG,
+            OPTIX_PRIMITIVE_TYPE_FLAGS_TRIANGLE);
+
+        const std::vector<char> optixIr = readBinaryFile(getExecutableDirectory() / "optixu_tests/ptxes/kernels_0.optixir");
+        optixu::Module module = pipeline.createModuleFromOptixIR(
+            optixIr, OPTIX_COMPILE_DEFAULT_MAX_REGISTER_COUNT,
+            DEBUG_SELECT(OPTIX_COMPILE_OPTIMIZATION_LEVEL_0, OPTIX_COMPILE_OPTIMIZATION_DEFAULT),
+            DEBUG_SELECT(OPTIX_COMPILE_DEBUG_LEVEL_FULL, OPTIX_COMPILE_DEBUG_LEVEL_NONE));
+        optixu::Module emptyModule;
+
+        optixu::Program rayGenProgram = pipeline.createRayGenProgram(module, RT_RG_NAME_STR("rg0"));
+        optixu::Program missProgram = pipeline.createMissProgram(module, RT_MS_NAME_STR("ms0"));
+        optixu::HitProgramGroup hitProgramGroup = pipeline.createHitProgramGroupForTriangleIS(
+            module, RT_CH_NAME_STR("ch0"),
+            emptyModule, nullptr);
+        pipeline.link(1);
+        pipeline.setRayGenerationProgram(rayGenProgram);
+        pipeline.setNumMissRayTypes(1);
+        pipeline.setMissProgram(0, missProgram);
+
+        optixu::Scene scene = context.createScene();
+
+        CUdeviceptr vertexMem;
+        CUDADRV_CHECK(cuMemAlloc(&vertexMem, 3 * sizeof(float) * 3));
+        optixu::Material mat = context.createMaterial();
+        mat.setHitGroup(0, hitProgramGroup);
+        mat.setUserData(0u);
+        optixu::GeometryInstance geomInst = scene.createGeometryInstance();
+        geomInst.setVertexBuffer(optixu::BufferView(vertexMem, 3, sizeof(float) * 3));
+        geomInst.setMaterial(0, 0, mat);
+
+        optixu::GeometryAccelerationStructure gas = scene.createGeometryAccelerationStructure();
+        gas.setNumRayTypes(0, 1);
+        gas.addChild(geomInst);
+
+        size_t hitGroupSbtSize;
+        scene.generateShaderBindingTableLayout(&hitGroupSbtSize);
+        CountingASMemoryAllocator allocator;
+        scene.buildDirty(stream, &allocator);
+
+        pipeline.setScene(scene);
+        size_t sbtSize;
+        pipeline.generateShaderBindingTableLayout(&sbtSize);
+        CUdeviceptr sbtMem, hitGroupSbtMem, plpOnDevice;
+        CUDADRV_CHECK(cuMemAlloc(&sbtMem, sbtSize));
+        CUDADRV_CHECK(cuMemAlloc(&hitGroupSbtMem, hitGroupSbtSize));
+        CUDADRV_CHECK(cuMemAlloc(&plpOnDevice, sizeof(shared::PipelineLaunchParameters0)));
+        std::vector<uint8_t> sbtHostMem(sbtSize);
+        std::vector<uint8_t> hitGroupSbtHostMem(hitGroupSbtSize);
+        optixu::BufferView sbt(sbtMem, sbtSize, 1);
+        optixu::BufferView hitGroupSbt(hitGroupSbtMem, hitGroupSbtSize, 1);
+
+        // JP: リングが有効な間はユーザーのSBTを設定できない。
+        constexpr uint32_t ringDepth = 3;
+        pipeline.setShaderBindingTableRingDepth(ringDepth);
+        EXPECT_EQ(pipeline.getShaderBindingTableRingDepth(), ringDepth);
+        EXPECT_EXCEPTION(pipeline.setShaderBindingTable(sbt, sbtHostMem.data()));
+        EXPECT_EXCEPTION(pipeline.setHitGroupShaderBindingTable(hitGroupSbt, hitGroupSbtHostMem.data()));
+
+        // JP: マテリアルのデータはヒットグループレコードのヘッダーの直後に置かれる。
+        const optixu::_Pipeline* _pipeline = optixu::extract(pipeline);
+        const optixu::_Scene* _scene = optixu::extract(scene);
+        auto readMaterialData = [](CUdeviceptr hitGroupRecordBase) {
+            uint32_t value;
+            CUDADRV_CHECK(cuMemcpyDtoH(
+                &value, hitGroupRecordBase + OPTIX_SBT_RECORD_HEADER_SIZE, sizeof(value)));
+            return value;
+        };
+
+        // JP: SBTのセットアップが必要なローンチごとにリングの次のスロットが使われ、
+        //     各スロットのデバイス側の内容はそのローンチ時点のホスト側の状態と一致する。
+        constexpr uint32_t numFrames = 2 * ringDepth;
+        CUdeviceptr hitGroupRecordBases[numFrames];
+        CUdeviceptr rayGenRecords[numFrames];
+        for (uint32_t frame = 0; frame < numFrames; ++frame) {
+            mat.setUserData(100 + frame);
+            pipeline.markHitGroupShaderBindingTableDirty();
+            pipeline.launch(stream, plpOnDevice, 16, 16, 1);
+            CUDADRV_CHECK(cuStreamSynchronize(stream));
+
+            const OptixShaderBindingTable &sbtParams = _pipeline->getSBTParams();
+            hitGroupRecordBases[frame] = sbtParams.hitgroupRecordBase;
+            rayGenRecords[frame] = sbtParams.raygenRecord;
+            EXPECT_EQ(readMaterialData(hitGroupRecordBases[frame]), 100 + frame);
+            // JP: 全てのスロットが反映済みの変更は変更履歴から捨てられる。
+            EXPECT_LE(_scene->getNumRetainedSBTRecordEdits(), ringDepth - 1);
+            if (frame >= ringDepth) {
+                EXPECT_EQ(hitGroupRecordBases[frame], hitGroupRecordBases[frame - ringDepth]);
+                EXPECT_EQ(rayGenRecords[frame], rayGenRecords[frame - ringDepth]);
+            }
+            for (uint32_t prevFrame = frame >= ringDepth ? frame - ringDepth + 1 : 0;
+                 prevFrame < frame; ++prevFrame) {
+                EXPECT_NE(hitGroupRecordBases[frame], hitGroupRecordBases[prevFrame]);
+                EXPECT_NE(rayGenRecords[frame], rayGenRecords[prevFrame]);
+            }
+        }
+
+        // JP: 後のスロットの更新は他のスロットの内容を変えない。
+        for (uint32_t slot = 0; slot < ringDepth; ++slot) {
+            uint32_t frame = numFrames - ringDepth + slot;
+            EXPECT_EQ(readMaterialData(hitGroupRecordBases[frame]), 100 + frame);
+        }
+
+        // JP: SBTが変更されていなければスロットは進まない。
+        pipeline.launch(stream, plpOnDevice, 16, 16, 1);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        EXPECT_EQ(_pipeline->getSBTParams().hitgroupRecordBase, hitGroupRecordBases[numFrames - 1]);
+
+        // JP: リングを無効化すればユーザーのSBTを再び設定できる。
+        pipeline.setShaderBindingTableRingDepth(0);
+        pipeline.setShaderBindingTable(sbt, sbtHostMem.data());
+        pipeline.setHitGroupShaderBindingTable(hitGroupSbt, hitGroupSbtHostMem.data());
+        mat.setUserData(7u);
+        pipeline.markHitGroupShaderBindingTableDirty();
+        pipeline.launch(stream, plpOnDevice, 16, 16, 1);
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        EXPECT_EQ(_pipeline->getSBTParams().hitgroupRecordBase, hitGroupSbtMem);
+        EXPECT_EQ(readMaterialData(hitGroupSbtMem), 7u);
+        EXPECT_EQ(_scene->getNumRetainedSBTRecordEdits(), 0u);
+
+        // JP: 毎フレームの少数の変更は履歴の上限に達せず、差分更新のままである。
+        const uint32_t sbtEpoch = _scene->getSBTEpoch();
+        for (uint32_t frame = 0; frame < optixu::_Scene::s_maxNumSBTRecordEdits + 10; ++frame) {
+            mat.setUserData(frame);
+            pipeline.markHitGroupShaderBindingTableDirty();
+            pipeline.launch(stream, plpOnDevice, 16, 16, 1);
+        }
+        CUDADRV_CHECK(cuStreamSynchronize(stream));
+        EXPECT_EQ(_scene->getSBTEpoch(), sbtEpoch);
+        EXPECT_EQ(_scene->getNumRetainedSBTRecordEdits(), 0u);
+
+        gas.destroy();
+        geomInst.destroy();
+        mat.destroy();
+        scene.destroy();
+
+        CUDADRV_CHECK(cuMemFree(plpOnDevice));
+        CUDADRV_CHECK(cuMemFree(hitGroupSbtMem));
+        CUDADRV_CHECK(cuMemFree(sbtMem));
+        CUDADRV_CHECK(cuMemFree(vertexMem));
+
+        hitProgramGroup.destroy();
+        missProgram.destroy();
+        rayGenProgram.destroy();
+        module.destroy();
+        pipeline.destroy();
+
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+TEST(PipelineTest, ParallelHitGroupSBTPacking) {
+    try {
+        // JP: 積まれたタスク数を数えるユーザーのスレッドプール。
+        struct CountingThreadPool : public optixu::ThreadPool {
+            optixu::WorkerThreadPool pool;
+            std::atomic<uint32_t> numEnqueuedTasks;
+
+            CountingThreadPool(uint32_t numThreads) : pool(numThreads), numEnqueuedTasks(0) {}
+
+            uint32_t getNumThreads() const override {
+                return pool.getNumThreads();
+            }
+            void enqueue(const std::function<void()> &task) override {
+                ++numEnqueuedTasks;
+                pool.enqueue(task);
+            }
+        };
+        CountingThreadPool userThreadPool(3);
+
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        CUstream stream;
+        CUDADRV_CHECK(cuStreamCreate(&stream, 0));
+
+        optixu::Pipeline pipeline = context.createPipeline();
+        pipeline.setPipelineOptions(
+            shared::Pipeline0Payload0Signature::numDwords,
+            optixu::calcSumDwords<float2>(),
+            "plp", sizeof(shared::PipelineLaunchParameters0),
+            OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_ANY,
+            OPTIX_EXCEPTION_FLAG_DEBUG,
+            OPTIX_PRIMITIVE_TYPE_FLAGS_TRIANGLE);
+
+        const std::vector<char> optixIr = readBinaryFile(getExecutableDirectory() / "optixu_tests/ptxes/kernels_0.optixir");
+        optixu::Module module = pipeline.createModuleFromOptixIR(
+            optixIr, OPTIX_COMPILE_DEFAULT_MAX_REGISTER_COUNT,
+            DEBUG_SELECT(OPTIX_COMPILE_OPTIMIZATION_LEVEL_0, OPTIX_COMPILE_OPTIMIZATION_DEFAULT),
+            DEBUG_SELECT(OPTIX_COMPILE_DEBUG_LEVEL_FULL, OPTIX_COMPILE_DEBUG_LEVEL_NONE));
+        optixu::Module emptyModule;
+
+        optixu::HitProgramGroup hitProgramGroup = pipeline.createHitProgramGroupForTriangleIS(
+            module, RT_CH_NAME_STR("ch0"),
+            emptyModule, nullptr);
+
+        optixu::Scene scene = context.createScene();
+
+        optixu::Material mat = context.createMaterial();
+        mat.setHitGroup(0, hitProgramGroup);
+        mat.setHitGroup(1, hitProgramGroup);
+        mat.setUserData(0u);
+        optixu::Material matWithoutHitGroup = context.createMaterial();
+        matWithoutHitGroup.setUserData(0u);
+
+        // JP: タスクあたりの最小数を超えるGASのレコードは複数のスレッドで詰められる。
+        //     レコードの内容がGASごとに異なるようにユーザーデータを設定する。
+        constexpr uint32_t numGASes = 4 * optixu::_Scene::s_minNumSBTPackingUnitsPerTask + 3;
+        std::vector<optixu::GeometryInstance> geomInsts(numGASes);
+        std::vector<optixu::GeometryAccelerationStructure> gases(numGASes);
+        for (uint32_t i = 0; i < numGASes; ++i) {
+            geomInsts[i] = scene.createGeometryInstance();
+            geomInsts[i].setMaterial(0, 0, mat);
+            geomInsts[i].setUserData(i);
+            gases[i] = scene.createGeometryAccelerationStructure();
+            gases[i].setNumRayTypes(0, 1 + i % 2);
+            gases[i].setUserData(numGASes - i);
+            gases[i].addChild(geomInsts[i]);
+        }
+
+        size_t hitGroupSbtSize;
+        scene.generateShaderBindingTableLayout(&hitGroupSbtSize);
+        CUdeviceptr hitGroupSbtMem;
+        CUDADRV_CHECK(cuMemAlloc(&hitGroupSbtMem, hitGroupSbtSize));
+        optixu::BufferView hitGroupSbt(hitGroupSbtMem, hitGroupSbtSize, 1);
+
+        optixu::_Scene* _scene = optixu::extract(scene);
+        const optixu::_Pipeline* _pipeline = optixu::extract(pipeline);
+        const auto packAll = [&](std::vector<uint8_t>* hostMem) {
+            hostMem->assign(hitGroupSbtSize, 0);
+            optixu::HitGroupSBTSyncState syncState;
+            _scene->setupHitGroupSBT(stream, _pipeline, hitGroupSbt, hostMem->data(), &syncState);
+            CUDADRV_CHECK(cuStreamSynchronize(stream));
+        };
+
+        // JP: 単一スレッドでの詰め込みを基準とする。
+        std::vector<uint8_t> refHostMem;
+        packAll(&refHostMem);
+
+        // JP: 内部のスレッドプールで詰めた結果は単一スレッドの結果と一致する。
+        context.setNumWorkerThreads(3);
+        std::vector<uint8_t> hostMem;
+        packAll(&hostMem);
+        EXPECT_EQ(hostMem, refHostMem);
+
+        std::vector<uint8_t> sbtOnDevice(hitGroupSbtSize);
+        CUDADRV_CHECK(cuMemcpyDtoH(sbtOnDevice.data(), hitGroupSbtMem, hitGroupSbtSize));
+        EXPECT_EQ(sbtOnDevice, refHostMem);
+
+        // JP: ユーザーのスレッドプールが設定されていればそちらが使われる。
+        context.setThreadPool(&userThreadPool);
+        packAll(&hostMem);
+        EXPECT_EQ(hostMem, refHostMem);
+        EXPECT_GT(userThreadPool.numEnqueuedTasks.load(), 0u);
+
+        // JP: ワーカースレッドで送出された例外が呼び出し元に届き、スレッドプールはその後も使える。
+        //     最後のGASは呼び出し元のスレッドが処理する最初のタスクには含まれない。
+        geomInsts[numGASes - 1].setMaterial(0, 0, matWithoutHitGroup);
+        EXPECT_EQ(scene.shaderBindingTableLayoutIsReady(), true);
+        EXPECT_EXCEPTION(packAll(&hostMem));
+
+        geomInsts[numGASes - 1].setMaterial(0, 0, mat);
+        packAll(&hostMem);
+        EXPECT_EQ(hostMem, refHostMem);
+
+        CUDADRV_CHECK(cuMemFree(hitGroupSbtMem));
+
+        for (uint32_t i = 0; i < numGASes; ++i) {
+            gases[i].destroy();
+            geomInsts[i].destroy();
+        }
+        matWithoutHitGroup.destroy();
+        mat.destroy();
+        scene.destroy();
+
+        hitProgramGroup.destroy();
+        module.destroy();
+        pipeline.destroy();
+
+        CUDADRV_CHECK(cuStreamDestroy(stream));
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+// JP: 大量のGASに対するSBTレイアウト生成時間の計測。
+//     --gtest_also_run_disabled_testsを指定して実行する。
+TEST(SceneTest, DISABLED_SceneSBTLayoutGenerationBenchmark) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        constexpr uint32_t numGASs = 1 << 20;
+        constexpr uint32_t numIterations = 10;
+
+        std::vector<optixu::GeometryAccelerationStructure> gases(numGASs);
+        for (uint32_t i = 0; i < numGASs; ++i) {
+            gases[i] = scene.createGeometryAccelerationStructure();
+            gases[i].setNumMaterialSets(1 + i % 2);
+            gases[i].setNumRayTypes(0, 1);
+        }
+
+        double totalTime = 0.0;
+        size_t sbtSize;
+        for (uint32_t iter = 0; iter < numIterations; ++iter) {
+            scene.markShaderBindingTableLayoutDirty();
+            auto start = std::chrono::high_resolution_clock::now();
+            scene.generateShaderBindingTableLayout(&sbtSize);
+            auto end = std::chrono::high_resolution_clock::now();
+            totalTime += std::chrono::duration<double, std::milli>(end - start).count();
+        }
+        devPrintf(
+            "generateShaderBindingTableLayout() for %u GASes: %.3f [ms]\n",
+            numGASs, totalTime / numIterations);
+
+        for (optixu::GeometryAccelerationStructure &gas : gases)
+            gas.destroy();
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
+// JP: 大量のインスタンスに対する変換設定の、インスタンスあたりの時間の計測。
+//     --gtest_also_run_disabled_testsを指定して実行する。
+TEST(SceneTest, DISABLED_IASSetChildTransformsBenchmark) {
+    try {
+        optixu::Context context = optixu::Context::create(cuContext);
+
+        optixu::Scene scene = context.createScene();
+
+        constexpr uint32_t numInsts = 500000;
+        constexpr uint32_t numIterations = 10;
+
+        std::vector<optixu::Instance> insts(numInsts);
+        scene.createInstances(numInsts, insts.data());
+        optixu::InstanceAccelerationStructure ias = scene.createInstanceAccelerationStructure();
+        ias.addChildren(insts.data(), numInsts);
+
+        std::vector<float> transformData(12 * numInsts);
+        std::vector<float> rowData[3];
+        for (uint32_t r = 0; r < 3; ++r)
+            rowData[r].resize(4 * numInsts);
+        for (uint32_t i = 0; i < numInsts; ++i) {
+            for (uint32_t j = 0; j < 12; ++j) {
+                transformData[12 * i + j] = static_cast<float>(i + j);
+                rowData[j / 4][4 * i + j % 4] = static_cast<float>(i + j);
+            }
+        }
+        auto transforms = reinterpret_cast<const float (*)[12]>(transformData.data());
+        const float (*rows[3])[4];
+        for (uint32_t r = 0; r < 3; ++r)
+            rows[r] = reinterpret_cast<const float (*)[4]>(rowData[r].data());
+
+        const auto measure = [&](const char* label, const std::function<void()> &func) {
+            double totalTime = 0.0;
+            for (uint32_t iter = 0; iter < numIterations; ++iter) {
+                auto start = std::chrono::high_resolution_clock::now();
+                func();
+                auto end = std::chrono::high_resolution_clock::now();
+                totalTime += std::chrono::duration<double, std::nano>(end - start).count();
+            }
+            devPrintf(
+                "%s for %u instances: %.3f [ns/instance]\n",
+                label, numInsts, totalTime / numIterations / numInsts);
+        };
+        measure("Instance::setTransform()", [&]() {
+            for (uint32_t i = 0; i < numInsts; ++i)
+                insts[i].setTransform(transforms[i]);
+        });
+        measure("IAS::setChildTransforms() (AoS)", [&]() {
+            ias.setChildTransforms(transforms, numInsts);
+        });
+        measure("IAS::setChildTransforms() (SoA)", [&]() {
+            ias.setChildTransforms(rows[0], rows[1], rows[2], numInsts);
+        });
+
+        ias.destroy();
+        for (optixu::Instance &inst : insts)
+            inst.destroy();
+
+        scene.destroy();
+
+        context.destroy();
+    }
+    catch (std::exception &ex) {
+        printf("%s\n", ex.what());
+        EXPECT_EQ(0, 1);
+    }
+}
+
+
+
 int32_t main(int32_t argc, const char* argv[]) {
     ::testing::InitGoogleTest(&argc, const_cast<char**>(argv));
 